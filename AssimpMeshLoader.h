@@ -3,6 +3,7 @@
 //#include	"BasicMesh.h"
 //#include	"SkinnedMesh.h"
 #include	"bbox.h"
+#include	"PackedVertex.h"
 #include	<glm/gtc/type_ptr.hpp>			// for make_mat
 #include	<glm/glm.hpp>
 #include	<glm/gtc/matrix_transform.hpp>
@@ -96,6 +97,18 @@ public:
 			indices.push_back( base + face.mIndices[2] );
 		}
 	}
+
+		// load into compressed vertices, attributes are read as floats and then packed
+	template <typename Index = uint32_t>
+	static void loadAiMesh ( const aiMesh * mesh, float scale, std::vector<PackedVertex>& vertices, std::vector<Index>& indices, bbox& box, int base = 0 )
+	{
+		std::vector<UnpackedVertex>	unpacked;
+
+		loadAiMesh ( mesh, scale, unpacked, indices, box, base );
+
+		for ( auto& v : unpacked )
+			vertices.push_back ( packVertex ( v ) );
+	}
 /*			
 	static void	loadMaterials ( const aiScene * scene, std::vector<BasicMaterial*>& materials )
 	{
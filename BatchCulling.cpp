@@ -0,0 +1,350 @@
+//
+// Batch frustum culling of SoA bounding volumes
+//
+
+#include	<assert.h>
+#include	<thread>
+#include	<algorithm>
+#include	"BatchCulling.h"
+#include	"Frustum.h"
+
+#if defined(__AVX__)
+	#include	<immintrin.h>
+	#define	CULL_AVX
+	#define	CULL_LANES	8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include	<emmintrin.h>
+	#define	CULL_SSE
+	#define	CULL_LANES	4
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	#include	<arm_neon.h>
+	#define	CULL_NEON
+	#define	CULL_LANES	4
+#else
+	#define	CULL_LANES	1
+#endif
+
+#if defined(_MSC_VER)
+	#include	<intrin.h>
+	#define	popCount(x)	((size_t)__popcnt64 ( x ))
+#else
+	#define	popCount(x)	((size_t)__builtin_popcountll ( x ))
+#endif
+
+enum
+{
+	minObjectsPerThread = 16 * 1024		// smaller batches are not worth starting a thread
+};
+
+size_t	VisibilityMask :: visibleCount () const
+{
+	size_t	n = 0;
+
+	for ( auto w : words )
+		n += popCount ( w );
+
+	return n;
+}
+
+void	BatchCuller :: setPlanes ( const Frustum& frustum )
+{
+	setPlanes ( frustum.planes.data () );
+}
+
+void	BatchCuller :: setPlanes ( const glm::vec4 planes [6] )
+{
+	for ( int i = 0; i < 6; i++ )
+	{
+		nx [i] = planes [i].x;
+		ny [i] = planes [i].y;
+		nz [i] = planes [i].z;
+		d  [i] = planes [i].w;
+	}
+}
+
+void	BatchCuller :: setMatrix ( const glm::mat4& viewProj )
+{
+	Frustum	frustum;
+
+	frustum.update ( viewProj );
+
+	setPlanes ( frustum );
+}
+
+	// scalar versions, used for tails and when no SIMD is available
+static inline bool	sphereVisible ( const float * nx, const float * ny, const float * nz, const float * d, float x, float y, float z, float r )
+{
+	for ( int p = 0; p < 6; p++ )
+		if ( nx [p] * x + ny [p] * y + nz [p] * z + d [p] <= -r )
+			return false;
+
+	return true;
+}
+
+	// box is visible when its vertex farthest along plane normal is inside every plane
+static inline bool	boxVisible ( const float * nx, const float * ny, const float * nz, const float * d, const AabbSoA& b, size_t i )
+{
+	for ( int p = 0; p < 6; p++ )
+	{
+		float	x = nx [p] >= 0 ? b.maxX [i] : b.minX [i];
+		float	y = ny [p] >= 0 ? b.maxY [i] : b.minY [i];
+		float	z = nz [p] >= 0 ? b.maxZ [i] : b.minZ [i];
+
+		if ( nx [p] * x + ny [p] * y + nz [p] * z + d [p] < 0 )
+			return false;
+	}
+
+	return true;
+}
+
+#if defined(CULL_AVX)
+
+static inline uint32_t	spheresVisible ( const float * nx, const float * ny, const float * nz, const float * d, const SphereSoA& s, size_t i )
+{
+	__m256	x    = _mm256_loadu_ps ( s.x.data () + i );
+	__m256	y    = _mm256_loadu_ps ( s.y.data () + i );
+	__m256	z    = _mm256_loadu_ps ( s.z.data () + i );
+	__m256	negR = _mm256_sub_ps   ( _mm256_setzero_ps (), _mm256_loadu_ps ( s.r.data () + i ) );
+	__m256	vis  = _mm256_castsi256_ps ( _mm256_set1_epi32 ( -1 ) );
+
+	for ( int p = 0; p < 6; p++ )
+	{
+		__m256	dist = _mm256_add_ps ( _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( nx [p] ), x ), _mm256_mul_ps ( _mm256_set1_ps ( ny [p] ), y ) ),
+									   _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( nz [p] ), z ), _mm256_set1_ps ( d [p] ) ) );
+
+		vis = _mm256_and_ps ( vis, _mm256_cmp_ps ( dist, negR, _CMP_GT_OQ ) );
+	}
+
+	return (uint32_t) _mm256_movemask_ps ( vis );
+}
+
+static inline uint32_t	boxesVisible ( const float * nx, const float * ny, const float * nz, const float * d, const AabbSoA& b, size_t i )
+{
+	__m256	minX = _mm256_loadu_ps ( b.minX.data () + i );
+	__m256	minY = _mm256_loadu_ps ( b.minY.data () + i );
+	__m256	minZ = _mm256_loadu_ps ( b.minZ.data () + i );
+	__m256	maxX = _mm256_loadu_ps ( b.maxX.data () + i );
+	__m256	maxY = _mm256_loadu_ps ( b.maxY.data () + i );
+	__m256	maxZ = _mm256_loadu_ps ( b.maxZ.data () + i );
+	__m256	vis  = _mm256_castsi256_ps ( _mm256_set1_epi32 ( -1 ) );
+
+	for ( int p = 0; p < 6; p++ )
+	{
+		__m256	x    = nx [p] >= 0 ? maxX : minX;
+		__m256	y    = ny [p] >= 0 ? maxY : minY;
+		__m256	z    = nz [p] >= 0 ? maxZ : minZ;
+		__m256	dist = _mm256_add_ps ( _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( nx [p] ), x ), _mm256_mul_ps ( _mm256_set1_ps ( ny [p] ), y ) ),
+									   _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( nz [p] ), z ), _mm256_set1_ps ( d [p] ) ) );
+
+		vis = _mm256_and_ps ( vis, _mm256_cmp_ps ( dist, _mm256_setzero_ps (), _CMP_GE_OQ ) );
+	}
+
+	return (uint32_t) _mm256_movemask_ps ( vis );
+}
+
+#elif defined(CULL_SSE)
+
+static inline uint32_t	spheresVisible ( const float * nx, const float * ny, const float * nz, const float * d, const SphereSoA& s, size_t i )
+{
+	__m128	x    = _mm_loadu_ps ( s.x.data () + i );
+	__m128	y    = _mm_loadu_ps ( s.y.data () + i );
+	__m128	z    = _mm_loadu_ps ( s.z.data () + i );
+	__m128	negR = _mm_sub_ps   ( _mm_setzero_ps (), _mm_loadu_ps ( s.r.data () + i ) );
+	__m128	vis  = _mm_castsi128_ps ( _mm_set1_epi32 ( -1 ) );
+
+	for ( int p = 0; p < 6; p++ )
+	{
+		__m128	dist = _mm_add_ps ( _mm_add_ps ( _mm_mul_ps ( _mm_set1_ps ( nx [p] ), x ), _mm_mul_ps ( _mm_set1_ps ( ny [p] ), y ) ),
+									_mm_add_ps ( _mm_mul_ps ( _mm_set1_ps ( nz [p] ), z ), _mm_set1_ps ( d [p] ) ) );
+
+		vis = _mm_and_ps ( vis, _mm_cmpgt_ps ( dist, negR ) );
+	}
+
+	return (uint32_t) _mm_movemask_ps ( vis );
+}
+
+static inline uint32_t	boxesVisible ( const float * nx, const float * ny, const float * nz, const float * d, const AabbSoA& b, size_t i )
+{
+	__m128	minX = _mm_loadu_ps ( b.minX.data () + i );
+	__m128	minY = _mm_loadu_ps ( b.minY.data () + i );
+	__m128	minZ = _mm_loadu_ps ( b.minZ.data () + i );
+	__m128	maxX = _mm_loadu_ps ( b.maxX.data () + i );
+	__m128	maxY = _mm_loadu_ps ( b.maxY.data () + i );
+	__m128	maxZ = _mm_loadu_ps ( b.maxZ.data () + i );
+	__m128	vis  = _mm_castsi128_ps ( _mm_set1_epi32 ( -1 ) );
+
+	for ( int p = 0; p < 6; p++ )
+	{
+		__m128	x    = nx [p] >= 0 ? maxX : minX;
+		__m128	y    = ny [p] >= 0 ? maxY : minY;
+		__m128	z    = nz [p] >= 0 ? maxZ : minZ;
+		__m128	dist = _mm_add_ps ( _mm_add_ps ( _mm_mul_ps ( _mm_set1_ps ( nx [p] ), x ), _mm_mul_ps ( _mm_set1_ps ( ny [p] ), y ) ),
+									_mm_add_ps ( _mm_mul_ps ( _mm_set1_ps ( nz [p] ), z ), _mm_set1_ps ( d [p] ) ) );
+
+		vis = _mm_and_ps ( vis, _mm_cmpge_ps ( dist, _mm_setzero_ps () ) );
+	}
+
+	return (uint32_t) _mm_movemask_ps ( vis );
+}
+
+#elif defined(CULL_NEON)
+
+static inline uint32_t	moveMask ( uint32x4_t v )
+{
+	static const uint32_t	bits [4] = { 1, 2, 4, 8 };
+
+	return vaddvq_u32 ( vandq_u32 ( v, vld1q_u32 ( bits ) ) );
+}
+
+static inline uint32_t	spheresVisible ( const float * nx, const float * ny, const float * nz, const float * d, const SphereSoA& s, size_t i )
+{
+	float32x4_t	x    = vld1q_f32 ( s.x.data () + i );
+	float32x4_t	y    = vld1q_f32 ( s.y.data () + i );
+	float32x4_t	z    = vld1q_f32 ( s.z.data () + i );
+	float32x4_t	negR = vnegq_f32 ( vld1q_f32 ( s.r.data () + i ) );
+	uint32x4_t	vis  = vdupq_n_u32 ( 0xFFFFFFFF );
+
+	for ( int p = 0; p < 6; p++ )
+	{
+		float32x4_t	dist = vdupq_n_f32 ( d [p] );
+
+		dist = vfmaq_n_f32 ( dist, x, nx [p] );
+		dist = vfmaq_n_f32 ( dist, y, ny [p] );
+		dist = vfmaq_n_f32 ( dist, z, nz [p] );
+		vis  = vandq_u32   ( vis, vcgtq_f32 ( dist, negR ) );
+	}
+
+	return moveMask ( vis );
+}
+
+static inline uint32_t	boxesVisible ( const float * nx, const float * ny, const float * nz, const float * d, const AabbSoA& b, size_t i )
+{
+	float32x4_t	minX = vld1q_f32 ( b.minX.data () + i );
+	float32x4_t	minY = vld1q_f32 ( b.minY.data () + i );
+	float32x4_t	minZ = vld1q_f32 ( b.minZ.data () + i );
+	float32x4_t	maxX = vld1q_f32 ( b.maxX.data () + i );
+	float32x4_t	maxY = vld1q_f32 ( b.maxY.data () + i );
+	float32x4_t	maxZ = vld1q_f32 ( b.maxZ.data () + i );
+	uint32x4_t	vis  = vdupq_n_u32 ( 0xFFFFFFFF );
+
+	for ( int p = 0; p < 6; p++ )
+	{
+		float32x4_t	dist = vdupq_n_f32 ( d [p] );
+
+		dist = vfmaq_n_f32 ( dist, nx [p] >= 0 ? maxX : minX, nx [p] );
+		dist = vfmaq_n_f32 ( dist, ny [p] >= 0 ? maxY : minY, ny [p] );
+		dist = vfmaq_n_f32 ( dist, nz [p] >= 0 ? maxZ : minZ, nz [p] );
+		vis  = vandq_u32   ( vis, vcgeq_f32 ( dist, vdupq_n_f32 ( 0 ) ) );
+	}
+
+	return moveMask ( vis );
+}
+
+#else
+
+static inline uint32_t	spheresVisible ( const float * nx, const float * ny, const float * nz, const float * d, const SphereSoA& s, size_t i )
+{
+	return sphereVisible ( nx, ny, nz, d, s.x [i], s.y [i], s.z [i], s.r [i] ) ? 1 : 0;
+}
+
+static inline uint32_t	boxesVisible ( const float * nx, const float * ny, const float * nz, const float * d, const AabbSoA& b, size_t i )
+{
+	return boxVisible ( nx, ny, nz, d, b, i ) ? 1 : 0;
+}
+
+#endif
+
+	// walk range by 64-object words, full groups of CULL_LANES objects go to SIMD code, tail is scalar
+template <typename Group, typename Single>
+static void	cullRange ( uint64_t * words, size_t first, size_t count, Group group, Single single )
+{
+	size_t	end = first + count;
+
+	for ( size_t base = first; base < end; base += 64 )
+	{
+		size_t		last = std::min ( base + 64, end );
+		uint64_t	bits = 0;
+		size_t		i    = base;
+
+		for ( ; i + CULL_LANES <= last; i += CULL_LANES )
+			bits |= uint64_t ( group ( i ) ) << (i - base);
+
+		for ( ; i < last; i++ )
+			if ( single ( i ) )
+				bits |= uint64_t ( 1 ) << (i - base);
+
+		words [base >> 6] = bits;
+	}
+}
+
+	// split [0, count) into 64-aligned ranges, one per thread, calling thread does the first one
+template <typename Func>
+static void	parallelFor ( size_t count, unsigned numThreads, Func func )
+{
+	if ( numThreads == 0 )
+		numThreads = std::max ( 1u, std::thread::hardware_concurrency () );
+
+	numThreads = (unsigned) std::min<size_t> ( numThreads, (count + minObjectsPerThread - 1) / minObjectsPerThread );
+
+	if ( numThreads <= 1 )
+	{
+		func ( 0, count );
+		return;
+	}
+
+	size_t						chunk = ((count + numThreads - 1) / numThreads + 63) & ~size_t ( 63 );
+	std::vector<std::thread>	threads;
+
+	for ( size_t start = chunk; start < count; start += chunk )
+		threads.emplace_back ( func, start, std::min ( chunk, count - start ) );
+
+	func ( 0, std::min ( chunk, count ) );
+
+	for ( auto& t : threads )
+		t.join ();
+}
+
+void	BatchCuller :: cullSpheres ( const SphereSoA& spheres, VisibilityMask& mask, size_t first, size_t count ) const
+{
+	assert ( (first & 63) == 0 && first + count <= spheres.size () && mask.size () >= first + count );
+
+	cullRange ( mask.data (), first, count,
+				[&] ( size_t i ) { return spheresVisible ( nx, ny, nz, d, spheres, i ); },
+				[&] ( size_t i ) { return sphereVisible  ( nx, ny, nz, d, spheres.x [i], spheres.y [i], spheres.z [i], spheres.r [i] ); } );
+}
+
+void	BatchCuller :: cullBoxes ( const AabbSoA& boxes, VisibilityMask& mask, size_t first, size_t count ) const
+{
+	assert ( (first & 63) == 0 && first + count <= boxes.size () && mask.size () >= first + count );
+
+	cullRange ( mask.data (), first, count,
+				[&] ( size_t i ) { return boxesVisible ( nx, ny, nz, d, boxes, i ); },
+				[&] ( size_t i ) { return boxVisible   ( nx, ny, nz, d, boxes, i ); } );
+}
+
+void	BatchCuller :: cullSpheres ( const SphereSoA& spheres, VisibilityMask& mask, unsigned numThreads ) const
+{
+	mask.resize ( spheres.size () );
+
+	parallelFor ( spheres.size (), numThreads, [&] ( size_t first, size_t count ) { cullSpheres ( spheres, mask, first, count ); } );
+}
+
+void	BatchCuller :: cullBoxes ( const AabbSoA& boxes, VisibilityMask& mask, unsigned numThreads ) const
+{
+	mask.resize ( boxes.size () );
+
+	parallelFor ( boxes.size (), numThreads, [&] ( size_t first, size_t count ) { cullBoxes ( boxes, mask, first, count ); } );
+}
+
+const char *	BatchCuller :: simdName ()
+{
+#if defined(CULL_AVX)
+	return "AVX";
+#elif defined(CULL_SSE)
+	return "SSE2";
+#elif defined(CULL_NEON)
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
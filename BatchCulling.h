@@ -0,0 +1,161 @@
+//
+// Batch frustum culling of many bounding volumes stored as structure of arrays.
+// Volumes are tested 4 (SSE, NEON) or 8 (AVX) at a time, result is a visibility
+// bitmask with one bit per object. Large batches can be split across threads.
+//
+
+#pragma once
+
+#include	<stdint.h>
+#include	<vector>
+#include	<glm/glm.hpp>
+#include	"bbox.h"
+
+class	Frustum;
+
+	// bounding spheres as separate arrays of coordinates
+struct	SphereSoA
+{
+	std::vector<float>	x, y, z, r;
+
+	size_t	size () const
+	{
+		return x.size ();
+	}
+
+	void	clear ()
+	{
+		x.clear ();
+		y.clear ();
+		z.clear ();
+		r.clear ();
+	}
+
+	void	reserve ( size_t n )
+	{
+		x.reserve ( n );
+		y.reserve ( n );
+		z.reserve ( n );
+		r.reserve ( n );
+	}
+
+	void	add ( const glm::vec3& center, float radius )
+	{
+		x.push_back ( center.x );
+		y.push_back ( center.y );
+		z.push_back ( center.z );
+		r.push_back ( radius   );
+	}
+};
+
+	// axis-aligned boxes as separate arrays of min and max coordinates
+struct	AabbSoA
+{
+	std::vector<float>	minX, minY, minZ;
+	std::vector<float>	maxX, maxY, maxZ;
+
+	size_t	size () const
+	{
+		return minX.size ();
+	}
+
+	void	clear ()
+	{
+		minX.clear ();
+		minY.clear ();
+		minZ.clear ();
+		maxX.clear ();
+		maxY.clear ();
+		maxZ.clear ();
+	}
+
+	void	reserve ( size_t n )
+	{
+		minX.reserve ( n );
+		minY.reserve ( n );
+		minZ.reserve ( n );
+		maxX.reserve ( n );
+		maxY.reserve ( n );
+		maxZ.reserve ( n );
+	}
+
+	void	add ( const glm::vec3& minPoint, const glm::vec3& maxPoint )
+	{
+		minX.push_back ( minPoint.x );
+		minY.push_back ( minPoint.y );
+		minZ.push_back ( minPoint.z );
+		maxX.push_back ( maxPoint.x );
+		maxY.push_back ( maxPoint.y );
+		maxZ.push_back ( maxPoint.z );
+	}
+
+	void	add ( const bbox& box )
+	{
+		add ( box.getMinPoint (), box.getMaxPoint () );
+	}
+};
+
+	// one bit per object, bit i of word i/64 is set when object i is visible
+class	VisibilityMask
+{
+	std::vector<uint64_t>	words;
+	size_t					count = 0;
+
+public:
+	void	resize ( size_t n )
+	{
+		count = n;
+		words.assign ( (n + 63) / 64, 0 );
+	}
+
+	size_t	size () const
+	{
+		return count;
+	}
+
+	bool	isVisible ( size_t i ) const
+	{
+		return (words [i >> 6] >> (i & 63)) & 1;
+	}
+
+	uint64_t * data ()
+	{
+		return words.data ();
+	}
+
+	const std::vector<uint64_t>&	getWords () const
+	{
+		return words;
+	}
+
+	size_t	visibleCount () const;
+};
+
+class	BatchCuller
+{
+	alignas(32) float	nx [6], ny [6], nz [6], d [6];	// planes in SoA form, normals point inside
+
+public:
+	BatchCuller () = default;
+	BatchCuller ( const Frustum& frustum )
+	{
+		setPlanes ( frustum );
+	}
+
+	void	setPlanes ( const Frustum& frustum );
+	void	setPlanes ( const glm::vec4 planes [6] );
+
+		// extract planes from view-projection matrix
+	void	setMatrix ( const glm::mat4& viewProj );
+
+		// cull objects [first, first + count), first must be multiple of 64
+	void	cullSpheres ( const SphereSoA& spheres, VisibilityMask& mask, size_t first, size_t count ) const;
+	void	cullBoxes   ( const AabbSoA&   boxes,   VisibilityMask& mask, size_t first, size_t count ) const;
+
+		// cull all objects, mask is resized, numThreads = 0 - use all hardware threads
+	void	cullSpheres ( const SphereSoA& spheres, VisibilityMask& mask, unsigned numThreads = 1 ) const;
+	void	cullBoxes   ( const AabbSoA&   boxes,   VisibilityMask& mask, unsigned numThreads = 1 ) const;
+
+		// instruction set selected at compile time
+	static	const char *	simdName ();
+};
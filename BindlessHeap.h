@@ -0,0 +1,354 @@
+//
+// Global bindless heap: one update-after-bind descriptor set with large arrays
+// of sampled images, samplers and storage buffers. Resources get stable indices
+// which are passed to shaders (push constants, SSBOs), so the set is bound only once.
+//
+// Shader side (set number is chosen by application):
+//	layout ( set = 1, binding = 0 ) uniform texture2D	textures [];
+//	layout ( set = 1, binding = 1 ) uniform sampler		samplers [];
+//	layout ( set = 1, binding = 2 ) buffer Data { ... }	buffers  [];
+//
+
+#pragma once
+
+#include	<vector>
+#include	"Device.h"
+#include	"Buffer.h"
+#include	"Texture.h"
+#include	"Pipeline.h"
+#include	"CommandBuffer.h"
+
+class	BindlessHeap
+{
+public:
+	enum
+	{
+		imagesBinding   = 0,
+		samplersBinding = 1,
+		buffersBinding  = 2,
+		invalidIndex    = UINT32_MAX
+	};
+
+private:
+		// slot allocator for single array, released slots are reused only when no frame in flight can reference them
+	struct	Slots
+	{
+		uint32_t										capacity = 0;
+		uint32_t										next     = 0;		// first never used slot
+		std::vector<uint32_t>							freeList;
+		std::vector<std::pair<uint32_t, uint64_t>>		pending;		// slot and frame it was released in
+
+		uint32_t	alloc ()
+		{
+			if ( !freeList.empty () )
+			{
+				uint32_t	index = freeList.back ();
+
+				freeList.pop_back ();
+
+				return index;
+			}
+
+			return next < capacity ? next++ : invalidIndex;
+		}
+
+		void	release ( uint32_t index, uint64_t frame )
+		{
+			assert ( index < next );
+
+			pending.push_back ( { index, frame } );
+		}
+
+		void	recycle ( uint64_t completedFrame )
+		{
+			size_t	j = 0;
+
+			for ( size_t i = 0; i < pending.size (); i++ )
+				if ( pending [i].second <= completedFrame )
+					freeList.push_back ( pending [i].first );
+				else
+					pending [j++] = pending [i];
+
+			pending.resize ( j );
+		}
+
+		uint32_t	used () const
+		{
+			return next - uint32_t ( freeList.size () + pending.size () );
+		}
+	};
+
+	Device                    * device         = nullptr;
+	VkDescriptorPool			pool           = VK_NULL_HANDLE;
+	VkDescriptorSet				set            = VK_NULL_HANDLE;
+	DescSetLayout				layout;
+	Slots						images;
+	Slots						samplers;
+	Slots						buffers;
+	uint32_t					framesInFlight = 2;
+	uint64_t					frameNumber    = 0;
+
+public:
+	BindlessHeap  () = default;
+	BindlessHeap  ( const BindlessHeap& ) = delete;
+	~BindlessHeap ()
+	{
+		clean ();
+	}
+
+	BindlessHeap& operator = ( const BindlessHeap& ) = delete;
+
+		// fill features required by heap, features should be added to DevicePolicy
+	static	void	enableFeatures ( VkPhysicalDeviceDescriptorIndexingFeatures& features )
+	{
+		features.runtimeDescriptorArray                        = VK_TRUE;
+		features.shaderSampledImageArrayNonUniformIndexing     = VK_TRUE;
+		features.shaderStorageBufferArrayNonUniformIndexing    = VK_TRUE;
+		features.descriptorBindingPartiallyBound               = VK_TRUE;
+		features.descriptorBindingUpdateUnusedWhilePending     = VK_TRUE;
+		features.descriptorBindingSampledImageUpdateAfterBind  = VK_TRUE;
+		features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	}
+
+	bool	isOk () const
+	{
+		return set != VK_NULL_HANDLE;
+	}
+
+	VkDescriptorSet	getHandle () const
+	{
+		return set;
+	}
+
+		// layout to be added to pipelines with addDescLayout
+	const DescSetLayout&	getLayout () const
+	{
+		return layout;
+	}
+
+	uint32_t	imageCount () const
+	{
+		return images.used ();
+	}
+
+	uint32_t	samplerCount () const
+	{
+		return samplers.used ();
+	}
+
+	uint32_t	bufferCount () const
+	{
+		return buffers.used ();
+	}
+
+	bool	create ( Device& dev, uint32_t maxImages = 4096, uint32_t maxSamplers = 64, uint32_t maxBuffers = 4096,
+					 VkShaderStageFlags stages = VK_SHADER_STAGE_ALL, uint32_t numFramesInFlight = 2 )
+	{
+		VkDescriptorBindingFlags	bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+												   VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+		clean ();
+
+		device             = &dev;
+		framesInFlight     = numFramesInFlight;
+		images.capacity    = maxImages;
+		samplers.capacity  = maxSamplers;
+		buffers.capacity   = maxBuffers;
+
+		layout
+			.add      ( imagesBinding,   VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,  stages, maxImages   )
+			.add      ( samplersBinding, VK_DESCRIPTOR_TYPE_SAMPLER,        stages, maxSamplers )
+			.add      ( buffersBinding,  VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, maxBuffers  )
+			.addFlags ( { bindingFlags, bindingFlags, bindingFlags } )
+			.create   ( dev.getDevice (), VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT );
+
+		VkDescriptorPoolSize		sizes [] =
+		{
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,  maxImages   },
+			{ VK_DESCRIPTOR_TYPE_SAMPLER,        maxSamplers },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxBuffers  }
+		};
+		VkDescriptorPoolCreateInfo	poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+
+		poolInfo.flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.maxSets       = 1;
+		poolInfo.poolSizeCount = 3;
+		poolInfo.pPoolSizes    = sizes;
+
+		if ( vkCreateDescriptorPool ( dev.getDevice (), &poolInfo, nullptr, &pool ) != VK_SUCCESS )
+		{
+			log () << "BindlessHeap: cannot create descriptor pool" << Log::endl;
+			return false;
+		}
+
+		VkDescriptorSetLayout		handle    = layout.getHandle ();
+		VkDescriptorSetAllocateInfo	allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+
+		allocInfo.descriptorPool     = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts        = &handle;
+
+		if ( vkAllocateDescriptorSets ( dev.getDevice (), &allocInfo, &set ) != VK_SUCCESS )
+		{
+			log () << "BindlessHeap: cannot allocate descriptor set" << Log::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	void	clean ()
+	{
+		if ( pool != VK_NULL_HANDLE )
+			vkDestroyDescriptorPool ( device->getDevice (), pool, nullptr );
+
+		pool     = VK_NULL_HANDLE;
+		set      = VK_NULL_HANDLE;
+		images   = Slots ();
+		samplers = Slots ();
+		buffers  = Slots ();
+
+		layout.clean ();
+	}
+
+		// call once per frame after frame's fence has been waited, recycles released slots
+	void	beginFrame ()
+	{
+		frameNumber++;
+
+		if ( frameNumber < framesInFlight )
+			return;
+
+		uint64_t	completed = frameNumber - framesInFlight;
+
+		images.recycle   ( completed );
+		samplers.recycle ( completed );
+		buffers.recycle  ( completed );
+	}
+
+		// register resources, return index in corresponding array or invalidIndex if heap is full
+	uint32_t	addTexture ( Texture& texture, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL )
+	{
+		return addImageView ( texture.getImageView (), imageLayout );
+	}
+
+	uint32_t	addImageView ( VkImageView view, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL )
+	{
+		assert ( view != VK_NULL_HANDLE );
+
+		uint32_t	index = images.alloc ();
+
+		if ( index != invalidIndex )
+			writeImage ( index, view, imageLayout );
+		else
+			log () << "BindlessHeap: no free image slots" << Log::endl;
+
+		return index;
+	}
+
+	uint32_t	addSampler ( Sampler& sampler )
+	{
+		assert ( sampler.getHandle () != VK_NULL_HANDLE );
+
+		uint32_t	index = samplers.alloc ();
+
+		if ( index == invalidIndex )
+		{
+			log () << "BindlessHeap: no free sampler slots" << Log::endl;
+
+			return index;
+		}
+
+		VkDescriptorImageInfo	info  = {};
+		VkWriteDescriptorSet	write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+
+		info.sampler          = sampler.getHandle ();
+		write.dstSet          = set;
+		write.dstBinding      = samplersBinding;
+		write.dstArrayElement = index;
+		write.descriptorType  = VK_DESCRIPTOR_TYPE_SAMPLER;
+		write.descriptorCount = 1;
+		write.pImageInfo      = &info;
+
+		vkUpdateDescriptorSets ( device->getDevice (), 1, &write, 0, nullptr );
+
+		return index;
+	}
+
+	uint32_t	addBuffer ( Buffer& buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE )
+	{
+		uint32_t	index = buffers.alloc ();
+
+		if ( index == invalidIndex )
+		{
+			log () << "BindlessHeap: no free buffer slots" << Log::endl;
+
+			return index;
+		}
+
+		VkDescriptorBufferInfo	info  = {};
+		VkWriteDescriptorSet	write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+
+		info.buffer           = buffer.getHandle ();
+		info.offset           = offset;
+		info.range            = size;
+		write.dstSet          = set;
+		write.dstBinding      = buffersBinding;
+		write.dstArrayElement = index;
+		write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.descriptorCount = 1;
+		write.pBufferInfo     = &info;
+
+		vkUpdateDescriptorSets ( device->getDevice (), 1, &write, 0, nullptr );
+
+		return index;
+	}
+
+		// replace image in existing slot (e.g. when texture is reloaded)
+	void	updateTexture ( uint32_t index, Texture& texture, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL )
+	{
+		assert ( index < images.next );
+
+		writeImage ( index, texture.getImageView (), imageLayout );
+	}
+
+		// slots are reused only after all frames in flight are completed
+	void	releaseTexture ( uint32_t index )
+	{
+		images.release ( index, frameNumber );
+	}
+
+	void	releaseSampler ( uint32_t index )
+	{
+		samplers.release ( index, frameNumber );
+	}
+
+	void	releaseBuffer ( uint32_t index )
+	{
+		buffers.release ( index, frameNumber );
+	}
+
+		// bind heap's set to given set number of currently bound pipeline
+	void	bind ( CommandBuffer& cb, uint32_t setIndex ) const
+	{
+		cb.bindDescriptorSet ( setIndex, set );
+	}
+
+private:
+	void	writeImage ( uint32_t index, VkImageView view, VkImageLayout imageLayout )
+	{
+		VkDescriptorImageInfo	info  = {};
+		VkWriteDescriptorSet	write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+
+		info.imageView        = view;
+		info.imageLayout      = imageLayout;
+		write.dstSet          = set;
+		write.dstBinding      = imagesBinding;
+		write.dstArrayElement = index;
+		write.descriptorType  = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		write.descriptorCount = 1;
+		write.pImageInfo      = &info;
+
+		vkUpdateDescriptorSets ( device->getDevice (), 1, &write, 0, nullptr );
+	}
+};
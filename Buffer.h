@@ -311,6 +311,30 @@ public:
 		return copy ( &data, sizeof ( T ) );
 	}
 
+		// create device-local buffer and fill it using staging buffer
+	bool	createDeviceLocal ( Device& dev, VkBufferUsageFlags usage, const void * data, VkDeviceSize sz )
+	{
+		Buffer	stagingBuffer;
+
+		if ( !stagingBuffer.create ( dev, sz, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, hostWrite ) || !stagingBuffer.copy ( data, sz ) )
+			return false;
+
+		if ( !create ( dev, sz, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, 0 ) )
+			return false;
+
+		SingleTimeCommand	cmd ( dev );
+
+		copyBuffer ( cmd, stagingBuffer, sz );
+
+		return true;
+	}
+
+	template <typename T>
+	bool	createDeviceLocal ( Device& dev, VkBufferUsageFlags usage, const std::vector<T>& data )
+	{
+		return createDeviceLocal ( dev, usage, data.data (), data.size () * sizeof ( T ) );
+	}
+
 	void	copyBuffer ( SingleTimeCommand& cmd, Buffer& fromBuffer, VkDeviceSize size )
 	{
 		VkBufferCopy	copyRegion    = {};
@@ -348,10 +372,11 @@ public:
 
 	void	clean ()
 	{
+		if ( ptr != nullptr )		// never created or already cleaned
 #ifdef USE_VMA
-		vmaUnmapMemory ( device->getAllocator (), allocation );
+			vmaUnmapMemory ( device->getAllocator (), allocation );
 #else
-		getMemory ().unmap ();
+			getMemory ().unmap ();
 #endif // USE_VMA
 
 		Buffer::clean ();
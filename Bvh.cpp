@@ -0,0 +1,454 @@
+//
+// Bounding volume hierarchy with binned SAH builder
+//
+
+#include	<assert.h>
+#include	<atomic>
+#include	<thread>
+#include	<algorithm>
+#include	"Bvh.h"
+#include	"Frustum.h"
+
+enum
+{
+	numBins           = 16,
+	maxDepth          = 32,				// deeper nodes are split by median to keep traversal stack small
+	parallelThreshold = 8 * 1024		// subtrees smaller than this are built by the same thread
+};
+
+static inline float	halfArea ( const glm::vec3& size )
+{
+	return size.x * size.y + size.x * size.z + size.y * size.z;
+}
+
+struct	Bvh :: Builder
+{
+	Bvh&						bvh;
+	std::vector<glm::vec3>		centers;
+	std::atomic<uint32_t>		nodeCount { 1 };
+	std::atomic<int>			freeThreads { 0 };
+
+	Builder ( Bvh& b, unsigned numThreads ) : bvh ( b )
+	{
+		freeThreads = int ( numThreads ) - 1;
+
+		centers.resize ( bvh.objects.size () );
+
+		for ( size_t i = 0; i < centers.size (); i++ )
+			centers [i] = bvh.objects [i].getCenter ();
+	}
+
+	void	build ( uint32_t index, uint32_t begin, uint32_t end, int depth )
+	{
+		Node&		node  = bvh.nodes [index];
+		uint32_t	count = end - begin;
+		bbox		bounds, centerBounds;
+
+		for ( uint32_t i = begin; i < end; i++ )
+		{
+			bounds.merge           ( bvh.objects [bvh.objectIndices [i]] );
+			centerBounds.addVertex ( centers [bvh.objectIndices [i]] );
+		}
+
+		node.minPoint = bounds.getMinPoint ();
+		node.maxPoint = bounds.getMaxPoint ();
+
+		if ( count <= (uint32_t) bvh.maxLeafSize )
+		{
+			makeLeaf ( node, begin, count );
+			return;
+		}
+
+		uint32_t	mid = split ( bounds, centerBounds, begin, end, depth );
+
+		if ( mid == begin || mid == end )		// leaf is cheaper than any split
+		{
+			makeLeaf ( node, begin, count );
+			return;
+		}
+
+		uint32_t	left = nodeCount.fetch_add ( 2 );
+
+		node.first = left;
+		node.count = 0;
+
+		bvh.parents [left]     = index;
+		bvh.parents [left + 1] = index;
+
+			// build larger subtrees in parallel while there are free threads
+		if ( count >= parallelThreshold && freeThreads.fetch_sub ( 1 ) > 0 )
+		{
+			std::thread	thread ( &Builder::build, this, left, begin, mid, depth + 1 );
+
+			build ( left + 1, mid, end, depth + 1 );
+			thread.join ();
+
+			freeThreads++;
+		}
+		else
+		{
+			if ( count >= parallelThreshold )
+				freeThreads++;					// restore counter after failed attempt
+
+			build ( left,     begin, mid, depth + 1 );
+			build ( left + 1, mid,   end, depth + 1 );
+		}
+	}
+
+	void	makeLeaf ( Node& node, uint32_t begin, uint32_t count )
+	{
+		node.first = begin;
+		node.count = count;
+	}
+
+		// choose split with binned SAH over all three axes, return partition point
+	uint32_t	split ( const bbox& bounds, const bbox& centerBounds, uint32_t begin, uint32_t end, int depth )
+	{
+		glm::vec3	extent = centerBounds.getSize ();
+		uint32_t	count  = end - begin;
+		int			axis   = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+		if ( extent [axis] <= 0 )				// all centers coincide, split by order
+			return begin + count / 2;
+
+		uint32_t  * idx = bvh.objectIndices.data ();
+
+		if ( depth >= maxDepth )
+		{
+			std::nth_element ( idx + begin, idx + begin + count / 2, idx + end, [&] ( uint32_t a, uint32_t b ) { return centers [a][axis] < centers [b][axis]; } );
+
+			return begin + count / 2;
+		}
+
+		struct	Bin
+		{
+			bbox		box;
+			uint32_t	count = 0;
+		};
+
+		float		bestCost = FLT_MAX;
+		int			bestAxis = -1;
+		int			bestBin  = 0;
+		glm::vec3	minC     = centerBounds.getMinPoint ();
+
+		for ( int a = 0; a < 3; a++ )
+		{
+			if ( extent [a] <= 0 )
+				continue;
+
+			Bin		bins [numBins];
+			float	scale = numBins / extent [a];
+
+			for ( uint32_t i = begin; i < end; i++ )
+			{
+				uint32_t	obj = idx [i];
+				int			b   = std::min ( numBins - 1, int ( (centers [obj][a] - minC [a]) * scale ) );
+
+				bins [b].count++;
+				bins [b].box.merge ( bvh.objects [obj] );
+			}
+
+				// sweep from the right to get areas and counts of right parts
+			float		rightArea  [numBins];
+			uint32_t	rightCount [numBins];
+			bbox		box;
+			uint32_t	n = 0;
+
+			for ( int b = numBins - 1; b > 0; b-- )
+			{
+				box.merge ( bins [b].box );
+				n += bins [b].count;
+
+				rightCount [b] = n;
+				rightArea  [b] = n > 0 ? halfArea ( box.getSize () ) : 0;
+			}
+
+			box.reset ();
+			n = 0;
+
+			for ( int b = 0; b < numBins - 1; b++ )
+			{
+				box.merge ( bins [b].box );
+				n += bins [b].count;
+
+				float	cost = (n > 0 ? n * halfArea ( box.getSize () ) : 0) + rightCount [b + 1] * rightArea [b + 1];
+
+				if ( cost < bestCost )
+				{
+					bestCost = cost;
+					bestAxis = a;
+					bestBin  = b;
+				}
+			}
+		}
+
+			// compare with cost of leaf (intersection cost equals traversal cost)
+		float	leafCost = count * halfArea ( bounds.getSize () );
+
+		if ( bestAxis < 0 || (bestCost >= leafCost && count <= 4 * (uint32_t) bvh.maxLeafSize) )
+			return begin;
+
+		float	scale = numBins / extent [bestAxis];
+		auto	it    = std::partition ( idx + begin, idx + end, [&] ( uint32_t obj )
+		{
+			return std::min ( numBins - 1, int ( (centers [obj][bestAxis] - minC [bestAxis]) * scale ) ) <= bestBin;
+		} );
+
+		uint32_t	mid = uint32_t ( it - idx );
+
+		if ( mid == begin || mid == end )		// may happen due to rounding, fall back to median
+		{
+			std::nth_element ( idx + begin, idx + begin + count / 2, idx + end, [&] ( uint32_t a, uint32_t b ) { return centers [a][bestAxis] < centers [b][bestAxis]; } );
+
+			mid = begin + count / 2;
+		}
+
+		return mid;
+	}
+};
+
+void	Bvh :: build ( const std::vector<bbox>& boxes, unsigned numThreads, int leafSize )
+{
+	clear ();
+
+	if ( boxes.empty () )
+		return;
+
+	if ( numThreads == 0 )
+		numThreads = std::max ( 1u, std::thread::hardware_concurrency () );
+
+	maxLeafSize = std::max ( 1, leafSize );
+	objects     = boxes;
+
+	objectIndices.resize ( objects.size () );
+	nodes.resize         ( 2 * objects.size () );
+	parents.resize       ( 2 * objects.size () );
+
+	for ( size_t i = 0; i < objectIndices.size (); i++ )
+		objectIndices [i] = uint32_t ( i );
+
+	Builder	builder ( *this, numThreads );
+
+	parents [0] = invalidIndex;
+
+	builder.build ( 0, 0, uint32_t ( objects.size () ), 0 );
+
+	nodes.resize   ( builder.nodeCount );
+	parents.resize ( builder.nodeCount );
+	leafOf.resize  ( objects.size () );
+
+	for ( uint32_t i = 0; i < nodes.size (); i++ )
+		for ( uint32_t j = 0; j < nodes [i].count; j++ )
+			leafOf [objectIndices [nodes [i].first + j]] = i;
+}
+
+void	Bvh :: clear ()
+{
+	nodes.clear         ();
+	objectIndices.clear ();
+	objects.clear       ();
+	parents.clear       ();
+	leafOf.clear        ();
+}
+
+void	Bvh :: refitNode ( uint32_t index )
+{
+	Node&	node = nodes [index];
+	bbox	box;
+
+	if ( node.count > 0 )
+	{
+		for ( uint32_t i = node.first; i < node.first + node.count; i++ )
+			box.merge ( objects [objectIndices [i]] );
+	}
+	else
+	{
+		box = bbox ( bbox ( nodes [node.first].minPoint,     nodes [node.first].maxPoint ),
+					 bbox ( nodes [node.first + 1].minPoint, nodes [node.first + 1].maxPoint ) );
+	}
+
+	node.minPoint = box.getMinPoint ();
+	node.maxPoint = box.getMaxPoint ();
+}
+
+	// children always have larger indices than parents, so reverse order is bottom-up
+void	Bvh :: refit ( const std::vector<bbox>& boxes )
+{
+	assert ( boxes.size () == objects.size () );
+
+	objects = boxes;
+
+	for ( size_t i = nodes.size (); i-- > 0; )
+		refitNode ( uint32_t ( i ) );
+}
+
+void	Bvh :: refit ( uint32_t object, const bbox& box )
+{
+	objects [object] = box;
+
+	for ( uint32_t index = leafOf [object]; index != invalidIndex; index = parents [index] )
+	{
+		glm::vec3	oldMin = nodes [index].minPoint;
+		glm::vec3	oldMax = nodes [index].maxPoint;
+
+		refitNode ( index );
+
+		if ( nodes [index].minPoint == oldMin && nodes [index].maxPoint == oldMax )
+			break;				// ancestors are not changed
+	}
+}
+
+float	Bvh :: sahCost () const
+{
+	if ( nodes.empty () )
+		return 0;
+
+	float	rootArea = halfArea ( nodes [0].maxPoint - nodes [0].minPoint );
+	float	cost     = 0;
+
+	for ( auto& node : nodes )
+	{
+		float	area = halfArea ( node.maxPoint - node.minPoint ) / rootArea;
+
+		cost += node.count > 0 ? area * node.count : area;
+	}
+
+	return cost;
+}
+
+void	Bvh :: frustumQuery ( const Frustum& frustum, std::vector<uint32_t>& result ) const
+{
+	if ( nodes.empty () )
+		return;
+
+	struct	Item
+	{
+		uint32_t	node;
+		uint32_t	planeMask;		// planes node is not yet known to be inside of
+	};
+
+		// test box against planes in mask, drop planes box is completely inside of, returns false if box is outside
+	auto	test = [&frustum] ( const glm::vec3& minPoint, const glm::vec3& maxPoint, uint32_t& mask )
+	{
+		for ( int p = 0; p < 6; p++ )
+		{
+			if ( (mask & (1u << p)) == 0 )
+				continue;
+
+			const glm::vec4&	pl = frustum.planes [p];
+			glm::vec3			n  ( pl.x, pl.y, pl.z );
+			glm::vec3			pv ( n.x >= 0 ? maxPoint.x : minPoint.x, n.y >= 0 ? maxPoint.y : minPoint.y, n.z >= 0 ? maxPoint.z : minPoint.z );
+			glm::vec3			nv ( n.x >= 0 ? minPoint.x : maxPoint.x, n.y >= 0 ? minPoint.y : maxPoint.y, n.z >= 0 ? minPoint.z : maxPoint.z );
+
+			if ( glm::dot ( n, pv ) + pl.w < 0 )
+				return false;
+
+			if ( glm::dot ( n, nv ) + pl.w >= 0 )			// completely inside this plane
+				mask &= ~(1u << p);
+		}
+
+		return true;
+	};
+
+	Item	stack [64];
+	int		sp = 0;
+
+	stack [sp++] = { 0, 0x3F };
+
+	while ( sp > 0 )
+	{
+		Item		item = stack [--sp];
+		const Node&	node = nodes [item.node];
+		uint32_t	mask = item.planeMask;
+
+		if ( !test ( node.minPoint, node.maxPoint, mask ) )
+			continue;
+
+		if ( node.count > 0 )
+		{
+			for ( uint32_t i = node.first; i < node.first + node.count; i++ )
+			{
+				uint32_t	objMask = mask;
+				const bbox&	box     = objects [objectIndices [i]];
+
+				if ( mask == 0 || test ( box.getMinPoint (), box.getMaxPoint (), objMask ) )
+					result.push_back ( objectIndices [i] );
+			}
+		}
+		else
+		{
+			stack [sp++] = { node.first + 1, mask };
+			stack [sp++] = { node.first,     mask };
+		}
+	}
+}
+
+void	Bvh :: boxQuery ( const bbox& box, std::vector<uint32_t>& result ) const
+{
+	if ( nodes.empty () )
+		return;
+
+	uint32_t	stack [64];
+	int			sp = 0;
+
+	stack [sp++] = 0;
+
+	while ( sp > 0 )
+	{
+		const Node&	node = nodes [stack [--sp]];
+
+		if ( !box.intersects ( bbox ( node.minPoint, node.maxPoint ) ) )
+			continue;
+
+		if ( node.count == 0 )
+		{
+			stack [sp++] = node.first + 1;
+			stack [sp++] = node.first;
+			continue;
+		}
+
+		for ( uint32_t i = node.first; i < node.first + node.count; i++ )
+			if ( box.intersects ( objects [objectIndices [i]] ) )
+				result.push_back ( objectIndices [i] );
+	}
+}
+
+bool	Bvh :: anyHit ( const ray& r, float maxT ) const
+{
+	if ( nodes.empty () )
+		return false;
+
+	glm::vec3	org    = r.getOrigin ();
+	glm::vec3	invDir = inverseDir ( r.getDir () );
+	uint32_t	stack [64];
+	int			sp     = 0;
+	float		tEnter;
+
+	stack [sp++] = 0;
+
+	while ( sp > 0 )
+	{
+		const Node&	node = nodes [stack [--sp]];
+
+		if ( !rayBox ( node, org, invDir, maxT, tEnter ) )
+			continue;
+
+		if ( node.count == 0 )
+		{
+			stack [sp++] = node.first + 1;
+			stack [sp++] = node.first;
+			continue;
+		}
+
+		for ( uint32_t i = node.first; i < node.first + node.count; i++ )
+		{
+			const bbox&	b       = objects [objectIndices [i]];
+			Node		leafBox = { b.getMinPoint (), 0, b.getMaxPoint (), 0 };
+
+			if ( rayBox ( leafBox, org, invDir, maxT, tEnter ) )
+				return true;
+		}
+	}
+
+	return false;
+}
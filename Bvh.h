@@ -0,0 +1,194 @@
+//
+// Bounding volume hierarchy over object bounding boxes (Primitive/Node bounds or any other).
+// Built with binned SAH (top levels are built in parallel), supports refit when objects move,
+// hierarchical frustum culling, ray queries (closest hit and any hit) and box overlap queries.
+// Objects are referenced by their index in array of boxes passed to build
+//
+
+#pragma once
+
+#include	<stdint.h>
+#include	<float.h>
+#include	<vector>
+#include	<algorithm>
+#include	<glm/glm.hpp>
+#include	"bbox.h"
+#include	"ray.h"
+
+class	Frustum;
+
+class	Bvh
+{
+public:
+	struct	Node					// 32 bytes, children of interior node are first and first + 1
+	{
+		glm::vec3	minPoint;
+		uint32_t	first;			// first object (leaf) or left child (interior)
+		glm::vec3	maxPoint;
+		uint32_t	count;			// number of objects, 0 for interior node
+	};
+
+	enum
+	{
+		invalidIndex = UINT32_MAX
+	};
+
+private:
+	std::vector<Node>		nodes;
+	std::vector<uint32_t>	objectIndices;		// leaves reference ranges of this array
+	std::vector<bbox>		objects;			// copy of object boxes
+	std::vector<uint32_t>	parents;			// parent of every node
+	std::vector<uint32_t>	leafOf;				// leaf containing every object
+	int						maxLeafSize = 4;
+
+public:
+	Bvh () = default;
+
+	bool	isEmpty () const
+	{
+		return nodes.empty ();
+	}
+
+	size_t	nodeCount () const
+	{
+		return nodes.size ();
+	}
+
+	size_t	objectCount () const
+	{
+		return objects.size ();
+	}
+
+	const std::vector<Node>&	getNodes () const
+	{
+		return nodes;
+	}
+
+	bbox	getBounds () const
+	{
+		return nodes.empty () ? bbox () : bbox ( nodes [0].minPoint, nodes [0].maxPoint );
+	}
+
+		// build tree, numThreads = 0 - use all hardware threads
+	void	build ( const std::vector<bbox>& boxes, unsigned numThreads = 0, int leafSize = 4 );
+	void	clear ();
+
+		// all objects moved, update every box bottom-up keeping the topology
+	void	refit ( const std::vector<bbox>& boxes );
+
+		// single object moved, update its leaf and ancestors
+	void	refit ( uint32_t object, const bbox& box );
+
+		// SAH cost of the tree relative to root area (for comparing builds)
+	float	sahCost () const;
+
+		// indices of objects whose boxes are not outside frustum
+	void	frustumQuery ( const Frustum& frustum, std::vector<uint32_t>& result ) const;
+
+		// indices of objects whose boxes overlap given box
+	void	boxQuery ( const bbox& box, std::vector<uint32_t>& result ) const;
+
+		// closest object box hit by ray within [0, maxT], returns false if none
+	bool	raycast ( const ray& r, uint32_t& object, float& t, float maxT = FLT_MAX ) const
+	{
+		return raycast ( r, object, t, maxT, [] ( uint32_t, float tBox ) { return tBox; } );
+	}
+
+		// closest hit with exact test: hit ( object, tBox ) returns distance to object or negative value if missed,
+		// objects are visited roughly front to back and subtrees farther than current hit are skipped
+	template <typename Hit>
+	bool	raycast ( const ray& r, uint32_t& object, float& t, float maxT, Hit hit ) const;
+
+		// line of sight test: whether any object box is hit within [0, maxT]
+	bool	anyHit ( const ray& r, float maxT = FLT_MAX ) const;
+
+private:
+	struct	Builder;
+
+	static	bool	rayBox ( const Node& node, const glm::vec3& org, const glm::vec3& invDir, float maxT, float& tEnter )
+	{
+		glm::vec3	t1   = (node.minPoint - org) * invDir;
+		glm::vec3	t2   = (node.maxPoint - org) * invDir;
+		glm::vec3	tMin = glm::min ( t1, t2 );
+		glm::vec3	tMax = glm::max ( t1, t2 );
+		float		t0   = std::max ( std::max ( tMin.x, tMin.y ), std::max ( tMin.z, 0.0f ) );
+		float		tEnd = std::min ( std::min ( tMax.x, tMax.y ), std::min ( tMax.z, maxT ) );
+
+		tEnter = t0;
+
+		return t0 <= tEnd;
+	}
+
+	static	glm::vec3	inverseDir ( const glm::vec3& dir )
+	{
+		return glm::vec3 ( 1.0f / (dir.x != 0 ? dir.x : 1e-30f), 1.0f / (dir.y != 0 ? dir.y : 1e-30f), 1.0f / (dir.z != 0 ? dir.z : 1e-30f) );
+	}
+
+	void	refitNode ( uint32_t index );
+};
+
+template <typename Hit>
+bool	Bvh :: raycast ( const ray& r, uint32_t& object, float& t, float maxT, Hit hit ) const
+{
+	if ( nodes.empty () )
+		return false;
+
+	glm::vec3	org    = r.getOrigin ();
+	glm::vec3	invDir = inverseDir ( r.getDir () );
+	uint32_t	stack [64];
+	int			sp     = 0;
+	float		tEnter;
+
+	object = invalidIndex;
+	t      = maxT;
+
+	if ( !rayBox ( nodes [0], org, invDir, t, tEnter ) )
+		return false;
+
+	stack [sp++] = 0;
+
+	while ( sp > 0 )
+	{
+		const Node&	node = nodes [stack [--sp]];
+
+		if ( !rayBox ( node, org, invDir, t, tEnter ) )		// t may have decreased since push
+			continue;
+
+		if ( node.count > 0 )
+		{
+			for ( uint32_t i = node.first; i < node.first + node.count; i++ )
+			{
+				Node	leafBox = { objects [objectIndices [i]].getMinPoint (), 0, objects [objectIndices [i]].getMaxPoint (), 0 };
+
+				if ( !rayBox ( leafBox, org, invDir, t, tEnter ) )
+					continue;
+
+				float	tHit = hit ( objectIndices [i], tEnter );
+
+				if ( tHit >= 0 && tHit <= t )
+				{
+					t      = tHit;
+					object = objectIndices [i];
+				}
+			}
+
+			continue;
+		}
+
+		float	tLeft, tRight;
+		bool	hitLeft  = rayBox ( nodes [node.first],     org, invDir, t, tLeft  );
+		bool	hitRight = rayBox ( nodes [node.first + 1], org, invDir, t, tRight );
+
+		if ( hitLeft && hitRight )		// push farther child first, so closer one is processed first
+		{
+			stack [sp++] = tLeft < tRight ? node.first + 1 : node.first;
+			stack [sp++] = tLeft < tRight ? node.first     : node.first + 1;
+		}
+		else if ( hitLeft )
+			stack [sp++] = node.first;
+		else if ( hitRight )
+			stack [sp++] = node.first + 1;
+	}
+
+	return object != invalidIndex;
+}
@@ -9,6 +9,9 @@
 
 class	CommandBuffer;
 
+template <typename T>
+class	InstanceBuffer;
+
 class	RenderPassInfo
 {
 	VkRenderPassBeginInfo		renderPassInfo  = {};
@@ -286,6 +289,90 @@ public:
 		return *this;
 	}
 
+		// bind single raw set (e.g. from cache or bindless heap) to given set number
+	CommandBuffer&	bindDescriptorSet ( uint32_t setIndex, VkDescriptorSet set )
+	{
+		vkCmdBindDescriptorSets ( buffer, bindingPoint, layout, setIndex, 1, &set, 0, nullptr );
+
+		return *this;
+	}
+
+		// write bindings of push descriptor set directly into command buffer
+	CommandBuffer&	pushDescriptorSet ( uint32_t setIndex, const DescriptorSet& descriptorSet )
+	{
+		auto&					writes = descriptorSet.getWrites ();
+		PushDescriptorFuncs&	funcs  = PushDescriptorFuncs::get ();
+
+		if ( !funcs.isOk ( device->getDevice () ) )
+			funcs.load ( device->getDevice () );
+
+		funcs.vkCmdPushDescriptorSetKHR ( buffer, bindingPoint, layout, setIndex, (uint32_t)writes.size (), writes.data () );
+
+		return *this;
+	}
+
+		// push descriptors from data using template (created with push = true)
+	CommandBuffer&	pushDescriptorSet ( uint32_t setIndex, const DescriptorUpdateTemplate& updateTemplate, const void * data )
+	{
+		PushDescriptorFuncs&	funcs = PushDescriptorFuncs::get ();
+
+		if ( !funcs.isOk ( device->getDevice () ) )
+			funcs.load ( device->getDevice () );
+
+		funcs.vkCmdPushDescriptorSetWithTemplateKHR ( buffer, updateTemplate.getHandle (), layout, setIndex, data );
+
+		return *this;
+	}
+
+		// bind descriptor buffers, their indices in list are used in setDescriptorBufferOffsets
+	CommandBuffer&	bindDescriptorBuffers ( std::initializer_list<std::reference_wrapper<DescriptorBuffer>> bufferList )
+	{
+		std::vector<VkDescriptorBufferBindingInfoEXT>	bindings;
+
+		for ( auto& b : bufferList )
+			bindings.push_back ( b.get().getBindingInfo () );
+
+		DescriptorBufferFuncs::get ().vkCmdBindDescriptorBuffersEXT ( buffer, (uint32_t)bindings.size (), bindings.data () );
+
+		return *this;
+	}
+
+		// set consecutive sets starting with firstSet to (buffer index, offset) pairs
+	CommandBuffer&	setDescriptorBufferOffsets ( uint32_t firstSet, std::initializer_list<std::pair<uint32_t, VkDeviceSize>> offsetList )
+	{
+		std::vector<uint32_t>		indices;
+		std::vector<VkDeviceSize>	offsets;
+
+		for ( auto& p : offsetList )
+		{
+			indices.push_back ( p.first  );
+			offsets.push_back ( p.second );
+		}
+
+		DescriptorBufferFuncs::get ().vkCmdSetDescriptorBufferOffsetsEXT ( buffer, bindingPoint, layout, firstSet, (uint32_t)indices.size (), indices.data (), offsets.data () );
+
+		return *this;
+	}
+
+		// set consecutive sets starting with firstSet to sets written into descriptor buffer with given index
+	CommandBuffer&	setDescriptorBufferOffsets ( uint32_t firstSet, uint32_t bufferIndex, std::initializer_list<std::reference_wrapper<DescriptorSet>> descriptorList )
+	{
+		std::vector<uint32_t>		indices;
+		std::vector<VkDeviceSize>	offsets;
+
+		for ( auto& d : descriptorList )
+		{
+			assert ( d.get().isDescriptorBuffer () );
+
+			indices.push_back ( bufferIndex );
+			offsets.push_back ( d.get().getBufferOffset () );
+		}
+
+		DescriptorBufferFuncs::get ().vkCmdSetDescriptorBufferOffsetsEXT ( buffer, bindingPoint, layout, firstSet, (uint32_t)indices.size (), indices.data (), offsets.data () );
+
+		return *this;
+	}
+
 	CommandBuffer&	beginRenderPass ( RenderPassInfo& pass, bool contentInline = true )
 	{
 		hasRenderPass = true;
@@ -295,6 +382,17 @@ public:
 		return *this;
 	}
 
+		// explicitly end render pass, e.g. to record compute work between passes (end () does it implicitly)
+	CommandBuffer&	endRenderPass ()
+	{
+		if ( hasRenderPass )
+			vkCmdEndRenderPass ( buffer );
+
+		hasRenderPass = false;
+
+		return *this;
+	}
+
 	CommandBuffer&	bindVertexBuffers ( std::initializer_list<std::pair<std::reference_wrapper<Buffer>, VkDeviceSize>> buffers )
 	{
 		std::vector<VkBuffer>		bufs;
@@ -352,6 +450,41 @@ public:
 		return *this;
 	}
 
+	CommandBuffer&	drawIndirect ( Buffer& buf, uint32_t drawCount, VkDeviceSize offset = 0, uint32_t stride = sizeof ( VkDrawIndirectCommand ) )
+	{
+		vkCmdDrawIndirect ( buffer, buf.getHandle (), offset, drawCount, stride );
+
+		return *this;
+	}
+
+	CommandBuffer&	drawIndexedIndirect ( Buffer& buf, uint32_t drawCount, VkDeviceSize offset = 0, uint32_t stride = sizeof ( VkDrawIndexedIndirectCommand ) )
+	{
+		vkCmdDrawIndexedIndirect ( buffer, buf.getHandle (), offset, drawCount, stride );
+
+		return *this;
+	}
+
+		// number of draws is taken from countBuf (requires drawIndirectCount or VK_KHR_draw_indirect_count)
+	CommandBuffer&	drawIndexedIndirectCount ( Buffer& buf, VkDeviceSize offset, Buffer& countBuf, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride = sizeof ( VkDrawIndexedIndirectCommand ) )
+	{
+		vkCmdDrawIndexedIndirectCount ( buffer, buf.getHandle (), offset, countBuf.getHandle (), countOffset, maxDrawCount, stride );
+
+		return *this;
+	}
+
+		// launch task (or mesh) shader workgroups, requires VK_EXT_mesh_shader
+	CommandBuffer&	drawMeshTasks ( uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1 )
+	{
+		MeshShaderFuncs&	funcs = MeshShaderFuncs::get ();
+
+		if ( !funcs.isOk ( device->getDevice () ) )
+			funcs.load ( device->getDevice () );
+
+		funcs.vkCmdDrawMeshTasksEXT ( buffer, groupCountX, groupCountY, groupCountZ );
+
+		return *this;
+	}
+
 	CommandBuffer& fillBuffer ( Buffer& buf, VkDeviceSize dstOffset = 0, VkDeviceSize size = VK_WHOLE_SIZE, uint32_t value = 0)
 	{
 		assert((size % 4) == 0 || size == VK_WHOLE_SIZE);
@@ -413,6 +546,24 @@ public:
 		return *this;
 	}
 
+		// all instances of InstanceBuffer (count at record time), its buffer for this image must be bound by descriptor set
+	template <class C, typename T>
+	CommandBuffer& renderInstanced ( C * obj, const InstanceBuffer<T>& instances )
+	{
+		obj->render ( *this, instances.size () );
+
+		return *this;
+	}
+
+		// depth-only draw using position stream
+	template <class C>
+	CommandBuffer& renderDepth ( C * obj )
+	{
+		obj->renderDepth ( *this );			// assume C has method renderDepth ( CommandBuffer& )
+
+		return *this;
+	}
+
 	CommandBuffer&	resetEvent ( Event& event, VkPipelineStageFlags flags )
 	{
 		vkCmdResetEvent ( buffer, event.getHandle (), flags );
@@ -0,0 +1,94 @@
+//
+// Optional depth prepass: depth-only pass with position stream (shaders/depthpass.*)
+// fills depth buffer, then main pass is drawn with VK_COMPARE_OP_EQUAL and depth writes off,
+// so expensive fragment shaders run only once per pixel. Pays off with high overdraw and
+// heavy shading, otherwise extra vertex work costs more (see benchmark-depth-prepass).
+// Both passes are drawn in the same subpass and share descriptor set layout of main
+// pipeline, whose UBO at binding 0 must start with mv and proj matrices. Main vertex
+// shader must compute gl_Position as proj * (mv * pos) and declare it invariant
+//
+
+#pragma once
+
+#include	<vector>
+#include	"Device.h"
+#include	"Pipeline.h"
+#include	"DescriptorSet.h"
+#include	"CommandBuffer.h"
+#include	"PackedVertex.h"
+
+class	DepthPrepass
+{
+	GraphicsPipeline	pipeline;
+	bool				enabled = true;
+
+public:
+	DepthPrepass () = default;
+
+	bool	isEnabled () const
+	{
+		return enabled;
+	}
+
+		// switch per scene, main pipeline must be set up for the same mode
+	void	setEnabled ( bool flag )
+	{
+		enabled = flag;
+	}
+
+	GraphicsPipeline&	getPipeline ()
+	{
+		return pipeline;
+	}
+
+		// depth state of main pipeline for given mode, call before its create
+	static GraphicsPipeline&	setupMainPipeline ( GraphicsPipeline& main, bool prepass )
+	{
+		return main.setDepthTest      ( true )
+				   .setDepthWrite     ( !prepass )
+				   .setDepthCompareOp ( prepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS );
+	}
+
+		// create depth-only pipeline after main one, descriptor set layout 0 is shared with it
+	void	create ( Device& device, Renderpass& renderPass, GraphicsPipeline& main, uint32_t width, uint32_t height, VkCullModeFlags cullMode = VK_CULL_MODE_NONE )
+	{
+		DescSetLayout	layout = main.getDescLayout ();		// shares VkDescriptorSetLayout
+
+		pipeline.setDevice         ( device )
+				.setVertexShader   ( "shaders/depthpass.vert.spv" )
+				.setFragmentShader ( "shaders/depthpass.frag.spv" )
+				.setSize           ( width, height )
+				.addVertexBinding  ( sizeof ( PositionVertex ) )
+				.addVertexAttributes<PositionVertex> ()
+				.addDescLayout     ( 0, layout )
+				.setCullMode       ( cullMode )
+				.setFrontFace      ( VK_FRONT_FACE_COUNTER_CLOCKWISE )
+				.setDepthTest      ( true )
+				.setDepthWrite     ( true )
+				.setDepthCompareOp ( VK_COMPARE_OP_LESS )
+				.setColorWriteMask ( false, false, false, false )
+				.create            ( renderPass );
+	}
+
+	void	clean ()
+	{
+		pipeline.clean ();
+	}
+
+		// record depth-only draws of objects having renderDepth ( CommandBuffer& ), e.g. Mesh,
+		// nothing is recorded when disabled. Main pipeline should be bound after it
+	template <class C>
+	CommandBuffer&	record ( CommandBuffer& cb, DescriptorSet& descriptorSet, const std::vector<C *>& objects )
+	{
+		if ( !enabled )
+			return cb;
+
+		cb.pipeline          ( pipeline )
+		  .addDescriptorSets ( { descriptorSet } );
+
+		for ( auto * obj : objects )
+			cb.renderDepth ( obj );
+
+		return cb;
+	}
+};
@@ -0,0 +1,250 @@
+//
+// Descriptor buffer backend (VK_EXT_descriptor_buffer): descriptor sets are just
+// ranges of host-visible buffer, descriptors are written there with vkGetDescriptorEXT.
+// Layouts must be created with VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+// and pipelines with VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+//
+
+#pragma once
+
+#include	<vector>
+#include	"Device.h"
+#include	"Buffer.h"
+
+	// entry points of VK_EXT_descriptor_buffer, loaded from device
+struct	DescriptorBufferFuncs
+{
+	PFN_vkGetDescriptorSetLayoutSizeEXT				vkGetDescriptorSetLayoutSizeEXT          = nullptr;
+	PFN_vkGetDescriptorSetLayoutBindingOffsetEXT	vkGetDescriptorSetLayoutBindingOffsetEXT = nullptr;
+	PFN_vkGetDescriptorEXT							vkGetDescriptorEXT                       = nullptr;
+	PFN_vkCmdBindDescriptorBuffersEXT				vkCmdBindDescriptorBuffersEXT            = nullptr;
+	PFN_vkCmdSetDescriptorBufferOffsetsEXT			vkCmdSetDescriptorBufferOffsetsEXT       = nullptr;
+
+	bool	isOk () const
+	{
+		return vkGetDescriptorEXT != nullptr && vkCmdBindDescriptorBuffersEXT != nullptr;
+	}
+
+	void	load ( VkDevice device )
+	{
+		vkGetDescriptorSetLayoutSizeEXT          = reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>         ( vkGetDeviceProcAddr ( device, "vkGetDescriptorSetLayoutSizeEXT"          ) );
+		vkGetDescriptorSetLayoutBindingOffsetEXT = reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>( vkGetDeviceProcAddr ( device, "vkGetDescriptorSetLayoutBindingOffsetEXT" ) );
+		vkGetDescriptorEXT                       = reinterpret_cast<PFN_vkGetDescriptorEXT>                      ( vkGetDeviceProcAddr ( device, "vkGetDescriptorEXT"                       ) );
+		vkCmdBindDescriptorBuffersEXT            = reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>           ( vkGetDeviceProcAddr ( device, "vkCmdBindDescriptorBuffersEXT"            ) );
+		vkCmdSetDescriptorBufferOffsetsEXT       = reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>      ( vkGetDeviceProcAddr ( device, "vkCmdSetDescriptorBufferOffsetsEXT"       ) );
+	}
+
+		// single instance, loaded by first DescriptorBuffer::create
+	static	DescriptorBufferFuncs&	get ()
+	{
+		static	DescriptorBufferFuncs	funcs;
+
+		return funcs;
+	}
+};
+
+class	DescriptorBuffer
+{
+	Device									  * device   = nullptr;
+	PersistentBuffer							buffer;
+	VkBufferUsageFlags							usage    = 0;
+	VkDeviceSize								used     = 0;			// linear allocation of sets
+	VkPhysicalDeviceDescriptorBufferPropertiesEXT	props = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT };
+
+public:
+	DescriptorBuffer  () = default;
+	DescriptorBuffer  ( const DescriptorBuffer& ) = delete;
+	~DescriptorBuffer () = default;
+
+	DescriptorBuffer& operator = ( const DescriptorBuffer& ) = delete;
+
+	static	void	enableFeatures ( VkPhysicalDeviceDescriptorBufferFeaturesEXT& features )
+	{
+		features.descriptorBuffer = VK_TRUE;
+	}
+
+	bool	isOk () const
+	{
+		return buffer.getHandle () != VK_NULL_HANDLE;
+	}
+
+	const VkPhysicalDeviceDescriptorBufferPropertiesEXT&	getProperties () const
+	{
+		return props;
+	}
+
+	VkDeviceSize	getSize () const
+	{
+		return buffer.getSize ();
+	}
+
+	VkDeviceSize	getUsed () const
+	{
+		return used;
+	}
+
+		// holdSamplers - buffer will contain samplers (and combined image samplers)
+	bool	create ( Device& dev, VkDeviceSize size, bool holdSamplers = true )
+	{
+		VkPhysicalDeviceProperties2	properties = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+
+		device           = &dev;
+		properties.pNext = &props;
+
+		vkGetPhysicalDeviceProperties2 ( dev.getPhysicalDevice (), &properties );
+
+		if ( !DescriptorBufferFuncs::get ().isOk () )
+			DescriptorBufferFuncs::get ().load ( dev.getDevice () );
+
+		if ( !DescriptorBufferFuncs::get ().isOk () )
+		{
+			log () << "DescriptorBuffer: VK_EXT_descriptor_buffer is not supported" << Log::endl;
+			return false;
+		}
+
+		usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT;
+
+		if ( holdSamplers )
+			usage |= VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
+
+		used = 0;
+
+		return buffer.create ( dev, size, usage, Buffer::hostWrite );
+	}
+
+	void	clean ()
+	{
+		buffer.clean ();
+		used = 0;
+	}
+
+		// start allocating sets from the beginning (GPU should not use old sets)
+	void	reset ()
+	{
+		used = 0;
+	}
+
+	VkDeviceSize	layoutSize ( VkDescriptorSetLayout layout ) const
+	{
+		VkDeviceSize	size = 0;
+
+		DescriptorBufferFuncs::get ().vkGetDescriptorSetLayoutSizeEXT ( device->getDevice (), layout, &size );
+
+		return size;
+	}
+
+	VkDeviceSize	bindingOffset ( VkDescriptorSetLayout layout, uint32_t binding ) const
+	{
+		VkDeviceSize	offset = 0;
+
+		DescriptorBufferFuncs::get ().vkGetDescriptorSetLayoutBindingOffsetEXT ( device->getDevice (), layout, binding, &offset );
+
+		return offset;
+	}
+
+		// size of single descriptor of given type
+	size_t	descriptorSize ( VkDescriptorType type ) const
+	{
+		switch ( type )
+		{
+			case VK_DESCRIPTOR_TYPE_SAMPLER:				return props.samplerDescriptorSize;
+			case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:	return props.combinedImageSamplerDescriptorSize;
+			case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:			return props.sampledImageDescriptorSize;
+			case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:			return props.storageImageDescriptorSize;
+			case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:	return props.uniformTexelBufferDescriptorSize;
+			case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:	return props.storageTexelBufferDescriptorSize;
+			case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:			return props.uniformBufferDescriptorSize;
+			case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:			return props.storageBufferDescriptorSize;
+			case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:		return props.inputAttachmentDescriptorSize;
+			default:
+				fatal () << "DescriptorBuffer: unsupported descriptor type " << type << Log::endl;
+		}
+
+		return 0;
+	}
+
+		// reserve space for a set with given layout, return its offset in buffer
+	VkDeviceSize	allocSet ( VkDescriptorSetLayout layout )
+	{
+		VkDeviceSize	offset = alignedSize<VkDeviceSize> ( used, props.descriptorBufferOffsetAlignment );
+		VkDeviceSize	size   = layoutSize ( layout );
+
+		if ( offset + size > buffer.getSize () )
+			fatal () << "DescriptorBuffer: buffer is full, size " << buffer.getSize () << Log::endl;
+
+		used = offset + size;
+
+		return offset;
+	}
+
+		// write descriptors from VkWriteDescriptorSet into set at given offset, dstSet is ignored
+	void	write ( VkDeviceSize setOffset, VkDescriptorSetLayout layout, const VkWriteDescriptorSet& w )
+	{
+		size_t	size   = descriptorSize ( w.descriptorType );
+		char  * ptr    = (char *) buffer.getPtr () + setOffset + bindingOffset ( layout, w.dstBinding );
+
+		for ( uint32_t i = 0; i < w.descriptorCount; i++ )
+		{
+			VkDescriptorGetInfoEXT		info        = { VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT     };
+			VkDescriptorAddressInfoEXT	addressInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT };
+
+			info.type = w.descriptorType;
+
+			switch ( w.descriptorType )
+			{
+				case VK_DESCRIPTOR_TYPE_SAMPLER:
+					info.data.pSampler = &w.pImageInfo [i].sampler;
+					break;
+
+				case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+					info.data.pCombinedImageSampler = &w.pImageInfo [i];
+					break;
+
+				case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+					info.data.pSampledImage = &w.pImageInfo [i];
+					break;
+
+				case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+					info.data.pStorageImage = &w.pImageInfo [i];
+					break;
+
+				case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+					info.data.pInputAttachmentImage = &w.pImageInfo [i];
+					break;
+
+				case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+				case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+				{
+					VkBufferDeviceAddressInfo	bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
+
+					bufferInfo.buffer   = w.pBufferInfo [i].buffer;
+					addressInfo.address = vkGetBufferDeviceAddress ( device->getDevice (), &bufferInfo ) + w.pBufferInfo [i].offset;
+					addressInfo.range   = w.pBufferInfo [i].range;			// VK_WHOLE_SIZE is not allowed here
+					addressInfo.format  = VK_FORMAT_UNDEFINED;
+
+					if ( w.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER )
+						info.data.pUniformBuffer = &addressInfo;
+					else
+						info.data.pStorageBuffer = &addressInfo;
+					break;
+				}
+
+				default:
+					fatal () << "DescriptorBuffer: unsupported descriptor type " << w.descriptorType << Log::endl;
+			}
+
+			DescriptorBufferFuncs::get ().vkGetDescriptorEXT ( device->getDevice (), &info, size, ptr + (w.dstArrayElement + i) * size );
+		}
+	}
+
+		// info to be passed to CommandBuffer::bindDescriptorBuffers
+	VkDescriptorBufferBindingInfoEXT	getBindingInfo () const
+	{
+		VkDescriptorBufferBindingInfoEXT	info = { VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT };
+
+		info.address = buffer.getDeviceAddress ();
+		info.usage   = usage;
+
+		return info;
+	}
+};
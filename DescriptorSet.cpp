@@ -1,5 +1,6 @@
 #include	"DescriptorSet.h"
 #include	"Pipeline.h"
+#include	<string.h>
 
 static VkDescriptorPool createPool ( VkDevice device, const DescriptorAllocator::PoolSizes& poolSizes, int count, VkDescriptorPoolCreateFlags flags = 0 )
 {
@@ -53,12 +54,16 @@ VkDescriptorPool DescriptorAllocator::pickPool ()
         
         return pool;
     }
-    else
-            // no pools available, so create a new one
-        return createPool ( device, descriptorSizes, 1000, flags );
+
+        // no pools available, so create a new one
+    VkDescriptorPool pool = createPool ( device, descriptorSizes, setsPerPool, flags );
+
+    stats.poolsCreated++;
+
+    return pool;
 }
 
-VkDescriptorSet	DescriptorAllocator::alloc ( VkDescriptorSetLayout layout )
+VkDescriptorSet	DescriptorAllocator::alloc ( VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize> * layoutSizes )
 {
         // initialize the currentPool handle if it's null
     if ( currentPool == VK_NULL_HANDLE )
@@ -77,25 +82,103 @@ VkDescriptorSet	DescriptorAllocator::alloc ( VkDescriptorSetLayout layout )
     allocInfo.descriptorSetCount = 1;
 
         // try to allocate the descriptor set
-    VkResult allocResult    = vkAllocateDescriptorSets ( device, &allocInfo, &set );
-    bool     needReallocate = false;
+    VkResult allocResult = vkAllocateDescriptorSets ( device, &allocInfo, &set );
 
-    if ( allocResult == VK_SUCCESS )
-        return set;
-    
-        // some strange error
-    if ( allocResult != VK_ERROR_FRAGMENTED_POOL && allocResult != VK_ERROR_OUT_OF_POOL_MEMORY )
-        return VK_NULL_HANDLE;
+    if ( allocResult != VK_SUCCESS )
+    {
+            // some strange error
+        if ( allocResult != VK_ERROR_FRAGMENTED_POOL && allocResult != VK_ERROR_OUT_OF_POOL_MEMORY )
+        {
+            stats.lostAllocs++;
+
+            return VK_NULL_HANDLE;
+        }
     
-        // allocate a new pool and retry
-    currentPool              = pickPool ();
-    allocInfo.descriptorPool = currentPool;        // ????
-    usedPools.push_back ( currentPool );
+            // allocate a new pool and retry
+        stats.failedAllocs++;
+
+        currentPool              = pickPool ();
+        allocInfo.descriptorPool = currentPool;
+        usedPools.push_back ( currentPool );
+
+        allocResult = vkAllocateDescriptorSets ( device, &allocInfo, &set );
+
+                // if it still fails then we have big issues
+        if ( allocResult != VK_SUCCESS )
+        {
+            stats.lostAllocs++;
+
+            return VK_NULL_HANDLE;
+        }
+    }
+
+        // gather usage info for adapting pool sizes
+    stats.setsAllocated++;
+
+    if ( typeUsage.size () != descriptorSizes.sizes.size () )
+        typeUsage.assign ( descriptorSizes.sizes.size (), 0 );
+
+    if ( layoutSizes == nullptr )
+        unknownLayouts++;
+    else
+        for ( auto& sz : *layoutSizes )
+            for ( size_t i = 0; i < descriptorSizes.sizes.size (); i++ )
+                if ( descriptorSizes.sizes [i].first == sz.type )
+                    typeUsage [i] += sz.descriptorCount;
+
+    return set;
+}
+
+void DescriptorAllocator::adaptSizes ()
+{
+    uint32_t    sets    = stats.setsAllocated;
+    bool        changed = false;
+
+    stats.peakSets = std::max ( stats.peakSets, sets );
+
+    if ( sets == 0 )
+        return;
+
+        // grow pool if we needed more than one pool, shrink it if we use much less than single pool
+    uint32_t    newSize = setsPerPool;
+
+    while ( newSize < sets && newSize < maxSetsPerPool )
+        newSize *= 2;
+
+    while ( newSize / 4 >= sets && newSize / 2 >= minSetsPerPool )
+        newSize /= 2;
+
+    newSize = std::min ( std::max ( newSize, minSetsPerPool ), maxSetsPerPool );
 
-    allocResult = vkAllocateDescriptorSets ( device, &allocInfo, &set );
+    if ( newSize != setsPerPool )
+    {
+        setsPerPool = newSize;
+        changed     = true;
+    }
+
+        // adapt multipliers only when we know layouts of all allocated sets
+    if ( unknownLayouts == 0 )
+        for ( size_t i = 0; i < descriptorSizes.sizes.size (); i++ )
+        {
+            float   avg    = float ( typeUsage [i] ) / float ( sets );
+            float   factor = std::max ( 1.25f * avg, 0.125f );		// keep small reserve for every type
 
-            // if it still fails then we have big issues
-    return allocResult == VK_SUCCESS ? set : VK_NULL_HANDLE;
+                // change multiplier only if pools are too small or more than twice too large
+            if ( factor > descriptorSizes.sizes [i].second || 2 * factor < descriptorSizes.sizes [i].second )
+            {
+                descriptorSizes.sizes [i].second = factor;
+                changed                          = true;
+            }
+        }
+
+        // free pools have old sizes, so destroy them
+    if ( changed )
+    {
+        for ( auto p : freePools )
+            vkDestroyDescriptorPool ( device, p, nullptr );
+    
+        freePools.clear ();
+    }
 }
 
 void DescriptorAllocator::reset ()
@@ -112,6 +195,266 @@ void DescriptorAllocator::reset ()
 
         // reset the current pool handle back to null
     currentPool = VK_NULL_HANDLE;
+
+    adaptSizes ();
+
+    stats.resets++;
+    stats.setsAllocated = 0;
+    unknownLayouts      = 0;
+    typeUsage.assign ( descriptorSizes.sizes.size (), 0 );
+}
+
+void	FrameDescriptorAllocator::create ( Device& dev, uint32_t framesInFlight )
+{
+	device = &dev;
+
+	frames.clear ();
+
+	for ( uint32_t i = 0; i < framesInFlight; i++ )
+		frames.push_back ( std::make_unique<Frame> () );
+
+	currentFrame = 0;
+}
+
+void	FrameDescriptorAllocator::clean ()
+{
+	for ( auto& frame : frames )
+	{
+		std::lock_guard<std::mutex>	guard ( frame->lock );
+
+		for ( auto& it : frame->allocators )
+			it.second->clean ();
+
+		frame->allocators.clear ();
+	}
+
+	frames.clear ();
+}
+
+void	FrameDescriptorAllocator::beginFrame ( uint32_t frameIndex )
+{
+	assert ( frameIndex < frames.size () );
+
+	Frame&	frame = *frames [frameIndex];
+
+	{
+		std::lock_guard<std::mutex>	guard ( frame.lock );
+
+		for ( auto& it : frame.allocators )
+			it.second->reset ();
+	}
+
+	currentFrame = frameIndex;
+}
+
+DescriptorAllocator&	FrameDescriptorAllocator::get ()
+{
+	assert ( !frames.empty () );
+
+	Frame&						frame = *frames [currentFrame];
+	std::lock_guard<std::mutex>	guard ( frame.lock );
+	auto&						ptr   = frame.allocators [std::this_thread::get_id ()];
+
+	if ( !ptr )
+	{
+		ptr = std::make_unique<DescriptorAllocator> ();
+		ptr->setFlags       ( flags );
+		ptr->setSetsPerPool ( setsPerPool, std::min ( 16u, setsPerPool ) );
+		ptr->create         ( *device );
+	}
+
+	return *ptr;
+}
+
+DescriptorAllocator::Stats	FrameDescriptorAllocator::getStats ()
+{
+	DescriptorAllocator::Stats	total;
+
+	for ( auto& frame : frames )
+	{
+		std::lock_guard<std::mutex>	guard ( frame->lock );
+
+		for ( auto& it : frame->allocators )
+			total += it.second->getStats ();
+	}
+
+	return total;
+}
+
+	// get raw bits of vulkan handle (pointer or uint64_t depending on platform)
+template <typename T>
+static uint64_t	handleBits ( T handle )
+{
+	uint64_t	v = 0;
+
+	memcpy ( &v, &handle, sizeof ( handle ) );
+
+	return v;
+}
+
+void	DescriptorSetCache::create ( Device& dev, size_t maxSets, uint32_t numFramesInFlight )
+{
+	device         = &dev;
+	capacity       = maxSets;
+	framesInFlight = numFramesInFlight;
+
+	allocator.create ( dev );
+}
+
+void	DescriptorSetCache::clean ()
+{
+	entries.clear    ();
+	index.clear      ();
+	sets.clear       ();
+	freeSets.clear   ();
+	allocator.clean  ();		// all sets are freed with pools
+}
+
+void	DescriptorSetCache::beginFrame ()
+{
+	frameNumber++;
+	evict ();
+}
+
+void	DescriptorSetCache::evict ()
+{
+		// least recently used entries are at the back, pinned ones are skipped
+	auto	it = entries.end ();
+
+	while ( entries.size () > capacity && it != entries.begin () )
+	{
+		Entry&	e = *--it;
+
+		if ( e.lastFrame + framesInFlight > frameNumber )		// may still be used by GPU
+			break;
+
+		if ( e.refs > 0 )
+			continue;
+
+		auto	range = index.equal_range ( hashKey ( e.key ) );
+
+		for ( auto i = range.first; i != range.second; ++i )
+			if ( i->second == it )
+			{
+				index.erase ( i );
+				break;
+			}
+
+		sets.erase ( e.set );
+		freeSets [e.layout].push_back ( e.set );
+		it = entries.erase ( it );
+		stats.evictions++;
+	}
+}
+
+void	DescriptorSetCache::release ( VkDescriptorSet set )
+{
+	auto	found = sets.find ( set );
+
+	if ( found == sets.end () )				// cache was cleaned
+		return;
+
+	auto	it = found->second;
+
+	assert ( it->refs > 0 );
+
+		// frames recorded with it may still be in flight
+	it->refs--;
+	it->lastFrame = frameNumber;
+	entries.splice ( entries.begin (), entries, it );
+}
+
+void	DescriptorSetCache::buildKey ( VkDescriptorSetLayout layout, const std::vector<VkWriteDescriptorSet>& writes, std::vector<uint64_t>& key )
+{
+	key.clear ();
+	key.push_back ( handleBits ( layout ) );
+
+	for ( auto& w : writes )
+	{
+		key.push_back ( (uint64_t ( w.dstBinding ) << 32) | w.dstArrayElement );
+		key.push_back ( (uint64_t ( w.descriptorType ) << 32) | w.descriptorCount );
+
+		for ( uint32_t i = 0; i < w.descriptorCount; i++ )
+			if ( w.pBufferInfo != nullptr )
+			{
+				key.push_back ( handleBits ( w.pBufferInfo [i].buffer ) );
+				key.push_back ( w.pBufferInfo [i].offset );
+				key.push_back ( w.pBufferInfo [i].range  );
+			}
+			else
+			if ( w.pImageInfo != nullptr )
+			{
+				key.push_back ( handleBits ( w.pImageInfo [i].sampler   ) );
+				key.push_back ( handleBits ( w.pImageInfo [i].imageView ) );
+				key.push_back ( w.pImageInfo [i].imageLayout );
+			}
+			else
+			if ( w.pTexelBufferView != nullptr )
+				key.push_back ( handleBits ( w.pTexelBufferView [i] ) );
+	}
+}
+
+uint64_t	DescriptorSetCache::hashKey ( const std::vector<uint64_t>& key )
+{
+	uint64_t	h = 14695981039346656037ull;		// FNV-1a over 64-bit words
+
+	for ( auto v : key )
+	{
+		h ^= v;
+		h *= 1099511628211ull;
+	}
+
+	return h ^ (h >> 29);
+}
+
+VkDescriptorSet	DescriptorSetCache::get ( VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize>& layoutSizes, std::vector<VkWriteDescriptorSet>& writes, bool pin )
+{
+	std::vector<uint64_t>	key;
+
+	buildKey ( layout, writes, key );
+
+	uint64_t	hash  = hashKey ( key );
+	auto		range = index.equal_range ( hash );
+
+	for ( auto it = range.first; it != range.second; ++it )
+		if ( it->second->key == key )
+		{
+			it->second->lastFrame = frameNumber;
+			it->second->refs     += pin ? 1 : 0;
+			entries.splice ( entries.begin (), entries, it->second );		// move to front
+			stats.hits++;
+
+			return it->second->set;
+		}
+
+		// not found - take evicted set with same layout or allocate new one
+	VkDescriptorSet	set  = VK_NULL_HANDLE;
+	auto&			free = freeSets [layout];
+
+	stats.misses++;
+
+	if ( !free.empty () )
+	{
+		set = free.back ();
+		free.pop_back ();
+	}
+	else
+		set = allocator.alloc ( layout, &layoutSizes );
+
+	if ( set == VK_NULL_HANDLE )
+		fatal () << "DescriptorSetCache: cannot allocate descriptor set" << Log::endl;
+
+	for ( auto& w : writes )
+		w.dstSet = set;
+
+	vkUpdateDescriptorSets ( device->getDevice (), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr );
+	stats.updates++;
+
+	entries.push_front ( Entry { layout, set, std::move ( key ), frameNumber, pin ? 1u : 0u } );
+	index.insert       ( { hash, entries.begin () } );
+	sets.insert        ( { set, entries.begin () } );
+
+	return set;
 }
 
 DescriptorSet&	DescriptorSet::setLayout (  Device& dev, DescriptorAllocator& descAllocator, const DescSetLayout& descSetLayout )
@@ -119,6 +462,38 @@ DescriptorSet&	DescriptorSet::setLayout (  Device& dev, DescriptorAllocator& des
 	device              = &dev;
 	descriptorSetLayout = descSetLayout.getHandle ();
 	allocator           = &descAllocator;
+	descBuffer          = nullptr;
+
+		// remember how many descriptors of every type the set uses
+	layoutSizes.clear ();
+
+	for ( uint32_t i = 0; i < descSetLayout.count (); i++ )
+		layoutSizes.push_back ( { descSetLayout.data () [i].descriptorType, descSetLayout.data () [i].descriptorCount } );
+
+	return *this;
+}
+
+DescriptorSet&	DescriptorSet::setLayout (  Device& dev, DescriptorBuffer& buffer, const DescSetLayout& descSetLayout )
+{
+	assert ( descSetLayout.isDescriptorBuffer () );
+
+	device              = &dev;
+	descriptorSetLayout = descSetLayout.getHandle ();
+	allocator           = nullptr;
+	descBuffer          = &buffer;
+	bufferOffset        = VK_WHOLE_SIZE;
+
+	return *this;
+}
+
+DescriptorSet&	DescriptorSet::setLayout (  Device& dev, const DescSetLayout& descSetLayout )
+{
+	assert ( descSetLayout.isPushDescriptor () );
+
+	device              = &dev;
+	descriptorSetLayout = descSetLayout.getHandle ();
+	allocator           = nullptr;
+	descBuffer          = nullptr;
 
 	return *this;
 }
@@ -2,14 +2,47 @@
 
 #include	<assert.h>
 #include	<vector>
+#include	<algorithm>
+#include	<memory>
+#include	<mutex>
+#include	<thread>
+#include	<atomic>
+#include	<unordered_map>
+#include	<list>
 #include	"Buffer.h"
 #include	"Texture.h"
+#include	"DescriptorBuffer.h"
 
 class	DescSetLayout;
 
+	// Allocator of descriptor sets from a list of pools. Sets are never freed individually,
+	// all pools are reset at once. Pool size adapts to the observed usage between resets.
+	// Not thread-safe: use FrameDescriptorAllocator to get one allocator per thread
 class DescriptorAllocator
 {
 public:
+	struct Stats
+	{
+		uint32_t	poolsCreated  = 0;		// number of vkCreateDescriptorPool calls
+		uint32_t	failedAllocs  = 0;		// allocations failed in current pool (retried in a new one)
+		uint32_t	lostAllocs    = 0;		// allocations failed completely
+		uint32_t	setsAllocated = 0;		// sets allocated since last reset
+		uint32_t	peakSets      = 0;		// max number of sets allocated between two resets
+		uint32_t	resets        = 0;
+
+		Stats&	operator += ( const Stats& s )
+		{
+			poolsCreated  += s.poolsCreated;
+			failedAllocs  += s.failedAllocs;
+			lostAllocs    += s.lostAllocs;
+			setsAllocated += s.setsAllocated;
+			peakSets       = std::max ( peakSets, s.peakSets );
+			resets        += s.resets;
+
+			return *this;
+		}
+	};
+
     struct PoolSizes
     {
         std::vector<std::pair<VkDescriptorType,float>> sizes =
@@ -33,11 +66,31 @@ public:
 		flags = f;
 	}
 
+		// number of sets in a new pool, it will be adapted between minCount and maxCount
+	void	setSetsPerPool ( uint32_t count, uint32_t minCount = 16, uint32_t maxCount = 4096 )
+	{
+		assert ( minCount > 0 && minCount <= count && count <= maxCount );
+
+		setsPerPool    = count;
+		minSetsPerPool = minCount;
+		maxSetsPerPool = maxCount;
+	}
+
+	uint32_t	getSetsPerPool () const
+	{
+		return setsPerPool;
+	}
+
+	const Stats&	getStats () const
+	{
+		return stats;
+	}
+
 	void create ( Device& newDevice );	// start allocator
 	void reset ();                      // reset all pools and move them to freePools
 	void clean ();                      // destroy allocator
-                                        // allocate descriptor set
-	VkDescriptorSet	alloc ( VkDescriptorSetLayout layout );
+                                        // allocate descriptor set, layoutSizes (if any) are used to adapt pool sizes
+	VkDescriptorSet	alloc ( VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize> * layoutSizes = nullptr );
 
 	void	setMultiplier ( VkDescriptorType type, float factor )
 	{
@@ -48,6 +101,7 @@ public:
 
 private:
 	VkDescriptorPool pickPool ();		// pick appropriate pool for allocation
+	void			 adaptSizes ();		// update pool size and multipliers from usage since last reset
 
 	VkDevice						device      = VK_NULL_HANDLE;
 	VkDescriptorPool                currentPool = VK_NULL_HANDLE;
@@ -55,6 +109,157 @@ private:
 	std::vector<VkDescriptorPool>	usedPools;        // active pools with allocated items
 	std::vector<VkDescriptorPool>	freePools;  
 	VkDescriptorPoolCreateFlags		flags = 0;
+	uint32_t						setsPerPool    = 1000;
+	uint32_t						minSetsPerPool = 16;
+	uint32_t						maxSetsPerPool = 4096;
+	uint32_t						unknownLayouts = 0;			// sets allocated without layout sizes since last reset
+	std::vector<uint32_t>			typeUsage;					// descriptors of every type in descriptorSizes since last reset
+	Stats							stats;
+};
+
+	// Set of allocators for transient descriptor sets: every thread gets its own
+	// DescriptorAllocator for every frame in flight. When the frame is retired
+	// (its fence has been waited for) all its allocators are reset at once
+class	FrameDescriptorAllocator
+{
+	struct	Frame
+	{
+		std::mutex																	lock;
+		std::unordered_map<std::thread::id, std::unique_ptr<DescriptorAllocator>>	allocators;
+	};
+
+	Device                            * device       = nullptr;
+	VkDescriptorPoolCreateFlags			flags        = 0;
+	uint32_t							setsPerPool  = 64;
+	std::vector<std::unique_ptr<Frame>>	frames;
+	std::atomic<uint32_t>				currentFrame { 0 };
+
+public:
+	FrameDescriptorAllocator  () = default;
+	FrameDescriptorAllocator  ( const FrameDescriptorAllocator& ) = delete;
+	~FrameDescriptorAllocator ()
+	{
+		clean ();
+	}
+
+	FrameDescriptorAllocator& operator = ( const FrameDescriptorAllocator& ) = delete;
+
+	void	setFlags ( VkDescriptorPoolCreateFlags f )
+	{
+		flags = f;
+	}
+
+	void	setSetsPerPool ( uint32_t count )
+	{
+		setsPerPool = count;
+	}
+
+	uint32_t	getCurrentFrame () const
+	{
+		return currentFrame;
+	}
+
+	void	create ( Device& dev, uint32_t framesInFlight );
+	void	clean  ();
+
+		// called when frame with given index can be reused (its fence is signaled)
+	void	beginFrame ( uint32_t frameIndex );
+
+		// allocator for the calling thread and the current frame
+	DescriptorAllocator&	get ();
+
+	VkDescriptorSet	alloc ( VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize> * layoutSizes = nullptr )
+	{
+		return get ().alloc ( layout, layoutSizes );
+	}
+
+		// summed statistics of all allocators
+	DescriptorAllocator::Stats	getStats ();
+};
+
+	// Cache of descriptor sets keyed by layout and bound resources. Identical sets
+	// (e.g. for the same material or for every swapchain image) share one VkDescriptorSet.
+	// Sets taken with pin (as DescriptorSet::create does) are kept until released, so they
+	// can be recorded into command buffers that are reused. Unpinned sets must be fetched
+	// with get () every frame they are used, otherwise they are recycled once their last
+	// frame is retired
+class	DescriptorSetCache
+{
+public:
+	struct	Stats
+	{
+		uint64_t	hits      = 0;
+		uint64_t	misses    = 0;
+		uint64_t	evictions = 0;
+		uint64_t	updates   = 0;			// vkUpdateDescriptorSets calls
+	};
+
+private:
+	struct	Entry
+	{
+		VkDescriptorSetLayout	layout;
+		VkDescriptorSet			set;
+		std::vector<uint64_t>	key;				// layout and resources to compare on hash collision
+		uint64_t				lastFrame;			// last frame set was used in
+		uint32_t				refs;				// pins, never evicted while not zero
+	};
+
+	using	EntryList = std::list<Entry>;
+
+	Device                                                    * device         = nullptr;
+	DescriptorAllocator											allocator;
+	EntryList													entries;		// front is most recently used
+	std::unordered_multimap<uint64_t, EntryList::iterator>		index;			// key hash -> entry
+	std::unordered_map<VkDescriptorSet, EntryList::iterator>	sets;			// set -> entry, for release
+	std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>>	freeSets;	// evicted sets, ready for reuse
+	size_t														capacity       = 1024;
+	uint32_t													framesInFlight = 2;
+	uint64_t													frameNumber    = 0;
+	Stats														stats;
+
+public:
+	DescriptorSetCache  () = default;
+	DescriptorSetCache  ( const DescriptorSetCache& ) = delete;
+	~DescriptorSetCache ()
+	{
+		clean ();
+	}
+
+	DescriptorSetCache& operator = ( const DescriptorSetCache& ) = delete;
+
+	void	setFlags ( VkDescriptorPoolCreateFlags f )
+	{
+		allocator.setFlags ( f );
+	}
+
+	size_t	size () const
+	{
+		return entries.size ();
+	}
+
+	const Stats&	getStats () const
+	{
+		return stats;
+	}
+
+		// capacity is a soft limit: pinned sets and sets used by frames in flight are never evicted
+	void	create ( Device& dev, size_t maxSets = 1024, uint32_t numFramesInFlight = 2 );
+	void	clean  ();
+
+		// start new frame, sets of retired frames above capacity are evicted
+	void	beginFrame ();
+
+		// find set with given layout and writes or allocate and write a new one,
+		// pinned set stays valid until release
+	VkDescriptorSet	get ( VkDescriptorSetLayout layout, const std::vector<VkDescriptorPoolSize>& layoutSizes, std::vector<VkWriteDescriptorSet>& writes, bool pin = false );
+
+		// drop pin taken by get, set can be recycled after frames in flight are retired
+	void	release ( VkDescriptorSet set );
+
+private:
+	static	void		buildKey ( VkDescriptorSetLayout layout, const std::vector<VkWriteDescriptorSet>& writes, std::vector<uint64_t>& key );
+	static	uint64_t	hashKey  ( const std::vector<uint64_t>& key );
+	void				evict    ();
 };
 
 class	DescriptorSet
@@ -64,6 +269,10 @@ class	DescriptorSet
 	VkDescriptorSet						set                 = VK_NULL_HANDLE;
 	VkDescriptorSetLayout				descriptorSetLayout = VK_NULL_HANDLE;
 	std::vector<VkWriteDescriptorSet>	writes;
+	std::vector<VkDescriptorPoolSize>	layoutSizes;		// descriptors used by layout, for pool sizing
+	DescriptorBuffer				  * descBuffer          = nullptr;			// descriptor buffer mode
+	VkDeviceSize						bufferOffset        = VK_WHOLE_SIZE;	// offset of set in descBuffer
+	DescriptorSetCache				  * cache               = nullptr;			// set is pinned in it
 
 public:
 	DescriptorSet () = default;
@@ -91,21 +300,55 @@ public:
 		}
 
 		writes.clear ();
+
+		if ( cache != nullptr )
+		{
+			cache->release ( set );
+
+			cache = nullptr;
+			set   = VK_NULL_HANDLE;
+		}
 	}
 
 	DescriptorSet&	setLayout (  Device& dev, DescriptorAllocator& descAllocator, const DescSetLayout& descSetLayout );
 
+		// descriptor buffer mode: set is written directly into descriptor buffer memory,
+		// layout must be created with VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+	DescriptorSet&	setLayout (  Device& dev, DescriptorBuffer& buffer, const DescSetLayout& descSetLayout );
+
+	bool	isDescriptorBuffer () const
+	{
+		return descBuffer != nullptr;
+	}
+
+		// push descriptor mode: writes are only collected and passed to CommandBuffer::pushDescriptorSet
+	DescriptorSet&	setLayout (  Device& dev, const DescSetLayout& descSetLayout );
+
+	const std::vector<VkWriteDescriptorSet>&	getWrites () const
+	{
+		return writes;
+	}
+
+		// offset of set in descriptor buffer, to be used with CommandBuffer::setDescriptorBufferOffsets
+	VkDeviceSize	getBufferOffset () const
+	{
+		return bufferOffset;
+	}
+
+		// transient set, allocated from the calling thread's allocator for the current frame
+	DescriptorSet&	setLayout (  Device& dev, FrameDescriptorAllocator& descAllocator, const DescSetLayout& descSetLayout )
+	{
+		return setLayout ( dev, descAllocator.get (), descSetLayout );
+	}
+
 	DescriptorSet&	addBuffer ( uint32_t binding, VkDescriptorType type, Buffer& buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE )
 	{
-		if ( set == VK_NULL_HANDLE )
-			alloc ();
-		
 		VkDescriptorBufferInfo * bufferInfo       = new VkDescriptorBufferInfo {};
 		VkWriteDescriptorSet	 descriptorWrites = {};
 
 		bufferInfo->buffer = buffer.getHandle ();
 		bufferInfo->offset = offset;
-		bufferInfo->range  = size;
+		bufferInfo->range  = size == VK_WHOLE_SIZE ? buffer.getSize () - offset : size;		// descriptor buffers need real range
 
 		descriptorWrites.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrites.dstSet          = set;
@@ -132,9 +375,6 @@ public:
 
 	DescriptorSet&	addImage ( uint32_t binding, Texture& texture, Sampler& sampler )
 	{
-		if ( set == VK_NULL_HANDLE )
-			alloc ();
-		
 		assert ( texture.getImageView () != VK_NULL_HANDLE );
 		assert ( sampler.getHandle    () != VK_NULL_HANDLE );
 
@@ -158,24 +398,68 @@ public:
 		return *this;
 	}
 
+		// combined image sampler for explicit view (single mip level, depth aspect, etc.)
+	DescriptorSet&	addImage ( uint32_t binding, VkImageView view, Sampler& sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL )
+	{
+		assert ( view                 != VK_NULL_HANDLE );
+		assert ( sampler.getHandle () != VK_NULL_HANDLE );
+
+		VkDescriptorImageInfo    * imageInfo        = new VkDescriptorImageInfo {};
+		VkWriteDescriptorSet	   descriptorWrites = {};
+
+		imageInfo->imageLayout = layout;
+		imageInfo->imageView   = view;
+		imageInfo->sampler     = sampler.getHandle ();
+
+		descriptorWrites.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites.dstSet          = set;
+		descriptorWrites.dstBinding      = binding;
+		descriptorWrites.dstArrayElement = 0;
+		descriptorWrites.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites.descriptorCount = 1;
+		descriptorWrites.pImageInfo      = imageInfo;
+
+		writes.push_back ( descriptorWrites );
+
+		return *this;
+	}
+
+	DescriptorSet&	addStorageImage ( uint32_t binding, VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL )
+	{
+		assert ( view != VK_NULL_HANDLE );
+
+		VkDescriptorImageInfo    * imageInfo        = new VkDescriptorImageInfo {};
+		VkWriteDescriptorSet	   descriptorWrites = {};
+
+		imageInfo->imageLayout = layout;
+		imageInfo->imageView   = view;
+
+		descriptorWrites.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites.dstSet          = set;
+		descriptorWrites.dstBinding      = binding;
+		descriptorWrites.dstArrayElement = 0;
+		descriptorWrites.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		descriptorWrites.descriptorCount = 1;
+		descriptorWrites.pImageInfo      = imageInfo;
+
+		writes.push_back ( descriptorWrites );
+
+		return *this;
+	}
+
 	DescriptorSet&	addImageArray ( uint32_t binding, std::initializer_list<std::reference_wrapper<Texture>> textureList )
 	{
 		assert ( textureList.size () > 0 );
 
-		if ( set == VK_NULL_HANDLE )
-			alloc ();
-
-		std::vector<VkDescriptorImageInfo>	views;
+		VkDescriptorImageInfo *	views = new VkDescriptorImageInfo [textureList.size ()];
+		VkDescriptorImageInfo *	v     = views;
 
 		for ( auto& tx : textureList )
 		{
-			VkDescriptorImageInfo	info;
-
-			info.sampler     = nullptr;
-			info.imageView   = tx.get().getImageView ();
-			info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-			views.push_back ( info );
+			v->sampler     = nullptr;
+			v->imageView   = tx.get().getImageView ();
+			v->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			v++;
 		}
 
 		VkWriteDescriptorSet	   descriptorWrites = {};
@@ -185,8 +469,8 @@ public:
 		descriptorWrites.dstBinding      = binding;
 		descriptorWrites.dstArrayElement = 0;
 		descriptorWrites.descriptorType  = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-		descriptorWrites.descriptorCount = (uint32_t)views.size ();
-		descriptorWrites.pImageInfo      = views.data ();
+		descriptorWrites.descriptorCount = (uint32_t)textureList.size ();
+		descriptorWrites.pImageInfo      = views;
 
 		writes.push_back ( descriptorWrites );
 
@@ -197,9 +481,6 @@ public:
 	{
 		assert ( textures.size () > 0 );
 
-		if ( set == VK_NULL_HANDLE )
-			alloc ();
-		
 		VkDescriptorImageInfo *	views = new VkDescriptorImageInfo [textures.size ()];
 		VkDescriptorImageInfo *	v     = views;
 
@@ -231,9 +512,6 @@ public:
 		VkWriteDescriptorSet	descriptorWrites = {};
 		VkDescriptorImageInfo * samplerInfo      = new VkDescriptorImageInfo;
 
-		if ( set == VK_NULL_HANDLE )
-			alloc ();
-
 		*samplerInfo = {};
 		samplerInfo->sampler             = sampler.getHandle ();
 		descriptorWrites.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -252,17 +530,47 @@ public:
 	
 	void	create ()
 	{
+		if ( descBuffer != nullptr )
+		{
+			if ( bufferOffset == VK_WHOLE_SIZE )
+				bufferOffset = descBuffer->allocSet ( descriptorSetLayout );
+
+			for ( auto& w : writes )
+				descBuffer->write ( bufferOffset, descriptorSetLayout, w );
+
+			return;
+		}
+
 		if ( set == VK_NULL_HANDLE )
 			alloc ();
 				
+		for ( auto& w : writes )
+			w.dstSet = set;
+
 		vkUpdateDescriptorSets ( device->getDevice (), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr );
 	}
 
+		// get set with the same layout and resources from cache or create and write a new one.
+		// Set is pinned in cache until clean, so command buffers recorded once can use it,
+		// cache must outlive this object
+	void	create ( DescriptorSetCache& setCache )
+	{
+		assert ( descriptorSetLayout != VK_NULL_HANDLE && descBuffer == nullptr );
+
+		VkDescriptorSet	newSet = setCache.get ( descriptorSetLayout, layoutSizes, writes, true );
+
+		if ( cache != nullptr )			// pin of previous set
+			cache->release ( set );
+
+		cache = &setCache;
+		set   = newSet;
+	}
+
 private:
 	void	alloc ()
 	{
 		assert ( device != nullptr && allocator != nullptr && descriptorSetLayout != VK_NULL_HANDLE );
 
-		set = allocator->alloc ( descriptorSetLayout);
+		set = allocator->alloc ( descriptorSetLayout, &layoutSizes );
 	}
 };
@@ -0,0 +1,125 @@
+//
+// Content-hash deduplication of geometry at load time. Vertex and index payloads (plus
+// salt for build options) are hashed with 64-bit FNV-1a, hash hits are verified by
+// comparing bytes with kept copy, so only bit-identical geometry is shared. Value of
+// entry refers to already created GPU data (Mesh uses weak pointer to its buffers, Model
+// index of primitive). Callers add GPU bytes they did not upload to getBytesSaved ()
+//
+
+#pragma once
+
+#include	<stdint.h>
+#include	<string.h>
+#include	<vector>
+#include	<unordered_map>
+
+template <typename T>
+class	GeometryCache
+{
+	struct	Entry
+	{
+		std::vector<uint8_t>	data;				// vertices followed by indices
+		size_t					vertexBytes;
+		uint64_t				salt;
+		T						value;
+	};
+
+	std::unordered_multimap<uint64_t, Entry>	entries;
+	size_t										hits       = 0;
+	size_t										bytesSaved = 0;
+
+public:
+	GeometryCache () = default;
+
+	static uint64_t	hash ( const void * data, size_t size, uint64_t h = 0xCBF29CE484222325ull )
+	{
+		const uint8_t * ptr = (const uint8_t *) data;
+
+		for ( size_t i = 0; i < size; i++ )
+			h = (h ^ ptr [i]) * 0x100000001B3ull;
+
+		return h;
+	}
+
+		// value of identical geometry added before or nullptr
+	T *	find ( const void * vertices, size_t vertexBytes, const void * indices, size_t indexBytes, uint64_t salt = 0 )
+	{
+		auto	range = entries.equal_range ( key ( vertices, vertexBytes, indices, indexBytes, salt ) );
+
+		for ( auto it = range.first; it != range.second; ++it )
+		{
+			Entry&	e = it->second;
+
+			if ( e.salt != salt || e.vertexBytes != vertexBytes || e.data.size () != vertexBytes + indexBytes )
+				continue;
+
+			if ( memcmp ( e.data.data (), vertices, vertexBytes ) == 0 && memcmp ( e.data.data () + vertexBytes, indices, indexBytes ) == 0 )
+			{
+				hits++;
+
+				return &e.value;
+			}
+		}
+
+		return nullptr;
+	}
+
+		// register geometry, replaces value of identical entry
+	void	add ( const void * vertices, size_t vertexBytes, const void * indices, size_t indexBytes, const T& value, uint64_t salt = 0 )
+	{
+		if ( T * old = find ( vertices, vertexBytes, indices, indexBytes, salt ) )
+		{
+			hits--;								// not a reuse
+			*old = value;
+
+			return;
+		}
+
+		Entry	e;
+
+		e.data.resize ( vertexBytes + indexBytes );
+		e.vertexBytes = vertexBytes;
+		e.salt        = salt;
+		e.value       = value;
+
+		memcpy ( e.data.data (), vertices, vertexBytes );
+		memcpy ( e.data.data () + vertexBytes, indices, indexBytes );
+
+		entries.emplace ( key ( vertices, vertexBytes, indices, indexBytes, salt ), std::move ( e ) );
+	}
+
+	void	addSaved ( size_t bytes )
+	{
+		bytesSaved += bytes;
+	}
+
+	size_t	getBytesSaved () const
+	{
+		return bytesSaved;
+	}
+
+		// number of successful lookups
+	size_t	getHits () const
+	{
+		return hits;
+	}
+
+	size_t	size () const
+	{
+		return entries.size ();
+	}
+
+	void	clear ()
+	{
+		entries.clear ();
+
+		hits       = 0;
+		bytesSaved = 0;
+	}
+
+private:
+	static uint64_t	key ( const void * vertices, size_t vertexBytes, const void * indices, size_t indexBytes, uint64_t salt )
+	{
+		return hash ( indices, indexBytes, hash ( vertices, vertexBytes, hash ( &salt, sizeof ( salt ) ) ) );
+	}
+};
@@ -0,0 +1,779 @@
+//
+// Out-of-core geometry streaming: chunk file, geometry heap, loader thread and residency
+//
+
+#include	<assert.h>
+#include	<string.h>
+#include	<algorithm>
+#include	"GeometryStreamer.h"
+#include	"SingleTimeCommand.h"
+#include	"LodSelector.h"
+#include	"Frustum.h"
+#include	"Log.h"
+
+	// layout of chunk file: header, data of all levels, table of chunks, table of levels
+struct	ChunkFileHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	vertexSize;
+	uint32_t	numChunks;
+	uint32_t	numLevels;
+	uint32_t	pad;
+	uint64_t	tableOffset;
+};
+
+struct	ChunkFileChunk
+{
+	float		minPoint [3];
+	float		maxPoint [3];
+	uint32_t	firstLevel;
+	uint32_t	numLevels;
+};
+
+	// level data is vertices followed by 32-bit indices relative to them
+struct	ChunkFileLevel
+{
+	uint64_t	offset;
+	uint32_t	numVertices;
+	uint32_t	numIndices;
+	float		error;
+	uint32_t	pad;
+};
+
+static const uint32_t	chunkFileMagic   = 0x52545347;		// 'GSTR'
+static const uint32_t	chunkFileVersion = 1;
+
+static bool	seekFile ( FILE * fp, uint64_t offset )
+{
+#ifdef	_WIN32
+	return _fseeki64 ( fp, (__int64) offset, SEEK_SET ) == 0;
+#else
+	return fseeko ( fp, (off_t) offset, SEEK_SET ) == 0;
+#endif
+}
+
+static uint64_t	tellFile ( FILE * fp )
+{
+#ifdef	_WIN32
+	return (uint64_t) _ftelli64 ( fp );
+#else
+	return (uint64_t) ftello ( fp );
+#endif
+}
+
+static VkDeviceSize	alignUp ( VkDeviceSize value, VkDeviceSize align )
+{
+	return (value + align - 1) / align * align;
+}
+
+bool	GeometryHeap :: create ( Device& device, VkDeviceSize size, VkDeviceSize align )
+{
+	alignment = align;
+	size      = size / alignment * alignment;
+	used      = 0;
+
+	freeRanges.clear ();
+
+	if ( size == 0 || !buffer.create ( device, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0 ) )
+		return false;
+
+	freeRanges [0] = size;
+
+	return true;
+}
+
+void	GeometryHeap :: clean ()
+{
+	buffer.clean ();
+	freeRanges.clear ();
+
+	used = 0;
+}
+
+bool	GeometryHeap :: alloc ( VkDeviceSize size, VkDeviceSize& offset )
+{
+	size = alignUp ( size, alignment );
+
+	for ( auto it = freeRanges.begin (); it != freeRanges.end (); ++it )
+		if ( it->second >= size )
+		{
+			offset = it->first;
+
+			if ( it->second > size )
+				freeRanges [offset + size] = it->second - size;
+
+			freeRanges.erase ( it );
+			used += size;
+
+			return true;
+		}
+
+	return false;
+}
+
+void	GeometryHeap :: free ( VkDeviceSize offset, VkDeviceSize size )
+{
+	size  = alignUp ( size, alignment );
+	used -= size;
+
+	addRange ( freeRanges, offset, size );
+}
+
+std::map<VkDeviceSize, VkDeviceSize>::iterator	GeometryHeap :: addRange ( std::map<VkDeviceSize, VkDeviceSize>& ranges, VkDeviceSize offset, VkDeviceSize size )
+{
+	auto	it = ranges.emplace ( offset, size ).first;
+
+		// merge with following and preceding free ranges
+	auto	next = std::next ( it );
+
+	if ( next != ranges.end () && it->first + it->second == next->first )
+	{
+		it->second += next->second;
+		ranges.erase ( next );
+	}
+
+	if ( it != ranges.begin () )
+	{
+		auto	prev = std::prev ( it );
+
+		if ( prev->first + prev->second == it->first )
+		{
+			prev->second += it->second;
+			ranges.erase ( it );
+
+			return prev;
+		}
+	}
+
+	return it;
+}
+
+bool	GeometryStreamer :: buildChunkFile ( const std::string& fileName, const void * vertices, size_t numVertices, size_t vertexSize,
+											 const std::vector<uint32_t>& indices, const glm::ivec3& grid, int maxLods )
+{
+	const uint8_t * src = (const uint8_t *) vertices;
+	auto			pos = [&] ( uint32_t i ) { return *(const glm::vec3 *) (src + i * vertexSize); };
+	bbox			box;
+
+	for ( size_t i = 0; i < numVertices; i++ )
+		box.addVertex ( pos ( (uint32_t) i ) );
+
+		// distribute triangles over cells by their centers
+	glm::vec3							size = glm::max ( box.getSize (), glm::vec3 ( 1e-6f ) );
+	std::vector<std::vector<uint32_t>>	cells ( grid.x * grid.y * grid.z );
+
+	for ( size_t i = 0; i + 2 < indices.size (); i += 3 )
+	{
+		glm::vec3	c    = (pos ( indices [i] ) + pos ( indices [i + 1] ) + pos ( indices [i + 2] )) / 3.0f;
+		glm::ivec3	cell = glm::clamp ( glm::ivec3 ( (c - box.getMinPoint ()) / size * glm::vec3 ( grid ) ), glm::ivec3 ( 0 ), grid - 1 );
+
+		cells [(cell.z * grid.y + cell.y) * grid.x + cell.x].push_back ( (uint32_t) i );
+	}
+
+	FILE * fp = fopen ( fileName.c_str (), "wb" );
+
+	if ( fp == nullptr )
+	{
+		log () << "GeometryStreamer: cannot create " << fileName << Log::endl;
+
+		return false;
+	}
+
+	ChunkFileHeader				header = { chunkFileMagic, chunkFileVersion, (uint32_t) vertexSize, 0, 0, 0, 0 };
+	std::vector<ChunkFileChunk>	chunkTable;
+	std::vector<ChunkFileLevel>	levelTable;
+	std::vector<uint32_t>		remap ( numVertices, ~0u );
+
+	fwrite ( &header, sizeof ( header ), 1, fp );
+
+	for ( auto& cell : cells )
+	{
+		if ( cell.empty () )
+			continue;
+
+			// chunk gets its own compact vertex list
+		std::vector<uint32_t>	used;
+		std::vector<uint32_t>	local;
+		std::vector<uint8_t>	chunkVertices;
+		bbox					bounds;
+
+		for ( uint32_t tri : cell )
+			for ( int k = 0; k < 3; k++ )
+			{
+				uint32_t	index = indices [tri + k];
+
+				if ( remap [index] == ~0u )
+				{
+					remap [index] = (uint32_t) used.size ();
+					used.push_back ( index );
+					chunkVertices.insert ( chunkVertices.end (), src + index * vertexSize, src + (index + 1) * vertexSize );
+					bounds.addVertex ( pos ( index ) );
+				}
+
+				local.push_back ( remap [index] );
+			}
+
+		for ( uint32_t index : used )
+			remap [index] = ~0u;
+
+		std::vector<uint32_t>	lodIndices;
+		std::vector<MeshLod>	lods;
+
+		MeshSimplifier ( chunkVertices.data (), used.size (), vertexSize ).buildLods ( local, lodIndices, lods, maxLods );
+
+		ChunkFileChunk	chunk;
+
+		memcpy ( chunk.minPoint, &bounds.getMinPoint (), sizeof ( chunk.minPoint ) );
+		memcpy ( chunk.maxPoint, &bounds.getMaxPoint (), sizeof ( chunk.maxPoint ) );
+
+		chunk.firstLevel = (uint32_t) levelTable.size ();
+		chunk.numLevels  = (uint32_t) lods.size ();
+
+			// every level keeps only vertices it references, so coarse levels are small to load
+		for ( auto& lod : lods )
+		{
+			std::vector<uint32_t>	levelIndices;
+			std::vector<uint8_t>	levelVertices;
+			std::vector<uint32_t>	levelUsed;
+			ChunkFileLevel			level;
+
+			for ( uint32_t i = 0; i < lod.indexCount; i++ )
+			{
+				uint32_t	index = lodIndices [lod.firstIndex + i];
+
+				if ( remap [index] == ~0u )
+				{
+					remap [index] = (uint32_t) levelUsed.size ();
+					levelUsed.push_back ( index );
+					levelVertices.insert ( levelVertices.end (), chunkVertices.begin () + index * vertexSize, chunkVertices.begin () + (index + 1) * vertexSize );
+				}
+
+				levelIndices.push_back ( remap [index] );
+			}
+
+			for ( uint32_t index : levelUsed )
+				remap [index] = ~0u;
+
+			level.offset      = tellFile ( fp );
+			level.numVertices = (uint32_t) levelUsed.size ();
+			level.numIndices  = (uint32_t) levelIndices.size ();
+			level.error       = lod.error;
+			level.pad         = 0;
+
+			fwrite ( levelVertices.data (), 1, levelVertices.size (), fp );
+			fwrite ( levelIndices.data (), sizeof ( uint32_t ), levelIndices.size (), fp );
+			levelTable.push_back ( level );
+		}
+
+		chunkTable.push_back ( chunk );
+	}
+
+	header.numChunks   = (uint32_t) chunkTable.size ();
+	header.numLevels   = (uint32_t) levelTable.size ();
+	header.tableOffset = tellFile ( fp );
+
+	fwrite ( chunkTable.data (), sizeof ( ChunkFileChunk ), chunkTable.size (), fp );
+	fwrite ( levelTable.data (), sizeof ( ChunkFileLevel ), levelTable.size (), fp );
+
+	bool	ok = seekFile ( fp, 0 ) && fwrite ( &header, sizeof ( header ), 1, fp ) == 1;
+
+	ok = fclose ( fp ) == 0 && ok;
+
+	log () << "GeometryStreamer: " << fileName << " has " << chunkTable.size () << " chunks, " << levelTable.size () << " levels" << Log::endl;
+
+	return ok;
+}
+
+bool	GeometryStreamer :: open ( Device& dev, const std::string& fileName, VkDeviceSize heapSize, size_t uploadBudget, uint32_t numFramesInFlight )
+{
+	clean ();
+
+	ChunkFileHeader	header;
+
+	file = fopen ( fileName.c_str (), "rb" );
+
+	if ( file == nullptr || fread ( &header, sizeof ( header ), 1, file ) != 1 || header.magic != chunkFileMagic || header.version != chunkFileVersion )
+	{
+		log () << "GeometryStreamer: cannot open chunk file " << fileName << Log::endl;
+		clean ();
+
+		return false;
+	}
+
+	std::vector<ChunkFileChunk>	chunkTable ( header.numChunks );
+	std::vector<ChunkFileLevel>	levelTable ( header.numLevels );
+
+	if ( !seekFile ( file, header.tableOffset ) || fread ( chunkTable.data (), sizeof ( ChunkFileChunk ), chunkTable.size (), file ) != chunkTable.size () ||
+		 fread ( levelTable.data (), sizeof ( ChunkFileLevel ), levelTable.size (), file ) != levelTable.size () )
+	{
+		log () << "GeometryStreamer: chunk file " << fileName << " is truncated" << Log::endl;
+		clean ();
+
+		return false;
+	}
+
+	device         = &dev;
+	vertexSize     = header.vertexSize;
+	framesInFlight = numFramesInFlight;
+	stagingSize    = uploadBudget;
+
+	for ( auto& lv : levelTable )
+	{
+		Level	level;
+
+		level.fileOffset  = lv.offset;
+		level.numVertices = lv.numVertices;
+		level.numIndices  = lv.numIndices;
+		level.error       = lv.error;
+
+		levels.push_back ( level );
+		stagingSize = std::max ( stagingSize, (size_t) levelSize ( level ) );
+	}
+
+	for ( auto& ch : chunkTable )
+	{
+		Chunk	chunk;
+
+		chunk.bounds     = bbox ( glm::vec3 ( ch.minPoint [0], ch.minPoint [1], ch.minPoint [2] ), glm::vec3 ( ch.maxPoint [0], ch.maxPoint [1], ch.maxPoint [2] ) );
+		chunk.firstLevel = ch.firstLevel;
+
+		for ( uint32_t i = 0; i < ch.numLevels; i++ )
+			chunk.lods.push_back ( MeshLod { 0, levels [ch.firstLevel + i].numIndices, levels [ch.firstLevel + i].error } );
+
+		chunks.push_back ( chunk );
+	}
+
+		// offsets must be in whole vertices for vertexOffset and whole indices for firstIndex
+	VkDeviceSize	alignment = vertexSize;
+
+	while ( alignment % sizeof ( uint32_t ) != 0 )
+		alignment += vertexSize;
+
+	if ( !heap.create ( dev, heapSize, alignment ) )
+		fatal () << "GeometryStreamer: cannot create geometry heap of " << heapSize << " bytes" << Log::endl;
+
+	for ( uint32_t i = 0; i < std::max ( 2u, framesInFlight ); i++ )
+	{
+		auto	slot = std::make_unique<UploadSlot> ();
+
+		if ( !slot->staging.create ( dev, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, Buffer::hostWrite ) )
+			fatal () << "GeometryStreamer: cannot create staging buffer" << Log::endl;
+
+		slot->cb.create    ( dev );
+		slot->fence.create ( dev );
+		uploads.push_back  ( std::move ( slot ) );
+	}
+
+		// coarsest levels are loaded now and stay resident
+	UploadSlot&					slot       = *uploads [0];
+	size_t						slotOffset = 0;
+	std::vector<VkBufferCopy>	regions;
+	std::vector<uint8_t>		data;
+
+	for ( auto& chunk : chunks )
+	{
+		uint32_t	index = chunk.firstLevel + (uint32_t) chunk.lods.size () - 1;
+		Level&		level = levels [index];
+
+		if ( !heap.alloc ( levelSize ( level ), level.offset ) )
+			fatal () << "GeometryStreamer: heap of " << heapSize << " bytes cannot hold coarsest levels" << Log::endl;
+
+		if ( !readLevel ( file, level, data ) )
+			fatal () << "GeometryStreamer: error reading " << fileName << Log::endl;
+
+		if ( slotOffset + data.size () > stagingSize )
+		{
+			SingleTimeCommand	cmd ( dev );
+
+			vkCmdCopyBuffer ( cmd.getHandle (), slot.staging.getHandle (), heap.getBuffer ().getHandle (), (uint32_t) regions.size (), regions.data () );
+			regions.clear ();
+
+			slotOffset = 0;
+		}
+
+		level.size   = levelSize ( level );
+		level.state  = resident;
+		level.pinned = true;
+
+		copyToStaging ( slot, slotOffset, regions, index, data );
+	}
+
+	if ( !regions.empty () )
+	{
+		SingleTimeCommand	cmd ( dev );
+
+		vkCmdCopyBuffer ( cmd.getHandle (), slot.staging.getHandle (), heap.getBuffer ().getHandle (), (uint32_t) regions.size (), regions.data () );
+	}
+
+	stats          = StreamingStats ();
+	stats.heapSize = (size_t) heap.getSize ();
+	quit           = false;
+	inProgress     = -1;
+	loader         = std::thread ( &GeometryStreamer::loaderThread, this );
+
+	log () << "GeometryStreamer: " << chunks.size () << " chunks, heap " << heap.getSize () / 1024 << " KB, " << heap.getUsed () / 1024 << " KB used by coarsest levels" << Log::endl;
+
+	return true;
+}
+
+void	GeometryStreamer :: clean ()
+{
+	if ( loader.joinable () )
+	{
+		{
+			std::lock_guard<std::mutex>	lock ( mutex );
+
+			quit = true;
+		}
+
+		wakeUp.notify_all ();
+		loader.join       ();
+	}
+
+		// copies in flight still write to heap
+	for ( auto& slot : uploads )
+		if ( slot->busy )
+			slot->fence.wait ( UINT64_MAX );
+
+	uploads.clear ();
+	heap.clean    ();
+
+	if ( file != nullptr )
+		fclose ( file );
+
+	file   = nullptr;
+	device = nullptr;
+
+	chunks.clear ();
+	levels.clear ();
+	ready.clear  ();
+	queue.clear  ();
+	done.clear   ();
+}
+
+VkDeviceSize	GeometryStreamer :: levelSize ( const Level& level ) const
+{
+	return alignUp ( level.numVertices * vertexSize, sizeof ( uint32_t ) ) + level.numIndices * sizeof ( uint32_t );
+}
+
+bool	GeometryStreamer :: readLevel ( FILE * fp, const Level& level, std::vector<uint8_t>& data ) const
+{
+	data.resize ( level.numVertices * vertexSize + level.numIndices * sizeof ( uint32_t ) );
+
+	return seekFile ( fp, level.fileOffset ) && fread ( data.data (), 1, data.size (), fp ) == data.size ();
+}
+
+	// vertices and indices go to their places in heap, indices start at 4-byte boundary
+void	GeometryStreamer :: copyToStaging ( UploadSlot& slot, size_t& slotOffset, std::vector<VkBufferCopy>& regions, uint32_t index, const std::vector<uint8_t>& data )
+{
+	const Level&	level       = levels [index];
+	VkDeviceSize	vertexBytes = level.numVertices * vertexSize;
+
+	memcpy ( (uint8_t *) slot.staging.getPtr () + slotOffset, data.data (), data.size () );
+
+	regions.push_back ( { slotOffset, level.offset, vertexBytes } );
+	regions.push_back ( { slotOffset + vertexBytes, level.offset + alignUp ( vertexBytes, sizeof ( uint32_t ) ), data.size () - vertexBytes } );
+
+	slotOffset += data.size ();
+}
+
+void	GeometryStreamer :: loaderThread ()
+{
+	std::vector<uint8_t>	data;
+
+	for ( ; ; )
+	{
+		Level	level;
+		int64_t	index;
+
+		{
+			std::unique_lock<std::mutex>	lock ( mutex );
+
+			wakeUp.wait ( lock, [this] { return quit || !queue.empty (); } );
+
+			if ( quit )
+				return;
+
+				// only fields which never change after open, state belongs to main thread
+			index             = queue.back ().level;
+			inProgress        = index;
+			level.fileOffset  = levels [index].fileOffset;
+			level.numVertices = levels [index].numVertices;
+			level.numIndices  = levels [index].numIndices;
+
+			queue.pop_back ();
+		}
+
+		bool	ok = readLevel ( file, level, data );
+
+		if ( !ok )
+			log () << "GeometryStreamer: error reading level " << index << Log::endl;
+
+		std::lock_guard<std::mutex>	lock ( mutex );
+
+		done.push_back ( ReadLevel { (uint32_t) index, ok ? std::move ( data ) : std::vector<uint8_t> () } );
+
+		inProgress = -1;
+	}
+}
+
+bool	GeometryStreamer :: allocLevel ( Level& level )
+{
+	level.size = levelSize ( level );
+
+	if ( heap.alloc ( level.size, level.offset ) )
+		return true;
+
+		// least recently used levels which commands in flight no longer use
+	std::vector<uint32_t>	lru;
+
+	for ( uint32_t i = 0; i < (uint32_t) levels.size (); i++ )
+		if ( levels [i].state == resident && !levels [i].pinned && levels [i].lastUsed + framesInFlight <= frame )
+			lru.push_back ( i );
+
+	std::sort ( lru.begin (), lru.end (), [this] ( uint32_t a, uint32_t b ) { return levels [a].lastUsed < levels [b].lastUsed; } );
+
+		// free candidates in LRU order on a copy of free list until some merged range is large
+		// enough, then evict only candidates inside that range. Nothing is evicted when it can't fit
+	std::map<VkDeviceSize, VkDeviceSize>	ranges = heap.getFreeRanges ();
+	VkDeviceSize							size   = alignUp ( level.size, heap.getAlignment () );
+
+	for ( size_t k = 0; k < lru.size (); k++ )
+	{
+		const Level&	victim = levels [lru [k]];
+		auto			range  = GeometryHeap::addRange ( ranges, victim.offset, alignUp ( victim.size, heap.getAlignment () ) );
+
+		if ( range->second < size )
+			continue;
+
+		for ( size_t j = 0; j <= k; j++ )
+			if ( levels [lru [j]].offset >= range->first && levels [lru [j]].offset < range->first + range->second )
+				evictLevel ( levels [lru [j]] );
+
+		return heap.alloc ( level.size, level.offset );
+	}
+
+	return false;
+}
+
+void	GeometryStreamer :: evictLevel ( Level& level )
+{
+	heap.free ( level.offset, level.size );
+
+	level.state = notLoaded;
+	stats.evictions++;
+}
+
+void	GeometryStreamer :: retireUploads ()
+{
+	for ( auto& slot : uploads )
+		if ( slot->busy && slot->fence.isSignaled () )
+		{
+			for ( uint32_t index : slot->levels )
+				levels [index].state = resident;
+
+			slot->levels.clear ();
+			slot->busy = false;
+		}
+}
+
+void	GeometryStreamer :: uploadReady ()
+{
+	auto	it = std::find_if ( uploads.begin (), uploads.end (), [] ( const std::unique_ptr<UploadSlot>& s ) { return !s->busy; } );
+
+	if ( ready.empty () || it == uploads.end () )
+		return;
+
+	UploadSlot&					slot       = **it;
+	size_t						slotOffset = 0;
+	size_t						count      = 0;
+	std::vector<VkBufferCopy>	regions;
+
+	for ( ; count < ready.size (); count++ )
+	{
+		ReadLevel&	item  = ready [count];
+		Level&		level = levels [item.level];
+
+		if ( level.state != loaded )
+			continue;
+
+		if ( slotOffset + item.data.size () > stagingSize )		// rest waits for the next update
+			break;
+
+			// failed read or heap is filled with levels in use, level is requested again after a delay
+		if ( item.data.empty () || !allocLevel ( level ) )
+		{
+			level.state      = notLoaded;
+			level.retryFrame = frame + retryDelay;
+			continue;
+		}
+
+		level.state = uploading;
+
+		copyToStaging ( slot, slotOffset, regions, item.level, item.data );
+		slot.levels.push_back ( item.level );
+	}
+
+	ready.erase ( ready.begin (), ready.begin () + count );
+
+	if ( regions.empty () )
+		return;
+
+	Barrier::Memory	memory  ( VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT );
+	Barrier			barrier ( VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT );
+
+	barrier.barriers ( { memory } );
+
+		// previous submission of this slot is complete, so its command buffer can be replaced
+	slot.cb.clean  ();
+	slot.cb.create ( *device );
+	slot.cb.begin  ();
+
+	vkCmdCopyBuffer ( slot.cb.getHandle (), slot.staging.getHandle (), heap.getBuffer ().getHandle (), (uint32_t) regions.size (), regions.data () );
+
+	slot.cb.barrier ( barrier );
+	slot.cb.end     ();
+	slot.fence.reset ();
+
+	SubmitInfo ().buffers ( { slot.cb } ).submit ( device->getGraphicsQueue (), slot.fence.getHandle () );
+
+	slot.busy            = true;
+	stats.uploadedBytes += slotOffset;
+}
+
+void	GeometryStreamer :: update ( Frustum& frustum, const LodSelector& selector )
+{
+	std::vector<Request>	wanted;
+
+	frame++;
+
+	stats.uploadedBytes = 0;
+	stats.fallbacks     = 0;
+
+	retireUploads ();
+
+	{
+		std::lock_guard<std::mutex>	lock ( mutex );
+
+			// level can only be read while requested, anything else is a stale result
+		for ( auto& item : done )
+			if ( levels [item.level].state == requested )
+			{
+				levels [item.level].state = loaded;
+				ready.push_back ( std::move ( item ) );
+			}
+
+		done.clear ();
+	}
+
+		// level by screen-space error, drawn is the nearest resident one not finer than it
+	for ( auto& chunk : chunks )
+	{
+		glm::vec3	center  = chunk.bounds.getCenter ();
+		float		radius  = 0.5f * glm::length ( chunk.bounds.getSize () );
+		float		dist    = std::max ( 0.0f, glm::length ( center - selector.getEye () ) - radius );
+		bool		visible = frustum.checkSphere ( center, radius );
+		int			lod     = selector.select ( chunk.lods, center, radius ).lod;
+		Level&		level   = levels [chunk.firstLevel + lod];
+
+		chunk.drawLevel = -1;
+
+		if ( !visible && dist > prefetchDistance )
+			continue;
+
+		level.lastUsed = frame;
+
+		if ( (level.state == notLoaded && level.retryFrame <= frame) || level.state == requested )
+			wanted.push_back ( { chunk.firstLevel + lod, visible ? dist : dist + prefetchDistance } );
+
+		if ( !visible )
+			continue;
+
+		int	draw = lod;
+
+		while ( levels [chunk.firstLevel + draw].state != resident )
+			draw++;
+
+		chunk.drawLevel = draw;
+		levels [chunk.firstLevel + draw].lastUsed = frame;
+
+		if ( draw != lod )
+			stats.fallbacks++;
+	}
+
+	uploadReady ();
+
+		// most urgent go last, as loader takes them from the back
+	std::sort ( wanted.begin (), wanted.end (), [] ( const Request& a, const Request& b ) { return a.priority < b.priority; } );
+
+	if ( ready.size () >= maxRequests )			// do not read ahead of uploads
+		wanted.clear ();
+	else
+	if ( wanted.size () > maxRequests )
+		wanted.resize ( maxRequests );
+
+	std::reverse ( wanted.begin (), wanted.end () );
+
+	{
+		std::lock_guard<std::mutex>	lock ( mutex );
+
+		for ( auto& r : queue )
+			if ( levels [r.level].state == requested )
+				levels [r.level].state = notLoaded;
+
+		queue.clear ();
+
+			// level being read or already read but not yet taken from done must not be read again
+		for ( auto& r : wanted )
+		{
+			State	state = levels [r.level].state;
+
+			if ( (state != notLoaded && state != requested) || r.level == inProgress )
+				continue;
+
+			if ( std::any_of ( done.begin (), done.end (), [&r] ( const ReadLevel& item ) { return item.level == r.level; } ) )
+				continue;
+
+			levels [r.level].state = requested;
+			queue.push_back ( r );
+		}
+	}
+
+	wakeUp.notify_one ();
+
+	stats.loadsPending  = 0;
+	stats.residentBytes = (size_t) heap.getUsed ();
+
+	for ( auto& level : levels )
+		if ( level.state != notLoaded && level.state != resident )
+			stats.loadsPending++;
+}
+
+uint32_t	GeometryStreamer :: writeCommands ( VkDrawIndexedIndirectCommand * commands ) const
+{
+	uint32_t	drawn = 0;
+
+	for ( size_t i = 0; i < chunks.size (); i++ )
+	{
+		if ( chunks [i].drawLevel < 0 )
+		{
+			commands [i] = { 0, 0, 0, 0, 0 };
+			continue;
+		}
+
+		const Level&	level      = levels [chunks [i].firstLevel + chunks [i].drawLevel];
+		VkDeviceSize	indexStart = level.offset + alignUp ( level.numVertices * vertexSize, sizeof ( uint32_t ) );
+
+		commands [i] = { level.numIndices, 1, (uint32_t) (indexStart / sizeof ( uint32_t )), (int32_t) (level.offset / vertexSize), 0 };
+		drawn++;
+	}
+
+	return drawn;
+}
+
+void	GeometryStreamer :: bindBuffers ( CommandBuffer& cb )
+{
+	cb.bindVertexBuffers ( {{ heap.getBuffer (), 0 }} );
+	cb.bindIndexBuffer   ( heap.getBuffer (), VK_INDEX_TYPE_UINT32 );
+}
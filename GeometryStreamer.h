@@ -0,0 +1,243 @@
+//
+// Out-of-core geometry streaming. Mesh is split offline into spatial chunks, every chunk gets
+// LOD chain from MeshSimplifier and every level is stored in chunk file as self-contained
+// record (own vertices and 32-bit indices). At runtime only chunks near the camera are kept in
+// fixed-size GPU heap - single Buffer sub-allocated by offset. Levels are read by loader thread,
+// most urgent first (visible before hidden, near before far), copied to heap through staging
+// buffers by fenced transfer submissions and evicted in LRU order when heap is full. Coarsest
+// level of every chunk is always resident, so while finer levels load chunk is drawn with the
+// nearest coarser resident one
+//
+
+#pragma once
+
+#include	<stdint.h>
+#include	<stdio.h>
+#include	<string>
+#include	<vector>
+#include	<map>
+#include	<memory>
+#include	<thread>
+#include	<mutex>
+#include	<condition_variable>
+#include	<vulkan/vulkan.h>
+#include	"Buffer.h"
+#include	"CommandBuffer.h"
+#include	"bbox.h"
+#include	"MeshSimplifier.h"
+
+class	Frustum;
+class	LodSelector;
+
+	// fixed-size buffer with vertices and indices of resident levels, first-fit allocation
+class	GeometryHeap
+{
+	Buffer								buffer;
+	std::map<VkDeviceSize, VkDeviceSize>	freeRanges;			// offset -> size, never adjacent
+	VkDeviceSize						alignment = 4;
+	VkDeviceSize						used      = 0;
+
+public:
+	GeometryHeap () = default;
+
+	bool	create ( Device& device, VkDeviceSize size, VkDeviceSize align );
+	void	clean  ();
+
+		// sizes are rounded up to alignment, returns false when no free range is large enough
+	bool	alloc ( VkDeviceSize size, VkDeviceSize& offset );
+	void	free  ( VkDeviceSize offset, VkDeviceSize size );
+
+		// add range to free list merging it with neighbours, returns merged range
+	static std::map<VkDeviceSize, VkDeviceSize>::iterator	addRange ( std::map<VkDeviceSize, VkDeviceSize>& ranges, VkDeviceSize offset, VkDeviceSize size );
+
+	const std::map<VkDeviceSize, VkDeviceSize>&	getFreeRanges () const
+	{
+		return freeRanges;
+	}
+
+	Buffer&	getBuffer ()
+	{
+		return buffer;
+	}
+
+	VkDeviceSize	getSize () const
+	{
+		return buffer.getSize ();
+	}
+
+	VkDeviceSize	getUsed () const
+	{
+		return used;
+	}
+
+	VkDeviceSize	getAlignment () const
+	{
+		return alignment;
+	}
+};
+
+struct	StreamingStats
+{
+	size_t	residentBytes = 0;
+	size_t	heapSize      = 0;
+	size_t	uploadedBytes = 0;				// during last update
+	size_t	loadsPending  = 0;				// requested, read or being uploaded
+	size_t	evictions     = 0;				// total
+	size_t	fallbacks     = 0;				// chunks drawn coarser than wanted in last update
+};
+
+class	GeometryStreamer
+{
+	enum	State
+	{
+		notLoaded,
+		requested,							// in loader queue or being read
+		loaded,								// read, waits for staging space
+		uploading,							// copy is submitted
+		resident
+	};
+
+	struct	Level
+	{
+		uint64_t		fileOffset  = 0;
+		uint32_t		numVertices = 0;
+		uint32_t		numIndices  = 0;
+		float			error       = 0;
+		State			state       = notLoaded;
+		bool			pinned      = false;		// coarsest level, never evicted
+		VkDeviceSize	offset      = 0;			// in heap when resident or uploading
+		VkDeviceSize	size        = 0;
+		uint64_t		lastUsed    = 0;			// frame it was drawn or wanted last time
+		uint64_t		retryFrame  = 0;			// not requested before it after failed load
+	};
+
+	struct	Chunk
+	{
+		bbox					bounds;
+		uint32_t				firstLevel = 0;
+		std::vector<MeshLod>	lods;				// errors for LodSelector, 0 is full resolution
+		int						drawLevel  = -1;	// chosen by last update, -1 if culled
+	};
+
+	struct	ReadLevel
+	{
+		uint32_t				level;
+		std::vector<uint8_t>	data;
+	};
+
+	struct	Request
+	{
+		uint32_t	level;
+		float		priority;						// smaller is more urgent
+	};
+
+		// staging buffer with transfer command buffer and fence to know when copies are done
+	struct	UploadSlot
+	{
+		PersistentBuffer		staging;
+		CommandBuffer			cb;
+		Fence					fence;
+		std::vector<uint32_t>	levels;
+		bool					busy = false;
+	};
+
+	Device								  * device      = nullptr;
+	FILE								  * file        = nullptr;
+	size_t									vertexSize  = 0;
+	std::vector<Chunk>						chunks;
+	std::vector<Level>						levels;
+	GeometryHeap							heap;
+	std::vector<std::unique_ptr<UploadSlot>>	uploads;
+	std::vector<ReadLevel>					ready;				// read but not uploaded yet
+	uint64_t								frame        = 0;
+	uint32_t								framesInFlight = 2;
+	size_t									stagingSize  = 0;
+	size_t									maxRequests  = 16;	// levels queued to loader at once
+	uint32_t								retryDelay   = 30;	// frames before failed level is requested again
+	float									prefetchDistance = 0;
+	StreamingStats							stats;
+
+		// shared with loader thread
+	std::thread								loader;
+	std::mutex								mutex;
+	std::condition_variable					wakeUp;
+	std::vector<Request>					queue;				// sorted, most urgent last
+	std::vector<ReadLevel>					done;
+	int64_t									inProgress   = -1;
+	bool									quit         = false;
+
+public:
+	GeometryStreamer () = default;
+	GeometryStreamer ( const GeometryStreamer& ) = delete;
+	~GeometryStreamer ()
+	{
+		clean ();
+	}
+
+	GeometryStreamer& operator = ( const GeometryStreamer& ) = delete;
+
+		// split indexed mesh into cells of grid over its bounds and write chunk file, position must be
+		// the first field of vertex. Every chunk gets up to maxLods levels, chunk borders are never
+		// simplified so neighbours with different levels have no cracks
+	static bool	buildChunkFile ( const std::string& fileName, const void * vertices, size_t numVertices, size_t vertexSize,
+								 const std::vector<uint32_t>& indices, const glm::ivec3& grid, int maxLods = 4 );
+
+		// open chunk file, create heap of heapSize bytes and load coarsest levels. uploadBudget - bytes
+		// copied to heap per update, framesInFlight - frames whose commands may still read heap
+	bool	open  ( Device& dev, const std::string& fileName, VkDeviceSize heapSize, size_t uploadBudget = 4 * 1024 * 1024, uint32_t framesInFlight = 3 );
+	void	clean ();
+
+		// distance from eye to bounds of hidden chunks that are still kept loaded
+	GeometryStreamer&	setPrefetchDistance ( float dist )
+	{
+		prefetchDistance = dist;
+
+		return *this;
+	}
+
+		// choose levels of chunks, issue loads, upload read levels and retire finished uploads.
+		// Call once per frame before writeCommands
+	void	update ( Frustum& frustum, const LodSelector& selector );
+
+		// draw command per chunk for levels chosen by update, culled chunks get instanceCount 0.
+		// Returns number of drawn chunks
+	uint32_t	writeCommands ( VkDrawIndexedIndirectCommand * commands ) const;
+
+		// heap is both vertex and 32-bit index buffer
+	void	bindBuffers ( CommandBuffer& cb );
+
+	size_t	getChunkCount () const
+	{
+		return chunks.size ();
+	}
+
+	size_t	getVertexSize () const
+	{
+		return vertexSize;
+	}
+
+	int	getDrawLevel ( size_t chunk ) const
+	{
+		return chunks [chunk].drawLevel;
+	}
+
+	const StreamingStats&	getStats () const
+	{
+		return stats;
+	}
+
+	GeometryHeap&	getHeap ()
+	{
+		return heap;
+	}
+
+private:
+	void	loaderThread     ();
+	bool	readLevel        ( FILE * fp, const Level& level, std::vector<uint8_t>& data ) const;
+	VkDeviceSize	levelSize ( const Level& level ) const;
+	bool	allocLevel       ( Level& level );
+	void	evictLevel       ( Level& level );
+	void	retireUploads    ();
+	void	uploadReady      ();
+	void	copyToStaging    ( UploadSlot& slot, size_t& slotOffset, std::vector<VkBufferCopy>& regions, uint32_t index, const std::vector<uint8_t>& data );
+};
@@ -0,0 +1,297 @@
+//
+// GPU-driven frustum culling: compute shader (shaders/cull.comp) tests bounding sphere
+// of every object and appends draw commands of visible ones into indirect buffer,
+// the number of draws is written into count buffer and used by drawIndexedIndirectCount.
+// Draw commands use firstInstance = object index, so vertex shader gets object data
+// via gl_InstanceIndex from the same objects buffer.
+// If created with HiZPyramid, culling also tests occlusion in two phases (shaders/cull-hiz.comp):
+// cull/draw render objects not occluded by previous frame pyramid, then after pyramid is rebuilt
+// from this depth, cullLate/drawLate render objects disoccluded since the previous frame
+//
+
+#pragma once
+
+#include	<string.h>
+#include	<memory>
+#include	<vector>
+#include	"Device.h"
+#include	"Buffer.h"
+#include	"Pipeline.h"
+#include	"DescriptorSet.h"
+#include	"CommandBuffer.h"
+#include	"Frustum.h"
+#include	"Model.h"
+#include	"HiZPyramid.h"
+
+class	GpuCulling
+{
+	enum
+	{
+		groupSize = 64			// must match local_size_x in cull.comp
+	};
+
+		// uniform block of cull.comp
+	struct	CullParams
+	{
+		glm::vec4	planes [6];
+		glm::mat4	viewProj;
+		glm::mat4	prevViewProj;		// pyramid was built with this matrix
+		glm::vec2	pyramidSize;
+		uint32_t	objectCount;
+		uint32_t	pyramidLevels;
+	};
+
+public:
+		// per frame counters of occlusion culling, written by GPU
+	struct	CullStats
+	{
+		uint32_t	frustumCulled;
+		uint32_t	earlyOccluded;		// rejected by previous frame pyramid
+		uint32_t	occluded;			// rejected by both pyramids
+		uint32_t	pad;
+	};
+
+private:
+
+		// per command buffer data, so recorded command buffers do not share draw lists
+	struct	Frame
+	{
+		Uniform<CullParams>		params;
+		Buffer					draws;
+		Buffer					count;
+		PersistentBuffer		stats;			// occlusion culling only
+		DescriptorSet			descSet;
+	};
+
+	Device                					  * device      = nullptr;
+	ComputePipeline								pipeline;
+	Buffer										objects;
+	uint32_t									objectCount = 0;
+	std::vector<std::unique_ptr<Frame>>			frames;
+	HiZPyramid								  * hiz         = nullptr;
+	Buffer										state;				// per object phase result, occlusion culling only
+	glm::mat4									lastViewProj = glm::mat4 ( 1 );
+
+public:
+	GpuCulling  () = default;
+	GpuCulling  ( const GpuCulling& ) = delete;
+	~GpuCulling ()
+	{
+		clean ();
+	}
+
+	GpuCulling& operator = ( const GpuCulling& ) = delete;
+
+	bool	isOk () const
+	{
+		return !frames.empty ();
+	}
+
+	uint32_t	getObjectCount () const
+	{
+		return objectCount;
+	}
+
+		// objects buffer to be bound to graphics pipeline (indexed by gl_InstanceIndex)
+	Buffer&	getObjectBuffer ()
+	{
+		return objects;
+	}
+
+	bool	hasOcclusion () const
+	{
+		return hiz != nullptr;
+	}
+
+		// counters of the last completed execution of given copy
+	CullStats	getStats ( uint32_t index ) const
+	{
+		return hiz != nullptr ? *(const CullStats *) frames [index]->stats.getPtr () : CullStats {};
+	}
+
+		// copies - number of independent draw lists (usually swap chain image count),
+		// pyramid - Hi-Z pyramid for occlusion culling (built by caller between cull and cullLate) or nullptr
+	bool	create ( Device& dev, DescriptorAllocator& allocator, const std::vector<GpuObject>& objs, uint32_t copies, HiZPyramid * pyramid = nullptr )
+	{
+		clean ();
+
+		if ( objs.empty () )
+			return false;
+
+		device      = &dev;
+		objectCount = (uint32_t) objs.size ();
+		hiz         = pyramid;
+
+		uint32_t	lists = hiz != nullptr ? 2 : 1;
+
+		if ( !objects.createDeviceLocal ( dev, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, objs ) )
+		{
+			log () << "GpuCulling: cannot create objects buffer" << Log::endl;
+			return false;
+		}
+
+		pipeline.setDevice     ( dev )
+				.setShader     ( hiz != nullptr ? "shaders/cull-hiz.comp.spv" : "shaders/cull.comp.spv" )
+				.addDescriptor ( 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT )
+				.addDescriptor ( 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT )
+				.addDescriptor ( 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT )
+				.addDescriptor ( 3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT );
+
+		if ( hiz != nullptr )
+		{
+			pipeline.addDescriptor     ( 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT )
+					.addDescriptor     ( 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT )
+					.addDescriptor     ( 6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT )
+					.addPushConstRange ( VK_SHADER_STAGE_COMPUTE_BIT, sizeof ( uint32_t ) );
+
+			state.create ( dev, objectCount * sizeof ( uint32_t ), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 0 );
+		}
+
+		pipeline.create ();
+
+		for ( uint32_t i = 0; i < copies; i++ )
+		{
+			auto	frame = std::make_unique<Frame> ();
+
+			frame->params.create ( dev );
+			frame->draws.create  ( dev, lists * objectCount * sizeof ( VkDrawIndexedIndirectCommand ), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, 0 );
+			frame->count.create  ( dev, lists * sizeof ( uint32_t ), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0 );
+			frame->descSet
+				.setLayout ( dev, allocator, pipeline.getDescLayout () )
+				.addBuffer ( 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objects )
+				.addBuffer ( 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame->draws )
+				.addBuffer ( 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame->count )
+				.addBuffer ( 3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame->params );
+
+			if ( hiz != nullptr )
+			{
+				frame->stats.create ( dev, sizeof ( CullStats ), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, Buffer::hostRead );
+				frame->descSet
+					.addImage  ( 4, hiz->getImageView (), hiz->getSampler (), VK_IMAGE_LAYOUT_GENERAL )
+					.addBuffer ( 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, state )
+					.addBuffer ( 6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame->stats );
+
+				memset ( frame->stats.getPtr (), 0, sizeof ( CullStats ) );
+			}
+
+			frame->descSet.create ();
+			frames.push_back ( std::move ( frame ) );
+		}
+
+		return true;
+	}
+
+	void	clean ()
+	{
+		frames.clear     ();
+		objects.clean    ();
+		state.clean      ();
+		pipeline.clean   ();
+
+		objectCount = 0;
+		hiz         = nullptr;
+	}
+
+		// set frustum for given copy, viewProj maps objects space into clip space
+	void	update ( uint32_t index, const glm::mat4& viewProj )
+	{
+		Frustum		frustum;
+		CullParams	params = {};
+
+		frustum.update ( viewProj );
+
+		for ( int i = 0; i < 6; i++ )
+			params.planes [i] = frustum.planes [i];
+
+		params.viewProj     = viewProj;
+		params.prevViewProj = lastViewProj;
+		params.objectCount  = objectCount;
+
+		if ( hiz != nullptr )
+		{
+			params.pyramidSize   = glm::vec2 ( hiz->getWidth (), hiz->getHeight () );
+			params.pyramidLevels = hiz->getLevels ();
+		}
+
+		lastViewProj = viewProj;		// frames are submitted in update order
+
+		*frames [index]->params.getPtr () = params;
+	}
+
+		// record culling, must be outside of render pass
+	void	cull ( CommandBuffer& cb, uint32_t index )
+	{
+		Frame&	frame = *frames [index];
+
+		cb.fillBuffer ( frame.count, 0, VK_WHOLE_SIZE, 0 );
+
+		pipelineBarrier ( cb, { bufferBarrier ( frame.count, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+												VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT ),
+								bufferBarrier ( frame.draws, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+												VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT ) } );
+
+		if ( hiz != nullptr )
+		{
+			cb.fillBuffer ( frame.stats, 0, VK_WHOLE_SIZE, 0 );
+
+				// state may still be read by second phase of previous frame
+			pipelineBarrier ( cb, { bufferBarrier ( frame.stats, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+													VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT ),
+									bufferBarrier ( state, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT,
+													VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT ) } );
+		}
+
+		dispatch ( cb, frame, 0 );
+	}
+
+		// record second phase of occlusion culling, must be outside of render pass,
+		// pyramid must be already rebuilt from depth written by draw ()
+	void	cullLate ( CommandBuffer& cb, uint32_t index )
+	{
+		assert ( hiz != nullptr );
+
+		Frame&	frame = *frames [index];
+
+		pipelineBarrier ( cb, { bufferBarrier ( state, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+												VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT ),
+								bufferBarrier ( frame.count, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+												VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT ),
+								bufferBarrier ( frame.draws, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+												VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT ) } );
+
+		dispatch ( cb, frame, 1 );
+	}
+
+		// draw visible objects, index and vertex buffers must be bound
+	void	draw ( CommandBuffer& cb, uint32_t index )
+	{
+		Frame&	frame = *frames [index];
+
+		cb.drawIndexedIndirectCount ( frame.draws, 0, frame.count, 0, objectCount );
+	}
+
+		// draw objects found visible by cullLate
+	void	drawLate ( CommandBuffer& cb, uint32_t index )
+	{
+		Frame&	frame = *frames [index];
+
+		cb.drawIndexedIndirectCount ( frame.draws, objectCount * sizeof ( VkDrawIndexedIndirectCommand ), frame.count, sizeof ( uint32_t ), objectCount );
+	}
+
+private:
+	void	dispatch ( CommandBuffer& cb, Frame& frame, uint32_t phase )
+	{
+		cb.pipeline          ( pipeline )
+		  .addDescriptorSets ( { frame.descSet } );
+
+		if ( hiz != nullptr )
+			cb.pushConstants ( pipeline.getLayout (), VK_SHADER_STAGE_COMPUTE_BIT, phase );
+
+		cb.dispatch ( (objectCount + groupSize - 1) / groupSize );
+
+		pipelineBarrier ( cb, { bufferBarrier ( frame.draws, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+												VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT ),
+								bufferBarrier ( frame.count, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+												VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT ) } );
+	}
+};
@@ -0,0 +1,247 @@
+//
+// Hierarchical-Z depth pyramid: every mip level stores the farthest depth of the
+// corresponding texels of the previous level (level 0 is reduced from depth buffer),
+// so a box whose nearest depth is greater than pyramid value over its footprint is occluded.
+// Built by compute shader (shaders/hiz-build.comp) one level per dispatch, pyramid image
+// always stays in GENERAL layout. Depth texture must be created with SAMPLED usage
+//
+
+#pragma once
+
+#include	<vector>
+#include	<algorithm>
+#include	"Device.h"
+#include	"Texture.h"
+#include	"Pipeline.h"
+#include	"DescriptorSet.h"
+#include	"CommandBuffer.h"
+#include	"SingleTimeCommand.h"
+
+class	HiZPyramid
+{
+	enum
+	{
+		groupSize = 8			// must match local_size_x/y in hiz-build.comp
+	};
+
+	struct	BuildParams
+	{
+		int32_t	srcWidth, srcHeight;
+		int32_t	dstWidth, dstHeight;
+	};
+
+	Device                * device    = nullptr;
+	Texture				  * depth     = nullptr;
+	Texture					pyramid;
+	Sampler					sampler;
+	ComputePipeline			pipeline;
+	std::vector<VkImageView>	levelViews;		// single level views for writing and reading previous level
+	std::vector<DescriptorSet>	levelSets;
+	uint32_t				width     = 0;		// size of level 0
+	uint32_t				height    = 0;
+	uint32_t				numLevels = 0;
+
+public:
+	HiZPyramid  () = default;
+	HiZPyramid  ( const HiZPyramid& ) = delete;
+	~HiZPyramid ()
+	{
+		clean ();
+	}
+
+	HiZPyramid& operator = ( const HiZPyramid& ) = delete;
+
+	bool	isOk () const
+	{
+		return pyramid.isOk ();
+	}
+
+	uint32_t	getWidth () const
+	{
+		return width;
+	}
+
+	uint32_t	getHeight () const
+	{
+		return height;
+	}
+
+	uint32_t	getLevels () const
+	{
+		return numLevels;
+	}
+
+		// view of all levels for sampling with texelFetch, layout is GENERAL
+	VkImageView	getImageView () const
+	{
+		return pyramid.getImageView ();
+	}
+
+	Sampler&	getSampler ()
+	{
+		return sampler;
+	}
+
+	Texture&	getTexture ()
+	{
+		return pyramid;
+	}
+
+		// level 0 is the largest power of two not exceeding depth size, so every next level is exact half
+	bool	create ( Device& dev, DescriptorAllocator& allocator, Texture& depthTexture )
+	{
+		clean ();
+
+		device    = &dev;
+		depth     = &depthTexture;
+		width     = prevPowerOfTwo ( depthTexture.getWidth  () );
+		height    = prevPowerOfTwo ( depthTexture.getHeight () );
+		numLevels = 1;
+
+		while ( (std::max ( width, height ) >> numLevels) > 0 )
+			numLevels++;
+
+		pyramid.create ( dev, width, height, 1, numLevels, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+						 VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, 0 );
+
+		sampler.setMinFilter     ( VK_FILTER_NEAREST )
+			   .setMagFilter     ( VK_FILTER_NEAREST )
+			   .setMipmapMode    ( VK_SAMPLER_MIPMAP_MODE_NEAREST )
+			   .setAddressMode   ( VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE )
+			   .setMaxLod        ( float ( numLevels ) )
+			   .create           ( dev );
+
+		for ( uint32_t i = 0; i < numLevels; i++ )
+		{
+			VkImageViewCreateInfo	viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+			VkImageView				view     = VK_NULL_HANDLE;
+
+			viewInfo.image                           = pyramid.getImage ().getHandle ();
+			viewInfo.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format                          = VK_FORMAT_R32_SFLOAT;
+			viewInfo.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+			viewInfo.subresourceRange.baseMipLevel   = i;
+			viewInfo.subresourceRange.levelCount     = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount     = 1;
+
+			if ( vkCreateImageView ( dev.getDevice (), &viewInfo, nullptr, &view ) != VK_SUCCESS )
+				fatal () << "HiZPyramid: cannot create level view" << Log::endl;
+
+			levelViews.push_back ( view );
+		}
+
+		pipeline.setDevice         ( dev )
+				.setShader         ( "shaders/hiz-build.comp.spv" )
+				.addDescriptor     ( 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT )
+				.addDescriptor     ( 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          VK_SHADER_STAGE_COMPUTE_BIT )
+				.addPushConstRange ( VK_SHADER_STAGE_COMPUTE_BIT, sizeof ( BuildParams ) )
+				.create            ();
+
+		levelSets.resize ( numLevels );
+
+		for ( uint32_t i = 0; i < numLevels; i++ )
+		{
+			levelSets [i].setLayout ( dev, allocator, pipeline.getDescLayout () );
+
+			if ( i == 0 )
+				levelSets [i].addImage ( 0, depthTexture.getImageView (), sampler, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL );
+			else
+				levelSets [i].addImage ( 0, levelViews [i - 1], sampler, VK_IMAGE_LAYOUT_GENERAL );
+
+			levelSets [i].addStorageImage ( 1, levelViews [i] )
+						 .create          ();
+		}
+
+			// until first build pyramid is at far plane, so nothing is occluded
+		SingleTimeCommand		cmd ( dev );
+		VkImageMemoryBarrier	barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+		VkClearColorValue		far     = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+		VkImageSubresourceRange	range   = { VK_IMAGE_ASPECT_COLOR_BIT, 0, numLevels, 0, 1 };
+
+		barrier.srcAccessMask       = 0;
+		barrier.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout           = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image               = pyramid.getImage ().getHandle ();
+		barrier.subresourceRange    = range;
+
+		vkCmdPipelineBarrier ( cmd.getHandle (), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier );
+		vkCmdClearColorImage ( cmd.getHandle (), barrier.image, VK_IMAGE_LAYOUT_GENERAL, &far, 1, &range );
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout     = VK_IMAGE_LAYOUT_GENERAL;
+
+		vkCmdPipelineBarrier ( cmd.getHandle (), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier );
+
+		return true;
+	}
+
+	void	clean ()
+	{
+		levelSets.clear ();
+
+		if ( device != nullptr )
+			for ( auto view : levelViews )
+				vkDestroyImageView ( device->getDevice (), view, nullptr );
+
+		levelViews.clear ();
+		pipeline.clean   ();
+		sampler.clean    ();
+		pyramid.clean    ();
+
+		numLevels = 0;
+	}
+
+		// record pyramid build from depth texture, must be outside of render pass;
+		// depth is expected in DEPTH_STENCIL_ATTACHMENT_OPTIMAL and is returned into it
+	void	build ( CommandBuffer& cb )
+	{
+		VkImage	depthImage = depth->getImage ().getHandle ();
+
+		pipelineBarrier ( cb, { imageBarrier ( depthImage, VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+											   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+											   VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT ),
+								imageBarrier ( pyramid.getImage (), VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL,
+											   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL ) } );
+
+		cb.pipeline ( pipeline );
+
+		for ( uint32_t i = 0; i < numLevels; i++ )
+		{
+			BuildParams	params;
+
+			params.srcWidth  = i == 0 ? depth->getWidth  () : std::max ( width  >> (i - 1), 1u );
+			params.srcHeight = i == 0 ? depth->getHeight () : std::max ( height >> (i - 1), 1u );
+			params.dstWidth  = std::max ( width  >> i, 1u );
+			params.dstHeight = std::max ( height >> i, 1u );
+
+			cb.addDescriptorSets ( { levelSets [i] } )
+			  .pushConstants     ( pipeline.getLayout (), VK_SHADER_STAGE_COMPUTE_BIT, params )
+			  .dispatch          ( (params.dstWidth + groupSize - 1) / groupSize, (params.dstHeight + groupSize - 1) / groupSize );
+
+				// next level reads this one
+			pipelineBarrier ( cb, { imageBarrier ( pyramid.getImage (), VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+												   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT, i, 1 ) } );
+		}
+
+		pipelineBarrier ( cb, { imageBarrier ( depthImage, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+											   VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+											   VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+											   VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT ) } );
+	}
+
+private:
+	static	uint32_t	prevPowerOfTwo ( uint32_t v )
+	{
+		uint32_t	p = 1;
+
+		while ( p * 2 <= v )
+			p *= 2;
+
+		return p;
+	}
+};
@@ -0,0 +1,202 @@
+//
+// Per-instance data (transforms and parameters) in persistently mapped storage buffers,
+// one copy per swapchain image since command buffers are recorded per image. CPU copy is
+// the master, changes are tracked per copy with dirty bitmask of blocks of instances, so
+// flush writes only blocks changed since that copy was last written. Shaders read
+// instances [gl_InstanceIndex] from storage buffer (std430 layout of T)
+//
+
+#pragma once
+
+#include	<assert.h>
+#include	<stdint.h>
+#include	<string.h>
+#include	<algorithm>
+#include	<vector>
+#include	<glm/glm.hpp>
+#include	"Buffer.h"
+#include	"Log.h"
+
+	// default instance: transform and free parameters (e.g. color)
+struct	InstanceData
+{
+	glm::mat4	matrix;
+	glm::vec4	params;
+};
+
+template <typename T = InstanceData>
+class	InstanceBuffer
+{
+	enum
+	{
+		blockSize = 64					// instances per dirty bit
+	};
+
+	std::vector<T>							data;				// master copy
+	std::vector<PersistentBuffer>			buffers;			// copy per swapchain image
+	std::vector<std::vector<uint64_t>>		dirty;				// dirty blocks of every copy
+	uint32_t								capacity = 0;
+	uint32_t								count    = 0;
+	size_t									bytesWritten = 0;	// by last flush
+
+public:
+	InstanceBuffer () = default;
+	InstanceBuffer ( const InstanceBuffer& ) = delete;
+
+	InstanceBuffer& operator = ( const InstanceBuffer& ) = delete;
+
+		// storage for maxInstances in copies buffers, all instances start dirty
+	bool	create ( Device& device, uint32_t maxInstances, uint32_t copies )
+	{
+		capacity = maxInstances;
+		count    = 0;
+
+		data.resize    ( capacity );
+		buffers.clear  ();
+		buffers.resize ( copies );
+		dirty.assign   ( copies, std::vector<uint64_t> ( (numBlocks () + 63) / 64, 0 ) );
+
+		for ( auto& buf : buffers )
+			if ( !buf.create ( device, capacity * sizeof ( T ), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, Buffer::hostWrite ) )
+				return false;
+
+		return true;
+	}
+
+	void	clean ()
+	{
+		buffers.clear ();
+		dirty.clear   ();
+		data.clear    ();
+
+		capacity = 0;
+		count    = 0;
+	}
+
+	uint32_t	size () const
+	{
+		return count;
+	}
+
+	uint32_t	getCapacity () const
+	{
+		return capacity;
+	}
+
+		// storage buffer for descriptor set of given image
+	PersistentBuffer&	getBuffer ( uint32_t copy )
+	{
+		return buffers [copy];
+	}
+
+	const T&	get ( uint32_t index ) const
+	{
+		return data [index];
+	}
+
+		// returns index of new instance
+	uint32_t	add ( const T& value )
+	{
+		if ( count >= capacity )
+			fatal () << "InstanceBuffer: capacity " << capacity << " exceeded" << Log::endl;
+
+		data [count] = value;
+		markDirty ( count, 1 );
+
+		return count++;
+	}
+
+	void	set ( uint32_t index, const T& value )
+	{
+		assert ( index < count );
+
+		data [index] = value;
+		markDirty ( index, 1 );
+	}
+
+		// direct access for in-place changes of range, it is marked dirty
+	T *	modify ( uint32_t first, uint32_t num = 1 )
+	{
+		assert ( first + num <= count );
+
+		markDirty ( first, num );
+
+		return &data [first];
+	}
+
+	void	resize ( uint32_t num )
+	{
+		assert ( num <= capacity );
+
+		if ( num > count )
+			markDirty ( count, num - count );
+
+		count = num;
+	}
+
+	void	markDirty ( uint32_t first, uint32_t num )
+	{
+		if ( num == 0 )
+			return;
+
+		uint32_t	firstBlock = first / blockSize;
+		uint32_t	lastBlock  = (first + num - 1) / blockSize;
+
+		for ( auto& bits : dirty )
+			for ( uint32_t b = firstBlock; b <= lastBlock; b++ )
+				bits [b / 64] |= uint64_t ( 1 ) << (b % 64);
+	}
+
+		// write changed blocks to copy of given image, call before submitting its command buffer
+	void	flush ( uint32_t copy )
+	{
+		std::vector<uint64_t>&	bits = dirty [copy];
+		char				  * dst  = (char *) buffers [copy].getPtr ();
+		uint32_t				blocks = numBlocks ();
+
+		bytesWritten = 0;
+
+		for ( uint32_t w = 0; w < (uint32_t) bits.size (); w++ )
+		{
+			if ( bits [w] == 0 )
+				continue;
+
+			for ( uint32_t b = w * 64; b < std::min ( (w + 1) * 64, blocks ); )
+			{
+				if ( (bits [b / 64] & (uint64_t ( 1 ) << (b % 64))) == 0 )
+				{
+					b++;
+					continue;
+				}
+
+				uint32_t	start = b;			// run of dirty blocks, may continue into next words
+
+				while ( b < blocks && (bits [b / 64] & (uint64_t ( 1 ) << (b % 64))) != 0 )
+				{
+					bits [b / 64] &= ~(uint64_t ( 1 ) << (b % 64));
+					b++;
+				}
+
+				uint32_t	first = start * blockSize;
+				uint32_t	last  = std::min ( b * blockSize, count );
+
+				if ( last > first )
+				{
+					memcpy ( dst + first * sizeof ( T ), &data [first], (last - first) * sizeof ( T ) );
+					bytesWritten += (last - first) * sizeof ( T );
+				}
+			}
+		}
+	}
+
+	size_t	getBytesWritten () const
+	{
+		return bytesWritten;
+	}
+
+private:
+	uint32_t	numBlocks () const
+	{
+		return (capacity + blockSize - 1) / blockSize;
+	}
+};
@@ -0,0 +1,103 @@
+//
+// Runtime LOD selection by projected screen-space error. Error of every level (in object space
+// units, as computed by MeshSimplifier) is projected to pixels at the distance of the bounding
+// sphere, the coarsest level below threshold is chosen. Near the switching distance both levels
+// can be drawn with complementary dither patterns to hide popping
+//
+
+#pragma once
+
+#include	<math.h>
+#include	<vector>
+#include	<glm/glm.hpp>
+#include	"MeshSimplifier.h"
+#include	"Camera.h"
+
+struct	LodChoice
+{
+	int		lod  = 0;				// level to draw
+	int		next = -1;				// coarser level to crossfade with or -1
+	float	fade = 0;				// weight of next level in [0,1]
+};
+
+class	LodSelector
+{
+	float	projScale  = 1000;		// pixels per object space unit at distance 1
+	float	threshold  = 1;			// max allowed error in pixels
+	float	fadeRange  = 0;			// relative part of threshold used for crossfade, 0 disables it
+	glm::vec3	eye    = glm::vec3 ( 0 );
+
+public:
+	LodSelector () = default;
+
+	LodSelector&	setCamera ( const Camera& camera )
+	{
+		return setView ( camera.getPos (), camera.getFov (), (float) camera.getHeight () );
+	}
+
+		// fov is vertical in degrees, viewportHeight in pixels
+	LodSelector&	setView ( const glm::vec3& pos, float fov, float viewportHeight )
+	{
+		eye       = pos;
+		projScale = 0.5f * viewportHeight / tanf ( 0.5f * glm::radians ( fov ) );
+
+		return *this;
+	}
+
+	LodSelector&	setThreshold ( float pixels )
+	{
+		threshold = pixels;
+
+		return *this;
+	}
+
+	LodSelector&	setFadeRange ( float range )
+	{
+		fadeRange = range;
+
+		return *this;
+	}
+
+	const glm::vec3&	getEye () const
+	{
+		return eye;
+	}
+
+		// error of object space size err at distance dist in pixels
+	float	projectedError ( float err, float dist ) const
+	{
+		return err * projScale / dist;
+	}
+
+		// center and radius of bounding sphere, scale - object scale of matrix
+	LodChoice	select ( const std::vector<MeshLod>& lods, const glm::vec3& center, float radius, float scale = 1.0f ) const
+	{
+		LodChoice	choice;
+		float		dist = glm::length ( center - eye ) - radius * scale;
+
+		if ( lods.empty () || dist <= 0 )
+			return choice;
+
+		for ( int i = (int) lods.size () - 1; i > 0; i-- )
+			if ( projectedError ( lods [i].error * scale, dist ) <= threshold )
+			{
+				choice.lod = i;
+				break;
+			}
+
+			// coarser level is close to acceptable: blend it in as it approaches threshold
+		if ( fadeRange > 0 && choice.lod + 1 < (int) lods.size () )
+		{
+			float	err = projectedError ( lods [choice.lod + 1].error * scale, dist );
+			float	end = threshold * (1 + fadeRange);
+
+			if ( err < end )
+			{
+				choice.next = choice.lod + 1;
+				choice.fade = (end - err) / (end - threshold);
+			}
+		}
+
+		return choice;
+	}
+};
@@ -27,22 +27,115 @@
 
 const float pi = 3.1415926f;
 
-Mesh :: Mesh ( Device& dev, BasicVertex * verticesPtr, const uint32_t * indicesPtr, size_t nv, size_t nt )
+MeshCache * Mesh::cache = nullptr;
+
+Mesh :: Mesh ( Device& dev, BasicVertex * verticesPtr, const uint32_t * indicesPtr, size_t nv, size_t nt, const MeshBuildFlags& flags )
 {
+	std::vector<uint32_t>		source ( indicesPtr, indicesPtr + 3 * nt );
+	std::vector<uint32_t>		lodIndices;
+	std::vector<BasicVertex>	vertexData;
+
 	device       = &dev;
 	numVertices  = (uint32_t)nv;
 	numTriangles = (uint32_t)nt;
 	name         = "";
 	material     = -1;
+	packed       = flags.packed;
+	indexType    = MeshOptimizer::fits16Bit ( nv ) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
 	
 	if ( verticesPtr [0].n.length () < 0.001 )
 		computeNormals  ( verticesPtr, indicesPtr, nv, nt );
-		
-	createBuffer ( vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,     numVertices  * sizeof ( verticesPtr [0] ), verticesPtr );
-	createBuffer ( indices,  VK_BUFFER_USAGE_INDEX_BUFFER_BIT,  3 * numTriangles * sizeof ( indicesPtr  [0] ), indicesPtr  );
 
-	for ( int i = 0; i < nv; i++ )
+	for ( size_t i = 0; i < nv; i++ )
 		box.addVertex ( verticesPtr [i].pos );
+
+		// identical mesh with the same options is already on GPU
+	uint64_t	salt = (uint64_t) flags.lods | (flags.meshlets ? 0x100 : 0) | (packed ? 0x200 : 0);
+
+	if ( cache != nullptr )
+		if ( auto * entry = cache->find ( verticesPtr, nv * sizeof ( BasicVertex ), indicesPtr, 3 * nt * sizeof ( uint32_t ), salt ) )
+			if ( (geometry = entry->lock ()) != nullptr )
+			{
+				lods        = geometry->lods;
+				numMeshlets = geometry->numMeshlets;
+				indexType   = geometry->indexType;
+
+				cache->addSaved ( geometry->getSize () );
+
+				return;
+			}
+
+	geometry = std::make_shared<MeshGeometry> ();
+
+		// reorder triangles for vertex cache and overdraw, vertices in order of first use,
+		// caller's array is left intact
+	vertexData.assign ( verticesPtr, verticesPtr + nv );
+	MeshOptimizer::optimize ( source, vertexData.data (), nv );
+		
+		// all levels go into the same index buffer and share vertices
+	if ( flags.lods > 1 )
+	{
+		MeshSimplifier ( vertexData.data (), nv, sizeof ( BasicVertex ) ).buildLods ( source, lodIndices, lods, flags.lods );
+
+		for ( size_t i = 1; i < lods.size (); i++ )
+		{
+			auto					first = lodIndices.begin () + lods [i].firstIndex;
+			std::vector<uint32_t>	level ( first, first + lods [i].indexCount );
+
+			MeshOptimizer::optimizeVertexCache ( level, nv );
+			std::copy ( level.begin (), level.end (), first );
+		}
+	}
+	else
+	{
+		lodIndices = source;
+		lods.push_back ( MeshLod { 0, 3 * numTriangles, 0.0f } );
+	}
+
+	uint32_t	vertexUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (flags.meshlets ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0);
+
+	if ( packed )
+	{
+		std::vector<PackedVertex>	packedData = packVertices ( vertexData.data (), nv );
+
+		createBuffer ( geometry->vertices, vertexUsage, numVertices * sizeof ( PackedVertex ), packedData.data () );
+	}
+	else
+		createBuffer ( geometry->vertices, vertexUsage, numVertices * sizeof ( BasicVertex ), vertexData.data () );
+
+	std::vector<PositionVertex>	positionData = extractPositions ( vertexData.data (), nv );
+
+	createBuffer ( geometry->positions, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, positionData.size () * sizeof ( PositionVertex ), positionData.data () );
+
+	if ( indexType == VK_INDEX_TYPE_UINT16 )
+	{
+		std::vector<uint16_t>	shortIndices = MeshOptimizer::to16Bit ( lodIndices );
+
+		if ( shortIndices.size () & 1 )				// vertex pulling reads indices as 32-bit words
+			shortIndices.push_back ( 0 );
+
+		createBuffer ( geometry->indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, shortIndices.size () * sizeof ( uint16_t ), shortIndices.data () );
+	}
+	else
+		createBuffer ( geometry->indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, lodIndices.size () * sizeof ( uint32_t ), lodIndices.data () );
+
+	if ( flags.meshlets )
+	{
+		MeshletBuilder	builder ( vertexData.data (), nv, sizeof ( BasicVertex ) );
+
+		numMeshlets = builder.build ( source ).meshletCount;
+
+		createBuffer ( geometry->meshletBuffer,    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, builder.getMeshlets  ().size () * sizeof ( Meshlet  ), builder.getMeshlets  ().data () );
+		createBuffer ( geometry->meshletVertices,  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, builder.getVertices  ().size () * sizeof ( uint32_t ), builder.getVertices  ().data () );
+		createBuffer ( geometry->meshletTriangles, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, builder.getTriangles ().size () * sizeof ( uint32_t ), builder.getTriangles ().data () );
+	}
+
+	geometry->lods        = lods;
+	geometry->numMeshlets = numMeshlets;
+	geometry->indexType   = indexType;
+
+	if ( cache != nullptr )
+		cache->add ( verticesPtr, nv * sizeof ( BasicVertex ), indicesPtr, 3 * nt * sizeof ( uint32_t ), geometry, salt );
 }
 
 			// create buffer and fill using staging buffer
@@ -128,7 +221,7 @@ void	computeTangents ( BasicVertex& v0, const BasicVertex& v1, const BasicVertex
 		v0.t = -v0.t;
 }
 
-Mesh * createSphere ( Device& dev, const glm::vec3& org, float r, int n1, int n2 )
+Mesh * createSphere ( Device& dev, const glm::vec3& org, float r, int n1, int n2, const MeshBuildFlags& flags )
 {
 	int							numVertices = (n1+1)*(n2+1);
 	int							numTris     = n1*n2*2;
@@ -176,7 +269,7 @@ Mesh * createSphere ( Device& dev, const glm::vec3& org, float r, int n1, int n2
 			faces [index++] = i*(n2+1) + j1;
 		}
 		
-	return new Mesh ( dev, vertices.data (), faces.data (), numVertices, numTris );
+	return new Mesh ( dev, vertices.data (), faces.data (), numVertices, numTris, flags );
 }
 
 Mesh * createQuad ( Device& dev, const glm::vec3& org, const glm::vec3& dir1, const glm::vec3& dir2 )
@@ -214,7 +307,7 @@ Mesh * createQuad ( Device& dev, const glm::vec3& org, const glm::vec3& dir1, co
 	return new Mesh ( dev, vertices, indices, 4, 2 );
 }
 
-Mesh * createBox ( Device& dev, const glm::vec3& pos, const glm::vec3& size, const glm::mat4 * mat, bool invertNormal )
+void	buildBox ( const glm::vec3& pos, const glm::vec3& size, const glm::mat4 * mat, bool invertNormal, std::vector<BasicVertex>& vs, std::vector<uint32_t>& is )
 {
     float   	x2 = pos.x + size.x;
     float   	y2 = pos.y + size.y;
@@ -401,10 +494,25 @@ Mesh * createBox ( Device& dev, const glm::vec3& pos, const glm::vec3& size, con
 		}
 	}
 	
-	return new Mesh ( dev, vertices, indices, numVertices, numTris );
+	uint32_t	base = (uint32_t) vs.size ();
+
+	vs.insert ( vs.end (), vertices, vertices + numVertices );
+
+	for ( int i = 0; i < 3 * numTris; i++ )
+		is.push_back ( base + indices [i] );
 }
 
-Mesh * createTorus ( Device& dev, float r1, float r2, int rings, int sides )
+Mesh * createBox ( Device& dev, const glm::vec3& pos, const glm::vec3& size, const glm::mat4 * mat, bool invertNormal )
+{
+	std::vector<BasicVertex>	vertices;
+	std::vector<uint32_t>		indices;
+
+	buildBox ( pos, size, mat, invertNormal, vertices, indices );
+
+	return new Mesh ( dev, vertices.data (), indices.data (), vertices.size (), indices.size () / 3 );
+}
+
+Mesh * createTorus ( Device& dev, float r1, float r2, int rings, int sides, const MeshBuildFlags& flags )
 {
 	const float ringDelta   = 2.0f * pi / rings;
 	const float sideDelta   = 2.0f * pi / sides;
@@ -472,7 +580,7 @@ Mesh * createTorus ( Device& dev, float r1, float r2, int rings, int sides )
 			faces [index++] = i*(sides+1) + j1;
 		}
 	
-	return  new Mesh ( dev, vertices.data (), faces.data (), numVertices, numTris );
+	return  new Mesh ( dev, vertices.data (), faces.data (), numVertices, numTris, flags );
 }
 
 static inline	glm::vec3 knot1D ( float t )
@@ -495,7 +603,7 @@ static inline	glm::vec3 knot ( float u, float v, glm::vec3& n, glm::vec3& t, glm
 	return r1 * knot1D ( u ) + r2 * n;
 }
 
-Mesh * createKnot ( Device& dev, float r1, float r2, int rings, int sides )
+Mesh * createKnot ( Device& dev, float r1, float r2, int rings, int sides, const MeshBuildFlags& flags )
 {
 	const float ringDelta   = 2.0f * pi / rings;
 	const float sideDelta   = 2.0f * pi / sides;
@@ -538,7 +646,7 @@ Mesh * createKnot ( Device& dev, float r1, float r2, int rings, int sides )
 			faces [index++] = i  * (sides+1) + j1;
 		}
 		
-	return new Mesh ( dev, vertices.data (), faces.data (), numVertices, numTris );
+	return new Mesh ( dev, vertices.data (), faces.data (), numVertices, numTris, flags );
 }
 
 Mesh * createHorQuad ( Device& dev, const glm::vec3& org, float s1, float s2 )
@@ -588,36 +696,36 @@ static void loadAiMesh ( const aiMesh * mesh, const glm::mat3& scale, const glm:
 	}
 }
 		
-static Mesh * loadMeshFromMesh ( Device& dev, const aiMesh * mesh, const glm::mat3& scale, const glm::vec3& offs )
+static Mesh * loadMeshFromMesh ( Device& dev, const aiMesh * mesh, const glm::mat3& scale, const glm::vec3& offs, const MeshBuildFlags& flags )
 {
 	std::vector<BasicVertex>	vertices;
 	std::vector<uint32_t>       indices;
 	
 	loadAiMesh ( mesh, scale, offs, vertices, indices );
 	
-	return new Mesh ( dev, vertices.data (), indices.data (), vertices.size (), indices.size () / 3 );
+	return new Mesh ( dev, vertices.data (), indices.data (), vertices.size (), indices.size () / 3, flags );
 }
 
-Mesh * loadMesh ( Device& dev, const char * fileName, float scale )
+Mesh * loadMesh ( Device& dev, const char * fileName, float scale, const MeshBuildFlags& flags )
 {
 	Assimp::Importer importer;
-	const int        flags = aiProcess_FlipWindingOrder | aiProcess_Triangulate | aiProcess_PreTransformVertices | aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals;
-	const aiScene  * scene = importer.ReadFile ( fileName, flags );
+	const int        importFlags = aiProcess_FlipWindingOrder | aiProcess_Triangulate | aiProcess_PreTransformVertices | aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals;
+	const aiScene  * scene       = importer.ReadFile ( fileName, importFlags );
 
 	if ( scene == nullptr )
 		return nullptr;
 		
-	return 	loadMeshFromMesh ( dev, scene -> mMeshes [0], glm::mat3 ( scale ), glm::vec3 ( 0 ) );
+	return 	loadMeshFromMesh ( dev, scene -> mMeshes [0], glm::mat3 ( scale ), glm::vec3 ( 0 ), flags );
 }
 
-Mesh * loadMesh ( Device& dev, const char * fileName, const glm::mat3& scale, const glm::vec3& offs )
+Mesh * loadMesh ( Device& dev, const char * fileName, const glm::mat3& scale, const glm::vec3& offs, const MeshBuildFlags& flags )
 {
 	Assimp::Importer importer;
-	const int        flags = aiProcess_FlipWindingOrder | aiProcess_Triangulate | aiProcess_PreTransformVertices | aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals;
-	const aiScene  * scene = importer.ReadFile ( fileName, flags );
+	const int        importFlags = aiProcess_FlipWindingOrder | aiProcess_Triangulate | aiProcess_PreTransformVertices | aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals;
+	const aiScene  * scene       = importer.ReadFile ( fileName, importFlags );
 
 	if ( scene == nullptr )
 		return nullptr;
 		
-	return 	loadMeshFromMesh ( dev, scene -> mMeshes [0], scale, offs );
+	return 	loadMeshFromMesh ( dev, scene -> mMeshes [0], scale, offs, flags );
 }
@@ -9,6 +9,7 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -24,6 +25,13 @@
 #include "Pipeline.h"
 #include "Device.h"
 #include "CommandBuffer.h"
+#include "RenderQueue.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "MeshOptimizer.h"
+#include "PackedVertex.h"
+#include "VertexPulling.h"
+#include "GeometryCache.h"
 #include "bbox.h"
 
 struct  BasicVertex
@@ -48,32 +56,215 @@ inline GraphicsPipeline&	registerVertexAttrs<BasicVertex> ( GraphicsPipeline& pi
 		.addVertexAttr ( 0, 4, VK_FORMAT_R32G32B32_SFLOAT, offsetof(BasicVertex, b) );
 }
 
+	// GPU data of mesh, meshes made of identical geometry share it (see Mesh::setGeometryCache)
+struct	MeshGeometry
+{
+	Buffer					vertices;			// vertex data
+	Buffer					indices;			// index buffer
+	Buffer					positions;			// position-only stream (PositionVertex) for depth passes
+	Buffer					meshletBuffer;		// optional meshlets of full resolution level
+	Buffer					meshletVertices;
+	Buffer					meshletTriangles;
+	std::vector<MeshLod>	lods;
+	uint32_t				numMeshlets = 0;
+	VkIndexType				indexType   = VK_INDEX_TYPE_UINT32;
+
+	size_t	getSize () const
+	{
+		return vertices.getSize () + indices.getSize () + positions.getSize () + meshletBuffer.getSize () + meshletVertices.getSize () + meshletTriangles.getSize ();
+	}
+};
+
+typedef	GeometryCache<std::weak_ptr<MeshGeometry>>	MeshCache;
+
+	// how mesh data is built, e.g. MeshBuildFlags ().setLods ( 4 ).setMeshlets ( true )
+struct	MeshBuildFlags
+{
+	int		lods     = 1;					// levels built by MeshSimplifier, 0 is full resolution
+	bool	meshlets = false;				// vertex buffer is also readable as storage buffer by mesh shaders
+	bool	packed   = false;				// vertex buffer holds PackedVertex (meshlet.mesh expects BasicVertex)
+
+	MeshBuildFlags&	setLods ( int count )
+	{
+		lods = count;
+
+		return *this;
+	}
+
+	MeshBuildFlags&	setMeshlets ( bool on = true )
+	{
+		meshlets = on;
+
+		return *this;
+	}
+
+	MeshBuildFlags&	setPacked ( bool on = true )
+	{
+		packed = on;
+
+		return *this;
+	}
+};
+
 class Mesh
 {
+	static MeshCache  * cache;			// optional deduplication of geometry
+
 	Device		  * device = nullptr;
-	Buffer			vertices;		// vertex data
-	Buffer			indices;		// index buffer
+	std::shared_ptr<MeshGeometry>	geometry;	// GPU buffers, may be shared with other meshes
 	int	         	numVertices;
 	int	         	numTriangles;
 	std::string  	name;
 	bbox		 	box;
 	int			 	material;
+	std::vector<MeshLod>	lods;		// ranges of index buffer, 0 is full resolution
+	uint32_t		numMeshlets = 0;
+	bool			packed      = false;	// vertex buffer holds PackedVertex
+	VkIndexType		indexType   = VK_INDEX_TYPE_UINT32;	// 16-bit when all vertices can be addressed
 	
 public:
-	Mesh ( Device& dev, BasicVertex * vertices, const uint32_t * indices, size_t nv, size_t nt );
+		// with flags.lods > 1 LOD chain is built by MeshSimplifier into the same index buffer.
+		// Triangles and vertices are reordered by MeshOptimizer, caller's arrays are not changed
+	Mesh ( Device& dev, BasicVertex * vertices, const uint32_t * indices, size_t nv, size_t nt, const MeshBuildFlags& flags = MeshBuildFlags () );
 	
-	CommandBuffer&	render ( CommandBuffer& commandBuffer, uint32_t instanceCount = 1 )
+		// meshes created while cache is set reuse GPU data of bit-identical meshes (same vertices,
+		// indices and options), nullptr disables. Cache must outlive its use, not the meshes
+	static void	setGeometryCache ( MeshCache * c )
 	{
-		return commandBuffer.bindVertexBuffers ( { { vertices, 0 } } ).bindIndexBuffer ( indices, VK_INDEX_TYPE_UINT32 ).drawIndexed ( numTriangles * 3, instanceCount );
+		cache = c;
+	}
+
+	static MeshCache *	getGeometryCache ()
+	{
+		return cache;
+	}
+
+	bool	isShared () const
+	{
+		return geometry.use_count () > 1;
+	}
+
+	CommandBuffer&	render ( CommandBuffer& commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0 )
+	{
+		return commandBuffer.bindVertexBuffers ( { { geometry->vertices, 0 } } ).bindIndexBuffer ( geometry->indices, indexType ).drawIndexed ( numTriangles * 3, instanceCount, 0, 0, firstInstance );
+	}
+
+		// depth-only draw binding only position stream, pipeline uses PositionVertex
+	CommandBuffer&	renderDepth ( CommandBuffer& commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0 )
+	{
+		return commandBuffer.bindVertexBuffers ( { { geometry->positions, 0 } } ).bindIndexBuffer ( geometry->indices, indexType ).drawIndexed ( numTriangles * 3, instanceCount, 0, 0, firstInstance );
+	}
+
+		// vertex pulling draw, pipeline has PullingData push constants at offset 0 (setupPullingPipeline)
+	CommandBuffer&	renderPulling ( CommandBuffer& commandBuffer, VkPipelineLayout layout, uint32_t instanceCount = 1, uint32_t firstInstance = 0, int lod = 0 )
+	{
+		return commandBuffer.pushConstants ( layout, VK_SHADER_STAGE_VERTEX_BIT, getPullingData () ).draw ( lods [lod].indexCount, instanceCount, lods [lod].firstIndex, firstInstance );
+	}
+
+	PullingData	getPullingData () const
+	{
+		uint32_t	flags = (packed ? pullPackedVertices : 0) | (indexType == VK_INDEX_TYPE_UINT16 ? pull16BitIndices : 0);
+
+		return PullingData { geometry->vertices.getDeviceAddress (), geometry->indices.getDeviceAddress (), flags, 0 };
+	}
+
+		// draw given level of detail
+	CommandBuffer&	renderLod ( CommandBuffer& commandBuffer, int lod, uint32_t instanceCount = 1, uint32_t firstInstance = 0 )
+	{
+		return commandBuffer.bindVertexBuffers ( { { geometry->vertices, 0 } } ).bindIndexBuffer ( geometry->indices, indexType ).drawIndexed ( lods [lod].indexCount, instanceCount, lods [lod].firstIndex, 0, firstInstance );
+	}
+
+		// geometry of given level of detail for RenderQueue::addMesh
+	RenderMesh	getRenderMesh ( int lod = 0 )
+	{
+		RenderMesh	mesh;
+
+		mesh.vertexBuffer = &geometry->vertices;
+		mesh.indexBuffer  = &geometry->indices;
+		mesh.indexType    = indexType;
+		mesh.firstIndex   = lods [lod].firstIndex;
+		mesh.indexCount   = lods [lod].indexCount;
+		mesh.center       = box.getCenter ();
+
+		return mesh;
+	}
+
+	const std::vector<MeshLod>&	getLods () const
+	{
+		return lods;
+	}
+
+	int	getLodCount () const
+	{
+		return (int) lods.size ();
+	}
+
+		// launch task shader for all meshlets, meshlet range goes to push constants
+	CommandBuffer&	renderMeshlets ( CommandBuffer& commandBuffer, VkPipelineLayout layout, uint32_t instanceCount = 1 )
+	{
+		MeshletRange	range = { 0, numMeshlets };
+
+		return commandBuffer.pushConstants ( layout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, range ).drawMeshTasks ( MeshletBuilder::taskCount ( numMeshlets ), instanceCount );
+	}
+
+	uint32_t	getMeshletCount () const
+	{
+		return numMeshlets;
+	}
+
+	Buffer&	getMeshletBuffer ()
+	{
+		return geometry->meshletBuffer;
+	}
+
+	Buffer&	getMeshletVertices ()
+	{
+		return geometry->meshletVertices;
+	}
+
+	Buffer&	getMeshletTriangles ()
+	{
+		return geometry->meshletTriangles;
+	}
+
+	Buffer&	getVertexBuffer ()
+	{
+		return geometry->vertices;
+	}
+
+	Buffer&	getPositionBuffer ()
+	{
+		return geometry->positions;
+	}
+
+	bool	isPacked () const
+	{
+		return packed;
+	}
+
+		// stride for addVertexBinding
+	uint32_t	getVertexSize () const
+	{
+		return packed ? sizeof ( PackedVertex ) : sizeof ( BasicVertex );
+	}
+
+	Buffer&	getIndexBuffer ()
+	{
+		return geometry->indices;
+	}
+
+	VkIndexType	getIndexType () const
+	{
+		return indexType;
 	}
 
 	void	render ( VkCommandBuffer commandBuffer )
 	{
-		VkBuffer		vertexBuffers [] = { vertices.getHandle () };
+		VkBuffer		vertexBuffers [] = { geometry->vertices.getHandle () };
 		VkDeviceSize	offsets       [] = { 0 };
 
 		vkCmdBindVertexBuffers ( commandBuffer, 0, 1, vertexBuffers, offsets );
-		vkCmdBindIndexBuffer   ( commandBuffer, indices.getHandle (), 0, VK_INDEX_TYPE_UINT32 );
+		vkCmdBindIndexBuffer   ( commandBuffer, geometry->indices.getHandle (), 0, indexType );
 		vkCmdDrawIndexed       ( commandBuffer, numTriangles*3, 1, 0, 0, 0 );
 	}
 
@@ -184,13 +375,16 @@ extern const float pi;
 void	computeTangents ( BasicVertex& v0, const BasicVertex& v1, const BasicVertex& v2 );
 void	computeNormals  ( BasicVertex * vertices, const uint32_t * indices, size_t nv, size_t nt );
 
-Mesh * createSphere  ( Device& dev, const glm::vec3& org, float radius, int n1, int n2 );
+Mesh * createSphere  ( Device& dev, const glm::vec3& org, float radius, int n1, int n2, const MeshBuildFlags& flags = MeshBuildFlags () );
 Mesh * createQuad    ( Device& dev, const glm::vec3& org, const glm::vec3& dir1, const glm::vec3& dir2 );
 Mesh * createHorQuad ( Device& dev, const glm::vec3& org, float s1, float s2 );
 Mesh * createBox     ( Device& dev, const glm::vec3& pos, const glm::vec3& size, const glm::mat4 * mat = nullptr, bool invertNormal = false );
-Mesh * createTorus   ( Device& dev, float r1, float r2, int n1, int n2 );
-Mesh * createKnot    ( Device& dev, float r1, float r2, int n1, int n2 );
-Mesh * loadMesh      ( Device& dev, const char * fileName, float scale = 1.0f );
-Mesh * loadMesh      ( Device& dev, const char * fileName, const glm::mat3& scale, const glm::vec3& offs );
+Mesh * createTorus   ( Device& dev, float r1, float r2, int n1, int n2, const MeshBuildFlags& flags = MeshBuildFlags () );
+Mesh * createKnot    ( Device& dev, float r1, float r2, int n1, int n2, const MeshBuildFlags& flags = MeshBuildFlags () );
+Mesh * loadMesh      ( Device& dev, const char * fileName, float scale = 1.0f, const MeshBuildFlags& flags = MeshBuildFlags () );
+Mesh * loadMesh      ( Device& dev, const char * fileName, const glm::mat3& scale, const glm::vec3& offs, const MeshBuildFlags& flags = MeshBuildFlags () );
+
+	// geometry of createBox appended to arrays (indices are absolute), e.g. for static batching
+void   buildBox      ( const glm::vec3& pos, const glm::vec3& size, const glm::mat4 * mat, bool invertNormal, std::vector<BasicVertex>& vertices, std::vector<uint32_t>& indices );
 
 #endif
@@ -0,0 +1,324 @@
+//
+// Mesh optimizer: Tipsify vertex cache ordering (Sander et al. 2007), overdraw ordering of
+// clusters by their facing, vertex fetch ordering and FIFO cache analysis
+//
+
+#include	<string.h>
+#include	<math.h>
+#include	<algorithm>
+#include	<numeric>
+#include	<glm/glm.hpp>
+#include	"MeshOptimizer.h"
+
+	// triangles around every vertex as offsets into single array
+static void	buildAdjacency ( const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& offsets, std::vector<uint32_t>& tris )
+{
+	offsets.assign ( vertexCount + 1, 0 );
+	tris.resize    ( indices.size () );
+
+	for ( uint32_t v : indices )
+		offsets [v + 1]++;
+
+	for ( size_t i = 0; i < vertexCount; i++ )
+		offsets [i + 1] += offsets [i];
+
+	std::vector<uint32_t>	fill ( offsets.begin (), offsets.end () - 1 );
+
+	for ( size_t i = 0; i < indices.size (); i++ )
+		tris [fill [indices [i]]++] = uint32_t ( i / 3 );
+}
+
+void	MeshOptimizer :: optimizeVertexCache ( std::vector<uint32_t>& indices, size_t vertexCount, int cache )
+{
+	size_t					numTris = indices.size () / 3;
+	std::vector<uint32_t>	offsets, adjTris;
+	std::vector<uint32_t>	live      ( vertexCount );		// not yet emitted triangles using vertex
+	std::vector<uint32_t>	cacheTime ( vertexCount, 0 );
+	std::vector<uint8_t>	emitted   ( numTris, 0 );
+	std::vector<uint32_t>	deadEnd;
+	std::vector<uint32_t>	candidates;
+	std::vector<uint32_t>	result;
+	uint32_t				timeStamp = cache + 1;
+	size_t					cursor    = 0;
+
+	if ( numTris == 0 )
+		return;
+
+	buildAdjacency ( indices, vertexCount, offsets, adjTris );
+
+	for ( size_t v = 0; v < vertexCount; v++ )
+		live [v] = offsets [v + 1] - offsets [v];
+
+	result.reserve ( indices.size () );
+
+	int64_t	f = indices [0];
+
+	while ( f >= 0 )
+	{
+		candidates.clear ();
+
+			// emit all triangles of fanning vertex
+		for ( uint32_t i = offsets [f]; i < offsets [f + 1]; i++ )
+		{
+			uint32_t	t = adjTris [i];
+
+			if ( emitted [t] )
+				continue;
+
+			for ( int k = 0; k < 3; k++ )
+			{
+				uint32_t	v = indices [3*t + k];
+
+				result.push_back     ( v );
+				deadEnd.push_back    ( v );
+				candidates.push_back ( v );
+
+				live [v]--;
+
+				if ( timeStamp - cacheTime [v] > (uint32_t) cache )
+					cacheTime [v] = timeStamp++;
+			}
+
+			emitted [t] = 1;
+		}
+
+			// next fanning vertex: oldest candidate still in cache after its remaining triangles
+		int64_t	best     = -1;
+		int64_t	priority = -1;
+
+		for ( uint32_t v : candidates )
+			if ( live [v] > 0 )
+			{
+				int64_t	p = 0;
+
+				if ( timeStamp - cacheTime [v] + 2 * live [v] <= (uint32_t) cache )
+					p = timeStamp - cacheTime [v];
+
+				if ( p > priority )
+				{
+					priority = p;
+					best     = v;
+				}
+			}
+
+		if ( best < 0 )			// dead end: recently used vertex with triangles left or any such vertex
+		{
+			while ( !deadEnd.empty () && best < 0 )
+			{
+				uint32_t	v = deadEnd.back ();
+
+				deadEnd.pop_back ();
+
+				if ( live [v] > 0 )
+					best = v;
+			}
+
+			while ( best < 0 && cursor < vertexCount )
+			{
+				if ( live [cursor] > 0 )
+					best = cursor;
+
+				cursor++;
+			}
+		}
+
+		f = best;
+	}
+
+	indices.swap ( result );
+}
+
+void	MeshOptimizer :: optimizeOverdraw ( std::vector<uint32_t>& indices, const void * vertices, size_t vertexCount, size_t stride, float threshold, int cache )
+{
+	size_t					numTris = indices.size () / 3;
+	std::vector<uint32_t>	cacheTime ( vertexCount, 0 );
+	std::vector<uint32_t>	missCount ( numTris );
+	std::vector<size_t>		clusters;					// start triangles
+	uint32_t				timeStamp = cache + 1;
+
+	if ( numTris < 2 )
+		return;
+
+	auto	position = [&] ( uint32_t v )
+	{
+		glm::vec3	p;
+
+		memcpy ( &p, (const char *) vertices + v * stride, sizeof ( p ) );
+
+		return p;
+	};
+
+		// hard boundaries: triangles with all vertices missing the cache start new cluster
+	for ( size_t t = 0; t < numTris; t++ )
+	{
+		uint32_t	misses = 0;
+
+		for ( int k = 0; k < 3; k++ )
+		{
+			uint32_t	v = indices [3*t + k];
+
+			if ( timeStamp - cacheTime [v] > (uint32_t) cache )
+			{
+				cacheTime [v] = timeStamp++;
+				misses++;
+			}
+		}
+
+		missCount [t] = misses;
+
+		if ( t == 0 || misses == 3 )
+			clusters.push_back ( t );
+	}
+
+	clusters.push_back ( numTris );
+
+		// soft boundaries: split cluster when ACMR of its part, simulated from empty cache since
+		// the part may be drawn after any other cluster, is within threshold of whole cluster ACMR
+	std::vector<size_t>	soft;
+
+	for ( size_t c = 0; c + 1 < clusters.size (); c++ )
+	{
+		size_t		start  = clusters [c];
+		size_t		end    = clusters [c + 1];
+		uint32_t	total  = 0;
+
+		for ( size_t t = start; t < end; t++ )
+			total += missCount [t];
+
+		float		limit  = threshold * total / float ( end - start );
+		uint32_t	misses = 0;
+		size_t		first  = start;
+
+		soft.push_back ( start );
+		timeStamp += cache + 1;				// flush cache
+
+		for ( size_t t = start; t < end; t++ )
+		{
+			for ( int k = 0; k < 3; k++ )
+			{
+				uint32_t	v = indices [3*t + k];
+
+				if ( timeStamp - cacheTime [v] > (uint32_t) cache )
+				{
+					cacheTime [v] = timeStamp++;
+					misses++;
+				}
+			}
+
+			if ( t + 1 < end && misses <= limit * (t + 1 - first) )
+			{
+				soft.push_back ( t + 1 );
+
+				first      = t + 1;
+				misses     = 0;
+				timeStamp += cache + 1;
+			}
+		}
+	}
+
+	soft.push_back ( numTris );
+
+		// sort clusters by facing relative to mesh centroid, outer ones are drawn first
+	glm::vec3			center ( 0 );
+	std::vector<float>	sortKey ( soft.size () - 1 );
+
+	for ( uint32_t v : indices )
+		center += position ( v );
+
+	center = center * (1.0f / indices.size ());
+
+	for ( size_t c = 0; c + 1 < soft.size (); c++ )
+	{
+		glm::vec3	cc ( 0 );
+		glm::vec3	cn ( 0 );
+		float		area = 0;
+
+		for ( size_t t = soft [c]; t < soft [c + 1]; t++ )
+		{
+			glm::vec3	p0 = position ( indices [3*t] );
+			glm::vec3	p1 = position ( indices [3*t + 1] );
+			glm::vec3	p2 = position ( indices [3*t + 2] );
+			glm::vec3	n  = glm::cross ( p1 - p0, p2 - p0 );
+			float		a  = glm::length ( n );
+
+			cc   += (a / 3.0f) * (p0 + p1 + p2);
+			cn   += n;
+			area += a;
+		}
+
+		if ( area > 0 )
+			cc = cc * (1.0f / area);
+
+		float	len = glm::length ( cn );
+
+		sortKey [c] = len > 0 ? glm::dot ( cc - center, cn * (1.0f / len) ) : 0;
+	}
+
+	std::vector<uint32_t>	order ( sortKey.size () );
+
+	std::iota        ( order.begin (), order.end (), 0 );
+	std::stable_sort ( order.begin (), order.end (), [&] ( uint32_t a, uint32_t b ) { return sortKey [a] > sortKey [b]; } );
+
+	std::vector<uint32_t>	result;
+
+	result.reserve ( indices.size () );
+
+	for ( uint32_t c : order )
+		result.insert ( result.end (), indices.begin () + 3 * soft [c], indices.begin () + 3 * soft [c + 1] );
+
+	indices.swap ( result );
+}
+
+std::vector<uint32_t>	MeshOptimizer :: optimizeVertexFetch ( std::vector<uint32_t>& indices, size_t vertexCount )
+{
+	std::vector<uint32_t>	remap ( vertexCount, UINT32_MAX );
+	uint32_t				next = 0;
+
+	for ( auto& v : indices )
+	{
+		if ( remap [v] == UINT32_MAX )
+			remap [v] = next++;
+
+		v = remap [v];
+	}
+
+		// unreferenced vertices go to the end
+	for ( auto& r : remap )
+		if ( r == UINT32_MAX )
+			r = next++;
+
+	return remap;
+}
+
+VertexCacheStats	MeshOptimizer :: analyzeVertexCache ( const std::vector<uint32_t>& indices, size_t vertexCount, int cache )
+{
+	VertexCacheStats		stats;
+	std::vector<uint32_t>	cacheTime ( vertexCount, 0 );
+	std::vector<uint8_t>	used      ( vertexCount, 0 );
+	uint32_t				timeStamp = cache + 1;
+	size_t					misses    = 0;
+	size_t					unique    = 0;
+
+	for ( uint32_t v : indices )
+	{
+		if ( timeStamp - cacheTime [v] > (uint32_t) cache )
+		{
+			cacheTime [v] = timeStamp++;
+			misses++;
+		}
+
+		if ( !used [v] )
+		{
+			used [v] = 1;
+			unique++;
+		}
+	}
+
+	if ( !indices.empty () )
+	{
+		stats.acmr = float ( misses ) / (indices.size () / 3);
+		stats.atvr = float ( misses ) / unique;
+	}
+
+	return stats;
+}
@@ -0,0 +1,71 @@
+//
+// Index and vertex buffer optimization at load time: vertex cache reordering (Tipsify),
+// overdraw reordering of triangle clusters (outward-facing clusters first), vertex fetch
+// reordering by first use and conversion to 16-bit indices. Vertex order changes are
+// returned as permutation, so unreferenced vertices are kept at the end
+//
+
+#pragma once
+
+#include	<stdint.h>
+#include	<stddef.h>
+#include	<vector>
+
+	// ACMR - cache misses per triangle, ATVR - cache misses per referenced vertex (1 is optimal)
+struct	VertexCacheStats
+{
+	float	acmr = 0;
+	float	atvr = 0;
+};
+
+class	MeshOptimizer
+{
+public:
+	enum
+	{
+		cacheSize = 16					// FIFO size assumed by reordering
+	};
+
+		// reorder triangles for post-transform vertex cache
+	static void	optimizeVertexCache ( std::vector<uint32_t>& indices, size_t vertexCount, int cache = cacheSize );
+
+		// reorder clusters of cache-optimized triangles to reduce overdraw, threshold limits ACMR
+		// growth from splitting clusters. Positions are read from vertex array with given stride
+	static void	optimizeOverdraw ( std::vector<uint32_t>& indices, const void * vertices, size_t vertexCount, size_t stride, float threshold = 1.05f, int cache = cacheSize );
+
+		// renumber vertices in order of first use, indices are rewritten and remap [old] = new is
+		// returned (permutation of vertexCount elements)
+	static std::vector<uint32_t>	optimizeVertexFetch ( std::vector<uint32_t>& indices, size_t vertexCount );
+
+		// apply permutation from optimizeVertexFetch to vertex array
+	template <typename Vertex>
+	static void	remapVertices ( Vertex * vertices, const std::vector<uint32_t>& remap )
+	{
+		std::vector<Vertex>	copy ( vertices, vertices + remap.size () );
+
+		for ( size_t i = 0; i < remap.size (); i++ )
+			vertices [remap [i]] = copy [i];
+	}
+
+		// all three stages, vertices are reordered in place
+	template <typename Vertex>
+	static void	optimize ( std::vector<uint32_t>& indices, Vertex * vertices, size_t vertexCount )
+	{
+		optimizeVertexCache ( indices, vertexCount );
+		optimizeOverdraw    ( indices, vertices, vertexCount, sizeof ( Vertex ) );
+		remapVertices       ( vertices, optimizeVertexFetch ( indices, vertexCount ) );
+	}
+
+		// simulate FIFO cache of given size
+	static VertexCacheStats	analyzeVertexCache ( const std::vector<uint32_t>& indices, size_t vertexCount, int cache = 32 );
+
+	static bool	fits16Bit ( size_t vertexCount )
+	{
+		return vertexCount <= 0x10000;
+	}
+
+	static std::vector<uint16_t>	to16Bit ( const std::vector<uint32_t>& indices )
+	{
+		return std::vector<uint16_t> ( indices.begin (), indices.end () );
+	}
+};
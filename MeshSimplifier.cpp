@@ -0,0 +1,400 @@
+//
+// Quadric error mesh simplifier: greedy passes of independent edge collapses ordered by error
+//
+
+#include	<string.h>
+#include	<math.h>
+#include	<algorithm>
+#include	<numeric>
+#include	"MeshSimplifier.h"
+
+MeshSimplifier :: MeshSimplifier ( const void * vertices, size_t vertexCount, size_t stride )
+{
+	std::vector<uint32_t>	order ( vertexCount );
+
+	positions.resize ( vertexCount );
+	remap.resize     ( vertexCount );
+	seam.assign      ( vertexCount, 0 );
+
+	for ( size_t i = 0; i < vertexCount; i++ )
+		memcpy ( &positions [i], (const char *) vertices + i * stride, sizeof ( glm::vec3 ) );
+
+		// vertices with equal positions become adjacent after sort
+	std::iota ( order.begin (), order.end (), 0 );
+	std::sort ( order.begin (), order.end (), [this] ( uint32_t a, uint32_t b )
+	{
+		const glm::vec3&	p = positions [a];
+		const glm::vec3&	q = positions [b];
+
+		return p.x < q.x || (p.x == q.x && (p.y < q.y || (p.y == q.y && (p.z < q.z || (p.z == q.z && a < b)))));
+	} );
+
+	for ( size_t i = 0; i < vertexCount; )
+	{
+		size_t	j = i + 1;
+
+		while ( j < vertexCount && positions [order [j]] == positions [order [i]] )
+			j++;
+
+		for ( size_t k = i; k < j; k++ )
+		{
+			remap [order [k]] = order [i];
+			seam  [order [k]] = j - i > 1 ? 1 : 0;
+		}
+
+		i = j;
+	}
+}
+
+	// vertices on seams and on border or non-manifold edges can't be moved
+void	MeshSimplifier :: lockVertices ( const std::vector<uint32_t>& indices, std::vector<uint8_t>& locked ) const
+{
+	std::vector<uint64_t>	edges;
+	std::vector<uint8_t>	lockedRoot ( positions.size (), 0 );
+
+	edges.reserve ( indices.size () );
+
+	for ( size_t i = 0; i < indices.size (); i += 3 )
+		for ( int k = 0; k < 3; k++ )
+		{
+			uint64_t	a = remap [indices [i + k]];
+			uint64_t	b = remap [indices [i + (k + 1) % 3]];
+
+			edges.push_back ( a < b ? (a << 32) | b : (b << 32) | a );
+		}
+
+	std::sort ( edges.begin (), edges.end () );
+
+	for ( size_t i = 0; i < edges.size (); )
+	{
+		size_t	j = i + 1;
+
+		while ( j < edges.size () && edges [j] == edges [i] )
+			j++;
+
+		if ( j - i != 2 )			// border or non-manifold
+		{
+			lockedRoot [edges [i] >> 32]        = 1;
+			lockedRoot [edges [i] & 0xFFFFFFFF] = 1;
+		}
+
+		i = j;
+	}
+
+	locked.resize ( positions.size () );
+
+	for ( size_t i = 0; i < positions.size (); i++ )
+		locked [i] = seam [i] | lockedRoot [remap [i]];
+}
+
+void	MeshSimplifier :: addPlane ( Quadric& q, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2 ) const
+{
+	glm::vec3	n    = glm::cross ( p1 - p0, p2 - p0 );
+	float		len  = glm::length ( n );
+
+	if ( len <= 0 )
+		return;
+
+	double	w = 0.5 * len;				// area of triangle
+	double	a = n.x / len;
+	double	b = n.y / len;
+	double	c = n.z / len;
+	double	d = -(a * p0.x + b * p0.y + c * p0.z);
+
+	q.a00 += w * a * a; q.a01 += w * a * b; q.a02 += w * a * c; q.a03 += w * a * d;
+	q.a11 += w * b * b; q.a12 += w * b * c; q.a13 += w * b * d;
+	q.a22 += w * c * c; q.a23 += w * c * d;
+	q.a33 += w * d * d;
+	q.weight += w;
+}
+
+	// mean squared distance from p to planes of both quadrics
+double	MeshSimplifier :: evaluate ( const Quadric& q1, const Quadric& q2, const glm::vec3& p ) const
+{
+	double	x = p.x, y = p.y, z = p.z;
+	double	s = 0;
+
+	for ( const Quadric * q : { &q1, &q2 } )
+		s += q->a00 * x * x + q->a11 * y * y + q->a22 * z * z + q->a33 +
+			 2 * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z + q->a03 * x + q->a13 * y + q->a23 * z);
+
+	double	w = q1.weight + q2.weight;
+
+	return w > 0 ? std::max ( s, 0.0 ) / w : 0.0;
+}
+
+	// whether moving vertex from to position of vertex to turns over some of its triangles
+bool	MeshSimplifier :: flips ( const std::vector<uint32_t>& indices, const uint32_t * tris, size_t numTris, uint32_t from, uint32_t to ) const
+{
+	for ( size_t i = 0; i < numTris; i++ )
+	{
+		const uint32_t	* t = &indices [3 * tris [i]];
+
+		if ( t [0] == to || t [1] == to || t [2] == to )		// collapsed triangle
+			continue;
+
+		glm::vec3	p [3], q [3];
+
+		for ( int k = 0; k < 3; k++ )
+		{
+			p [k] = positions [t [k]];
+			q [k] = t [k] == from ? positions [to] : p [k];
+		}
+
+		glm::vec3	n0 = glm::cross ( p [1] - p [0], p [2] - p [0] );
+		glm::vec3	n1 = glm::cross ( q [1] - q [0], q [2] - q [0] );
+
+		if ( glm::dot ( n0, n1 ) <= 0 )
+			return true;
+	}
+
+	return false;
+}
+
+std::vector<uint32_t>	MeshSimplifier :: simplify ( const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, float * resultError ) const
+{
+	std::vector<std::vector<uint32_t>>	results;
+	std::vector<float>					errors;
+
+	run ( indices, { targetIndexCount }, maxError, results, errors );
+
+	if ( resultError != nullptr )
+		*resultError = errors [0];
+
+	return results [0];
+}
+
+	// simplification goes through decreasing targets, result and its error are saved at every target
+void	MeshSimplifier :: run ( const std::vector<uint32_t>& indices, const std::vector<size_t>& targets, float maxError,
+								std::vector<std::vector<uint32_t>>& results, std::vector<float>& errors ) const
+{
+	struct	Collapse
+	{
+		uint32_t	from, to;
+		double		cost;
+	};
+
+	size_t					n       = positions.size ();
+	double					maxCost = 0;
+	bool					stuck   = false;
+	double					limit   = double ( maxError ) * double ( maxError );
+	std::vector<uint32_t>	result  ( indices );
+	std::vector<uint8_t>	locked;
+	std::vector<Quadric>	quadrics ( n, Quadric {} );
+	std::vector<uint32_t>	collapseTo ( n );
+	std::vector<uint32_t>	offsets ( n + 1 );
+	std::vector<uint32_t>	adjacency;
+	std::vector<uint8_t>	touched;
+	std::vector<uint64_t>	edges;
+	std::vector<Collapse>	collapses;
+
+	lockVertices ( indices, locked );
+	std::iota    ( collapseTo.begin (), collapseTo.end (), 0 );
+
+		// planes of triangles are shared by all vertices with the same position
+	for ( size_t i = 0; i < indices.size (); i += 3 )
+	{
+		Quadric	q = {};
+
+		addPlane ( q, positions [indices [i]], positions [indices [i + 1]], positions [indices [i + 2]] );
+
+		for ( int k = 0; k < 3; k++ )
+		{
+			Quadric&	v = quadrics [remap [indices [i + k]]];
+
+			v.a00 += q.a00; v.a01 += q.a01; v.a02 += q.a02; v.a03 += q.a03;
+			v.a11 += q.a11; v.a12 += q.a12; v.a13 += q.a13;
+			v.a22 += q.a22; v.a23 += q.a23;
+			v.a33 += q.a33;
+			v.weight += q.weight;
+		}
+	}
+
+	for ( size_t next = 0; next < targets.size (); )
+	{
+		size_t	targetIndexCount = targets [next];
+		size_t	numTris          = result.size () / 3;
+
+		if ( result.size () <= targetIndexCount || stuck )
+		{
+			results.push_back ( result );
+			errors.push_back  ( float ( sqrt ( maxCost ) ) );
+			next++;
+			continue;
+		}
+
+			// triangles of every vertex
+		std::fill ( offsets.begin (), offsets.end (), 0 );
+
+		for ( auto v : result )
+			offsets [v + 1]++;
+
+		for ( size_t i = 0; i < n; i++ )
+			offsets [i + 1] += offsets [i];
+
+		adjacency.resize ( result.size () );
+
+		{
+			std::vector<uint32_t>	fill ( offsets.begin (), offsets.end () - 1 );
+
+			for ( size_t i = 0; i < result.size (); i++ )
+				adjacency [fill [result [i]]++] = uint32_t ( i / 3 );
+		}
+
+			// unique edges and the cheapest allowed direction of collapse for each
+		edges.clear     ();
+		collapses.clear ();
+
+		for ( size_t i = 0; i < result.size (); i += 3 )
+			for ( int k = 0; k < 3; k++ )
+			{
+				uint64_t	a = result [i + k];
+				uint64_t	b = result [i + (k + 1) % 3];
+
+				edges.push_back ( a < b ? (a << 32) | b : (b << 32) | a );
+			}
+
+		std::sort ( edges.begin (), edges.end () );
+		edges.erase ( std::unique ( edges.begin (), edges.end () ), edges.end () );
+
+		for ( auto e : edges )
+		{
+			uint32_t	a    = uint32_t ( e >> 32 );
+			uint32_t	b    = uint32_t ( e & 0xFFFFFFFF );
+			Collapse	best = { 0, 0, -1 };
+
+				// moved vertex must be free, target can't be on seam or attributes of other side would be taken
+			if ( !locked [a] && !seam [b] )
+				best = { a, b, evaluate ( quadrics [a], quadrics [remap [b]], positions [b] ) };
+
+			if ( !locked [b] && !seam [a] )
+			{
+				double	cost = evaluate ( quadrics [b], quadrics [remap [a]], positions [a] );
+
+				if ( best.cost < 0 || cost < best.cost )
+					best = { b, a, cost };
+			}
+
+			if ( best.cost >= 0 && best.cost <= limit )
+				collapses.push_back ( best );
+		}
+
+		std::sort ( collapses.begin (), collapses.end (), [] ( const Collapse& c1, const Collapse& c2 ) { return c1.cost < c2.cost; } );
+
+			// apply independent collapses: triangles around moved vertex are not changed twice in pass
+		size_t	budget  = numTris - targetIndexCount / 3;
+		size_t	removed = 0;
+		size_t	applied = 0;
+
+		touched.assign ( n, 0 );
+
+		for ( auto& c : collapses )
+		{
+			if ( removed >= budget )
+				break;
+
+			if ( touched [c.from] || touched [c.to] )
+				continue;
+
+			const uint32_t	* tris  = &adjacency [offsets [c.from]];
+			size_t			  count = offsets [c.from + 1] - offsets [c.from];
+
+			if ( flips ( result, tris, count, c.from, c.to ) )
+				continue;
+
+			for ( size_t i = 0; i < count; i++ )
+			{
+				const uint32_t	* t = &result [3 * tris [i]];
+
+				if ( t [0] == c.to || t [1] == c.to || t [2] == c.to )
+					removed++;
+
+				touched [t [0]] = touched [t [1]] = touched [t [2]] = 1;
+			}
+
+			Quadric&		q = quadrics [remap [c.to]];
+			const Quadric&	f = quadrics [c.from];
+
+			q.a00 += f.a00; q.a01 += f.a01; q.a02 += f.a02; q.a03 += f.a03;
+			q.a11 += f.a11; q.a12 += f.a12; q.a13 += f.a13;
+			q.a22 += f.a22; q.a23 += f.a23;
+			q.a33 += f.a33;
+			q.weight += f.weight;
+
+			collapseTo [c.from] = c.to;
+			maxCost             = std::max ( maxCost, c.cost );
+			applied++;
+		}
+
+		if ( applied == 0 )			// nothing can be collapsed within error limit
+		{
+			stuck = true;
+			continue;
+		}
+
+			// remap indices and remove degenerate triangles
+		size_t	count = 0;
+
+		for ( size_t i = 0; i < result.size (); i += 3 )
+		{
+			uint32_t	a = collapseTo [result [i]];
+			uint32_t	b = collapseTo [result [i + 1]];
+			uint32_t	c = collapseTo [result [i + 2]];
+
+			if ( a == b || b == c || a == c )
+				continue;
+
+			result [count++] = a;
+			result [count++] = b;
+			result [count++] = c;
+		}
+
+		result.resize ( count );
+	}
+}
+
+int	MeshSimplifier :: buildLods ( const std::vector<uint32_t>& indices, std::vector<uint32_t>& lodIndices, std::vector<MeshLod>& lods,
+								  int maxLods, float ratio, float maxError, uint32_t baseVertex ) const
+{
+	std::vector<size_t>					targets;
+	std::vector<std::vector<uint32_t>>	results;
+	std::vector<float>					errors;
+	size_t								count = indices.size () / 3;
+
+		// all levels are made in single run, so errors are measured against the source
+	for ( int level = 1; level < maxLods && (count = size_t ( float ( count ) * ratio )) > 0; level++ )
+		targets.push_back ( 3 * count );
+
+	run ( indices, targets, maxError, results, errors );
+
+	results.insert ( results.begin (), indices );
+	errors.insert  ( errors.begin (), 0.0f );
+	lods.clear     ();
+
+	for ( size_t i = 0; i < results.size (); i++ )
+	{
+		MeshLod	lod;
+
+			// stop when less than half of requested reduction is reached, previous level
+			// may already be below this target when simplifier overshoots
+		if ( i > 0 )
+		{
+			size_t	prev = results [i - 1].size ();
+			size_t	want = prev > targets [i - 1] ? (prev - targets [i - 1]) / 2 : 0;
+
+			if ( results [i].size () >= prev || results [i].size () + want > prev )
+				break;
+		}
+
+		lod.firstIndex = (uint32_t) lodIndices.size ();
+		lod.indexCount = (uint32_t) results [i].size ();
+		lod.error      = errors [i];
+
+		for ( auto index : results [i] )
+			lodIndices.push_back ( index + baseVertex );
+
+		lods.push_back ( lod );
+	}
+
+	return (int) lods.size ();
+}
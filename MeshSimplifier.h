@@ -0,0 +1,61 @@
+//
+// Quadric error mesh simplifier. Edges are collapsed into one of their vertices, so simplified
+// index lists refer to the original vertex buffer and levels of detail differ only by ranges
+// of the index buffer. Vertices on borders and attribute seams (several vertices sharing
+// the same position) are never moved, so texture coordinates and normals stay intact
+//
+
+#pragma once
+
+#include	<stdint.h>
+#include	<stddef.h>
+#include	<float.h>
+#include	<vector>
+#include	<glm/glm.hpp>
+
+	// level of detail: range of index buffer and its simplification error in object space units
+struct	MeshLod
+{
+	uint32_t	firstIndex = 0;
+	uint32_t	indexCount = 0;
+	float		error      = 0;
+};
+
+class	MeshSimplifier
+{
+	struct	Quadric					// sum of area-weighted squared distances to planes
+	{
+		double	a00, a01, a02, a03;
+		double	a11, a12, a13;
+		double	a22, a23;
+		double	a33;
+		double	weight;
+	};
+
+	std::vector<glm::vec3>	positions;
+	std::vector<uint32_t>	remap;			// first vertex with the same position
+	std::vector<uint8_t>	seam;			// other vertices have the same position
+
+public:
+		// positions are read from vertex array with given stride in bytes
+	MeshSimplifier ( const void * vertices, size_t vertexCount, size_t stride );
+
+		// collapse edges until index count is not above targetIndexCount or error would exceed maxError,
+		// returns simplified index list, resultError gets error of the result
+	std::vector<uint32_t>	simplify ( const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError = FLT_MAX, float * resultError = nullptr ) const;
+
+		// append LOD chain to lodIndices: level 0 is the source itself, every next level has about
+		// ratio of triangles of the previous one. Chain stops at maxLods levels, when error exceeds
+		// maxError or when simplification does not give enough reduction. baseVertex is added to all
+		// appended indices, returns number of levels
+	int		buildLods ( const std::vector<uint32_t>& indices, std::vector<uint32_t>& lodIndices, std::vector<MeshLod>& lods,
+						int maxLods, float ratio = 0.5f, float maxError = FLT_MAX, uint32_t baseVertex = 0 ) const;
+
+private:
+	void	lockVertices     ( const std::vector<uint32_t>& indices, std::vector<uint8_t>& locked ) const;
+	void	addPlane         ( Quadric& q, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2 ) const;
+	double	evaluate         ( const Quadric& q1, const Quadric& q2, const glm::vec3& p ) const;
+	bool	flips            ( const std::vector<uint32_t>& indices, const uint32_t * tris, size_t numTris, uint32_t from, uint32_t to ) const;
+	void	run              ( const std::vector<uint32_t>& indices, const std::vector<size_t>& targets, float maxError,
+							   std::vector<std::vector<uint32_t>>& results, std::vector<float>& errors ) const;
+};
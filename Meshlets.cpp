@@ -0,0 +1,193 @@
+//
+// Meshlet builder: meshlet grows by adjacent triangles adding fewest new vertices
+//
+
+#include	<string.h>
+#include	<math.h>
+#include	<algorithm>
+#include	"Meshlets.h"
+
+MeshletBuilder :: MeshletBuilder ( const void * vertexData, size_t vertexCount, size_t stride )
+{
+	positions.resize ( vertexCount );
+
+	for ( size_t i = 0; i < vertexCount; i++ )
+		memcpy ( &positions [i], (const char *) vertexData + i * stride, sizeof ( glm::vec3 ) );
+}
+
+MeshletRange	MeshletBuilder :: build ( const std::vector<uint32_t>& indices, uint32_t baseVertex )
+{
+	size_t					numTris = indices.size () / 3;
+	std::vector<uint32_t>	adjOffset ( positions.size () + 1, 0 );
+	std::vector<uint32_t>	adjTris   ( indices.size () );
+	std::vector<uint8_t>	emitted   ( numTris, 0 );
+	std::vector<uint32_t>	owner     ( positions.size (), UINT32_MAX );	// meshlet the vertex was added to
+	std::vector<uint32_t>	slot      ( positions.size (), 0 );				// local index in that meshlet
+	std::vector<uint32_t>	local;											// vertices of current meshlet
+	std::vector<uint32_t>	tris;											// triangles of current meshlet
+	MeshletRange			range     = { (uint32_t) meshlets.size (), 0 };
+	size_t					cursor    = 0;
+	double					volume    = 0;
+
+		// triangles around every vertex
+	for ( uint32_t v : indices )
+		adjOffset [v + 1]++;
+
+	for ( size_t i = 0; i < positions.size (); i++ )
+		adjOffset [i + 1] += adjOffset [i];
+
+	std::vector<uint32_t>	fill ( adjOffset.begin (), adjOffset.end () - 1 );
+
+	for ( size_t t = 0; t < numTris; t++ )
+		for ( int k = 0; k < 3; k++ )
+			adjTris [fill [indices [3*t + k]]++] = (uint32_t) t;
+
+		// sign of mesh volume tells whether winding is counter-clockwise for outer side
+	for ( size_t t = 0; t < numTris; t++ )
+	{
+		const glm::vec3&	p0 = positions [indices [3*t]];
+		const glm::vec3&	p1 = positions [indices [3*t + 1]];
+		const glm::vec3&	p2 = positions [indices [3*t + 2]];
+
+		volume += glm::dot ( p0, glm::cross ( p1, p2 ) );
+	}
+
+		// number of vertices of triangle not yet in current meshlet
+	auto	newVertices = [&] ( size_t t, uint32_t id )
+	{
+		int	count = 0;
+
+		for ( int k = 0; k < 3; k++ )
+			if ( owner [indices [3*t + k]] != id )
+				count++;
+
+		return count;
+	};
+
+	for ( ; ; )
+	{
+		while ( cursor < numTris && emitted [cursor] )
+			cursor++;
+
+		if ( cursor >= numTris )
+			break;
+
+		uint32_t	id   = (uint32_t) meshlets.size ();
+		size_t		next = cursor;
+
+		local.clear ();
+		tris.clear  ();
+
+		while ( next != SIZE_MAX )
+		{
+			emitted [next] = 1;
+			tris.push_back ( (uint32_t) next );
+
+			for ( int k = 0; k < 3; k++ )
+			{
+				uint32_t	v = indices [3*next + k];
+
+				if ( owner [v] != id )
+				{
+					owner [v] = id;
+					slot  [v] = (uint32_t) local.size ();
+					local.push_back ( v );
+				}
+			}
+
+			if ( tris.size () >= maxTriangles )
+				break;
+
+				// best adjacent triangle that still fits
+			int	best = 3;
+
+			next = SIZE_MAX;
+
+			for ( uint32_t v : local )
+				for ( uint32_t i = adjOffset [v]; i < adjOffset [v + 1] && best > 0; i++ )
+				{
+					uint32_t	t = adjTris [i];
+
+					if ( emitted [t] )
+						continue;
+
+					int	count = newVertices ( t, id );
+
+					if ( count < best && local.size () + count <= maxVertices )
+					{
+						best = count;
+						next = t;
+					}
+				}
+		}
+
+		Meshlet	m;
+
+		m.vertexOffset   = (uint32_t) vertices.size  ();
+		m.vertexCount    = (uint32_t) local.size     ();
+		m.triangleOffset = (uint32_t) triangles.size ();
+		m.triangleCount  = (uint32_t) tris.size      ();
+
+		for ( uint32_t v : local )
+			vertices.push_back ( v + baseVertex );
+
+		for ( uint32_t t : tris )
+			triangles.push_back ( slot [indices [3*t]] | (slot [indices [3*t + 1]] << 8) | (slot [indices [3*t + 2]] << 16) );
+
+		computeBounds ( m, local, tris, indices, volume < 0 );
+		meshlets.push_back ( m );
+	}
+
+	range.meshletCount = (uint32_t) meshlets.size () - range.firstMeshlet;
+
+	return range;
+}
+
+	// cluster is back-facing for all eye positions with dot(center - eye, axis) >= cutoff * |center - eye| + radius
+void	MeshletBuilder :: computeBounds ( Meshlet& m, const std::vector<uint32_t>& local, const std::vector<uint32_t>& tris, const std::vector<uint32_t>& indices, bool flip ) const
+{
+	glm::vec3	pMin   = positions [local [0]];
+	glm::vec3	pMax   = pMin;
+	glm::vec3	axis   = glm::vec3 ( 0 );
+	float		radius = 0;
+	float		minDot = 1;
+
+	for ( uint32_t v : local )
+	{
+		pMin = glm::min ( pMin, positions [v] );
+		pMax = glm::max ( pMax, positions [v] );
+	}
+
+	glm::vec3	center = 0.5f * (pMin + pMax);
+
+	for ( uint32_t v : local )
+		radius = std::max ( radius, glm::length ( positions [v] - center ) );
+
+	std::vector<glm::vec3>	normals;
+
+	for ( uint32_t t : tris )
+	{
+		glm::vec3	n   = glm::cross ( positions [indices [3*t + 1]] - positions [indices [3*t]], positions [indices [3*t + 2]] - positions [indices [3*t]] );
+		float		len = glm::length ( n );
+
+		if ( len < 1e-12f )				// degenerate triangles have no orientation
+			continue;
+
+		normals.push_back ( (flip ? -1.0f : 1.0f) / len * n );
+		axis += normals.back ();
+	}
+
+	m.sphere = glm::vec4 ( center, radius );
+	m.cone   = glm::vec4 ( 0, 0, 1, 1 );
+
+	if ( normals.empty () || glm::length ( axis ) < 1e-6f )
+		return;
+
+	axis = glm::normalize ( axis );
+
+	for ( auto& n : normals )
+		minDot = std::min ( minDot, glm::dot ( axis, n ) );
+
+	if ( minDot > 0 )					// cone is narrower than half-space
+		m.cone = glm::vec4 ( axis, sqrtf ( 1 - minDot * minDot ) );
+}
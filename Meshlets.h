@@ -0,0 +1,78 @@
+//
+// Meshlet builder for mesh shading. Triangles are grouped greedily into small clusters with
+// bounded number of vertices and triangles, every cluster gets bounding sphere and normal cone
+// for culling in task shader. Meshlet vertices are indices into the original vertex buffer,
+// triangles are 3 local 8-bit indices packed into uint32
+//
+
+#pragma once
+
+#include	<stdint.h>
+#include	<stddef.h>
+#include	<vector>
+#include	<glm/glm.hpp>
+
+	// layout matches std430 struct Meshlet in shaders/meshlet.task and shaders/meshlet.mesh
+struct	Meshlet
+{
+	uint32_t	vertexOffset   = 0;		// in meshlet vertices
+	uint32_t	vertexCount    = 0;
+	uint32_t	triangleOffset = 0;		// in meshlet triangles
+	uint32_t	triangleCount  = 0;
+	glm::vec4	sphere;					// center and radius
+	glm::vec4	cone;					// axis and cutoff, cutoff 1 means cone cannot be culled
+};
+
+	// range of meshlets passed to task shader in push constants
+struct	MeshletRange
+{
+	uint32_t	firstMeshlet = 0;
+	uint32_t	meshletCount = 0;
+};
+
+class	MeshletBuilder
+{
+	std::vector<glm::vec3>	positions;
+	std::vector<Meshlet>	meshlets;
+	std::vector<uint32_t>	vertices;		// indices into vertex buffer
+	std::vector<uint32_t>	triangles;		// packed local indices
+
+public:
+	enum
+	{
+		maxVertices      = 64,				// must match mesh shader output limits
+		maxTriangles     = 124,
+		meshletsPerTask  = 32				// task shader workgroup size
+	};
+
+		// positions are read from vertex array with given stride in bytes
+	MeshletBuilder ( const void * vertices, size_t vertexCount, size_t stride );
+
+		// split triangle list into meshlets and append them, baseVertex is added to stored
+		// vertex indices, returns range of appended meshlets
+	MeshletRange	build ( const std::vector<uint32_t>& indices, uint32_t baseVertex = 0 );
+
+	const std::vector<Meshlet>&	getMeshlets () const
+	{
+		return meshlets;
+	}
+
+	const std::vector<uint32_t>&	getVertices () const
+	{
+		return vertices;
+	}
+
+	const std::vector<uint32_t>&	getTriangles () const
+	{
+		return triangles;
+	}
+
+		// number of task shader workgroups to cover count meshlets
+	static uint32_t	taskCount ( uint32_t count )
+	{
+		return (count + meshletsPerTask - 1) / meshletsPerTask;
+	}
+
+private:
+	void	computeBounds ( Meshlet& m, const std::vector<uint32_t>& local, const std::vector<uint32_t>& tris, const std::vector<uint32_t>& indices, bool flip ) const;
+};
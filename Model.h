@@ -1,5 +1,14 @@
+#pragma once
+
+#include	<algorithm>
 #include	"Texture.h"
 #include	"AssimpMeshLoader.h"
+#include	"RenderQueue.h"
+#include	"MeshSimplifier.h"
+#include	"Meshlets.h"
+#include	"MeshOptimizer.h"
+#include	"VertexPulling.h"
+#include	"GeometryCache.h"
 
 inline float max3 ( const glm::vec3& v )
 {
@@ -14,6 +23,16 @@ struct PushConstants
 	uint32_t	albedo, metallic, normal, roughness;	// indices into textures array
 };
 
+	// per-primitive data for GPU-driven rendering, std430 layout is used in shaders
+struct	GpuObject
+{
+	glm::mat4	matrix;									// node transform matrix
+	glm::vec4	sphere;									// bounding sphere after transform (center, radius)
+	uint32_t	firstIndex, indexCount;
+	uint32_t	albedo, metallic, normal, roughness;	// indices into textures array
+	uint32_t	pad [2];
+};
+
 struct  BasicVertex
 {
 	glm::vec3	pos;
@@ -85,6 +104,8 @@ public:
 		printf ( "\tLoading %s \n", (path + "/" + prefix + "_Roughness.png").c_str () );
 	}
 
+	PbrMaterial ( const std::string& nm, uint32_t a, uint32_t m, uint32_t n, uint32_t r ) : name ( nm ), albedo ( a ), metallic ( m ), normal ( n ), roughness ( r ) {}
+
 	const std::string&	getName () const
 	{
 		return name;
@@ -98,13 +119,29 @@ struct Primitive
 	int				firstIndex  = 0;
 	int				indexCount  = 0;
 	int				firstVertex = 0;
+	int				vertexCount = 0;
+	Primitive	  * shared      = nullptr;		// primitive with identical geometry, its ranges are used
+	uint32_t		queueMesh   = 0;			// id in RenderQueue after Model::addToQueue
 	bbox			bounds;
+	std::vector<MeshLod>	lods;				// absolute ranges of model's index buffer, 0 is full resolution
+	MeshletRange	meshlets;					// range in model's meshlet buffer
 	
 	void	render ( CommandBuffer& cb ) const
 	{
 		cb.drawIndexed ( indexCount, 1, firstIndex, 0, 0 );
 		//glDrawElements ( GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (const void *) (firstIndex*sizeof(GLuint)) );
 	}
+
+	void	renderLod ( CommandBuffer& cb, int lod ) const
+	{
+		cb.drawIndexed ( lods [lod].indexCount, 1, lods [lod].firstIndex, 0, 0 );
+	}
+
+		// launch task shader for meshlets of primitive, range goes to push constants
+	void	renderMeshlets ( CommandBuffer& cb, VkPipelineLayout layout, uint32_t instanceCount = 1 ) const
+	{
+		cb.pushConstants ( layout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, meshlets ).drawMeshTasks ( MeshletBuilder::taskCount ( meshlets.meshletCount ), instanceCount );
+	}
 };
 
 struct	Node
@@ -114,7 +151,8 @@ struct	Node
 	Node                  * parent    = nullptr;
 	std::vector<Node *>		children;
 	std::vector<Primitive*> meshes;
-	bbox					bounds;
+	bbox					bounds;					// bounds of subtree in model space
+	int						index     = -1;			// index in Model's flattened hierarchy
 	
 	Node ( const std::string& n, const glm::mat4& m ) : name ( n ), transform ( m ) {}
 	
@@ -122,36 +160,13 @@ struct	Node
 	{
 		return bounds;
 	}
-	
-	void	computeBounds ()
-	{
-		bounds.reset ();
-		
-			// get bounds for all meshes
-		for ( auto * mesh : meshes )
-			bounds.merge ( mesh->bounds );
-		
-			// collect bounds from children
-		for ( auto * child : children )
-		{
-			child->computeBounds ();
-			
-			bounds.merge ( child->bounds );
-		}
-		
-			// apply transform to them
-		bounds.apply ( transform );
-	}
-	
+
+		// product of transforms from root's child down to this node applied to m, root's own is skipped
 	glm::mat4	parentTransform ( const glm::mat4& m ) const
 	{
 		if ( parent != nullptr )
-		{
-			//m = transform * m;
-			
 			return parent->parentTransform ( transform * m );
-		}
-		
+
 		return m;
 	}
 };
@@ -161,57 +176,391 @@ class	Model
 	std::string					name;
 	Buffer						vertexBuf;
 	Buffer						indexBuf;
+	Buffer						positionBuf;			// position-only stream (PositionVertex) for depth passes
+	Buffer						indirectBuf;			// VkDrawIndexedIndirectCommand per primitive
+	Buffer						pullingIndirectBuf;		// VkDrawIndirectCommand per primitive for vertex pulling
+	Buffer						drawDataBuf;			// PushConstants per primitive, indexed by gl_DrawID
+	Buffer						meshletBuf;				// optional meshlets of all primitives
+	Buffer						meshletVertexBuf;
+	Buffer						meshletTriangleBuf;
+	uint32_t					drawCount = 0;
+	VkIndexType					indexType = VK_INDEX_TYPE_UINT32;	// 16-bit when all vertices can be addressed
+	size_t						bytesSaved = 0;						// by sharing identical geometry of primitives
 	std::vector<Primitive *>	meshes;
 	std::vector<PbrMaterial *>	materials;
 	std::vector<Texture>		textures;
 	Node					  * root = nullptr;
+
+		// flattened hierarchy, parent always precedes its children, root is at 0
+	std::vector<Node *>			nodes;
+	std::vector<int>			parents;					// -1 for root
+	std::vector<glm::mat4>		localTransforms;
+	std::vector<glm::mat4>		modelTransforms;			// relative to root: parent's model * local
+	std::vector<uint8_t>		dirty;
+	bool						transformsDirty = false;
+
+	std::vector<uint32_t>		queueMaterials;				// ids in RenderQueue, filled by addToQueue
 	
 public:
 	Model () = default;
 	
-	bool	load ( Device& device, const std::string& fileName, const std::string& texturePath, const std::string& prefix )
+		// with lodCount > 1 every primitive gets LOD chain in the same index buffer,
+		// with meshlets every primitive is split into meshlets for mesh shading
+	bool	load ( Device& device, const std::string& fileName, const std::string& texturePath, const std::string& prefix, int lodCount = 1, bool meshlets = false )
 	{	
 		MeshLoader	loader;
 		auto      * scene = loader.loadScene ( fileName );
 
 		loadMaterials ( device, loader, scene, texturePath, prefix );
-		loadMeshes    ( device, loader, scene, 1  );
+		loadMeshes    ( device, loader, scene, 1, lodCount, meshlets );
 		loadNodes     ( loader, scene     );
+		createIndirect ( device );
 		
 		return true;
 	}
+
+		// build model from geometry in memory: ranges are (firstIndex, indexCount) of primitives with absolute indices,
+		// every primitive gets node of its own with given transform, all primitives share material made of single texture
+	bool	create ( Device& device, const std::vector<BasicVertex>& vertices, const std::vector<GLuint>& indices,
+					 const std::vector<glm::uvec2>& ranges, const std::vector<glm::mat4>& transforms, const std::string& textureName )
+	{
+		assert ( ranges.size () == transforms.size () );
+
+		textures.emplace_back ( Texture () );
+
+		if ( !textures.back ().load ( device, textureName ) )
+			return false;
+
+		materials.push_back ( new PbrMaterial ( textureName, 0, 0, 0, 0 ) );
+
+		root = new Node ( "root", glm::mat4 ( 1.0f ) );
+
+		for ( size_t i = 0; i < ranges.size (); i++ )
+		{
+			Primitive * mesh = new Primitive;
+			Node      * node = new Node ( "node-" + std::to_string ( i ), transforms [i] );
+
+			mesh->materialNo  = 0;
+			mesh->material    = materials [0];
+			mesh->firstIndex  = (int)ranges [i].x;
+			mesh->indexCount  = (int)ranges [i].y;
+			mesh->firstVertex = 0;
+
+			for ( uint32_t j = 0; j < ranges [i].y; j++ )
+				mesh->bounds.addVertex ( vertices [indices [ranges [i].x + j]].pos );
+
+			node->parent = root;
+			node->meshes.push_back ( mesh );
+			root->children.push_back ( node );
+			meshes.push_back ( mesh );
+		}
+
+		buildHierarchy ();
+
+		createBuffer   ( device, vertexBuf, vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT );
+		createBuffer   ( device, positionBuf, extractPositions ( vertices.data (), vertices.size () ), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT );
+		createIndexBuffer ( device, indices, vertices.size () );
+		createIndirect    ( device );
+
+		return true;
+	}
 	
 	const std::vector<Texture>&	getTextures () const
 	{
 		return textures;
 	}
 
+	Buffer&	getVertexBuffer ()
+	{
+		return vertexBuf;
+	}
+
+	Buffer&	getIndexBuffer ()
+	{
+		return indexBuf;
+	}
+
+	Buffer&	getPositionBuffer ()
+	{
+		return positionBuf;
+	}
+
+	VkIndexType	getIndexType () const
+	{
+		return indexType;
+	}
+
+		// GPU memory not used thanks to primitives sharing identical geometry
+	size_t	getBytesSaved () const
+	{
+		return bytesSaved;
+	}
+
+	Buffer&	getMeshletBuffer ()
+	{
+		return meshletBuf;
+	}
+
+	Buffer&	getMeshletVertices ()
+	{
+		return meshletVertexBuf;
+	}
+
+	Buffer&	getMeshletTriangles ()
+	{
+		return meshletTriangleBuf;
+	}
+
+	size_t	primitiveCount () const
+	{
+		return meshes.size ();
+	}
+
+		// per-draw data (PushConstants layout) for shaders using gl_DrawID
+	Buffer&	getDrawDataBuffer ()
+	{
+		return drawDataBuf;
+	}
+
+	void	bindBuffers ( CommandBuffer& cb )
+	{
+		cb.bindVertexBuffers ( {{ vertexBuf, 0 }} );
+		cb.bindIndexBuffer   ( indexBuf, indexType );
+	}
+
+		// position stream for depth-only pipelines using PositionVertex
+	void	bindDepthBuffers ( CommandBuffer& cb )
+	{
+		cb.bindVertexBuffers ( {{ positionBuf, 0 }} );
+		cb.bindIndexBuffer   ( indexBuf, indexType );
+	}
+
+		// collect every primitive with its transform and bounds for GPU-driven rendering
+	void	collectObjects ( std::vector<GpuObject>& objects, const glm::mat4& matrix = glm::mat4 ( 1 ) )
+	{
+		updateTransforms ();
+
+		for ( size_t i = 0; i < nodes.size (); i++ )
+		{
+			glm::mat4	mv    = matrix * modelTransforms [i];
+			float		scale = std::max ( glm::length ( glm::vec3 ( mv [0] ) ), std::max ( glm::length ( glm::vec3 ( mv [1] ) ), glm::length ( glm::vec3 ( mv [2] ) ) ) );
+
+			for ( auto * mesh : nodes [i]->meshes )
+			{
+				GpuObject	obj = {};
+				glm::vec4	c   = mv * glm::vec4 ( mesh->bounds.getCenter (), 1.0f );
+
+				obj.matrix     = mv;
+				obj.sphere     = glm::vec4 ( glm::vec3 ( c ) / c.w, 0.5f * glm::length ( mesh->bounds.getSize () ) * scale );
+				obj.firstIndex = mesh->firstIndex;
+				obj.indexCount = mesh->indexCount;
+				obj.albedo     = mesh->material->albedo;
+				obj.metallic   = mesh->material->metallic;
+				obj.normal     = mesh->material->normal;
+				obj.roughness  = mesh->material->roughness;
+
+				objects.push_back ( obj );
+			}
+		}
+	}
+
+		// model-space bounds of every primitive in the same order as collectObjects, e.g. for Bvh
+	void	collectBounds ( std::vector<bbox>& boxes )
+	{
+		updateTransforms ();
+
+		for ( size_t i = 0; i < nodes.size (); i++ )
+			for ( auto * mesh : nodes [i]->meshes )
+			{
+				bbox	box = mesh->bounds;
+
+				box.apply ( modelTransforms [i] );
+				boxes.push_back ( box );
+			}
+	}
+
+	size_t	nodeCount () const
+	{
+		return nodes.size ();
+	}
+
+	Node *	getNode ( int index ) const
+	{
+		return nodes [index];
+	}
+
+	const glm::mat4&	getModelTransform ( int index ) const
+	{
+		return modelTransforms [index];
+	}
+
+		// change node's local transform, applied to subtree by next updateTransforms
+	void	setLocalTransform ( Node * node, const glm::mat4& m )
+	{
+		assert ( node->index >= 0 );
+
+		node->transform              = m;
+		localTransforms [node->index] = m;
+		dirty [node->index]           = 1;
+		transformsDirty               = true;
+	}
+
+		// single linear pass, only dirty nodes and their subtrees are recomputed; root's transform
+		// is inverted and premultiplied, so model transforms are relative to root as in renderNode.
+		// Bounds are updated for the same nodes and their ancestors
+	void	updateTransforms ()
+	{
+		if ( !transformsDirty || nodes.empty () )
+			return;
+
+		if ( dirty [0] )
+			modelTransforms [0] = glm::inverse ( localTransforms [0] );
+
+		for ( size_t i = 1; i < nodes.size (); i++ )
+		{
+			int	p = parents [i];
+
+			if ( dirty [p] )
+				dirty [i] = 1;
+
+			if ( dirty [i] )
+				modelTransforms [i] = modelTransforms [p] * localTransforms [i];
+		}
+
+		transformsDirty = false;
+
+		computeBounds ();
+	}
+
+		// node bounds in model space for dirty nodes and their ancestors: meshes of each node, then
+		// children merged into parents by reverse pass. Clears dirty flags
+	void	computeBounds ()
+	{
+		if ( nodes.empty () )
+			return;
+
+		for ( size_t i = nodes.size () - 1; i > 0; i-- )
+			if ( dirty [i] )
+				dirty [parents [i]] = 1;
+
+		for ( size_t i = 0; i < nodes.size (); i++ )
+		{
+			if ( !dirty [i] )
+				continue;
+
+			nodes [i]->bounds.reset ();
+
+			for ( auto * mesh : nodes [i]->meshes )
+			{
+				bbox	box = mesh->bounds;
+
+				box.apply ( modelTransforms [i] );
+				nodes [i]->bounds.merge ( box );
+			}
+		}
+
+		for ( size_t i = nodes.size () - 1; i > 0; i-- )
+			if ( dirty [parents [i]] )
+				nodes [parents [i]]->bounds.merge ( nodes [i]->bounds );
+
+		std::fill ( dirty.begin (), dirty.end (), 0 );
+	}
+
 	void render ( GraphicsPipeline& pipeline, CommandBuffer& cb, const glm::mat4& matrix )
 	{
 		cb.bindVertexBuffers ( {{ vertexBuf, 0 }} );
-		cb.bindIndexBuffer ( indexBuf, VK_INDEX_TYPE_UINT32 );
+		cb.bindIndexBuffer ( indexBuf, indexType );
 
-		renderNode ( root, pipeline, cb, matrix );
+		updateTransforms ();
+
+		for ( size_t i = 0; i < nodes.size (); i++ )
+			renderNode ( (int) i, pipeline, cb, matrix );
 	}
 	
-	void	renderNode ( Node * node, GraphicsPipeline& pipeline, CommandBuffer& cb, const glm::mat4& matrix )
+		// depth-only draw with position stream, pipeline takes the same PushConstants as for render
+	void	renderDepth ( GraphicsPipeline& pipeline, CommandBuffer& cb, const glm::mat4& matrix )
+	{
+		bindDepthBuffers ( cb );
+		updateTransforms ();
+
+		for ( size_t i = 0; i < nodes.size (); i++ )
+			renderNode ( (int) i, pipeline, cb, matrix );
+	}
+
+		// renderIndirect with vertex pulling: no buffers are bound, pipeline has PullingData push
+		// constants (setupPullingPipeline) and per-draw data as for renderIndirect. Caller must
+		// enable multiDrawIndirect and shaderDrawParameters (gl_DrawIDARB) features
+	void	renderIndirectPulling ( CommandBuffer& cb, VkPipelineLayout layout )
+	{
+		cb.pushConstants ( layout, VK_SHADER_STAGE_VERTEX_BIT, getPullingData () );
+		cb.drawIndirect  ( pullingIndirectBuf, drawCount );
+	}
+
+	PullingData	getPullingData () const
+	{
+		return PullingData { vertexBuf.getDeviceAddress (), indexBuf.getDeviceAddress (), indexType == VK_INDEX_TYPE_UINT16 ? (uint32_t) pull16BitIndices : 0u, 0 };
+	}
+
+		// depth-only variant of renderIndirect
+	void	renderIndirectDepth ( CommandBuffer& cb )
 	{
-		glm::mat4	tr   = glm::inverse ( root->transform ) * node->parentTransform ( glm::mat4 ( 1 ) );
-		glm::mat4	mv   = matrix * tr;
-		//glm::mat3	nm   = normalMatrix ( mv );
-		glm::vec3	sz   = root->getBox ().getSize   ();
-		float     	size = max3 ( sz ) / 7;
-		glm::mat4	translate = glm::translate ( glm::mat4(1), -root->getBox ().getCenter () );
-		glm::mat4	scale     = glm::scale     ( glm::mat4(1), glm::vec3 ( 1.0f / size ) );
+		bindDepthBuffers ( cb );
 
-		//program.setUniformMatrix ( "mv", scale * translate * mv );
-		//program.setUniformMatrix ( "nm", nm );
+		cb.drawIndexedIndirect ( indirectBuf, drawCount );
+	}
+
+		// draw whole model with single vkCmdDrawIndexedIndirect, needs multiDrawIndirect feature,
+		// shaders take matrix and material from getDrawDataBuffer () using gl_DrawID
+	void	renderIndirect ( CommandBuffer& cb )
+	{
+		bindBuffers ( cb );
+
+		cb.drawIndexedIndirect ( indirectBuf, drawCount );
+	}
+
+		// register primitives and materials in queue, must be called once before submit
+	void	addToQueue ( RenderQueue& queue )
+	{
+		queueMaterials.clear ();
+
+		for ( auto * mat : materials )
+			queueMaterials.push_back ( queue.addMaterial ( glm::uvec4 ( mat->albedo, mat->metallic, mat->normal, mat->roughness ) ) );
+
+		for ( auto * mesh : meshes )
+		{
+			RenderMesh	rm;
+
+			rm.vertexBuffer = &vertexBuf;
+			rm.indexBuffer  = &indexBuf;
+			rm.indexType    = indexType;
+			rm.firstIndex   = mesh->firstIndex;
+			rm.indexCount   = mesh->indexCount;
+			rm.center       = mesh->bounds.getCenter ();
+
+			mesh->queueMesh = queue.addMesh ( rm );
+		}
+	}
 
-		PushConstants	push { mv, 0, 0, 0, 0 };
+		// add packet for every primitive, identical primitives of many model copies become
+		// single instanced draw, shaders take matrix and material by gl_InstanceIndex
+	void	submit ( RenderQueue& queue, uint32_t pipeline, const glm::mat4& matrix, uint32_t pass = 0 )
+	{
+		assert ( queueMaterials.size () == materials.size () );
+
+		updateTransforms ();
+
+		for ( size_t i = 0; i < nodes.size (); i++ )
+			for ( auto * mesh : nodes [i]->meshes )
+				queue.submit ( mesh->queueMesh, queueMaterials [mesh->materialNo], pipeline, matrix * modelTransforms [i], pass );
+	}
 
-		for ( auto * mesh : node->meshes )
+		// draw meshes of single node, children are not drawn
+	void	renderNode ( int index, GraphicsPipeline& pipeline, CommandBuffer& cb, const glm::mat4& matrix )
+	{
+		PushConstants	push { matrix * modelTransforms [index], 0, 0, 0, 0 };
+
+		for ( auto * mesh : nodes [index]->meshes )
 		{
-			push.matrix    = mv;
 			push.albedo    = mesh->material->albedo;
 			push.metallic  = mesh->material->metallic;
 			push.normal    = mesh->material->normal;
@@ -221,9 +570,6 @@ public:
 
 			mesh -> render ( cb );
 		}
-		
-		for ( auto * c : node->children )
-			renderNode ( c, pipeline, cb, node->transform * matrix );
 	}
 	
 	Node * createNode ( const aiNode * n, Node * parent )
@@ -247,15 +593,47 @@ public:
 	{
 		root = createNode ( scene->mRootNode, nullptr );
 
-		root->computeBounds ();	
+		buildHierarchy ();
+	}
+
+		// flatten tree in depth-first order, so parents precede children, and compute all transforms
+	void	buildHierarchy ()
+	{
+		nodes.clear ();
+		parents.clear ();
+		localTransforms.clear ();
+
+		addToHierarchy ( root, -1 );
+
+		modelTransforms.assign ( nodes.size (), glm::mat4 ( 1.0f ) );
+		dirty.assign           ( nodes.size (), 1 );
+
+		transformsDirty = true;
+
+		updateTransforms ();
+	}
+
+	void	addToHierarchy ( Node * node, int parent )
+	{
+		node->index = (int) nodes.size ();
+
+		nodes.push_back           ( node );
+		parents.push_back         ( parent );
+		localTransforms.push_back ( node->transform );
+
+		for ( auto * c : node->children )
+			addToHierarchy ( c, node->index );
 	}
 	
-	void	loadMeshes ( Device& device, MeshLoader& loader, const aiScene * scene, float scale )
+	void	loadMeshes ( Device& device, MeshLoader& loader, const aiScene * scene, float scale, int lodCount, bool meshlets )
 	{
 		bbox 						box;
 		std::vector<BasicVertex>	vertices;
 		std::vector<GLuint>			indices;
 		int							base = 0;
+		GeometryCache<uint32_t>		cache;				// index of primitive by its geometry
+		size_t						savedVertices = 0;
+		size_t						savedIndices  = 0;
 			
 				// Count the number of vertices and indices
 		for ( uint32_t i = 0 ; i < scene->mNumMeshes ;i++ ) 
@@ -267,28 +645,164 @@ public:
 			std::vector<GLint>			is;
 			Primitive				  * mesh = new Primitive;
 			
-			loader.loadAiMesh<BasicVertex> ( scene->mMeshes[i], scale, vs, is, box, base );
+			loader.loadAiMesh<BasicVertex> ( scene->mMeshes[i], scale, vs, is, box, 0 );
 			
 			mesh->materialNo  = scene -> mMeshes [i] -> mMaterialIndex;
 			mesh->firstIndex  = (int)indices.size  ();
 			mesh->indexCount  = (int)is.size       ();
 			mesh->firstVertex = (int)vertices.size ();
+			mesh->vertexCount = (int)vs.size       ();
 			mesh->material    = materials [mesh->materialNo];
 			mesh->bounds      = box;
 
+				// bit-identical geometry (material may differ) is stored once
+			if ( uint32_t * src = cache.find ( vs.data (), vs.size () * sizeof ( BasicVertex ), is.data (), is.size () * sizeof ( GLint ) ) )
+			{
+				mesh->shared      = meshes [*src];
+				mesh->firstIndex  = mesh->shared->firstIndex;
+				mesh->firstVertex = mesh->shared->firstVertex;
+				savedVertices    += vs.size ();
+				savedIndices     += is.size ();
+
+				meshes.push_back ( mesh );
+				continue;
+			}
+
+			cache.add ( vs.data (), vs.size () * sizeof ( BasicVertex ), is.data (), is.size () * sizeof ( GLint ), (uint32_t) meshes.size () );
 			meshes.push_back ( mesh );
 			
 			for ( auto& v : vs )
 				vertices.push_back ( v );
 			
 			for ( auto i : is )
-				indices.push_back ( i );			
+				indices.push_back ( base + i );			
 
 			base = (int)vertices.size ();
 		}	
 
-		createBuffer ( device, vertexBuf, vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT );
-		createBuffer ( device, indexBuf,  indices,  VK_BUFFER_USAGE_INDEX_BUFFER_BIT );
+			// LODs are appended after all full resolution primitives, so firstIndex of primitives is unchanged
+		for ( size_t k = 0; k < meshes.size (); k++ )
+		{
+			Primitive			  * mesh  = meshes [k];
+			int						first = mesh->firstVertex;
+			int						last  = first + mesh->vertexCount;
+			std::vector<uint32_t>	local;
+
+			if ( mesh->shared != nullptr )		// source precedes it, so its levels are ready
+			{
+				mesh->lods = mesh->shared->lods;
+				continue;
+			}
+
+			for ( int i = 0; i < mesh->indexCount; i++ )
+				local.push_back ( indices [mesh->firstIndex + i] - first );
+
+				// vertex cache, overdraw and vertex fetch order, vertices stay within primitive's range
+			MeshOptimizer::optimize ( local, &vertices [first], last - first );
+
+			for ( int i = 0; i < mesh->indexCount; i++ )
+				indices [mesh->firstIndex + i] = local [i] + first;
+
+			if ( lodCount < 2 )
+			{
+				mesh->lods.push_back ( MeshLod { (uint32_t) mesh->firstIndex, (uint32_t) mesh->indexCount, 0.0f } );
+				continue;
+			}
+
+			std::vector<uint32_t>	lodIndices;
+
+			MeshSimplifier ( &vertices [first], last - first, sizeof ( BasicVertex ) ).buildLods ( local, lodIndices, mesh->lods, lodCount, 0.5f, FLT_MAX, first );
+
+				// level 0 is already in index buffer
+			for ( size_t i = 1; i < mesh->lods.size (); i++ )
+			{
+				MeshLod&				lod = mesh->lods [i];
+				uint32_t				pos = (uint32_t) indices.size ();
+				std::vector<uint32_t>	level ( lodIndices.begin () + lod.firstIndex, lodIndices.begin () + lod.firstIndex + lod.indexCount );
+
+				MeshOptimizer::optimizeVertexCache ( level, vertices.size () );
+				indices.insert ( indices.end (), level.begin (), level.end () );
+				lod.firstIndex = pos;
+			}
+
+			mesh->lods [0].firstIndex = mesh->firstIndex;
+		}
+
+		if ( meshlets )
+			createMeshlets ( device, vertices, indices );
+
+		createBuffer ( device, vertexBuf, vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (meshlets ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0) );
+		createBuffer ( device, positionBuf, extractPositions ( vertices.data (), vertices.size () ), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT );
+		createIndexBuffer ( device, indices, vertices.size () );
+
+		bytesSaved = savedVertices * (sizeof ( BasicVertex ) + sizeof ( PositionVertex )) + savedIndices * (indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4);
+
+		if ( cache.getHits () > 0 )
+			log () << "Model: " << cache.getHits () << " of " << meshes.size () << " primitives share geometry, " << bytesSaved << " bytes saved" << Log::endl;
+	}
+
+		// 16-bit indices when vertex count allows, all indices are absolute
+	void	createIndexBuffer ( Device& device, const std::vector<GLuint>& indices, size_t vertexCount )
+	{
+		indexType = MeshOptimizer::fits16Bit ( vertexCount ) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+		if ( indexType == VK_INDEX_TYPE_UINT16 )
+		{
+			std::vector<uint16_t>	shortIndices = MeshOptimizer::to16Bit ( indices );
+
+			if ( shortIndices.size () & 1 )			// vertex pulling reads indices as 32-bit words
+				shortIndices.push_back ( 0 );
+
+			createBuffer ( device, indexBuf, shortIndices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT );
+		}
+		else
+			createBuffer ( device, indexBuf, indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT );
+	}
+
+		// meshlets of full resolution level of every primitive, all primitives share meshlet buffers
+	void	createMeshlets ( Device& device, const std::vector<BasicVertex>& vertices, const std::vector<GLuint>& indices )
+	{
+		std::vector<Meshlet>	allMeshlets;
+		std::vector<uint32_t>	allVertices;
+		std::vector<uint32_t>	allTriangles;
+
+		for ( size_t k = 0; k < meshes.size (); k++ )
+		{
+			Primitive			  * mesh  = meshes [k];
+			int						first = mesh->firstVertex;
+			int						last  = first + mesh->vertexCount;
+			std::vector<uint32_t>	local;
+
+			if ( mesh->shared != nullptr )
+			{
+				mesh->meshlets = mesh->shared->meshlets;
+				continue;
+			}
+
+			MeshletBuilder			builder ( &vertices [first], last - first, sizeof ( BasicVertex ) );
+
+			for ( int i = 0; i < mesh->indexCount; i++ )
+				local.push_back ( indices [mesh->firstIndex + i] - first );
+
+			builder.build ( local, first );
+
+			mesh->meshlets = { (uint32_t) allMeshlets.size (), (uint32_t) builder.getMeshlets ().size () };
+
+			for ( auto m : builder.getMeshlets () )
+			{
+				m.vertexOffset   += (uint32_t) allVertices.size  ();
+				m.triangleOffset += (uint32_t) allTriangles.size ();
+
+				allMeshlets.push_back ( m );
+			}
+
+			allVertices.insert  ( allVertices.end  (), builder.getVertices  ().begin (), builder.getVertices  ().end () );
+			allTriangles.insert ( allTriangles.end (), builder.getTriangles ().begin (), builder.getTriangles ().end () );
+		}
+
+		createBuffer ( device, meshletBuf,         allMeshlets,  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT );
+		createBuffer ( device, meshletVertexBuf,   allVertices,  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT );
+		createBuffer ( device, meshletTriangleBuf, allTriangles, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT );
 	}
 
 	void	loadMaterials ( Device& device, MeshLoader& loader, const aiScene * scene, const std::string& path, const std::string& prefix )
@@ -313,6 +827,33 @@ public:
 		}
 	}
 
+		// build indirect commands and per-draw data for renderIndirect, indices are already absolute
+	void	createIndirect ( Device& device )
+	{
+		std::vector<GpuObject>						objects;
+		std::vector<VkDrawIndexedIndirectCommand>	commands;
+		std::vector<VkDrawIndirectCommand>			pullingCommands;		// firstVertex is position in index buffer
+		std::vector<PushConstants>					drawData;
+
+		collectObjects ( objects );
+
+		for ( auto& obj : objects )
+		{
+			commands.push_back        ( { obj.indexCount, 1, obj.firstIndex, 0, 0 } );
+			pullingCommands.push_back ( { obj.indexCount, 1, obj.firstIndex, 0 } );
+			drawData.push_back        ( { obj.matrix, obj.albedo, obj.metallic, obj.normal, obj.roughness } );
+		}
+
+		drawCount = (uint32_t) commands.size ();
+
+		if ( drawCount == 0 )
+			return;
+
+		createBuffer ( device, indirectBuf, commands, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT );
+		createBuffer ( device, pullingIndirectBuf, pullingCommands, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT );
+		createBuffer ( device, drawDataBuf, drawData, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT  );
+	}
+
 	// create buffer and fill using staging buffer
 	template<typename T>
 	void	createBuffer ( Device& device, Buffer& buffer, const std::vector<T>& data, uint32_t usage )
@@ -0,0 +1,399 @@
+//
+// Occlusion culling of heavy objects with hardware occlusion queries.
+// Bounding boxes are drawn after occluders (no color and depth writes) inside per object queries,
+// query results are copied into buffer at the end of the frame and used one frame later:
+// either on GPU as VK_EXT_conditional_rendering predicates (shaders/occlusion-predicate.comp)
+// or on CPU (isVisible) once the copy is finished, so nobody ever waits for the results.
+// To avoid flicker object is shown as soon as its box passes and is hidden only after
+// Policy::hideFrames results in a row have found it occluded.
+// If camera is inside the box (grown by margin), box is drawn as full screen quads, so it always passes
+//
+
+#pragma once
+
+#include	<string.h>
+#include	<memory>
+#include	<vector>
+#include	"Device.h"
+#include	"Buffer.h"
+#include	"Pipeline.h"
+#include	"DescriptorSet.h"
+#include	"CommandBuffer.h"
+#include	"OcclusionQueryPool.h"
+#include	"bbox.h"
+
+	// entry points of VK_EXT_conditional_rendering, loaded when predicates are used
+struct	ConditionalRenderingFuncs
+{
+	PFN_vkCmdBeginConditionalRenderingEXT	vkCmdBeginConditionalRenderingEXT = nullptr;
+	PFN_vkCmdEndConditionalRenderingEXT		vkCmdEndConditionalRenderingEXT   = nullptr;
+
+	bool	isOk () const
+	{
+		return vkCmdBeginConditionalRenderingEXT != nullptr;
+	}
+
+	void	load ( VkDevice device )
+	{
+		vkCmdBeginConditionalRenderingEXT = reinterpret_cast<PFN_vkCmdBeginConditionalRenderingEXT>( vkGetDeviceProcAddr ( device, "vkCmdBeginConditionalRenderingEXT" ) );
+		vkCmdEndConditionalRenderingEXT   = reinterpret_cast<PFN_vkCmdEndConditionalRenderingEXT>  ( vkGetDeviceProcAddr ( device, "vkCmdEndConditionalRenderingEXT"   ) );
+
+		if ( !isOk () )
+			fatal () << "ConditionalRenderingFuncs: " << VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME << " is not enabled" << Log::endl;
+	}
+
+	static	ConditionalRenderingFuncs&	get ()
+	{
+		static	ConditionalRenderingFuncs	funcs;
+
+		return funcs;
+	}
+};
+
+class	OcclusionQueries
+{
+public:
+	struct	Policy
+	{
+		uint32_t	minSamples = 1;		// fewer passed samples means occluded, > 1 requires occlusionQueryPrecise
+		uint32_t	hideFrames = 4;		// occluded results in a row before object is hidden
+	};
+
+private:
+	enum
+	{
+		groupSize = 64			// must match local_size_x in occlusion-predicate.comp
+	};
+
+		// uniform block of occlusion-box.vert
+	struct	BoxParams
+	{
+		glm::mat4	viewProj;
+		glm::vec4	eye;				// w - margin around box, when camera is inside box is not tested
+	};
+
+	struct	GpuBox
+	{
+		glm::vec4	minPoint;
+		glm::vec4	maxPoint;
+	};
+
+		// push constants of occlusion-predicate.comp
+	struct	PredicateParams
+	{
+		uint32_t	count;
+		uint32_t	minSamples;
+		uint32_t	hideFrames;
+	};
+
+		// per command buffer data
+	struct	Frame
+	{
+		Uniform<BoxParams>	params;
+		PersistentBuffer	boxes;
+		PersistentBuffer	results;			// ( samples, availability ) pairs, zero until copy is done
+		DescriptorSet		boxSet;
+		DescriptorSet		predicateSet;		// conditional rendering only
+		uint64_t			serial = 0;			// number of submission with unread results, 0 - none
+	};
+
+	Device                				  * device      = nullptr;
+	OcclusionQueryPool						pool;
+	GraphicsPipeline						boxPipeline;
+	ComputePipeline							predicatePipeline;
+	Buffer									predicates;			// per object hysteresis counter, non-zero - draw
+	std::vector<std::unique_ptr<Frame>>		frames;
+	std::vector<bbox>						boxes;
+	std::vector<uint32_t>					counters;			// CPU copy of predicates
+	Policy									policy;
+	uint32_t								objectCount = 0;
+	uint64_t								serial      = 0;
+	bool									conditional = false;
+
+public:
+	OcclusionQueries  () = default;
+	OcclusionQueries  ( const OcclusionQueries& ) = delete;
+	~OcclusionQueries ()
+	{
+		clean ();
+	}
+
+	OcclusionQueries& operator = ( const OcclusionQueries& ) = delete;
+
+	bool	isOk () const
+	{
+		return !frames.empty ();
+	}
+
+	uint32_t	getObjectCount () const
+	{
+		return objectCount;
+	}
+
+	bool	hasConditionalRendering () const
+	{
+		return conditional;
+	}
+
+		// boxes - world space bounds of tested objects, copies - number of command buffers (swap chain images),
+		// useConditional - skip draws with VK_EXT_conditional_rendering (extension and feature must be enabled),
+		// otherwise caller checks isVisible when recording draws
+	bool	create ( Device& dev, DescriptorAllocator& allocator, Renderpass& renderPass, const std::vector<bbox>& bounds, uint32_t copies, bool useConditional, const Policy& pol = Policy () )
+	{
+		clean ();
+
+		if ( bounds.empty () )
+			return false;
+
+		device      = &dev;
+		boxes       = bounds;
+		policy      = pol;
+		objectCount = (uint32_t) boxes.size ();
+		conditional = useConditional;
+
+		counters.assign ( objectCount, policy.hideFrames );		// everything is visible until tested
+
+		if ( !pool.create ( dev, objectCount * copies ) )
+		{
+			log () << "OcclusionQueries: cannot create query pool" << Log::endl;
+			return false;
+		}
+
+		boxPipeline.setDevice         ( dev )
+				   .setVertexShader   ( "shaders/occlusion-box.vert.spv" )
+				   .setFragmentShader ( "shaders/occlusion-box.frag.spv" )
+				   .addDescLayout     ( 0, DescSetLayout ()
+						.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT )
+						.add ( 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT ) )
+				   .setCullMode       ( VK_CULL_MODE_NONE )
+				   .setDepthTest      ( true )
+				   .setDepthWrite     ( false )
+				   .setDepthCompareOp ( VK_COMPARE_OP_LESS_OR_EQUAL )
+				   .setColorWriteMask ( false, false, false, false )
+				   .create            ( renderPass );
+
+		if ( conditional )
+		{
+			if ( !ConditionalRenderingFuncs::get ().isOk () )
+				ConditionalRenderingFuncs::get ().load ( dev.getDevice () );
+
+			predicatePipeline.setDevice         ( dev )
+							 .setShader         ( "shaders/occlusion-predicate.comp.spv" )
+							 .addDescriptor     ( 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT )
+							 .addDescriptor     ( 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT )
+							 .addPushConstRange ( VK_SHADER_STAGE_COMPUTE_BIT, sizeof ( PredicateParams ) )
+							 .create            ();
+
+			if ( !predicates.createDeviceLocal ( dev, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT, counters ) )
+			{
+				log () << "OcclusionQueries: cannot create predicate buffer" << Log::endl;
+				return false;
+			}
+		}
+
+		for ( uint32_t i = 0; i < copies; i++ )
+		{
+			auto	frame = std::make_unique<Frame> ();
+
+			frame->params.create  ( dev );
+			frame->boxes.create   ( dev, objectCount * sizeof ( GpuBox ), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, Buffer::hostWrite );
+			frame->results.create ( dev, objectCount * 2 * sizeof ( uint32_t ), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, Buffer::hostRead );
+			frame->boxSet
+				.setLayout ( dev, allocator, boxPipeline.getDescLayout () )
+				.addBuffer ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame->params )
+				.addBuffer ( 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame->boxes )
+				.create    ();
+
+			if ( conditional )
+				frame->predicateSet
+					.setLayout ( dev, allocator, predicatePipeline.getDescLayout () )
+					.addBuffer ( 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame->results )
+					.addBuffer ( 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, predicates )
+					.create    ();
+
+			memset ( frame->results.getPtr (), 0, objectCount * 2 * sizeof ( uint32_t ) );
+			frames.push_back ( std::move ( frame ) );
+		}
+
+		return true;
+	}
+
+	void	clean ()
+	{
+		frames.clear             ();
+		predicates.clean         ();
+		boxPipeline.clean        ();
+		predicatePipeline.clean  ();
+		pool.destroy             ();
+		boxes.clear              ();
+		counters.clear           ();
+
+		objectCount = 0;
+		serial      = 0;
+	}
+
+		// object has moved, new box is used from the next update
+	void	setBox ( uint32_t object, const bbox& box )
+	{
+		boxes [object] = box;
+	}
+
+		// object is visible according to results read on CPU so far
+	bool	isVisible ( uint32_t object ) const
+	{
+		return counters [object] > 0;
+	}
+
+	uint32_t	visibleCount () const
+	{
+		uint32_t	n = 0;
+
+		for ( auto c : counters )
+			if ( c > 0 )
+				n++;
+
+		return n;
+	}
+
+		// call before submitting given copy, when its previous submission has completed:
+		// reads all finished results and sets camera, margin should be not less than
+		// distance from eye to corners of near plane
+	void	update ( uint32_t index, const glm::mat4& viewProj, const glm::vec3& eye, float margin )
+	{
+		Frame&	frame = *frames [index];
+
+		collect ();
+
+		if ( frame.serial != 0 )		// completed but was not collected in order
+			apply ( frame );
+
+		memset ( frame.results.getPtr (), 0, objectCount * 2 * sizeof ( uint32_t ) );
+
+		GpuBox	  * dst = (GpuBox *) frame.boxes.getPtr ();
+
+		for ( uint32_t i = 0; i < objectCount; i++ )
+			dst [i] = { glm::vec4 ( boxes [i].getMinPoint (), 1 ), glm::vec4 ( boxes [i].getMaxPoint (), 1 ) };
+
+		frame.params.getPtr ()->viewProj = viewProj;
+		frame.params.getPtr ()->eye      = glm::vec4 ( eye, margin );
+		frame.serial                     = ++serial;
+	}
+
+		// record before render pass
+	void	begin ( CommandBuffer& cb, uint32_t index )
+	{
+		pool.reset ( cb, index * objectCount, objectCount );
+
+			// predicates were written by previous frame
+		if ( conditional )
+			pipelineBarrier ( cb, { bufferBarrier ( predicates, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+													VK_PIPELINE_STAGE_2_CONDITIONAL_RENDERING_BIT_EXT, VK_ACCESS_2_CONDITIONAL_RENDERING_READ_BIT_EXT ) } );
+	}
+
+		// record inside render pass after occluders are drawn, binds its own pipeline,
+		// so caller must bind its pipeline and descriptor sets again
+	void	drawBoxes ( CommandBuffer& cb, uint32_t index )
+	{
+		Frame&	frame = *frames [index];
+		bool	precise = policy.minSamples > 1;
+
+		cb.pipeline          ( boxPipeline )
+		  .addDescriptorSets ( { frame.boxSet } );
+
+		for ( uint32_t i = 0; i < objectCount; i++ )
+		{
+			pool.begin ( cb, index * objectCount + i, precise );
+			cb.draw    ( 36, 1, 0, i );			// box index is passed as gl_InstanceIndex
+			pool.end   ( cb, index * objectCount + i );
+		}
+	}
+
+		// draws between beginConditional and endConditional are skipped when object is occluded
+	void	beginConditional ( CommandBuffer& cb, uint32_t object )
+	{
+		VkConditionalRenderingBeginInfoEXT	info = { VK_STRUCTURE_TYPE_CONDITIONAL_RENDERING_BEGIN_INFO_EXT };
+
+		info.buffer = predicates.getHandle ();
+		info.offset = object * sizeof ( uint32_t );
+
+		ConditionalRenderingFuncs::get ().vkCmdBeginConditionalRenderingEXT ( cb.getHandle (), &info );
+	}
+
+	void	endConditional ( CommandBuffer& cb )
+	{
+		ConditionalRenderingFuncs::get ().vkCmdEndConditionalRenderingEXT ( cb.getHandle () );
+	}
+
+		// record after render pass: copy results and update predicates for the next frame
+	void	end ( CommandBuffer& cb, uint32_t index )
+	{
+		Frame&	frame = *frames [index];
+
+		pool.copyResults ( cb, frame.results, 0, index * objectCount, objectCount, VK_QUERY_RESULT_WAIT_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT );
+
+		pipelineBarrier ( cb, { bufferBarrier ( frame.results, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+												VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_HOST_READ_BIT ) } );
+
+		if ( !conditional )
+			return;
+
+			// predicates may still be used by draws of this frame
+		pipelineBarrier ( cb, { bufferBarrier ( predicates, VK_PIPELINE_STAGE_2_CONDITIONAL_RENDERING_BIT_EXT, VK_ACCESS_2_CONDITIONAL_RENDERING_READ_BIT_EXT,
+												VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT ) } );
+
+		cb.pipeline          ( predicatePipeline )
+		  .addDescriptorSets ( { frame.predicateSet } )
+		  .pushConstants     ( predicatePipeline.getLayout (), VK_SHADER_STAGE_COMPUTE_BIT, PredicateParams { objectCount, policy.minSamples, policy.hideFrames } )
+		  .dispatch          ( (objectCount + groupSize - 1) / groupSize );
+	}
+
+private:
+		// apply finished results in submission order, stop at the first unfinished
+	void	collect ()
+	{
+		for ( ; ; )
+		{
+			Frame * oldest = nullptr;
+
+			for ( auto& f : frames )
+				if ( f->serial != 0 && (oldest == nullptr || f->serial < oldest->serial) )
+					oldest = f.get ();
+
+			if ( oldest == nullptr || !isFinished ( *oldest ) )
+				return;
+
+			apply ( *oldest );
+		}
+	}
+
+	bool	isFinished ( const Frame& frame ) const
+	{
+		const uint32_t * res = (const uint32_t *) frame.results.getPtr ();
+
+		for ( uint32_t i = 0; i < objectCount; i++ )
+			if ( res [2*i + 1] == 0 )
+				return false;
+
+		return true;
+	}
+
+		// same rule as in occlusion-predicate.comp
+	void	apply ( Frame& frame )
+	{
+		const uint32_t * res = (const uint32_t *) frame.results.getPtr ();
+
+		for ( uint32_t i = 0; i < objectCount; i++ )
+		{
+			if ( res [2*i + 1] == 0 )		// not available
+				continue;
+
+			if ( res [2*i] >= policy.minSamples )
+				counters [i] = policy.hideFrames;
+			else
+			if ( counters [i] > 0 )
+				counters [i]--;
+		}
+
+		frame.serial = 0;
+	}
+};
@@ -0,0 +1,120 @@
+//
+// Pool of occlusion queries: every query counts samples passed depth test between begin and end.
+// Results may be read on CPU without waiting (getResults returns availability of every query)
+// or copied into buffer on GPU, e.g. for VK_EXT_conditional_rendering predicates
+//
+
+#pragma once
+
+#include	<vector>
+#include	"CommandBuffer.h"
+#include	"Device.h"
+#include	"Buffer.h"
+
+class	OcclusionQueryPool
+{
+	Device        * device    = nullptr;
+	VkQueryPool		queryPool = VK_NULL_HANDLE;
+	uint32_t		count     = 0;
+
+public:
+	OcclusionQueryPool () = default;
+	OcclusionQueryPool ( const OcclusionQueryPool& ) = delete;
+	~OcclusionQueryPool ()
+	{
+		destroy ();
+	}
+
+	OcclusionQueryPool& operator = ( const OcclusionQueryPool& ) = delete;
+
+		// create pool with cnt slots
+	bool	create ( Device& dev, uint32_t cnt )
+	{
+		VkQueryPoolCreateInfo createInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+
+		device                = &dev;
+		count                 = cnt;
+		createInfo.queryType  = VK_QUERY_TYPE_OCCLUSION;
+		createInfo.queryCount = count;
+
+		return vkCreateQueryPool ( device->getDevice (), &createInfo, nullptr, &queryPool ) == VK_SUCCESS;
+	}
+
+	void	destroy ()
+	{
+		if ( queryPool && device )
+			vkDestroyQueryPool ( device->getDevice (), queryPool, nullptr );
+
+		queryPool = VK_NULL_HANDLE;
+		count     = 0;
+	}
+
+	VkQueryPool	getHandle () const
+	{
+		return queryPool;
+	}
+
+	uint32_t	getCount () const
+	{
+		return count;
+	}
+
+		// reset queries, must be outside of render pass
+	void	reset ( CommandBuffer& commandBuffer, uint32_t first = 0, uint32_t num = 0 )
+	{
+		if ( num < 1 )
+			num = count;
+
+		vkCmdResetQueryPool ( commandBuffer.getHandle (), queryPool, first, num );
+	}
+
+		// precise queries return exact sample count (occlusionQueryPrecise feature),
+		// otherwise any non-zero value means some samples passed
+	void	begin ( CommandBuffer& commandBuffer, uint32_t index, bool precise = false )
+	{
+		vkCmdBeginQuery ( commandBuffer.getHandle (), queryPool, index, precise ? VK_QUERY_CONTROL_PRECISE_BIT : 0 );
+	}
+
+	void	end ( CommandBuffer& commandBuffer, uint32_t index )
+	{
+		vkCmdEndQuery ( commandBuffer.getHandle (), queryPool, index );
+	}
+
+		// get results without waiting, results gets pairs ( samples, availability ) for every query,
+		// returns true when all queries are available
+	bool	getResults ( std::vector<uint64_t>& results, uint32_t first = 0, uint32_t num = 0 )
+	{
+		if ( num == 0 )
+			num = count;
+
+		results.resize ( 2 * num );
+
+		VkResult	res = vkGetQueryPoolResults ( device->getDevice (), queryPool, first, num, results.size () * sizeof ( uint64_t ), results.data (), 2 * sizeof ( uint64_t ),
+												  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT );
+
+		return res == VK_SUCCESS;
+	}
+
+		// non-blocking read of one query, returns false if result is not ready yet
+	bool	getResult ( uint32_t index, uint64_t& samples )
+	{
+		uint64_t	value [2] = { 0, 0 };
+
+		vkGetQueryPoolResults ( device->getDevice (), queryPool, index, 1, sizeof ( value ), value, sizeof ( value ), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT );
+
+		samples = value [0];
+
+		return value [1] != 0;
+	}
+
+		// copy results into buffer on GPU, must be outside of render pass. Values are 32-bit or
+		// 64-bit with VK_QUERY_RESULT_64_BIT, with VK_QUERY_RESULT_WITH_AVAILABILITY_BIT every
+		// result is followed by its availability of the same size
+	void	copyResults ( CommandBuffer& commandBuffer, Buffer& buffer, VkDeviceSize offset, uint32_t first, uint32_t num, VkQueryResultFlags flags = VK_QUERY_RESULT_WAIT_BIT )
+	{
+		VkDeviceSize	size   = (flags & VK_QUERY_RESULT_64_BIT) ? sizeof ( uint64_t ) : sizeof ( uint32_t );
+		VkDeviceSize	stride = (flags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) ? 2 * size : size;
+
+		vkCmdCopyQueryPoolResults ( commandBuffer.getHandle (), queryPool, first, num, buffer.getHandle (), offset, stride, flags );
+	}
+};
@@ -0,0 +1,151 @@
+//
+// Compressed vertex format: 20 bytes instead of 56 of BasicVertex. Position and texture
+// coordinates are half floats, normal and tangent are octahedral-encoded 16-bit snorm,
+// bitangent is restored in shader as sign * cross ( n, t ), the sign is stored in pos.w.
+// Decoding for shaders is in shaders/vertex-packed.vert.
+// PositionVertex is position-only stream for depth and shadow passes (shaders/depthpass.vert)
+//
+
+#pragma once
+
+#include	<stdint.h>
+#include	<stddef.h>
+#include	<math.h>
+#include	<algorithm>
+#include	<vector>
+#include	<glm/glm.hpp>
+#include	<glm/gtc/packing.hpp>
+#include	"Pipeline.h"
+
+struct	PackedVertex
+{
+	uint16_t	pos   [4];			// half x, y, z and bitangent sign
+	uint16_t	tex   [2];			// half u, v
+	int16_t		frame [4];			// octahedral normal and tangent
+};
+
+	// tightly packed positions, 12 bytes instead of 56 for passes not reading other attributes
+struct	PositionVertex
+{
+	glm::vec3	pos;
+};
+
+	// float vertex with the same layout as BasicVertex, used for loading before packing
+struct	UnpackedVertex
+{
+	glm::vec3	pos;
+	glm::vec2	tex;
+	glm::vec3	n;
+	glm::vec3	t, b;
+};
+
+	// map unit vector to [-1,1]^2 by projecting onto octahedron and unfolding lower half
+inline glm::vec2	octEncode ( const glm::vec3& v )
+{
+	float	len = fabsf ( v.x ) + fabsf ( v.y ) + fabsf ( v.z );
+
+	if ( len < 1e-12f )
+		return glm::vec2 ( 0 );
+
+	glm::vec3	n = v * (1.0f / len);
+
+	if ( n.z >= 0 )
+		return glm::vec2 ( n.x, n.y );
+
+	return glm::vec2 ( (1 - fabsf ( n.y )) * (n.x >= 0 ? 1 : -1), (1 - fabsf ( n.x )) * (n.y >= 0 ? 1 : -1) );
+}
+
+inline glm::vec3	octDecode ( const glm::vec2& e )
+{
+	glm::vec3	v ( e.x, e.y, 1 - fabsf ( e.x ) - fabsf ( e.y ) );
+	float		t = std::max ( -v.z, 0.0f );
+
+	v.x += v.x >= 0 ? -t : t;
+	v.y += v.y >= 0 ? -t : t;
+
+	return glm::normalize ( v );
+}
+
+inline int16_t	packSnorm16 ( float v )
+{
+	return (int16_t) roundf ( std::min ( std::max ( v, -1.0f ), 1.0f ) * 32767.0f );
+}
+
+inline float	unpackSnorm16 ( int16_t v )
+{
+	return std::max ( v / 32767.0f, -1.0f );
+}
+
+	// Vertex must have pos, tex, n, t, b members (BasicVertex or UnpackedVertex)
+template <typename Vertex>
+inline PackedVertex	packVertex ( const Vertex& v )
+{
+	PackedVertex	p;
+	glm::vec2		n    = octEncode ( v.n );
+	glm::vec2		t    = octEncode ( v.t );
+	float			sign = glm::dot ( glm::cross ( v.n, v.t ), v.b ) < 0 ? -1.0f : 1.0f;
+
+	p.pos   [0] = glm::packHalf1x16 ( v.pos.x );
+	p.pos   [1] = glm::packHalf1x16 ( v.pos.y );
+	p.pos   [2] = glm::packHalf1x16 ( v.pos.z );
+	p.pos   [3] = glm::packHalf1x16 ( sign );
+	p.tex   [0] = glm::packHalf1x16 ( v.tex.x );
+	p.tex   [1] = glm::packHalf1x16 ( v.tex.y );
+	p.frame [0] = packSnorm16 ( n.x );
+	p.frame [1] = packSnorm16 ( n.y );
+	p.frame [2] = packSnorm16 ( t.x );
+	p.frame [3] = packSnorm16 ( t.y );
+
+	return p;
+}
+
+inline UnpackedVertex	unpackVertex ( const PackedVertex& p )
+{
+	UnpackedVertex	v;
+
+	v.pos = glm::vec3 ( glm::unpackHalf1x16 ( p.pos [0] ), glm::unpackHalf1x16 ( p.pos [1] ), glm::unpackHalf1x16 ( p.pos [2] ) );
+	v.tex = glm::vec2 ( glm::unpackHalf1x16 ( p.tex [0] ), glm::unpackHalf1x16 ( p.tex [1] ) );
+	v.n   = octDecode ( glm::vec2 ( unpackSnorm16 ( p.frame [0] ), unpackSnorm16 ( p.frame [1] ) ) );
+	v.t   = octDecode ( glm::vec2 ( unpackSnorm16 ( p.frame [2] ), unpackSnorm16 ( p.frame [3] ) ) );
+	v.b   = glm::unpackHalf1x16 ( p.pos [3] ) * glm::cross ( v.n, v.t );
+
+	return v;
+}
+
+template <typename Vertex>
+inline std::vector<PackedVertex>	packVertices ( const Vertex * vertices, size_t count )
+{
+	std::vector<PackedVertex>	packed ( count );
+
+	for ( size_t i = 0; i < count; i++ )
+		packed [i] = packVertex ( vertices [i] );
+
+	return packed;
+}
+
+	// pos.w is bitangent sign, frame.xy is normal and frame.zw is tangent
+template <>
+inline GraphicsPipeline&	registerVertexAttrs<PackedVertex> ( GraphicsPipeline& pipeline )
+{
+	return pipeline
+		.addVertexAttr ( 0, 0, VK_FORMAT_R16G16B16A16_SFLOAT, offsetof(PackedVertex, pos) )		// binding, location, format, offset
+		.addVertexAttr ( 0, 1, VK_FORMAT_R16G16_SFLOAT,       offsetof(PackedVertex, tex) )
+		.addVertexAttr ( 0, 2, VK_FORMAT_R16G16B16A16_SNORM,  offsetof(PackedVertex, frame) );
+}
+
+template <>
+inline GraphicsPipeline&	registerVertexAttrs<PositionVertex> ( GraphicsPipeline& pipeline )
+{
+	return pipeline.addVertexAttr ( 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PositionVertex, pos) );
+}
+
+template <typename Vertex>
+inline std::vector<PositionVertex>	extractPositions ( const Vertex * vertices, size_t count )
+{
+	std::vector<PositionVertex>	positions ( count );
+
+	for ( size_t i = 0; i < count; i++ )
+		positions [i].pos = vertices [i].pos;
+
+	return positions;
+}
@@ -5,6 +5,7 @@
 #include	<memory>			// for shared_ptr
 #include	"Data.h"
 #include	"Texture.h"
+#include	"PushDescriptors.h"
 
 class	GraphicsPipeline;
 
@@ -303,10 +304,12 @@ class	DescSetLayout
 	std::shared_ptr<bool>						shared;		// shared marker used to track shared usage
 	VkDescriptorSetLayout						descriptorSetLayout = VK_NULL_HANDLE;
 	VkDevice									device              = VK_NULL_HANDLE;
+	VkDescriptorSetLayoutCreateFlags			createFlags         = 0;
+	bool										push                = false;		// push descriptor layout
 
 public:
 	DescSetLayout () = default;
-	DescSetLayout ( const DescSetLayout& dsl) : descr ( dsl.descr ), flags ( dsl.flags ), descriptorSetLayout ( dsl.descriptorSetLayout ), device ( dsl.device ) 
+	DescSetLayout ( const DescSetLayout& dsl) : descr ( dsl.descr ), flags ( dsl.flags ), descriptorSetLayout ( dsl.descriptorSetLayout ), device ( dsl.device ), createFlags ( dsl.createFlags ), push ( dsl.push ) 
 	{
 		if ( descriptorSetLayout )		// share only if there is layout to share
 			shared = dsl.shared;
@@ -318,6 +321,8 @@ public:
 		std::swap ( descriptorSetLayout, dsl.descriptorSetLayout );
 		std::swap ( descr,               dsl.descr );
 		std::swap ( shared,              dsl.shared );
+		std::swap ( createFlags,         dsl.createFlags );
+		std::swap ( push,                dsl.push );
 	}
 	
 	~DescSetLayout ()
@@ -333,6 +338,8 @@ public:
 		flags               = dsl.flags;
 		device              = dsl.device;
 		descriptorSetLayout = dsl.descriptorSetLayout;
+		createFlags         = dsl.createFlags;
+		push                = dsl.push;
 
 		if ( dsl.descriptorSetLayout )	// realy shared layout
 			shared = dsl.shared;
@@ -348,6 +355,8 @@ public:
 		std::swap ( descriptorSetLayout, dsl.descriptorSetLayout );
 		std::swap ( descr,               dsl.descr  );
 		std::swap ( shared,              dsl.shared );
+		std::swap ( createFlags,         dsl.createFlags );
+		std::swap ( push,                dsl.push );
 	}
 	
 	uint32_t	count () const
@@ -364,6 +373,32 @@ public:
 	{
 		return descriptorSetLayout;
 	}
+
+	VkDescriptorSetLayoutCreateFlags	getCreateFlags () const
+	{
+		return createFlags;
+	}
+
+		// layout is used with descriptor buffers instead of descriptor sets
+	bool	isDescriptorBuffer () const
+	{
+		return (createFlags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT) != 0;
+	}
+
+	bool	isPushDescriptor () const
+	{
+		return push;
+	}
+
+		// layout for push descriptors (requires VK_KHR_push_descriptor), no sets are allocated for it
+	DescSetLayout&	setPushDescriptor ( bool on = true )
+	{
+		assert ( descriptorSetLayout == VK_NULL_HANDLE );
+
+		push = on;
+
+		return *this;
+	}
 	
 	void	clean ()
 	{
@@ -426,7 +461,16 @@ public:
 		layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 		layoutInfo.bindingCount = count ();
 		layoutInfo.pBindings    = data  ();
+		if ( push )
+		{
+			layoutCreateFlags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+
+			if ( !PushDescriptorFuncs::get ().isOk ( dev ) )
+				PushDescriptorFuncs::get ().load ( dev );
+		}
+
 		layoutInfo.flags        = layoutCreateFlags;
+		createFlags             = layoutCreateFlags;
 		shared                  = std::make_shared<bool> ( true );
 
 		if ( vkCreateDescriptorSetLayout ( device = dev, &layoutInfo, nullptr, &descriptorSetLayout ) != VK_SUCCESS )
@@ -483,6 +527,35 @@ public:
 	}
 };
 
+	// entry point of VK_EXT_mesh_shader, it is not exported by loader. Loaded for device
+	// when mesh shading pipeline is created and reloaded if commands come from another device
+struct	MeshShaderFuncs
+{
+	VkDevice					device                = VK_NULL_HANDLE;
+	PFN_vkCmdDrawMeshTasksEXT	vkCmdDrawMeshTasksEXT = nullptr;
+
+	bool	isOk ( VkDevice dev ) const
+	{
+		return device == dev && vkCmdDrawMeshTasksEXT != nullptr;
+	}
+
+	void	load ( VkDevice dev )
+	{
+		device                = dev;
+		vkCmdDrawMeshTasksEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT> ( vkGetDeviceProcAddr ( dev, "vkCmdDrawMeshTasksEXT" ) );
+
+		if ( vkCmdDrawMeshTasksEXT == nullptr )
+			fatal () << "MeshShaderFuncs: " << VK_EXT_MESH_SHADER_EXTENSION_NAME << " is not enabled" << Log::endl;
+	}
+
+	static	MeshShaderFuncs&	get ()
+	{
+		static	MeshShaderFuncs	funcs;
+
+		return funcs;
+	}
+};
+
 class	GraphicsPipeline
 {
 	Device			  * device         = nullptr;
@@ -493,6 +566,7 @@ class	GraphicsPipeline
 	Shader	fragShader;
 	Shader	geomShader;
 	Shader	tessControlShader, tessEvalShader;
+	Shader	taskShader, meshShader;				// mesh shading pipeline replaces vertex input and vertex shader
 
 	VkPrimitiveTopology                        topology                = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
  	VkBool32                                   primitiveRestartEnable  = VK_FALSE;
@@ -570,6 +644,8 @@ public:
 		
 		vertShader.clean     ();
 		fragShader.clean     ();
+		taskShader.clean     ();
+		meshShader.clean     ();
 		vertexBindings.clean ();
 		vertexAttrs.clean    ();
 
@@ -661,6 +737,32 @@ public:
 		return *this; 
 	}
 
+		// optional task shader for mesh shading pipeline (requires VK_EXT_mesh_shader)
+	GraphicsPipeline&	setTaskShader ( const std::string& fileName )
+	{ 
+		Data	data ( fileName );
+		
+		if ( data.getLength () < 1 )
+			fatal () << "Shader: cannot open " << fileName << Log::endl;
+		
+		taskShader.load ( device->getDevice (), data );
+		
+		return *this; 
+	}
+
+		// mesh shader is used instead of vertex shader, vertex bindings are ignored
+	GraphicsPipeline&	setMeshShader ( const std::string& fileName )
+	{ 
+		Data	data ( fileName );
+		
+		if ( data.getLength () < 1 )
+			fatal () << "Shader: cannot open " << fileName << Log::endl;
+		
+		meshShader.load ( device->getDevice (), data );
+		
+		return *this; 
+	}
+
 	GraphicsPipeline&	setPatchSize ( uint32_t pSize )
 	{
 		patchSize = pSize;
@@ -978,6 +1080,9 @@ public:
 		VkPipelineShaderStageCreateInfo geomShaderStageInfo        = {};
 		VkPipelineShaderStageCreateInfo tessControlShaderStageInfo = {};
 		VkPipelineShaderStageCreateInfo tessEvalShaderStageInfo    = {};
+		VkPipelineShaderStageCreateInfo taskShaderStageInfo        = {};
+		VkPipelineShaderStageCreateInfo meshShaderStageInfo        = {};
+		bool							meshShading                = meshShader.getHandle () != VK_NULL_HANDLE;
 
 		vertShaderStageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		vertShaderStageInfo.stage  = VK_SHADER_STAGE_VERTEX_BIT;
@@ -991,6 +1096,30 @@ public:
 
 		std::vector<VkPipelineShaderStageCreateInfo>	shaderStages = { vertShaderStageInfo, fragShaderStageInfo };
 
+			// mesh shading - task (optional) and mesh shaders instead of vertex shader
+		if ( meshShading )
+		{
+			if ( !MeshShaderFuncs::get ().isOk ( device->getDevice () ) )
+				MeshShaderFuncs::get ().load ( device->getDevice () );
+
+			meshShaderStageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			meshShaderStageInfo.stage  = VK_SHADER_STAGE_MESH_BIT_EXT;
+			meshShaderStageInfo.module = meshShader.getHandle ();
+			meshShaderStageInfo.pName  = meshShader.getName   ();
+
+			shaderStages = { meshShaderStageInfo, fragShaderStageInfo };
+
+			if ( taskShader.getHandle () != VK_NULL_HANDLE )
+			{
+				taskShaderStageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+				taskShaderStageInfo.stage  = VK_SHADER_STAGE_TASK_BIT_EXT;
+				taskShaderStageInfo.module = taskShader.getHandle ();
+				taskShaderStageInfo.pName  = taskShader.getName   ();
+
+				shaderStages.push_back ( taskShaderStageInfo );
+			}
+		}
+
 				// optional - geometry shader
 		if ( geomShader.getHandle () != VK_NULL_HANDLE )
 		{
@@ -1165,8 +1294,8 @@ public:
 		pipelineInfo.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		pipelineInfo.stageCount          = (uint32_t) shaderStages.size ();
 		pipelineInfo.pStages             = shaderStages.data ();
-		pipelineInfo.pVertexInputState   = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pVertexInputState   = meshShading ? nullptr : &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = meshShading ? nullptr : &inputAssembly;
 		pipelineInfo.pViewportState      = &viewportState;
 		pipelineInfo.pRasterizationState = &rasterizer;
 		pipelineInfo.pMultisampleState   = &multisampling;
@@ -0,0 +1,127 @@
+//
+// Push descriptors (VK_KHR_push_descriptor) and descriptor update templates.
+// Push layouts are created with DescSetLayout::setPushDescriptor, bindings are written
+// directly into command buffer with CommandBuffer::pushDescriptorSet - no pools and no sets
+//
+
+#pragma once
+
+#include	<vector>
+#include	"Device.h"
+
+	// entry points of VK_KHR_push_descriptor, loaded for device when first push layout is
+	// created and reloaded if push layouts or commands come from another device
+struct	PushDescriptorFuncs
+{
+	VkDevice									device                                = VK_NULL_HANDLE;
+	PFN_vkCmdPushDescriptorSetKHR				vkCmdPushDescriptorSetKHR             = nullptr;
+	PFN_vkCmdPushDescriptorSetWithTemplateKHR	vkCmdPushDescriptorSetWithTemplateKHR = nullptr;
+
+	bool	isOk ( VkDevice dev ) const
+	{
+		return device == dev && vkCmdPushDescriptorSetKHR != nullptr;
+	}
+
+	void	load ( VkDevice dev )
+	{
+		device                                = dev;
+		vkCmdPushDescriptorSetKHR             = reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>            ( vkGetDeviceProcAddr ( dev, "vkCmdPushDescriptorSetKHR"             ) );
+		vkCmdPushDescriptorSetWithTemplateKHR = reinterpret_cast<PFN_vkCmdPushDescriptorSetWithTemplateKHR>( vkGetDeviceProcAddr ( dev, "vkCmdPushDescriptorSetWithTemplateKHR" ) );
+
+		if ( vkCmdPushDescriptorSetKHR == nullptr )
+			fatal () << "PushDescriptorFuncs: " << VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME << " is not enabled" << Log::endl;
+	}
+
+	static	PushDescriptorFuncs&	get ()
+	{
+		static	PushDescriptorFuncs	funcs;
+
+		return funcs;
+	}
+};
+
+	// Template describing where descriptors are in application's struct, so the whole set
+	// is written with one call from that struct. Can be used both for push descriptors
+	// and for updating ordinary descriptor sets
+class	DescriptorUpdateTemplate
+{
+	VkDevice									device   = VK_NULL_HANDLE;
+	VkDescriptorUpdateTemplate					handle   = VK_NULL_HANDLE;
+	std::vector<VkDescriptorUpdateTemplateEntry>	entries;
+
+public:
+	DescriptorUpdateTemplate  () = default;
+	DescriptorUpdateTemplate  ( const DescriptorUpdateTemplate& ) = delete;
+	~DescriptorUpdateTemplate ()
+	{
+		clean ();
+	}
+
+	DescriptorUpdateTemplate& operator = ( const DescriptorUpdateTemplate& ) = delete;
+
+	VkDescriptorUpdateTemplate	getHandle () const
+	{
+		return handle;
+	}
+
+		// offset is offset of VkDescriptorBufferInfo/VkDescriptorImageInfo in data, stride is for arrays
+	DescriptorUpdateTemplate&	add ( uint32_t binding, VkDescriptorType type, size_t offset, uint32_t count = 1, size_t stride = 0, uint32_t arrayElement = 0 )
+	{
+		assert ( handle == VK_NULL_HANDLE );
+
+		VkDescriptorUpdateTemplateEntry	entry = {};
+
+		entry.dstBinding      = binding;
+		entry.dstArrayElement = arrayElement;
+		entry.descriptorCount = count;
+		entry.descriptorType  = type;
+		entry.offset          = offset;
+		entry.stride          = stride;
+
+		if ( entry.stride == 0 )
+			entry.stride = (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER ||
+							type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) ?
+							sizeof ( VkDescriptorBufferInfo ) : sizeof ( VkDescriptorImageInfo );
+
+		entries.push_back ( entry );
+
+		return *this;
+	}
+
+		// push = true - template for CommandBuffer::pushDescriptorSet, pipelineLayout and setIndex are used only for it
+	bool	create ( Device& dev, VkDescriptorSetLayout setLayout, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t setIndex = 0,
+					 VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS, bool push = true )
+	{
+		VkDescriptorUpdateTemplateCreateInfo	createInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO };
+
+		clean ();
+
+		device                                = dev.getDevice ();
+		createInfo.descriptorUpdateEntryCount = (uint32_t) entries.size ();
+		createInfo.pDescriptorUpdateEntries   = entries.data ();
+		createInfo.templateType               = push ? VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR : VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+		createInfo.descriptorSetLayout        = setLayout;
+		createInfo.pipelineBindPoint          = bindPoint;
+		createInfo.pipelineLayout             = pipelineLayout;
+		createInfo.set                        = setIndex;
+
+		if ( push && !PushDescriptorFuncs::get ().isOk ( device ) )
+			PushDescriptorFuncs::get ().load ( device );
+
+		return vkCreateDescriptorUpdateTemplate ( device, &createInfo, nullptr, &handle ) == VK_SUCCESS;
+	}
+
+	void	clean ()
+	{
+		if ( handle != VK_NULL_HANDLE )
+			vkDestroyDescriptorUpdateTemplate ( device, handle, nullptr );
+
+		handle = VK_NULL_HANDLE;
+	}
+
+		// write ordinary descriptor set from data (template created with push = false)
+	void	update ( VkDescriptorSet set, const void * data ) const
+	{
+		vkUpdateDescriptorSetWithTemplate ( device, set, handle, data );
+	}
+};
@@ -0,0 +1,236 @@
+//
+// Render queue: sorting, merging into instanced batches and recording
+//
+
+#include	<assert.h>
+#include	<algorithm>
+#include	"RenderQueue.h"
+#include	"CommandBuffer.h"
+#include	"Log.h"
+
+uint32_t	RenderQueue :: addMesh ( const RenderMesh& mesh )
+{
+	if ( meshes.size () >= (1u << meshBits) )
+		fatal () << "RenderQueue: too many meshes" << Log::endl;
+
+	meshes.push_back ( mesh );
+
+	return (uint32_t) meshes.size () - 1;
+}
+
+uint32_t	RenderQueue :: addMaterial ( const glm::uvec4& textures )
+{
+	if ( materials.size () >= (1u << materialBits) )
+		fatal () << "RenderQueue: too many materials" << Log::endl;
+
+	materials.push_back ( textures );
+
+	return (uint32_t) materials.size () - 1;
+}
+
+uint32_t	RenderQueue :: addPipeline ( GraphicsPipeline& pipeline )
+{
+	if ( pipelines.size () >= (1u << pipelineBits) )
+		fatal () << "RenderQueue: too many pipelines" << Log::endl;
+
+	pipelines.push_back ( &pipeline );
+
+	return (uint32_t) pipelines.size () - 1;
+}
+
+void	RenderQueue :: clear ()
+{
+	packets.clear   ();
+	submitted.clear ();
+	instances.clear ();
+	batches.clear   ();
+
+	stats         = RenderQueueStats ();
+	unsortedStats = RenderQueueStats ();
+}
+
+uint64_t	RenderQueue :: makeKey ( uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depth )
+{
+	uint64_t	key = pass;
+
+	key = (key << pipelineBits) | pipeline;
+	key = (key << materialBits) | material;
+	key = (key << meshBits)     | mesh;
+	key = (key << depthBits)    | depth;
+
+	return key;
+}
+
+	// depth goes above material and mesh and is inverted to get back to front order
+uint64_t	RenderQueue :: makeTransparentKey ( uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depth )
+{
+	uint64_t	key = pass;
+
+	key = (key << pipelineBits) | pipeline;
+	key = (key << depthBits)    | ((1u << depthBits) - 1 - depth);
+	key = (key << materialBits) | material;
+	key = (key << meshBits)     | mesh;
+
+	return key;
+}
+
+uint32_t	RenderQueue :: quantizeDepth ( const glm::mat4& matrix, const RenderMesh& mesh ) const
+{
+	glm::vec4	c = matrix * glm::vec4 ( mesh.center, 1.0f );
+	float		d = glm::length ( glm::vec3 ( c ) - eye ) / maxDistance;
+
+	d = std::min ( std::max ( d, 0.0f ), 1.0f );
+
+	return uint32_t ( d * float ( (1u << depthBits) - 1 ) );
+}
+
+void	RenderQueue :: submit ( uint32_t mesh, uint32_t material, uint32_t pipeline, const glm::mat4& matrix, uint32_t pass, bool transparent )
+{
+	assert ( mesh < meshes.size () && material < materials.size () && pipeline < pipelines.size () && pass < (1u << passBits) );
+
+	uint32_t		depth = quantizeDepth ( matrix, meshes [mesh] );
+	const auto&		m     = materials [material];
+	DrawPacket		packet;
+
+	packet.key      = transparent ? makeTransparentKey ( pass, pipeline, material, mesh, depth ) : makeKey ( pass, pipeline, material, mesh, depth );
+	packet.pipeline = pipeline;
+	packet.material = material;
+	packet.mesh     = mesh;
+	packet.instance = (uint32_t) submitted.size ();
+
+	packets.push_back   ( packet );
+	submitted.push_back ( { matrix, m.x, m.y, m.z, m.w } );
+}
+
+void	RenderQueue :: radixSort ( std::vector<SortItem>& items, std::vector<SortItem>& temp )
+{
+	std::vector<size_t>	count ( 8 * 256, 0 );		// histograms of all bytes are built in single pass
+
+	temp.resize ( items.size () );
+
+	for ( auto& item : items )
+		for ( int b = 0; b < 8; b++ )
+			count [b * 256 + ((item.key >> (8 * b)) & 0xFF)]++;
+
+	for ( int b = 0; b < 8; b++ )
+	{
+		size_t	  * c     = &count [b * 256];
+		int			shift = 8 * b;
+
+		if ( items.empty () || c [(items [0].key >> shift) & 0xFF] == items.size () )		// all keys have the same byte
+			continue;
+
+		size_t	offs = 0;
+
+		for ( int i = 0; i < 256; i++ )
+		{
+			size_t	n = c [i];
+
+			c [i]  = offs;
+			offs  += n;
+		}
+
+		for ( auto& item : items )			// stable, so order by lower bytes is kept
+			temp [c [(item.key >> shift) & 0xFF]++] = item;
+
+		items.swap ( temp );
+	}
+}
+
+	// state changes needed to draw batch after prev
+void	RenderQueue :: countBatch ( RenderQueueStats& s, const DrawBatch& batch, const DrawBatch * prev ) const
+{
+	const RenderMesh&	mesh = meshes [batch.mesh];
+
+	s.draws++;
+
+	if ( prev == nullptr || prev->pipeline != batch.pipeline )
+		s.pipelineChanges++;
+
+	if ( prev == nullptr || prev->material != batch.material )
+		s.materialChanges++;
+
+	if ( prev == nullptr || meshes [prev->mesh].vertexBuffer != mesh.vertexBuffer )
+		s.bufferBinds++;
+
+	if ( prev == nullptr || meshes [prev->mesh].indexBuffer != mesh.indexBuffer || meshes [prev->mesh].indexType != mesh.indexType )
+		s.bufferBinds++;
+}
+
+void	RenderQueue :: build ()
+{
+	instances.clear ();
+	batches.clear   ();
+	items.resize    ( packets.size () );
+
+	stats         = RenderQueueStats ();
+	unsortedStats = RenderQueueStats ();
+
+	DrawBatch	prev = {};
+
+	for ( size_t i = 0; i < packets.size (); i++ )
+	{
+		const DrawPacket&	p     = packets [i];
+		DrawBatch			batch = { uint32_t ( p.key >> (64 - passBits) ), p.pipeline, p.material, p.mesh, (uint32_t) i, 1 };
+
+		countBatch ( unsortedStats, batch, i > 0 ? &prev : nullptr );
+
+		prev            = batch;
+		items [i].key   = p.key;
+		items [i].index = (uint32_t) i;
+	}
+
+	unsortedStats.packets = packets.size ();
+
+	radixSort ( items, tempItems );
+
+		// merge runs with the same pass and state into single draw
+	for ( auto& item : items )
+	{
+		const DrawPacket&	p    = packets [item.index];
+		uint32_t			pass = uint32_t ( p.key >> (64 - passBits) );
+
+		if ( batches.empty () || batches.back ().pass != pass || batches.back ().pipeline != p.pipeline ||
+			 batches.back ().material != p.material || batches.back ().mesh != p.mesh )
+		{
+			batches.push_back ( { pass, p.pipeline, p.material, p.mesh, (uint32_t) instances.size (), 0 } );
+
+			countBatch ( stats, batches.back (), batches.size () > 1 ? &batches [batches.size () - 2] : nullptr );
+		}
+
+		batches.back ().instanceCount++;
+		instances.push_back ( submitted [p.instance] );
+	}
+
+	stats.packets = packets.size ();
+}
+
+void	RenderQueue :: record ( CommandBuffer& cb, int pass )
+{
+	const DrawBatch	* prev = nullptr;
+
+	for ( auto& batch : batches )
+	{
+		if ( pass >= 0 && batch.pass != (uint32_t) pass )
+			continue;
+
+		const RenderMesh&	mesh     = meshes [batch.mesh];
+		const RenderMesh  * prevMesh = prev != nullptr ? &meshes [prev->mesh] : nullptr;
+
+		if ( prev == nullptr || prev->pipeline != batch.pipeline )
+			cb.pipeline ( *pipelines [batch.pipeline] );
+
+		if ( materialCallback && (prev == nullptr || prev->material != batch.material) )
+			materialCallback ( cb, batch.material );
+
+		if ( prevMesh == nullptr || prevMesh->vertexBuffer != mesh.vertexBuffer )
+			cb.bindVertexBuffers ( { { *mesh.vertexBuffer, 0 } } );
+
+		if ( prevMesh == nullptr || prevMesh->indexBuffer != mesh.indexBuffer || prevMesh->indexType != mesh.indexType )
+			cb.bindIndexBuffer ( *mesh.indexBuffer, mesh.indexType );
+
+		cb.drawIndexed ( mesh.indexCount, batch.instanceCount, mesh.firstIndex, mesh.vertexOffset, batch.firstInstance );
+
+		prev = &batch;
+	}
+}
@@ -0,0 +1,179 @@
+//
+// Render queue: draw packets with 64-bit sort keys (pass, pipeline, material, mesh, depth)
+// are radix sorted and runs with the same pipeline, material and mesh are merged into
+// instanced draws. Per-instance data is read in vertex shader from storage buffer
+// using gl_InstanceIndex, so only state changes between batches are recorded
+//
+
+#pragma once
+
+#include	<stdint.h>
+#include	<vector>
+#include	<functional>
+#include	<vulkan/vulkan.h>
+#include	<glm/glm.hpp>
+
+class	Buffer;
+class	CommandBuffer;
+class	GraphicsPipeline;
+
+	// range of indexed geometry, several meshes may share the same buffers
+struct	RenderMesh
+{
+	Buffer    * vertexBuffer = nullptr;
+	Buffer    * indexBuffer  = nullptr;
+	VkIndexType	indexType    = VK_INDEX_TYPE_UINT32;
+	uint32_t	firstIndex   = 0;
+	uint32_t	indexCount   = 0;
+	int32_t		vertexOffset = 0;
+	glm::vec3	center       = glm::vec3 ( 0 );		// in object space, gives depth of packet
+};
+
+	// per-instance data, same layout as PushConstants, std430 in shaders
+struct	InstanceData
+{
+	glm::mat4	matrix;
+	uint32_t	albedo, metallic, normal, roughness;	// material textures
+};
+
+struct	DrawPacket
+{
+	uint64_t	key;
+	uint32_t	pipeline, material, mesh;
+	uint32_t	instance;								// index in submitted instances
+};
+
+	// single instanced draw made from run of sorted packets
+struct	DrawBatch
+{
+	uint32_t	pass, pipeline, material, mesh;
+	uint32_t	firstInstance, instanceCount;
+};
+
+struct	RenderQueueStats
+{
+	size_t	packets         = 0;
+	size_t	draws           = 0;
+	size_t	pipelineChanges = 0;
+	size_t	materialChanges = 0;
+	size_t	bufferBinds     = 0;
+};
+
+class	RenderQueue
+{
+public:
+	enum		// key fields from low to high bits, opaque: depth | mesh | material | pipeline | pass
+	{
+		depthBits    = 20,
+		meshBits     = 16,
+		materialBits = 16,
+		pipelineBits = 8,
+		passBits     = 4
+	};
+
+	typedef std::function<void ( CommandBuffer&, uint32_t )>	MaterialCallback;
+
+	struct	SortItem
+	{
+		uint64_t	key;
+		uint32_t	index;			// of packet
+	};
+
+private:
+	std::vector<RenderMesh>			meshes;
+	std::vector<glm::uvec4>			materials;			// albedo, metallic, normal, roughness
+	std::vector<GraphicsPipeline *>	pipelines;
+	std::vector<DrawPacket>			packets;
+	std::vector<InstanceData>		submitted;			// in submission order
+	std::vector<InstanceData>		instances;			// in order of batches
+	std::vector<DrawBatch>			batches;
+	std::vector<SortItem>			items, tempItems;
+	MaterialCallback				materialCallback;
+	RenderQueueStats				stats;
+	RenderQueueStats				unsortedStats;
+	glm::vec3						eye         = glm::vec3 ( 0 );
+	float							maxDistance = 1000.0f;
+
+public:
+	RenderQueue () = default;
+
+		// registration, returned ids are used in submit
+	uint32_t	addMesh     ( const RenderMesh& mesh );
+	uint32_t	addMaterial ( const glm::uvec4& textures );
+	uint32_t	addPipeline ( GraphicsPipeline& pipeline );
+
+		// called when material changes during record, e.g. to bind per-material descriptor set
+	void	setMaterialCallback ( const MaterialCallback& callback )
+	{
+		materialCallback = callback;
+	}
+
+		// depth of packets is distance from eye divided by maxDistance
+	void	setCamera ( const glm::vec3& eyePos, float maxDist )
+	{
+		eye         = eyePos;
+		maxDistance = maxDist;
+	}
+
+		// remove packets, registered meshes, materials and pipelines are kept
+	void	clear ();
+
+		// opaque packets are sorted front to back inside run of the same state,
+		// transparent ones back to front before state, so they are merged only when adjacent
+	void	submit ( uint32_t mesh, uint32_t material, uint32_t pipeline, const glm::mat4& matrix, uint32_t pass = 0, bool transparent = false );
+
+		// sort packets, merge runs into batches and fill instance data for them
+	void	build ();
+
+		// record batches (of given pass or all if pass < 0), instance buffer and
+		// other descriptor sets must be bound already, pipelines must have compatible layouts
+	void	record ( CommandBuffer& cb, int pass = -1 );
+
+	static uint64_t	makeKey            ( uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depth );
+	static uint64_t	makeTransparentKey ( uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depth );
+
+		// LSD radix sort by 8 bits, passes where all keys have the same byte are skipped
+	static void		radixSort ( std::vector<SortItem>& items, std::vector<SortItem>& temp );
+
+	const std::vector<InstanceData>&	getInstances () const
+	{
+		return instances;
+	}
+
+	const std::vector<DrawBatch>&	getBatches () const
+	{
+		return batches;
+	}
+
+	const std::vector<DrawPacket>&	getPackets () const
+	{
+		return packets;
+	}
+
+	size_t	packetCount () const
+	{
+		return packets.size ();
+	}
+
+		// size of instance buffer for current packets
+	size_t	instanceDataSize () const
+	{
+		return instances.size () * sizeof ( InstanceData );
+	}
+
+		// state changes and draws of built queue
+	const RenderQueueStats&	getStats () const
+	{
+		return stats;
+	}
+
+		// the same packets drawn one by one in submission order
+	const RenderQueueStats&	getUnsortedStats () const
+	{
+		return unsortedStats;
+	}
+
+private:
+	uint32_t	quantizeDepth ( const glm::mat4& matrix, const RenderMesh& mesh ) const;
+	void		countBatch    ( RenderQueueStats& s, const DrawBatch& batch, const DrawBatch * prev ) const;
+};
@@ -0,0 +1,469 @@
+//
+// CPU occlusion culling with masked software depth buffer
+//
+
+#include	<assert.h>
+#include	<math.h>
+#include	<float.h>
+#include	<thread>
+#include	<algorithm>
+#include	"SoftwareOcclusion.h"
+
+#if defined(__AVX__)
+	#include	<immintrin.h>
+	#define	OCC_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include	<emmintrin.h>
+	#define	OCC_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	#include	<arm_neon.h>
+	#define	OCC_NEON
+#endif
+
+enum
+{
+	minBoxesPerThread = 4 * 1024		// smaller batches are not worth starting a thread
+};
+
+	// run func ( index ) on numThreads threads, including the calling one
+template <typename Func>
+static void	runThreads ( unsigned numThreads, Func func )
+{
+	std::vector<std::thread>	threads;
+
+	for ( unsigned i = 1; i < numThreads; i++ )
+		threads.emplace_back ( func, i );
+
+	func ( 0 );
+
+	for ( auto& t : threads )
+		t.join ();
+}
+
+static unsigned	threadCount ( unsigned numThreads )
+{
+	return numThreads == 0 ? std::max ( 1u, std::thread::hardware_concurrency () ) : numThreads;
+}
+
+	// coverage of one 8 pixel row: bit i is set when center of pixel i is inside all edges,
+	// e0, e1, e2 - edge functions at the first pixel, a0, a1, a2 - their x steps
+static inline uint32_t	rowCoverage ( float e0, float e1, float e2, float a0, float a1, float a2 )
+{
+#if defined(OCC_AVX)
+	const __m256	steps = _mm256_setr_ps ( 0, 1, 2, 3, 4, 5, 6, 7 );
+	const __m256	zero  = _mm256_setzero_ps ();
+	__m256			v0    = _mm256_add_ps ( _mm256_set1_ps ( e0 ), _mm256_mul_ps ( _mm256_set1_ps ( a0 ), steps ) );
+	__m256			v1    = _mm256_add_ps ( _mm256_set1_ps ( e1 ), _mm256_mul_ps ( _mm256_set1_ps ( a1 ), steps ) );
+	__m256			v2    = _mm256_add_ps ( _mm256_set1_ps ( e2 ), _mm256_mul_ps ( _mm256_set1_ps ( a2 ), steps ) );
+	__m256			in    = _mm256_and_ps ( _mm256_and_ps ( _mm256_cmp_ps ( v0, zero, _CMP_GT_OQ ), _mm256_cmp_ps ( v1, zero, _CMP_GT_OQ ) ), _mm256_cmp_ps ( v2, zero, _CMP_GT_OQ ) );
+
+	return (uint32_t) _mm256_movemask_ps ( in );
+#elif defined(OCC_SSE)
+	const __m128	steps = _mm_setr_ps ( 0, 1, 2, 3 );
+	const __m128	zero  = _mm_setzero_ps ();
+	__m128			s0    = _mm_mul_ps ( _mm_set1_ps ( a0 ), steps );
+	__m128			s1    = _mm_mul_ps ( _mm_set1_ps ( a1 ), steps );
+	__m128			s2    = _mm_mul_ps ( _mm_set1_ps ( a2 ), steps );
+	uint32_t		bits  = 0;
+
+	for ( int half = 0; half < 2; half++ )
+	{
+		__m128	v0 = _mm_add_ps ( _mm_set1_ps ( e0 + 4 * half * a0 ), s0 );
+		__m128	v1 = _mm_add_ps ( _mm_set1_ps ( e1 + 4 * half * a1 ), s1 );
+		__m128	v2 = _mm_add_ps ( _mm_set1_ps ( e2 + 4 * half * a2 ), s2 );
+		__m128	in = _mm_and_ps ( _mm_and_ps ( _mm_cmpgt_ps ( v0, zero ), _mm_cmpgt_ps ( v1, zero ) ), _mm_cmpgt_ps ( v2, zero ) );
+
+		bits |= (uint32_t) _mm_movemask_ps ( in ) << (4 * half);
+	}
+
+	return bits;
+#elif defined(OCC_NEON)
+	static const float		stepData [4] = { 0, 1, 2, 3 };
+	static const uint32_t	bitData  [4] = { 1, 2, 4, 8 };
+	const float32x4_t		steps = vld1q_f32 ( stepData );
+	const uint32x4_t		bit   = vld1q_u32 ( bitData );
+	const float32x4_t		zero  = vdupq_n_f32 ( 0 );
+	uint32_t				bits  = 0;
+
+	for ( int half = 0; half < 2; half++ )
+	{
+		float32x4_t	v0 = vmlaq_n_f32 ( vdupq_n_f32 ( e0 + 4 * half * a0 ), steps, a0 );
+		float32x4_t	v1 = vmlaq_n_f32 ( vdupq_n_f32 ( e1 + 4 * half * a1 ), steps, a1 );
+		float32x4_t	v2 = vmlaq_n_f32 ( vdupq_n_f32 ( e2 + 4 * half * a2 ), steps, a2 );
+		uint32x4_t	in = vandq_u32 ( vandq_u32 ( vcgtq_f32 ( v0, zero ), vcgtq_f32 ( v1, zero ) ), vcgtq_f32 ( v2, zero ) );
+
+		bits |= vaddvq_u32 ( vandq_u32 ( in, bit ) ) << (4 * half);
+	}
+
+	return bits;
+#else
+	uint32_t	bits = 0;
+
+	for ( int i = 0; i < 8; i++ )
+		if ( e0 + i * a0 > 0 && e1 + i * a1 > 0 && e2 + i * a2 > 0 )
+			bits |= 1u << i;
+
+	return bits;
+#endif
+}
+
+	// merge triangle covering cov pixels of tile with farthest depth z into tile
+static inline void	updateTile ( SoftwareOcclusion::Tile& tile, uint32_t cov, float z )
+{
+	if ( cov == 0 || z >= tile.zMax1 )
+		return;
+
+	if ( cov == ~0u )					// whole tile is covered, working layer may become useless
+	{
+		tile.zMax1 = z;
+
+		if ( tile.zMax0 >= tile.zMax1 )
+		{
+			tile.mask  = 0;
+			tile.zMax0 = 0;
+		}
+
+		return;
+	}
+
+		// triangle is much farther than working layer, merging would make it useless: start a new one
+	if ( tile.mask != 0 && z - tile.zMax0 > tile.zMax1 - z )
+	{
+		tile.mask  = 0;
+		tile.zMax0 = 0;
+	}
+
+	tile.mask  |= cov;
+	tile.zMax0  = std::max ( tile.zMax0, z );
+
+	if ( tile.mask == ~0u )				// working layer covers the tile
+	{
+		tile.zMax1 = std::min ( tile.zMax1, tile.zMax0 );
+		tile.mask  = 0;
+		tile.zMax0 = 0;
+	}
+}
+
+void	SoftwareOcclusion :: setResolution ( int w, int h )
+{
+	tilesX = (w + tileWidth  - 1) / tileWidth;
+	tilesY = (h + tileHeight - 1) / tileHeight;
+	width  = tilesX * tileWidth;
+	height = tilesY * tileHeight;
+
+	tiles.resize ( tilesX * tilesY );
+}
+
+void	SoftwareOcclusion :: begin ( const glm::mat4& matrix )
+{
+	viewProj = matrix;
+
+	occluders.clear ();
+	std::fill ( tiles.begin (), tiles.end (), Tile { 0, 0.0f, 1.0f } );
+}
+
+void	SoftwareOcclusion :: addOccluder ( const glm::vec3 * positions, size_t stride, const uint32_t * indices, size_t numTriangles, const glm::mat4& model )
+{
+	occluders.push_back ( { (const uint8_t *) positions, stride, indices, numTriangles, viewProj * model } );
+}
+
+size_t	SoftwareOcclusion :: triangleCount () const
+{
+	size_t	n = 0;
+
+	for ( auto& list : triangles )
+		n += list.size ();
+
+	return n;
+}
+
+void	SoftwareOcclusion :: setupTriangles ( const Occluder& occluder, std::vector<Triangle>& result ) const
+{
+	uint32_t	maxIndex = 0;
+
+	for ( size_t i = 0; i < 3 * occluder.numTriangles; i++ )
+		maxIndex = std::max ( maxIndex, occluder.indices [i] );
+
+	std::vector<glm::vec4>	clip ( maxIndex + 1 );
+
+	for ( uint32_t i = 0; i <= maxIndex; i++ )
+		clip [i] = occluder.matrix * glm::vec4 ( *(const glm::vec3 *)(occluder.positions + i * occluder.stride), 1.0f );
+
+	auto	emit = [&] ( const glm::vec4& p0, const glm::vec4& p1, const glm::vec4& p2 )
+	{
+		Triangle	tri;
+		const glm::vec4 * p [3] = { &p0, &p1, &p2 };
+
+		for ( int k = 0; k < 3; k++ )
+		{
+			float	invW = 1.0f / p [k]->w;
+
+			tri.x [k] = (p [k]->x * invW * 0.5f + 0.5f) * width;
+			tri.y [k] = (p [k]->y * invW * 0.5f + 0.5f) * height;
+			tri.z [k] = p [k]->z * invW;
+		}
+
+		float	area = (tri.x [1] - tri.x [0]) * (tri.y [2] - tri.y [0]) - (tri.x [2] - tri.x [0]) * (tri.y [1] - tri.y [0]);
+
+		if ( fabsf ( area ) < 1e-6f )
+			return;
+
+		if ( area < 0 )					// make counter-clockwise
+		{
+			std::swap ( tri.x [1], tri.x [2] );
+			std::swap ( tri.y [1], tri.y [2] );
+			std::swap ( tri.z [1], tri.z [2] );
+		}
+
+			// outside of the screen
+		if ( std::max ( tri.x [0], std::max ( tri.x [1], tri.x [2] ) ) < 0 || std::min ( tri.x [0], std::min ( tri.x [1], tri.x [2] ) ) > width  ||
+			 std::max ( tri.y [0], std::max ( tri.y [1], tri.y [2] ) ) < 0 || std::min ( tri.y [0], std::min ( tri.y [1], tri.y [2] ) ) > height )
+			return;
+
+		result.push_back ( tri );
+	};
+
+	for ( size_t i = 0; i < occluder.numTriangles; i++ )
+	{
+		const glm::vec4&	v0 = clip [occluder.indices [3*i]];
+		const glm::vec4&	v1 = clip [occluder.indices [3*i + 1]];
+		const glm::vec4&	v2 = clip [occluder.indices [3*i + 2]];
+		int					in = (v0.z >= 0 ? 1 : 0) + (v1.z >= 0 ? 1 : 0) + (v2.z >= 0 ? 1 : 0);
+
+		if ( in == 3 )
+		{
+			emit ( v0, v1, v2 );
+			continue;
+		}
+
+		if ( in == 0 )
+			continue;
+
+			// clip polygon by near plane z = 0
+		const glm::vec4 * src [3] = { &v0, &v1, &v2 };
+		glm::vec4		  poly [4];
+		int				  count = 0;
+
+		for ( int k = 0; k < 3; k++ )
+		{
+			const glm::vec4&	a = *src [k];
+			const glm::vec4&	b = *src [(k + 1) % 3];
+
+			if ( a.z >= 0 )
+				poly [count++] = a;
+
+			if ( (a.z >= 0) != (b.z >= 0) )
+				poly [count++] = a + (b - a) * (a.z / (a.z - b.z));
+		}
+
+		for ( int k = 2; k < count; k++ )
+			emit ( poly [0], poly [k - 1], poly [k] );
+	}
+}
+
+void	SoftwareOcclusion :: rasterizeTriangle ( const Triangle& tri, int firstRow, int lastRow )
+{
+	float	minX = std::min ( tri.x [0], std::min ( tri.x [1], tri.x [2] ) );
+	float	maxX = std::max ( tri.x [0], std::max ( tri.x [1], tri.x [2] ) );
+	float	minY = std::min ( tri.y [0], std::min ( tri.y [1], tri.y [2] ) );
+	float	maxY = std::max ( tri.y [0], std::max ( tri.y [1], tri.y [2] ) );
+	int		tx0  = std::max ( 0,          int ( minX ) / tileWidth );
+	int		tx1  = std::min ( tilesX - 1, int ( maxX ) / tileWidth );
+	int		ty0  = std::max ( firstRow,   int ( minY ) / tileHeight );
+	int		ty1  = std::min ( lastRow - 1, int ( maxY ) / tileHeight );
+
+	if ( minX < 0 )
+		tx0 = 0;
+
+	if ( minY < 0 )
+		ty0 = firstRow;
+
+	if ( tx0 > tx1 || ty0 > ty1 )
+		return;
+
+		// edge functions a*x + b*y + c, positive inside
+	float	a [3], b [3], c [3];
+
+	for ( int k = 0; k < 3; k++ )
+	{
+		int	n = (k + 1) % 3;
+
+		a [k] = tri.y [k] - tri.y [n];
+		b [k] = tri.x [n] - tri.x [k];
+		c [k] = -(a [k] * tri.x [k] + b [k] * tri.y [k]);
+	}
+
+		// depth plane z = dzdx * x + dzdy * y + z0
+	float	det  = (tri.x [1] - tri.x [0]) * (tri.y [2] - tri.y [0]) - (tri.x [2] - tri.x [0]) * (tri.y [1] - tri.y [0]);
+	float	dzdx = ((tri.z [1] - tri.z [0]) * (tri.y [2] - tri.y [0]) - (tri.z [2] - tri.z [0]) * (tri.y [1] - tri.y [0])) / det;
+	float	dzdy = ((tri.z [2] - tri.z [0]) * (tri.x [1] - tri.x [0]) - (tri.z [1] - tri.z [0]) * (tri.x [2] - tri.x [0])) / det;
+	float	z0   = tri.z [0] - dzdx * tri.x [0] - dzdy * tri.y [0];
+	float	zMax = std::max ( tri.z [0], std::max ( tri.z [1], tri.z [2] ) );
+
+	for ( int ty = ty0; ty <= ty1; ty++ )
+	{
+		float	y0 = ty * tileHeight + 0.5f;					// centers of the first and last pixel rows
+		float	y1 = y0 + tileHeight - 1;
+
+		for ( int tx = tx0; tx <= tx1; tx++ )
+		{
+			float		x0    = tx * tileWidth + 0.5f;
+			float		x1    = x0 + tileWidth - 1;
+			bool		full  = true;
+			bool		empty = false;
+			float		e [3];
+
+			for ( int k = 0; k < 3 && !empty; k++ )
+			{
+				float	e00 = a [k] * x0 + b [k] * y0 + c [k];
+				float	e10 = e00 + a [k] * (tileWidth  - 1);
+				float	e01 = e00 + b [k] * (tileHeight - 1);
+				float	e11 = e10 + b [k] * (tileHeight - 1);
+
+				e [k] = e00;
+
+				if ( e00 <= 0 && e10 <= 0 && e01 <= 0 && e11 <= 0 )
+					empty = true;
+				else
+				if ( e00 <= 0 || e10 <= 0 || e01 <= 0 || e11 <= 0 )
+					full = false;
+			}
+
+			if ( empty )
+				continue;
+
+			uint32_t	cov = ~0u;
+
+			if ( !full )
+			{
+				cov = 0;
+
+				for ( int row = 0; row < tileHeight; row++ )
+					cov |= rowCoverage ( e [0] + row * b [0], e [1] + row * b [1], e [2] + row * b [2], a [0], a [1], a [2] ) << (row * tileWidth);
+			}
+
+				// plane is linear, so its farthest value over tile is at one of corners
+			float	zc = std::max ( std::max ( dzdx * x0 + dzdy * y0, dzdx * x1 + dzdy * y0 ), std::max ( dzdx * x0 + dzdy * y1, dzdx * x1 + dzdy * y1 ) ) + z0;
+
+			updateTile ( tiles [ty * tilesX + tx], cov, std::min ( zMax, zc ) );
+		}
+	}
+}
+
+void	SoftwareOcclusion :: rasterizeRows ( int firstRow, int lastRow )
+{
+	float	top    = float ( firstRow * tileHeight );
+	float	bottom = float ( lastRow  * tileHeight );
+
+	for ( auto& list : triangles )
+		for ( auto& tri : list )
+			if ( std::max ( tri.y [0], std::max ( tri.y [1], tri.y [2] ) ) >= top && std::min ( tri.y [0], std::min ( tri.y [1], tri.y [2] ) ) < bottom )
+				rasterizeTriangle ( tri, firstRow, lastRow );
+}
+
+void	SoftwareOcclusion :: rasterize ( unsigned numThreads )
+{
+	numThreads = std::min ( threadCount ( numThreads ), (unsigned) tilesY );
+
+		// transform and clip triangles, occluders are distributed between threads
+	triangles.resize ( numThreads );
+
+	for ( auto& list : triangles )
+		list.clear ();
+
+	runThreads ( numThreads, [&] ( unsigned t )
+	{
+		for ( size_t i = t; i < occluders.size (); i += numThreads )
+			setupTriangles ( occluders [i], triangles [t] );
+	} );
+
+		// every thread rasterizes all triangles into its own band of tile rows
+	runThreads ( numThreads, [&] ( unsigned t )
+	{
+		rasterizeRows ( tilesY * t / numThreads, tilesY * (t + 1) / numThreads );
+	} );
+}
+
+bool	SoftwareOcclusion :: testBox ( const bbox& box, const glm::mat4& matrix ) const
+{
+	float		minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float		zMin   = 1;
+	int			behind = 0;
+	glm::vec4	p [8];
+
+	for ( int i = 0; i < 8; i++ )
+	{
+		p [i] = matrix * glm::vec4 ( box.getVertex ( i ), 1.0f );
+
+		if ( p [i].z < 0 )
+			behind++;
+	}
+
+	if ( behind == 8 )				// whole box is before near plane
+		return false;
+
+	if ( behind > 0 )				// crosses near plane, cannot be tested
+		return true;
+
+	for ( int i = 0; i < 8; i++ )
+	{
+		float	invW = 1.0f / p [i].w;
+		float	x    = (p [i].x * invW * 0.5f + 0.5f) * width;
+		float	y    = (p [i].y * invW * 0.5f + 0.5f) * height;
+
+		minX = std::min ( minX, x );
+		maxX = std::max ( maxX, x );
+		minY = std::min ( minY, y );
+		maxY = std::max ( maxY, y );
+		zMin = std::min ( zMin, p [i].z * invW );
+	}
+
+	if ( maxX < 0 || maxY < 0 || minX > width || minY > height || zMin > 1 )
+		return false;
+
+	int	tx0 = std::max ( 0,          int ( std::max ( minX, 0.0f ) ) / tileWidth  );
+	int	tx1 = std::min ( tilesX - 1, int ( std::min ( maxX, float ( width  ) ) ) / tileWidth  );
+	int	ty0 = std::max ( 0,          int ( std::max ( minY, 0.0f ) ) / tileHeight );
+	int	ty1 = std::min ( tilesY - 1, int ( std::min ( maxY, float ( height ) ) ) / tileHeight );
+
+	for ( int ty = ty0; ty <= ty1; ty++ )
+		for ( int tx = tx0; tx <= tx1; tx++ )
+			if ( zMin < tiles [ty * tilesX + tx].zMax1 )
+				return true;
+
+	return false;
+}
+
+void	SoftwareOcclusion :: testBoxes ( const std::vector<bbox>& boxes, VisibilityMask& mask, unsigned numThreads ) const
+{
+	mask.resize ( boxes.size () );
+
+	size_t		words = (boxes.size () + 63) / 64;
+	uint64_t  * bits  = mask.data ();
+
+	numThreads = (unsigned) std::min<size_t> ( threadCount ( numThreads ), (boxes.size () + minBoxesPerThread - 1) / minBoxesPerThread );
+	numThreads = std::max ( numThreads, 1u );
+
+		// every thread gets whole words of mask
+	runThreads ( numThreads, [&] ( unsigned t )
+	{
+		size_t	last = std::min ( words * (t + 1) / numThreads * 64, boxes.size () );
+
+		for ( size_t i = words * t / numThreads * 64; i < last; i++ )
+			if ( isVisible ( boxes [i] ) )
+				bits [i >> 6] |= uint64_t ( 1 ) << (i & 63);
+	} );
+}
+
+const char *	SoftwareOcclusion :: simdName ()
+{
+#if defined(OCC_AVX)
+	return "AVX";
+#elif defined(OCC_SSE)
+	return "SSE2";
+#elif defined(OCC_NEON)
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,125 @@
+//
+// CPU occlusion culling with masked software depth buffer.
+// Occluder triangles are rasterized into low resolution buffer of 8x4 pixel tiles,
+// every tile keeps 32-bit coverage mask of working layer with its farthest depth and
+// conservative farthest depth of the whole tile (masked hierarchical depth), coverage
+// is computed for a row of pixels at once with SIMD. Rows of tiles are split across threads.
+// Boxes are tested by their nearest depth against farthest tile depth over screen footprint.
+// No GPU is required, depth is in [0,1] range with 0 at near plane
+//
+
+#pragma once
+
+#include	<stdint.h>
+#include	<vector>
+#include	<glm/glm.hpp>
+#include	"bbox.h"
+#include	"BatchCulling.h"
+
+class	SoftwareOcclusion
+{
+public:
+	enum
+	{
+		tileWidth  = 8,
+		tileHeight = 4
+	};
+
+	struct	Tile
+	{
+		uint32_t	mask;			// pixels covered by working layer
+		float		zMax0;			// farthest depth of working layer
+		float		zMax1;			// farthest depth of the whole tile
+	};
+
+private:
+	struct	Occluder				// referenced data must live until rasterize
+	{
+		const uint8_t  * positions;
+		size_t			 stride;
+		const uint32_t * indices;
+		size_t			 numTriangles;
+		glm::mat4		 matrix;
+	};
+
+	struct	Triangle				// screen space x, y and depth, counter-clockwise
+	{
+		float	x [3], y [3], z [3];
+	};
+
+	int						width  = 0;
+	int						height = 0;
+	int						tilesX = 0;
+	int						tilesY = 0;
+	std::vector<Tile>		tiles;
+	std::vector<Occluder>	occluders;
+	std::vector<std::vector<Triangle>>	triangles;		// per setup thread
+	glm::mat4				viewProj = glm::mat4 ( 1 );
+
+public:
+	SoftwareOcclusion ( int w = 256, int h = 128 )
+	{
+		setResolution ( w, h );
+	}
+
+		// size is rounded up to whole tiles
+	void	setResolution ( int w, int h );
+
+	int	getWidth () const
+	{
+		return width;
+	}
+
+	int	getHeight () const
+	{
+		return height;
+	}
+
+	const std::vector<Tile>&	getTiles () const
+	{
+		return tiles;
+	}
+
+		// start new frame: clear depth and occluder list
+	void	begin ( const glm::mat4& matrix );
+
+		// triangle list, positions are read with given stride (e.g. sizeof ( BasicVertex ))
+	void	addOccluder ( const glm::vec3 * positions, size_t stride, const uint32_t * indices, size_t numTriangles, const glm::mat4& model = glm::mat4 ( 1 ) );
+
+		// vertices of any type with pos member, e.g. data used to create Mesh or Model
+	template <typename Vertex>
+	void	addOccluder ( const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const glm::mat4& model = glm::mat4 ( 1 ) )
+	{
+		if ( !vertices.empty () )
+			addOccluder ( &vertices [0].pos, sizeof ( Vertex ), indices.data (), indices.size () / 3, model );
+	}
+
+		// rasterize all added occluders, numThreads = 0 - use all hardware threads
+	void	rasterize ( unsigned numThreads = 0 );
+
+		// number of triangles rasterized by the last rasterize (after near plane clipping)
+	size_t	triangleCount () const;
+
+		// box may be visible (not occluded and not outside of the screen)
+	bool	isVisible ( const bbox& box ) const
+	{
+		return testBox ( box, viewProj );
+	}
+
+	bool	isVisible ( const bbox& box, const glm::mat4& model ) const
+	{
+		return testBox ( box, viewProj * model );
+	}
+
+		// test all boxes, mask is resized
+	void	testBoxes ( const std::vector<bbox>& boxes, VisibilityMask& mask, unsigned numThreads = 1 ) const;
+
+		// instruction set selected at compile time
+	static	const char *	simdName ();
+
+private:
+	bool	testBox          ( const bbox& box, const glm::mat4& matrix ) const;
+	void	setupTriangles   ( const Occluder& occluder, std::vector<Triangle>& result ) const;
+	void	rasterizeRows    ( int firstRow, int lastRow );
+	void	rasterizeTriangle( const Triangle& tri, int firstRow, int lastRow );
+};
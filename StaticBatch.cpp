@@ -0,0 +1,258 @@
+//
+// Static batching: Morton ordering, packing into batches, upload, culling and picking
+//
+
+#include	<assert.h>
+#include	<string.h>
+#include	<algorithm>
+#include	"StaticBatch.h"
+#include	"SingleTimeCommand.h"
+#include	"CommandBuffer.h"
+#include	"Frustum.h"
+#include	"MeshOptimizer.h"
+#include	"Log.h"
+
+	// spread 10 low bits so there are two zero bits between them
+static uint32_t	expandBits ( uint32_t v )
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+
+	return v;
+}
+
+	// 30-bit Morton code of point inside box
+static uint32_t	mortonCode ( const glm::vec3& p, const bbox& box )
+{
+	glm::vec3	size = glm::max ( box.getSize (), glm::vec3 ( 1e-6f ) );
+	glm::vec3	t    = glm::clamp ( (p - box.getMinPoint ()) / size, 0.0f, 1.0f ) * 1023.0f;
+
+	return (expandBits ( (uint32_t) t.x ) << 2) | (expandBits ( (uint32_t) t.y ) << 1) | expandBits ( (uint32_t) t.z );
+}
+
+static void	uploadBuffer ( Device& device, Buffer& buffer, const void * data, size_t size, uint32_t usage )
+{
+	Buffer				stagingBuffer;
+	SingleTimeCommand	cmd ( device );
+
+		// use staging buffer to copy data to GPU-local memory
+	stagingBuffer.create ( device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, Buffer::hostWrite );
+	stagingBuffer.copy   ( data, size );
+	buffer.create        ( device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, 0 );
+	buffer.copyBuffer    ( cmd, stagingBuffer, size );
+}
+
+StaticBatcher&	StaticBatcher :: addTransformed ( const void * vertices, size_t size, size_t numVertices, const uint32_t * indices, size_t numTriangles, const bbox& bounds, uint32_t material, uint32_t id )
+{
+	if ( vertexSize == 0 )
+		vertexSize = size;
+	else if ( vertexSize != size )
+		fatal () << "StaticBatcher: all objects must have the same vertex format" << Log::endl;
+
+	Source	src;
+
+	src.material    = material;
+	src.id          = id;
+	src.firstVertex = vertexData.size () / vertexSize;
+	src.numVertices = numVertices;
+	src.firstIndex  = indexData.size ();
+	src.numIndices  = 3 * numTriangles;
+	src.bounds      = bounds;
+
+	vertexData.insert ( vertexData.end (), (const uint8_t *) vertices, (const uint8_t *) vertices + numVertices * size );
+	indexData.insert  ( indexData.end  (), indices, indices + 3 * numTriangles );
+	sources.push_back ( src );
+
+	return *this;
+}
+
+bool	StaticBatcher :: create ( Device& device, uint32_t maxVertices )
+{
+	if ( sources.empty () )
+		return false;
+
+	bbox					sceneBox;
+	std::vector<uint32_t>	codes ( sources.size () );
+	std::vector<uint32_t>	order ( sources.size () );
+
+	for ( auto& src : sources )
+		sceneBox.merge ( src.bounds );
+
+	for ( size_t i = 0; i < sources.size (); i++ )
+	{
+		codes [i] = mortonCode ( sources [i].bounds.getCenter (), sceneBox );
+		order [i] = (uint32_t) i;
+	}
+
+		// by material, then along Morton curve so neighbours end up in the same batch
+	std::sort ( order.begin (), order.end (), [&] ( uint32_t a, uint32_t b )
+	{
+		if ( sources [a].material != sources [b].material )
+			return sources [a].material < sources [b].material;
+
+		return codes [a] < codes [b];
+	} );
+
+	std::vector<uint8_t>	vertices;
+	std::vector<uint32_t>	indices;			// relative to vertexOffset of batch
+	uint32_t				maxBatchVertices = 0;
+
+	batches.clear   ();
+	instances.clear ();
+	materials.clear ();
+
+	vertices.reserve ( vertexData.size () );
+	indices.reserve  ( indexData.size  () );
+
+	for ( uint32_t k : order )
+	{
+		const Source&	src = sources [k];
+
+			// start new batch when material changes or batch is full, large objects get batch of their own
+		if ( batches.empty () || batches.back ().material != src.material || batches.back ().vertexCount + src.numVertices > maxVertices )
+		{
+			StaticBatch	batch;
+
+			batch.material      = src.material;
+			batch.firstIndex    = (uint32_t) indices.size ();
+			batch.vertexOffset  = (int32_t) (vertices.size () / vertexSize);
+			batch.firstInstance = (uint32_t) instances.size ();
+
+			if ( materials.empty () || materials.back ().material != src.material )
+				materials.push_back ( { src.material, (uint32_t) batches.size (), 0 } );
+
+			materials.back ().batchCount++;
+			batches.push_back ( batch );
+		}
+
+		StaticBatch&	batch = batches.back ();
+		StaticInstance	inst;
+
+		inst.id         = src.id;
+		inst.firstIndex = (uint32_t) indices.size ();
+		inst.indexCount = (uint32_t) src.numIndices;
+		inst.bounds     = src.bounds;
+
+		for ( size_t i = 0; i < src.numIndices; i++ )
+			indices.push_back ( batch.vertexCount + indexData [src.firstIndex + i] );
+
+		vertices.insert ( vertices.end (), vertexData.begin () + src.firstVertex * vertexSize, vertexData.begin () + (src.firstVertex + src.numVertices) * vertexSize );
+
+		batch.vertexCount   += (uint32_t) src.numVertices;
+		batch.indexCount    += (uint32_t) src.numIndices;
+		batch.instanceCount++;
+		batch.bounds.merge ( src.bounds );
+		instances.push_back ( inst );
+
+		maxBatchVertices = std::max ( maxBatchVertices, batch.vertexCount );
+	}
+
+	std::vector<bbox>	boxes;
+
+	for ( auto& inst : instances )
+		boxes.push_back ( inst.bounds );
+
+	instanceTree.build ( boxes );
+
+	uploadBuffer ( device, vertexBuf, vertices.data (), vertices.size (), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT );
+
+	indexType = MeshOptimizer::fits16Bit ( maxBatchVertices ) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+	if ( indexType == VK_INDEX_TYPE_UINT16 )
+	{
+		std::vector<uint16_t>	shortIndices = MeshOptimizer::to16Bit ( indices );
+
+		uploadBuffer ( device, indexBuf, shortIndices.data (), shortIndices.size () * sizeof ( uint16_t ), VK_BUFFER_USAGE_INDEX_BUFFER_BIT );
+	}
+	else
+		uploadBuffer ( device, indexBuf, indices.data (), indices.size () * sizeof ( uint32_t ), VK_BUFFER_USAGE_INDEX_BUFFER_BIT );
+
+	log () << "StaticBatcher: " << instances.size () << " objects, " << materials.size () << " materials -> " << batches.size () << " batches, "
+		   << (indexType == VK_INDEX_TYPE_UINT16 ? 16 : 32) << "-bit indices" << Log::endl;
+
+		// source data is not needed any more
+	vertexData = std::vector<uint8_t>  ();
+	indexData  = std::vector<uint32_t> ();
+	sources    = std::vector<Source>   ();
+
+	return true;
+}
+
+void	StaticBatcher :: clean ()
+{
+	vertexBuf.clean ();
+	indexBuf.clean  ();
+	vertexData.clear ();
+	indexData.clear  ();
+	sources.clear    ();
+	batches.clear    ();
+	instances.clear  ();
+	materials.clear  ();
+	instanceTree.clear ();
+
+	vertexSize = 0;
+}
+
+void	StaticBatcher :: bindBuffers ( CommandBuffer& cb )
+{
+	cb.bindVertexBuffers ( {{ vertexBuf, 0 }} );
+	cb.bindIndexBuffer   ( indexBuf, indexType );
+}
+
+void	StaticBatcher :: renderBatch ( CommandBuffer& cb, uint32_t batch ) const
+{
+	const StaticBatch&	b = batches [batch];
+
+	cb.drawIndexed ( b.indexCount, 1, b.firstIndex, b.vertexOffset, 0 );
+}
+
+uint32_t	StaticBatcher :: writeCommands ( VkDrawIndexedIndirectCommand * commands, Frustum& frustum ) const
+{
+	uint32_t	visible = 0;
+
+	for ( size_t i = 0; i < batches.size (); i++ )
+	{
+		const StaticBatch&	b        = batches [i];
+		bool				isInside = frustum.checkSphere ( b.bounds.getCenter (), 0.5f * glm::length ( b.bounds.getSize () ) );
+
+		commands [i] = { b.indexCount, isInside ? 1u : 0u, b.firstIndex, b.vertexOffset, 0 };
+
+		if ( isInside )
+			visible++;
+	}
+
+	return visible;
+}
+
+int	StaticBatcher :: findInstance ( uint32_t batch, uint32_t triangle ) const
+{
+	if ( batch >= batches.size () )
+		return -1;
+
+	const StaticBatch&	b     = batches [batch];
+	uint32_t			index = b.firstIndex + 3 * triangle;
+	auto				first = instances.begin () + b.firstInstance;
+	auto				last  = first + b.instanceCount;
+
+		// last instance starting at or before index
+	auto	it = std::upper_bound ( first, last, index, [] ( uint32_t i, const StaticInstance& inst ) { return i < inst.firstIndex; } );
+
+	if ( it == first )
+		return -1;
+
+	--it;
+
+	return index < it->firstIndex + it->indexCount ? (int) it->id : -1;
+}
+
+int	StaticBatcher :: pick ( const ray& r, float& t ) const
+{
+	uint32_t	object;
+
+	if ( instanceTree.isEmpty () || !instanceTree.raycast ( r, object, t ) )
+		return -1;
+
+	return (int) instances [object].id;
+}
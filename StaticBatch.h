@@ -0,0 +1,155 @@
+//
+// Static batching: many small static meshes are pre-transformed to world space and merged
+// by material into shared vertex and index buffers, so static scenery is drawn with a few
+// draws instead of one per object. Objects of every material are ordered along Morton curve
+// and packed into spatially compact batches of at most 64k vertices, batches have bounds
+// for culling and use 16-bit indices relative to their vertexOffset. Index ranges of
+// original objects are kept in every batch to map triangles back to them, and BVH over
+// their bounds is used for ray picking
+//
+
+#pragma once
+
+#include	<stdint.h>
+#include	<vector>
+#include	<glm/glm.hpp>
+#include	<glm/gtc/matrix_inverse.hpp>
+#include	<vulkan/vulkan.h>
+#include	"Buffer.h"
+#include	"bbox.h"
+#include	"Bvh.h"
+
+class	CommandBuffer;
+class	Frustum;
+
+	// merged geometry of one material, ranges are in StaticBatcher's buffers
+struct	StaticBatch
+{
+	uint32_t	material      = 0;
+	uint32_t	firstIndex    = 0;
+	uint32_t	indexCount    = 0;
+	int32_t		vertexOffset  = 0;
+	uint32_t	vertexCount   = 0;
+	uint32_t	firstInstance = 0;				// range in getInstances ()
+	uint32_t	instanceCount = 0;
+	bbox		bounds;							// world space
+};
+
+	// original object inside batch
+struct	StaticInstance
+{
+	uint32_t	id         = 0;					// given to add
+	uint32_t	firstIndex = 0;					// absolute in index buffer
+	uint32_t	indexCount = 0;
+	bbox		bounds;
+};
+
+	// consecutive batches of the same material
+struct	StaticMaterialRange
+{
+	uint32_t	material;
+	uint32_t	firstBatch;
+	uint32_t	batchCount;
+};
+
+class	StaticBatcher
+{
+		// object added but not yet built, vertices are already in world space
+	struct	Source
+	{
+		uint32_t	material;
+		uint32_t	id;
+		size_t		firstVertex, numVertices;
+		size_t		firstIndex,  numIndices;		// indices are relative to firstVertex
+		bbox		bounds;
+	};
+
+	std::vector<uint8_t>				vertexData;			// until create
+	std::vector<uint32_t>				indexData;
+	std::vector<Source>					sources;
+	size_t								vertexSize = 0;
+
+	Buffer								vertexBuf;
+	Buffer								indexBuf;
+	VkIndexType							indexType = VK_INDEX_TYPE_UINT16;
+	std::vector<StaticBatch>			batches;			// sorted by material
+	std::vector<StaticInstance>			instances;
+	std::vector<StaticMaterialRange>	materials;
+	Bvh									instanceTree;		// over bounds of instances for picking
+
+public:
+	StaticBatcher () = default;
+
+		// copy object transformed by matrix, Vertex must have pos, n, t and b fields
+	template <typename Vertex>
+	StaticBatcher&	add ( const Vertex * vertices, size_t numVertices, const uint32_t * indices, size_t numTriangles, const glm::mat4& matrix, uint32_t material, uint32_t id )
+	{
+		std::vector<Vertex>	vs ( vertices, vertices + numVertices );
+		glm::mat3			nm = glm::inverseTranspose ( glm::mat3 ( matrix ) );
+		bbox				box;
+
+		for ( auto& v : vs )
+		{
+			v.pos = glm::vec3 ( matrix * glm::vec4 ( v.pos, 1 ) );
+			v.n   = nm * v.n;
+			v.t   = nm * v.t;
+			v.b   = nm * v.b;
+
+			box.addVertex ( v.pos );
+		}
+
+		return addTransformed ( vs.data (), sizeof ( Vertex ), numVertices, indices, numTriangles, box, material, id );
+	}
+
+		// object already in world space with bounds
+	StaticBatcher&	addTransformed ( const void * vertices, size_t size, size_t numVertices, const uint32_t * indices, size_t numTriangles, const bbox& bounds, uint32_t material, uint32_t id );
+
+		// build batches of at most maxVertices and upload them, added objects are released
+	bool	create ( Device& device, uint32_t maxVertices = 0x10000 );
+	void	clean  ();
+
+	const std::vector<StaticBatch>&	getBatches () const
+	{
+		return batches;
+	}
+
+	const std::vector<StaticInstance>&	getInstances () const
+	{
+		return instances;
+	}
+
+	const std::vector<StaticMaterialRange>&	getMaterials () const
+	{
+		return materials;
+	}
+
+	Buffer&	getVertexBuffer ()
+	{
+		return vertexBuf;
+	}
+
+	Buffer&	getIndexBuffer ()
+	{
+		return indexBuf;
+	}
+
+	VkIndexType	getIndexType () const
+	{
+		return indexType;
+	}
+
+	void	bindBuffers ( CommandBuffer& cb );
+
+		// single batch, buffers must be bound
+	void	renderBatch ( CommandBuffer& cb, uint32_t batch ) const;
+
+		// draw commands for all batches, culled ones get instanceCount 0, returns number of visible batches.
+		// Batches of material range are drawn by single drawIndexedIndirect starting at its firstBatch
+	uint32_t	writeCommands ( VkDrawIndexedIndirectCommand * commands, Frustum& frustum ) const;
+
+		// id of object owning triangle of batch (e.g. gl_PrimitiveID from picking pass), -1 if none
+	int		findInstance ( uint32_t batch, uint32_t triangle ) const;
+
+		// id of nearest object whose bounds are hit by ray, -1 if none
+	int		pick ( const ray& r, float& t ) const;
+};
@@ -92,6 +92,17 @@ public:
 	{
 		return inFlightFences [currentFrame].getHandle ();
 	}
+
+		// index of the frame in flight, resources indexed by it are safe to reuse after acquireNextImage
+	uint32_t	getCurrentFrame () const
+	{
+		return (uint32_t) currentFrame;
+	}
+
+	uint32_t	framesInFlight () const
+	{
+		return (uint32_t) MAX_FRAMES_IN_FLIGHT;
+	}
 	
 	void	clean ( bool cleanSync = true )
 	{
@@ -9,6 +9,7 @@ class	TimestampPool
 	VkQueryPool		queryPool = VK_NULL_HANDLE;
 	uint32_t		count     = 0;
 
+public:
 	TimestampPool () = default;
 	~TimestampPool ()
 	{
@@ -32,6 +33,8 @@ class	TimestampPool
 	{
 		if ( queryPool && device )
 			vkDestroyQueryPool ( device->getDevice (), queryPool, nullptr );
+
+		queryPool = VK_NULL_HANDLE;
 	}
 
 		// reset all timestamps in the pool
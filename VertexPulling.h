@@ -0,0 +1,34 @@
+//
+// Vertex pulling: pipeline has no vertex input state, vertex shader reads indices and
+// vertices through buffer device addresses (GL_EXT_buffer_reference) passed in PullingData.
+// Draws are non-indexed with firstVertex = firstIndex, so gl_VertexIndex is position in
+// index buffer. Meshes with different vertex formats, index types and buffers share one
+// pipeline and no vertex or index buffers are bound. Post-transform vertex reuse is lost
+// with non-indexed draws. Shaders are shaders/vertex-pulling.vert and model-pulling.vert
+//
+
+#pragma once
+
+#include	<stdint.h>
+#include	"Pipeline.h"
+
+enum	PullingFlags
+{
+	pullPackedVertices = 1,				// PackedVertex instead of BasicVertex
+	pull16BitIndices   = 2
+};
+
+	// push constants, std430 layout in shaders
+struct	PullingData
+{
+	uint64_t	vertices;				// device addresses
+	uint64_t	indices;
+	uint32_t	flags;					// PullingFlags
+	uint32_t	pad;
+};
+
+	// push constant range for PullingData, vertex input is left empty
+inline GraphicsPipeline&	setupPullingPipeline ( GraphicsPipeline& pipeline, uint32_t offset = 0, VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT )
+{
+	return pipeline.addPushConstRange ( stages, sizeof ( PullingData ), offset );
+}
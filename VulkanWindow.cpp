@@ -93,6 +93,8 @@ void	VulkanWindow::initVulkan ( DevicePolicy * p )
 	swapChain.create            ( device, surface, window, width, height, srgb );	
 	swapChain.createSyncObjects ();
 	descAllocator.create        ( device );
+	frameDescAllocator.create   ( device, swapChain.framesInFlight () );
+	descSetCache.create         ( device, 1024, swapChain.framesInFlight () );
 
 	createDepthTexture   ();
 }
@@ -230,7 +232,7 @@ void	VulkanWindow::createDepthTexture ()
 	if ( hasDepth )
 	{
 		depthTexture.create ( device, getWidth (), getHeight (), 1, 1, VK_FORMAT_D24_UNORM_S8_UINT, VK_IMAGE_TILING_OPTIMAL, 
-							  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0 );
+							  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0 );		// sampled for Hi-Z pyramid
 		
 		
 		SingleTimeCommand	cmd ( device, device.getGraphicsQueue (), device.getCommandPool () );
@@ -260,6 +262,10 @@ void	VulkanWindow::drawFrame ()
 			
 		return;
 	}
+				// frame's fence is signaled, so its transient descriptor sets can be reused
+	frameDescAllocator.beginFrame ( swapChain.getCurrentFrame () );
+	descSetCache.beginFrame       ();
+
 				// submit command buffers
 	submit ( currentImage );
 		
@@ -59,6 +59,25 @@ struct	DevicePolicy
 		features.pNext = pFeatures;
 	}
 
+		// enable Vulkan 1.2 features through VkPhysicalDeviceVulkan12Features (e.g. drawIndirectCount
+		// has no separate structure). It may not be chained together with separate 1.2 structures,
+		// so buffer device address moves into it
+	void	addFeatures12 ( VkPhysicalDeviceVulkan12Features& features12 )
+	{
+		VkBaseOutStructure * prev = reinterpret_cast<VkBaseOutStructure *> ( &features );
+
+		for ( ; prev->pNext != nullptr; prev = prev->pNext )
+			if ( prev->pNext == reinterpret_cast<VkBaseOutStructure *> ( &bufferDeviceAddressFeatures ) )
+			{
+				prev->pNext = prev->pNext->pNext;
+				break;
+			}
+
+		features12.bufferDeviceAddress = VK_TRUE;
+
+		addFeatures ( &features12 );
+	}
+
 		// add property to the list of properties
 	void	addProperties ( void * pProperties )
 	{
@@ -171,6 +190,8 @@ protected:
 	SwapChain						swapChain;
 	Texture							depthTexture;		// may be empty
 	DescriptorAllocator				descAllocator;
+	FrameDescriptorAllocator		frameDescAllocator;		// transient sets, reset every frame
+	DescriptorSetCache				descSetCache;			// sets shared by identical layout and resources
 
 public:
 	VulkanWindow ( int w, int h, const std::string& t, bool depth = true, DevicePolicy * p = nullptr ) : hasDepth ( depth )
@@ -184,8 +205,10 @@ public:
 
 	~VulkanWindow ()
 	{
-		descAllocator.clean ();
-		depthTexture.clean  ();
+		descSetCache.clean       ();
+		frameDescAllocator.clean ();
+		descAllocator.clean      ();
+		depthTexture.clean       ();
 		clean ();
 	}
 
@@ -234,6 +257,16 @@ public:
 	{
 		return descAllocator;
 	}
+
+	FrameDescriptorAllocator&	getFrameDescriptorAllocator ()
+	{
+		return frameDescAllocator;
+	}
+
+	DescriptorSetCache&	getDescriptorSetCache ()
+	{
+		return descSetCache;
+	}
 	
 	Texture&	getDepthTexture ()
 	{
@@ -166,13 +166,21 @@ public:
 		if ( isEmpty () )		// leave it empty
 			return;
 
-		auto	mn = m * glm::vec4 ( minPoint, 1 );
-		auto	mx = m * glm::vec4 ( maxPoint, 1 );
-		auto	minNew = glm::vec3 ( mn.x, mn.y, mn.z ) / mn.w;
-		auto	maxNew = glm::vec3 ( mx.x, mx.y, mx.z ) / mx.w;
+			// transform all 8 corners, two of them are not enough for rotations
+		glm::vec3	minNew ( std::numeric_limits<float>::max () );
+		glm::vec3	maxNew ( -std::numeric_limits<float>::max () );
 
-		minPoint = glm::min ( minNew, maxNew );
-		maxPoint = glm::max ( minNew, maxNew );
+		for ( int i = 0; i < 8; i++ )
+		{
+			auto	v = m * glm::vec4 ( getVertex ( i ), 1 );
+			auto	p = glm::vec3 ( v.x, v.y, v.z ) / v.w;
+
+			minNew = glm::min ( minNew, p );
+			maxNew = glm::max ( maxNew, p );
+		}
+
+		minPoint = minNew;
+		maxPoint = maxNew;
 	}
 /*
 									// distance from point along given direction to this box
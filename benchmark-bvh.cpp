@@ -0,0 +1,174 @@
+//
+// Benchmark: Bvh build time (single and multithreaded), refit and query throughput
+// for frustum, ray and box queries, results are checked against linear search
+//
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<chrono>
+#include	<thread>
+#include	<glm/glm.hpp>
+#include	<glm/gtc/matrix_transform.hpp>
+#include	"Bvh.h"
+#include	"Frustum.h"
+
+enum
+{
+	numObjects = 200 * 1000,
+	numRays    = 1000 * 1000,
+	numBoxes   = 100 * 1000,
+	numFrusta  = 100
+};
+
+static float	rnd ( float a, float b )
+{
+	return a + (b - a) * float ( rand () ) / float ( RAND_MAX );
+}
+
+static double	now ()
+{
+	return std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ().time_since_epoch () ).count ();
+}
+
+static bool	outside ( const Frustum& frustum, const bbox& box )
+{
+	for ( auto& p : frustum.planes )
+		if ( glm::dot ( glm::vec3 ( p.x, p.y, p.z ), box.getVertex ( (p.x >= 0 ? 1 : 0) | (p.y >= 0 ? 2 : 0) | (p.z >= 0 ? 4 : 0) ) ) + p.w < 0 )
+			return true;
+
+	return false;
+}
+
+int main ( int argc, const char * argv [] )
+{
+	std::vector<bbox>	boxes;
+	Bvh					bvh;
+	unsigned			threads = std::max ( 1u, std::thread::hardware_concurrency () );
+
+	for ( int i = 0; i < numObjects; i++ )
+	{
+		glm::vec3	c ( rnd ( -500, 500 ), rnd ( -500, 500 ), rnd ( -50, 50 ) );
+		glm::vec3	h ( rnd ( 0.1f, 2 ), rnd ( 0.1f, 2 ), rnd ( 0.1f, 2 ) );
+
+		boxes.push_back ( bbox ( c - h, c + h ) );
+	}
+
+	printf ( "%d objects, %u threads\n", numObjects, threads );
+
+	double	t0 = now ();
+
+	bvh.build ( boxes, 1 );
+
+	double	t1 = now ();
+
+	bvh.build ( boxes, threads );
+
+	double	t2 = now ();
+
+	printf ( "Build: 1 thread %.2f ms, %u threads %.2f ms, %zu nodes, SAH cost %.2f\n", t1 - t0, threads, t2 - t1, bvh.nodeCount (), bvh.sahCost () );
+
+		// move every object a bit and refit
+	for ( auto& b : boxes )
+	{
+		glm::vec3	d ( rnd ( -1, 1 ), rnd ( -1, 1 ), rnd ( -1, 1 ) );
+
+		b = bbox ( b.getMinPoint () + d, b.getMaxPoint () + d );
+	}
+
+	t0 = now ();
+	bvh.refit ( boxes );
+	t1 = now ();
+
+	for ( uint32_t i = 0; i < 1000; i++ )
+		bvh.refit ( i, boxes [i] );
+
+	t2 = now ();
+
+	printf ( "Refit: all %.2f ms, 1000 single objects %.3f ms\n", t1 - t0, t2 - t1 );
+
+		// frustum queries
+	std::vector<uint32_t>	result;
+	size_t					visible = 0;
+	glm::mat4				proj    = glm::perspective ( glm::radians ( 60.0f ), 16.0f / 9.0f, 0.1f, 300.0f );
+
+	t0 = now ();
+
+	for ( int i = 0; i < numFrusta; i++ )
+	{
+		Frustum	frustum;
+		float	angle = 6.2831853f * i / numFrusta;
+
+		frustum.update ( proj * glm::lookAt ( glm::vec3 ( 0 ), glm::vec3 ( cosf ( angle ), sinf ( angle ), 0 ), glm::vec3 ( 0, 0, 1 ) ) );
+		result.clear ();
+		bvh.frustumQuery ( frustum, result );
+
+		visible += result.size ();
+
+		if ( i == 0 )		// check against linear search
+		{
+			size_t	n = 0;
+
+			for ( auto& b : boxes )
+				if ( !outside ( frustum, b ) )
+					n++;
+
+			if ( n != result.size () )
+				printf ( "Frustum query mismatch: %zu vs %zu\n", result.size (), n );
+		}
+	}
+
+	t1 = now ();
+
+	printf ( "Frustum: %.3f ms per query, %zu objects on average\n", (t1 - t0) / numFrusta, visible / numFrusta );
+
+		// ray queries from center in random directions
+	std::vector<ray>	rays;
+	size_t				hits = 0;
+	uint32_t			object;
+	float				t;
+
+	for ( int i = 0; i < numRays; i++ )
+		rays.push_back ( ray ( glm::vec3 ( rnd ( -10, 10 ), rnd ( -10, 10 ), 0 ), glm::vec3 ( rnd ( -1, 1 ), rnd ( -1, 1 ), rnd ( -0.1f, 0.1f ) ) ) );
+
+	t0 = now ();
+
+	for ( auto& r : rays )
+		if ( bvh.raycast ( r, object, t ) )
+			hits++;
+
+	t1 = now ();
+
+	printf ( "Rays (closest): %.2f Mrays/s, %zu hits\n", numRays / (t1 - t0) / 1000, hits );
+
+	hits = 0;
+	t0   = now ();
+
+	for ( auto& r : rays )
+		if ( bvh.anyHit ( r, 100 ) )
+			hits++;
+
+	t1 = now ();
+
+	printf ( "Rays (any hit within 100): %.2f Mrays/s, %zu hits\n", numRays / (t1 - t0) / 1000, hits );
+
+		// box queries
+	size_t	found = 0;
+
+	t0 = now ();
+
+	for ( int i = 0; i < numBoxes; i++ )
+	{
+		glm::vec3	c ( rnd ( -500, 500 ), rnd ( -500, 500 ), rnd ( -50, 50 ) );
+
+		result.clear ();
+		bvh.boxQuery ( bbox ( c - glm::vec3 ( 5 ), c + glm::vec3 ( 5 ) ), result );
+
+		found += result.size ();
+	}
+
+	t1 = now ();
+
+	printf ( "Boxes: %.2f Mqueries/s, %.2f objects per query\n", numBoxes / (t1 - t0) / 1000, double ( found ) / numBoxes );
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+//
+// Benchmark: per-object Frustum::checkSphere vs batch SIMD culling of 1M spheres and boxes
+//
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<chrono>
+#include	<thread>
+#include	<glm/glm.hpp>
+#include	<glm/gtc/matrix_transform.hpp>
+#include	"BatchCulling.h"
+#include	"Frustum.h"
+
+enum
+{
+	numObjects = 1000 * 1000,
+	numRuns    = 10
+};
+
+static float	rnd ( float a, float b )
+{
+	return a + (b - a) * float ( rand () ) / float ( RAND_MAX );
+}
+
+	// run func numRuns times, return best time in milliseconds
+template <typename Func>
+static double	measure ( Func func )
+{
+	double	best = 1e10;
+
+	for ( int i = 0; i < numRuns; i++ )
+	{
+		auto	start = std::chrono::high_resolution_clock::now ();
+
+		func ();
+
+		best = std::min ( best, std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now () - start ).count () );
+	}
+
+	return best;
+}
+
+int main ( int argc, const char * argv [] )
+{
+	SphereSoA			spheres;
+	AabbSoA				boxes;
+	VisibilityMask		mask;
+	std::vector<bool>	reference ( numObjects );
+	glm::mat4			proj    = glm::perspective ( glm::radians ( 60.0f ), 16.0f / 9.0f, 0.1f, 500.0f );
+	glm::mat4			view    = glm::lookAt ( glm::vec3 ( 0, 0, 0 ), glm::vec3 ( 1, 0, 0 ), glm::vec3 ( 0, 0, 1 ) );
+	unsigned			threads = std::max ( 1u, std::thread::hardware_concurrency () );
+	Frustum				frustum;
+
+	spheres.reserve ( numObjects );
+	boxes.reserve   ( numObjects );
+
+	for ( int i = 0; i < numObjects; i++ )
+	{
+		glm::vec3	c ( rnd ( -500, 500 ), rnd ( -500, 500 ), rnd ( -100, 100 ) );
+		glm::vec3	h ( rnd ( 0.1f, 2 ), rnd ( 0.1f, 2 ), rnd ( 0.1f, 2 ) );
+
+		spheres.add ( c, glm::length ( h ) );
+		boxes.add   ( c - h, c + h );
+	}
+
+	frustum.update ( proj * view );
+
+	BatchCuller	culler ( frustum );
+	size_t		visible = 0;
+
+	printf ( "%d objects, %s, %u threads\n", numObjects, BatchCuller::simdName (), threads );
+
+	double	scalar = measure ( [&] ()
+	{
+		for ( size_t i = 0; i < spheres.size (); i++ )
+			reference [i] = frustum.checkSphere ( glm::vec3 ( spheres.x [i], spheres.y [i], spheres.z [i] ), spheres.r [i] );
+	} );
+
+	double	batch1 = measure ( [&] () { culler.cullSpheres ( spheres, mask, 1 ); } );
+
+	for ( size_t i = 0; i < spheres.size (); i++ )
+		if ( mask.isVisible ( i ) != reference [i] )
+		{
+			printf ( "Mismatch at sphere %zu\n", i );
+			return 1;
+		}
+
+	double	batchN = measure ( [&] () { culler.cullSpheres ( spheres, mask, threads ); } );
+
+	visible = mask.visibleCount ();
+
+	printf ( "Spheres: Frustum::checkSphere %.3f ms, batch %.3f ms, batch MT %.3f ms, visible %zu\n", scalar, batch1, batchN, visible );
+
+	batch1 = measure ( [&] () { culler.cullBoxes ( boxes, mask, 1       ); } );
+	batchN = measure ( [&] () { culler.cullBoxes ( boxes, mask, threads ); } );
+
+	printf ( "Boxes:   batch %.3f ms, batch MT %.3f ms, visible %zu\n", batch1, batchN, mask.visibleCount () );
+
+	return 0;
+}
@@ -0,0 +1,256 @@
+//
+// Benchmark: depth prepass vs single pass by overdraw level. Stack of screen-covering
+// layers is drawn back to front (worst case), so every layer is shaded without prepass.
+// All combinations of shading cost, layer count and prepass mode are measured in turn
+// with GPU timestamps, then the sweep starts again. Press P to stop sweep and toggle prepass
+//
+
+#include	"VulkanWindow.h"
+#include	"Buffer.h"
+#include	"DescriptorSet.h"
+#include	"Mesh.h"
+#include	"DepthPrepass.h"
+#include	"TimestampPool.h"
+
+struct UniformBufferObject					// the same block as in depthpass.vert
+{
+	glm::mat4 mv;
+	glm::mat4 proj;
+	glm::mat4 nm;
+	glm::vec4 light;						// w is number of shading iterations
+	glm::mat4 shadowMat;
+};
+
+class	ExampleWindow : public VulkanWindow
+{
+	enum
+	{
+		maxLayers   = 16,
+		statsFrames = 100					// frames to average GPU time
+	};
+
+	struct	Config
+	{
+		int		layers;
+		int		iterations;
+		bool	prepass;
+	};
+
+	std::vector<CommandBuffer>					commandBuffers;
+	std::vector<DescriptorSet> 					descriptorSets;
+	std::vector<Uniform<UniformBufferObject>>	uniformBuffers;
+	GraphicsPipeline							pipeline;			// single pass: depth test LESS with writes
+	GraphicsPipeline							pipelineEqual;		// after prepass: depth test EQUAL without writes
+	DepthPrepass								prepass;
+	Renderpass									renderPass;
+	std::vector<std::unique_ptr<Mesh>>			layers;				// from near to far
+	TimestampPool								timestamps;
+	std::vector<bool>							submitted;
+	std::vector<Config>							configs;
+	size_t										current   = 0;
+	bool										sweep     = true;
+	double										gpuTime   = 0;
+	int											gpuFrames = 0;
+
+public:
+	ExampleWindow ( int w, int h, const std::string& t, DevicePolicy * p ) : VulkanWindow ( w, h, t, true, p )
+	{
+		for ( int i = 0; i < maxLayers; i++ )
+			layers.push_back ( std::unique_ptr<Mesh> ( createQuad ( device, glm::vec3 ( -4, -4, -0.05f * i ), glm::vec3 ( 8, 0, 0 ), glm::vec3 ( 0, 8, 0 ) ) ) );
+
+		for ( int iterations : { 1, 64 } )
+			for ( int n : { 1, 2, 4, 8, 16 } )
+				for ( bool pre : { false, true } )
+					configs.push_back ( { n, iterations, pre } );
+
+		createPipelines ();
+	}
+
+	void	createUniformBuffers ()
+	{
+		uniformBuffers.resize ( swapChain.imageCount () );
+
+		for ( auto& ub : uniformBuffers )
+			ub.create ( device );
+	}
+
+	void	createDescriptorSets ()
+	{
+		descriptorSets.resize ( swapChain.imageCount () );
+
+		for ( uint32_t i = 0; i < swapChain.imageCount (); i++ )
+		{
+			descriptorSets [i]
+				.setLayout ( device, descAllocator, pipeline.getDescLayout () )
+				.addBuffer ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers [i], 0, sizeof ( UniformBufferObject ) )
+				.create    ();
+		}
+	}
+
+	void	createMainPipeline ( GraphicsPipeline& p, bool afterPrepass, DescSetLayout& layout )
+	{
+		p.setDevice ( device )
+		 .setVertexShader   ( "shaders/prepass-heavy.vert.spv" )
+		 .setFragmentShader ( "shaders/prepass-heavy.frag.spv" )
+		 .setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
+		 .addVertexBinding  ( sizeof ( BasicVertex ) )
+		 .addVertexAttributes <BasicVertex> ()
+		 .addDescLayout     ( 0, layout )
+		 .setCullMode       ( VK_CULL_MODE_NONE );
+
+		DepthPrepass::setupMainPipeline ( p, afterPrepass ).create ( renderPass );
+	}
+
+	virtual	void	createPipelines () override
+	{
+		createUniformBuffers    ();
+		createDefaultRenderPass ( renderPass );
+		createMainPipeline      ( pipeline, false, DescSetLayout ()
+			.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT ) );
+
+		DescSetLayout	shared = pipeline.getDescLayout ();		// both main pipelines use the same descriptor sets
+
+		createMainPipeline      ( pipelineEqual, true, shared );
+		prepass.create          ( device, renderPass, pipeline, swapChain.getExtent ().width, swapChain.getExtent ().height );
+
+				// create before command buffers
+		swapChain.createFramebuffers ( renderPass, depthTexture.getImageView () );
+
+		timestamps.create    ( device, 2 * swapChain.imageCount () );
+		createDescriptorSets ();
+		createCommandBuffers ();
+	}
+
+	virtual	void	freePipelines () override
+	{
+		commandBuffers.clear  ();
+		pipeline.clean        ();
+		pipelineEqual.clean   ();
+		prepass.clean         ();
+		renderPass.clean      ();
+		uniformBuffers.clear  ();
+		descriptorSets.clear  ();
+		timestamps.destroy    ();
+		descAllocator.clean   ();
+	}
+
+	virtual	void	submit ( uint32_t imageIndex ) override
+	{
+		std::vector<uint64_t>	ts ( 2 );
+
+			// previous submission of this command buffer is completed here
+		if ( submitted [imageIndex] && timestamps.getResults ( ts, 2 * imageIndex, 2 ) && ts [1] > ts [0] )
+		{
+			gpuTime += timestamps.convertToMs ( ts [1] - ts [0] );
+
+			if ( ++gpuFrames == statsFrames )
+			{
+				const Config&	c = configs [current];
+
+				log () << "layers " << c.layers << ", iterations " << c.iterations << (c.prepass ? ", prepass:    " : ", no prepass: ")
+					   << gpuTime / gpuFrames << " ms" << Log::endl;
+
+				if ( sweep )
+					setConfig ( (current + 1) % configs.size () );
+
+				gpuTime   = 0;
+				gpuFrames = 0;
+			}
+		}
+
+		updateUniformBuffer ( imageIndex );
+
+		defaultSubmit ( commandBuffers [imageIndex] );
+
+		submitted [imageIndex] = true;
+	}
+
+	virtual	void	keyTyped ( int key, int scancode, int action, int mods ) override
+	{
+		if ( key == 'P' && action == GLFW_RELEASE )		// stay with current layers and shading, toggle prepass
+		{
+			Config	c = configs [current];
+
+			sweep     = false;
+			c.prepass = !c.prepass;
+
+			for ( size_t i = 0; i < configs.size (); i++ )
+				if ( configs [i].layers == c.layers && configs [i].iterations == c.iterations && configs [i].prepass == c.prepass )
+					setConfig ( i );
+
+			gpuTime   = 0;
+			gpuFrames = 0;
+		}
+
+		VulkanWindow::keyTyped ( key, scancode, action, mods );
+	}
+
+	void	setConfig ( size_t index )
+	{
+		current = index;
+
+		prepass.setEnabled   ( configs [current].prepass );
+		vkDeviceWaitIdle     ( device.getDevice () );
+		createCommandBuffers ();
+	}
+
+	void	createCommandBuffers ()
+	{
+		auto				framebuffers = swapChain.getFramebuffers ();
+		std::vector<Mesh *>	drawList;
+
+		for ( int i = configs [current].layers - 1; i >= 0; i-- )		// back to front
+			drawList.push_back ( layers [i].get () );
+
+		prepass.setEnabled ( configs [current].prepass );
+
+		commandBuffers = device.allocCommandBuffers ( (uint32_t)framebuffers.size ());
+		submitted.assign ( commandBuffers.size (), false );
+
+		for ( size_t i = 0; i < commandBuffers.size(); i++ )
+		{
+			CommandBuffer&	cb = commandBuffers [i];
+
+			cb.begin ();
+
+			timestamps.reset          ( cb, 2 * (uint32_t) i, 2 );
+			timestamps.writeTimestamp ( cb, 2 * (int) i, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT );
+
+			cb.beginRenderPass ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor ().clearDepthStencil () )
+			  .setViewport     ( swapChain.getExtent () )
+			  .setScissor      ( swapChain.getExtent () );
+
+			prepass.record ( cb, descriptorSets [i], drawList );
+
+			cb.pipeline          ( prepass.isEnabled () ? pipelineEqual : pipeline )
+			  .addDescriptorSets ( { descriptorSets [i] } );
+
+			for ( auto * mesh : drawList )
+				cb.render ( mesh );
+
+			cb.endRenderPass ();
+
+			timestamps.writeTimestamp ( cb, 2 * (int) i + 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT );
+			cb.end ();
+		}
+	}
+
+	void updateUniformBuffer ( uint32_t currentImage )
+	{
+		UniformBufferObject	ubo = {};
+
+		ubo.mv    = glm::lookAt ( glm::vec3 ( 0, 0, 4 ), glm::vec3 ( 0 ), glm::vec3 ( 0, 1, 0 ) );
+		ubo.proj  = projectionMatrix ( 60, getAspect (), 0.1f, 20.0f );
+		ubo.nm    = normalMatrix ( ubo.mv );
+		ubo.light = glm::vec4 ( 2, 3, 5, (float) configs [current].iterations );
+
+		*uniformBuffers [currentImage].getPtr () = ubo;
+	}
+};
+
+int main ( int argc, const char * argv [] )
+{
+	DevicePolicy	policy;
+
+	return ExampleWindow ( 1200, 1200, "Depth prepass benchmark", &policy ).run ();
+}
@@ -0,0 +1,296 @@
+//
+// Benchmark: per-primitive pushConstants + drawIndexed (Model::render) vs single
+// vkCmdDrawIndexedIndirect (Model::renderIndirect) vs single vkCmdDrawIndirect with
+// vertex pulling (Model::renderIndirectPulling) for a model with 10k primitives.
+// Press M to switch path, command buffer record time and average GPU time are logged
+//
+
+#include	<chrono>
+#include	"VulkanWindow.h"
+#include	"Buffer.h"
+#include	"DescriptorSet.h"
+#include	"Model.h"
+#include	"TimestampPool.h"
+#include	"Controller.h"
+
+struct UniformBufferObject
+{
+	glm::mat4 model;
+	glm::mat4 proj;
+	glm::vec4 eye;
+	glm::vec4 light;
+};
+
+static const char * pathNames [] = { "per-primitive", "indirect", "indirect pulling" };
+
+class	ExampleWindow : public VulkanWindow
+{
+	enum
+	{
+		gridSize    = 100,					// gridSize^2 primitives
+		statsFrames = 200					// frames to average GPU time
+	};
+
+	std::vector<CommandBuffer>		commandBuffers;
+	std::vector<DescriptorSet> 		descriptorSets;
+	std::vector<Buffer>				uniformBuffers;
+	GraphicsPipeline				pipeline;			// per-primitive push constants
+	GraphicsPipeline				pipelineMdi;		// per-draw data buffer
+	GraphicsPipeline				pipelinePulling;	// per-draw data buffer, no vertex input
+	Renderpass						renderPass;
+	Model							model;
+	Sampler							sampler;
+	TimestampPool					timestamps;
+	std::vector<bool>				submitted;			// timestamps of image's command buffer were written
+	int								path        = 1;		// index in pathNames
+	double							gpuTime     = 0;
+	int								gpuFrames   = 0;
+	glm::vec3						light = glm::vec3 ( -12, 0, 0 );
+	glm::vec3						eye   = glm::vec3 ( -12, 0, 0 );
+
+public:
+	ExampleWindow ( int w, int h, const std::string& t, DevicePolicy * p ) : VulkanWindow ( w, h, t, true, p )
+	{
+		setController ( new RotateController ( this, eye ) );
+
+		createModel    ();
+		sampler.create ( device );		// use default options
+
+		createPipelines ();
+	}
+
+		// grid of cubes in x = 0 plane, every cube is a separate primitive
+	void	createModel ()
+	{
+		static const glm::vec3	normals [6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+
+		std::vector<BasicVertex>	vertices;
+		std::vector<GLuint>			indices;
+		std::vector<glm::uvec2>		ranges;
+		std::vector<glm::mat4>		transforms;
+		const float					step = 0.1f;
+		const float					size = 0.03f;
+
+		for ( int i = 0; i < gridSize; i++ )
+			for ( int j = 0; j < gridSize; j++ )
+			{
+				ranges.push_back     ( glm::uvec2 ( (uint32_t) indices.size (), 36 ) );
+				transforms.push_back ( glm::translate ( glm::mat4 ( 1 ), glm::vec3 ( 0, (i - gridSize / 2) * step, (j - gridSize / 2) * step ) ) );
+
+				for ( int f = 0; f < 6; f++ )
+				{
+					glm::vec3	n    = normals [f];
+					glm::vec3	t    = glm::vec3 ( n.y != 0 || n.z != 0 ? 1 : 0, n.x != 0 ? 1 : 0, 0 );
+					glm::vec3	b    = glm::cross ( n, t );
+					GLuint		base = (GLuint) vertices.size ();
+
+					for ( int k = 0; k < 4; k++ )
+					{
+						glm::vec2	tex ( k & 1, k >> 1 );
+						BasicVertex	v ( size * ( n + (2.0f * tex.x - 1.0f) * t + (2.0f * tex.y - 1.0f) * b ), tex );
+
+						v.n = n;
+						v.t = t;
+						v.b = b;
+
+						vertices.push_back ( v );
+					}
+
+					for ( GLuint k : { 0, 1, 3, 0, 3, 2 } )
+						indices.push_back ( base + k );
+				}
+			}
+
+		if ( !model.create ( device, vertices, indices, ranges, transforms, "textures/texture.jpg" ) )
+			fatal () << "Cannot create model" << Log::endl;
+
+		log () << "Model with " << model.primitiveCount () << " primitives" << Log::endl;
+	}
+
+	void	createUniformBuffers ()
+	{
+		uniformBuffers.resize ( swapChain.imageCount() );
+
+		for ( size_t i = 0; i < swapChain.imageCount (); i++ )
+			uniformBuffers [i].create ( device, sizeof ( UniformBufferObject ), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+	}
+
+	void	freeUniformBuffers ()
+	{
+		uniformBuffers.clear ();
+	}
+
+		// both pipelines use the same set layout, so one set per image is enough
+	void	createDescriptorSets ()
+	{
+		descriptorSets.resize ( swapChain.imageCount () );
+
+		for ( uint32_t i = 0; i < swapChain.imageCount (); i++ )
+		{
+			descriptorSets  [i]
+				.setLayout      ( device, descAllocator, pipelineMdi.getDescLayout () )
+				.addBuffer      ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers [i], 0, sizeof ( UniformBufferObject ) )
+				.addSampler     ( 1, sampler )
+				.addImageArray  ( 2, model.getTextures () )
+				.addBuffer      ( 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, model.getDrawDataBuffer () )
+				.create    ();
+		}
+	}
+
+	void	createPipeline ( GraphicsPipeline& p, const std::string& vertexShader, const std::string& fragmentShader, bool pulling = false )
+	{
+		if ( pulling )
+			setupPullingPipeline ( p );
+		else
+			p.addPushConstRange (  VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof ( PushConstants ) )
+			 .addVertexBinding  ( sizeof ( BasicVertex ) )
+			 .addVertexAttributes <BasicVertex> ();
+
+		p.setDevice ( device )
+				.setVertexShader   ( vertexShader )
+				.setFragmentShader ( fragmentShader )
+				.setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
+				.addDescLayout     ( 0, DescSetLayout ()
+					.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,    VK_SHADER_STAGE_VERTEX_BIT )
+					.add ( 1, VK_DESCRIPTOR_TYPE_SAMPLER,           VK_SHADER_STAGE_FRAGMENT_BIT )
+					.add ( 2, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,     VK_SHADER_STAGE_FRAGMENT_BIT, (uint32_t) model.getTextures ().size () )
+					.add ( 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,    VK_SHADER_STAGE_VERTEX_BIT ) )
+				.setCullMode       ( VK_CULL_MODE_NONE               )
+				.setDepthTest      ( true )
+				.setDepthWrite     ( true )
+				.create            ( renderPass );
+	}
+
+	virtual	void	createPipelines () override
+	{
+		createUniformBuffers    ();
+		createDefaultRenderPass ( renderPass );
+		createPipeline          ( pipeline,    "shaders/model-pbr.vert.spv",     "shaders/model-pbr.frag.spv" );
+		createPipeline          ( pipelineMdi, "shaders/model-pbr-mdi.vert.spv", "shaders/model-pbr-culled.frag.spv" );
+		createPipeline          ( pipelinePulling, "shaders/model-pulling.vert.spv", "shaders/model-pbr-culled.frag.spv", true );
+
+				// create before command buffers
+		swapChain.createFramebuffers ( renderPass, depthTexture.getImageView () );
+
+		timestamps.create    ( device, 2 * swapChain.imageCount () );
+		createDescriptorSets ();
+		createCommandBuffers ( renderPass );
+	}
+
+	virtual	void	freePipelines () override
+	{
+		commandBuffers.clear ();
+		pipeline.clean       ();
+		pipelineMdi.clean    ();
+		pipelinePulling.clean ();
+		renderPass.clean     ();
+		freeUniformBuffers   ();
+		descriptorSets.clear ();
+		timestamps.destroy   ();
+		descAllocator.clean  ();
+	}
+
+	virtual	void	submit ( uint32_t imageIndex ) override
+	{
+		std::vector<uint64_t>	ts ( 2 );
+
+			// previous submission of this command buffer is completed here
+		if ( submitted [imageIndex] && timestamps.getResults ( ts, 2 * imageIndex, 2 ) && ts [1] > ts [0] )
+		{
+			gpuTime += timestamps.convertToMs ( ts [1] - ts [0] );
+
+			if ( ++gpuFrames == statsFrames )
+			{
+				log () << pathNames [path] << ": GPU time " << gpuTime / gpuFrames << " ms" << Log::endl;
+
+				gpuTime   = 0;
+				gpuFrames = 0;
+			}
+		}
+
+		updateUniformBuffer ( imageIndex );
+
+		defaultSubmit ( commandBuffers [imageIndex] );
+
+		submitted [imageIndex] = true;
+	}
+
+	virtual	void	keyTyped ( int key, int scancode, int action, int mods ) override
+	{
+		if ( key == 'M' && action == GLFW_RELEASE )		// switch between render paths
+		{
+			path        = (path + 1) % 3;
+			gpuTime     = 0;
+			gpuFrames   = 0;
+
+			vkDeviceWaitIdle     ( device.getDevice () );
+			createCommandBuffers ( renderPass );
+		}
+
+		VulkanWindow::keyTyped ( key, scancode, action, mods );
+	}
+
+	void	createCommandBuffers ( Renderpass& renderPass )
+	{
+		auto	framebuffers = swapChain.getFramebuffers ();
+		auto	start        = std::chrono::high_resolution_clock::now ();
+
+		commandBuffers = device.allocCommandBuffers ( (uint32_t)framebuffers.size ());
+		submitted.assign ( commandBuffers.size (), false );
+
+		for ( size_t i = 0; i < commandBuffers.size(); i++ )
+		{
+			GraphicsPipeline&	p = path == 0 ? pipeline : (path == 1 ? pipelineMdi : pipelinePulling);
+
+			commandBuffers [i].begin ();
+
+			timestamps.reset          ( commandBuffers [i], 2 * (uint32_t) i, 2 );
+			timestamps.writeTimestamp ( commandBuffers [i], 2 * (int) i, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT );
+
+			commandBuffers [i].beginRenderPass ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor ().clearDepthStencil () )
+				.pipeline          ( p )
+				.addDescriptorSets ( { descriptorSets[i] } )
+				.setViewport       ( swapChain.getExtent () )
+				.setScissor        ( swapChain.getExtent () );
+
+			if ( path == 0 )
+				model.render ( p, commandBuffers [i], glm::mat4 ( 1.0f ) );
+			else if ( path == 1 )
+				model.renderIndirect ( commandBuffers [i] );
+			else
+				model.renderIndirectPulling ( commandBuffers [i], p.getLayout () );
+
+			timestamps.writeTimestamp ( commandBuffers [i], 2 * (int) i + 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT );
+			commandBuffers [i].end ();
+		}
+
+		double	ms = std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now () - start ).count ();
+
+		log () << pathNames [path] << ": recording " << commandBuffers.size () << " command buffers took " << ms << " ms" << Log::endl;
+	}
+
+	void updateUniformBuffer ( uint32_t currentImage )
+	{
+		UniformBufferObject ubo  = {};
+
+		ubo.model = controller->getModelView  ();
+		ubo.proj  = projectionMatrix ( 45, getAspect (), 0.1f, 1000.0f );
+		ubo.eye   = glm::vec4 ( eye, 1.0f );
+		ubo.light = glm::vec4 ( light, 1.0 );
+
+		uniformBuffers [currentImage].copy ( &ubo, sizeof ( ubo ) );
+	}
+};
+
+int main ( int argc, const char * argv [] )
+{
+	DevicePolicy								policy;
+	VkPhysicalDeviceShaderDrawParametersFeatures	drawParameters = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES };
+
+	policy.features.features.multiDrawIndirect = VK_TRUE;		// single call for all primitives
+	drawParameters.shaderDrawParameters        = VK_TRUE;		// gl_DrawID in shaders
+
+	policy.addFeatures ( &drawParameters );
+
+	return ExampleWindow ( 1200, 1200, "Multi-draw indirect benchmark", &policy ).run ();
+}
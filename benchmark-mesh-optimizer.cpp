@@ -0,0 +1,172 @@
+//
+// Benchmark: ACMR/ATVR of index buffers before and after MeshOptimizer stages for procedural
+// meshes in generation order, the same meshes with shuffled triangles (as often comes from
+// exporters) and optionally meshes of a model file given on command line
+//
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<math.h>
+#include	<chrono>
+#include	<array>
+#include	<string>
+#include	<algorithm>
+#include	<random>
+#include	<glm/glm.hpp>
+#include	<assimp/Importer.hpp>
+#include	<assimp/scene.h>
+#include	<assimp/postprocess.h>
+#include	"MeshOptimizer.h"
+
+struct	TestMesh
+{
+	std::string				name;
+	std::vector<glm::vec3>	positions;
+	std::vector<uint32_t>	indices;
+};
+
+static double	now ()
+{
+	return std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ().time_since_epoch () ).count ();
+}
+
+	// torus with rings x sides quads, rows are generated one after another
+static TestMesh	createTorus ( int rings, int sides )
+{
+	TestMesh	mesh;
+
+	mesh.name = "torus " + std::to_string ( rings ) + "x" + std::to_string ( sides );
+
+	for ( int i = 0; i <= rings; i++ )
+		for ( int j = 0; j <= sides; j++ )
+		{
+			float	phi = 2 * 3.1415926f * i / rings;
+			float	psi = 2 * 3.1415926f * j / sides;
+
+			mesh.positions.push_back ( glm::vec3 ( (1 + 0.3f * cosf ( psi )) * cosf ( phi ), (1 + 0.3f * cosf ( psi )) * sinf ( phi ), 0.3f * sinf ( psi ) ) );
+		}
+
+	for ( int i = 0; i < rings; i++ )
+		for ( int j = 0; j < sides; j++ )
+		{
+			uint32_t	a = i * (sides + 1) + j;
+			uint32_t	b = a + sides + 1;
+
+			mesh.indices.insert ( mesh.indices.end (), { a, b, a + 1, a + 1, b, b + 1 } );
+		}
+
+	return mesh;
+}
+
+static TestMesh	shuffled ( const TestMesh& src )
+{
+	TestMesh				mesh = src;
+	std::vector<uint32_t>	order ( src.indices.size () / 3 );
+	std::mt19937			rng ( 1 );
+
+	for ( size_t i = 0; i < order.size (); i++ )
+		order [i] = (uint32_t) i;
+
+	std::shuffle ( order.begin (), order.end (), rng );
+
+	for ( size_t i = 0; i < order.size (); i++ )
+		for ( int k = 0; k < 3; k++ )
+			mesh.indices [3*i + k] = src.indices [3*order [i] + k];
+
+	mesh.name += " shuffled";
+
+	return mesh;
+}
+
+	// sorted list of triangles with vertex positions, must be the same before and after optimization
+static std::vector<std::array<float, 9>>	triangleSet ( const TestMesh& mesh )
+{
+	std::vector<std::array<float, 9>>	tris;
+
+	for ( size_t i = 0; i < mesh.indices.size (); i += 3 )
+	{
+		std::array<float, 9>	t;
+
+		for ( int k = 0; k < 3; k++ )
+			for ( int c = 0; c < 3; c++ )
+				t [3*k + c] = mesh.positions [mesh.indices [i + k]][c];
+
+		tris.push_back ( t );
+	}
+
+	std::sort ( tris.begin (), tris.end () );
+
+	return tris;
+}
+
+static bool	test ( const TestMesh& src )
+{
+	TestMesh			mesh   = src;
+	size_t				nv     = mesh.positions.size ();
+	VertexCacheStats	before = MeshOptimizer::analyzeVertexCache ( mesh.indices, nv );
+	double				t0     = now ();
+
+	MeshOptimizer::optimizeVertexCache ( mesh.indices, nv );
+
+	double				t1     = now ();
+	VertexCacheStats	cached = MeshOptimizer::analyzeVertexCache ( mesh.indices, nv );
+
+	MeshOptimizer::optimizeOverdraw ( mesh.indices, mesh.positions.data (), nv, sizeof ( glm::vec3 ) );
+
+	double				t2     = now ();
+	VertexCacheStats	after  = MeshOptimizer::analyzeVertexCache ( mesh.indices, nv );
+
+	MeshOptimizer::remapVertices ( mesh.positions.data (), MeshOptimizer::optimizeVertexFetch ( mesh.indices, nv ) );
+
+	double				t3     = now ();
+	bool				ok     = triangleSet ( mesh ) == triangleSet ( src );
+
+	printf ( "%-28s %7zu tris: ACMR %.3f -> %.3f (cache) -> %.3f (overdraw), ATVR %.3f -> %.3f, %s indices, %.1f + %.1f + %.1f ms%s\n",
+			 src.name.c_str (), src.indices.size () / 3, before.acmr, cached.acmr, after.acmr, before.atvr, after.atvr,
+			 MeshOptimizer::fits16Bit ( nv ) ? "16-bit" : "32-bit", t1 - t0, t2 - t1, t3 - t2, ok ? "" : ", TRIANGLES CHANGED" );
+
+	return ok;
+}
+
+int main ( int argc, const char * argv [] )
+{
+	std::vector<TestMesh>	meshes;
+	int						errors = 0;
+
+	for ( auto m : { createTorus ( 64, 32 ), createTorus ( 400, 40 ), createTorus ( 1000, 100 ) } )
+	{
+		meshes.push_back ( m );
+		meshes.push_back ( shuffled ( m ) );
+	}
+
+	if ( argc > 1 )
+	{
+		Assimp::Importer	importer;
+		const aiScene	  * scene = importer.ReadFile ( argv [1], aiProcess_Triangulate | aiProcess_JoinIdenticalVertices );
+
+		for ( unsigned i = 0; scene != nullptr && i < scene->mNumMeshes; i++ )
+		{
+			const aiMesh  * src = scene->mMeshes [i];
+			TestMesh		mesh;
+
+			mesh.name = std::string ( "model mesh " ) + std::to_string ( i );
+
+			for ( unsigned v = 0; v < src->mNumVertices; v++ )
+				mesh.positions.push_back ( glm::vec3 ( src->mVertices [v].x, src->mVertices [v].y, src->mVertices [v].z ) );
+
+			for ( unsigned f = 0; f < src->mNumFaces; f++ )
+				if ( src->mFaces [f].mNumIndices == 3 )
+					mesh.indices.insert ( mesh.indices.end (), src->mFaces [f].mIndices, src->mFaces [f].mIndices + 3 );
+
+			meshes.push_back ( mesh );
+		}
+	}
+
+	printf ( "FIFO cache of 32 entries for analysis, %d for optimization\n", (int) MeshOptimizer::cacheSize );
+
+	for ( auto& m : meshes )
+		if ( !test ( m ) )
+			errors++;
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+//
+// Benchmark: software occlusion culling of a city block scene, occluder rasterization
+// (single and multithreaded) and box test time per frame. Results are checked against
+// simple per-pixel depth buffer: masked buffer must never hide box that reference shows
+//
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<float.h>
+#include	<chrono>
+#include	<thread>
+#include	<algorithm>
+
+#define	GLM_FORCE_DEPTH_ZERO_TO_ONE			// SoftwareOcclusion expects Vulkan depth range
+
+#include	<glm/glm.hpp>
+#include	<glm/gtc/matrix_transform.hpp>
+#include	"SoftwareOcclusion.h"
+
+enum
+{
+	gridSize   = 30,				// gridSize x gridSize buildings
+	numObjects = 100 * 1000,
+	numFrames  = 50,
+	width      = 256,
+	height     = 128
+};
+
+const float	blockSize  = 20.0f;
+const float	streetSize = 8.0f;
+
+struct	Vertex
+{
+	glm::vec3	pos;
+	glm::vec2	tex;
+};
+
+static float	rnd ( float a, float b )
+{
+	return a + (b - a) * float ( rand () ) / float ( RAND_MAX );
+}
+
+static double	now ()
+{
+	return std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ().time_since_epoch () ).count ();
+}
+
+static void	addBox ( std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const glm::vec3& a, const glm::vec3& b )
+{
+	static const int	faces [6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+	uint32_t			base = (uint32_t) vertices.size ();
+
+	for ( int i = 0; i < 8; i++ )
+		vertices.push_back ( { glm::vec3 ( i & 1 ? b.x : a.x, i & 2 ? b.y : a.y, i & 4 ? b.z : a.z ), glm::vec2 ( 0 ) } );
+
+	for ( auto& f : faces )
+	{
+		uint32_t	q [6] = { 0, 1, 2, 0, 2, 3 };
+
+		for ( int k = 0; k < 6; k++ )
+			indices.push_back ( base + f [q [k]] );
+	}
+}
+
+	// reference: per-pixel depth buffer with inclusive edges and exact depth
+class	ReferenceBuffer
+{
+	std::vector<float>	depth;
+	glm::mat4			viewProj;
+
+public:
+	ReferenceBuffer () : depth ( width * height ) {}
+
+	void	clear ( const glm::mat4& matrix )
+	{
+		viewProj = matrix;
+		std::fill ( depth.begin (), depth.end (), 1.0f );
+	}
+
+	glm::vec3	toScreen ( const glm::vec4& p ) const
+	{
+		return glm::vec3 ( (p.x / p.w * 0.5f + 0.5f) * width, (p.y / p.w * 0.5f + 0.5f) * height, p.z / p.w );
+	}
+
+	void	triangle ( glm::vec3 v0, glm::vec3 v1, glm::vec3 v2 )
+	{
+		float	area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+
+		if ( area == 0 )
+			return;
+
+		int	x0 = std::max ( 0,          int ( floorf ( std::min ( v0.x, std::min ( v1.x, v2.x ) ) ) ) );
+		int	x1 = std::min ( width - 1,  int ( ceilf  ( std::max ( v0.x, std::max ( v1.x, v2.x ) ) ) ) );
+		int	y0 = std::max ( 0,          int ( floorf ( std::min ( v0.y, std::min ( v1.y, v2.y ) ) ) ) );
+		int	y1 = std::min ( height - 1, int ( ceilf  ( std::max ( v0.y, std::max ( v1.y, v2.y ) ) ) ) );
+
+		for ( int y = y0; y <= y1; y++ )
+			for ( int x = x0; x <= x1; x++ )
+			{
+				float	px = x + 0.5f, py = y + 0.5f;
+				float	w0 = ((v2.x - v1.x) * (py - v1.y) - (v2.y - v1.y) * (px - v1.x)) / area;
+				float	w1 = ((v0.x - v2.x) * (py - v2.y) - (v0.y - v2.y) * (px - v2.x)) / area;
+				float	w2 = 1.0f - w0 - w1;
+
+				if ( w0 < 0 || w1 < 0 || w2 < 0 )
+					continue;
+
+				float&	d = depth [y * width + x];
+
+				d = std::min ( d, w0 * v0.z + w1 * v1.z + w2 * v2.z );
+			}
+	}
+
+	void	mesh ( const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices )
+	{
+		for ( size_t i = 0; i < indices.size (); i += 3 )
+		{
+			glm::vec4	p [3];
+			glm::vec4	poly [4];
+			int			count = 0;
+
+			for ( int k = 0; k < 3; k++ )
+				p [k] = viewProj * glm::vec4 ( vertices [indices [i + k]].pos, 1.0f );
+
+			for ( int k = 0; k < 3; k++ )			// clip by near plane
+			{
+				const glm::vec4&	a = p [k];
+				const glm::vec4&	b = p [(k + 1) % 3];
+
+				if ( a.z >= 0 )
+					poly [count++] = a;
+
+				if ( (a.z >= 0) != (b.z >= 0) )
+					poly [count++] = a + (b - a) * (a.z / (a.z - b.z));
+			}
+
+			for ( int k = 2; k < count; k++ )
+				triangle ( toScreen ( poly [0] ), toScreen ( poly [k - 1] ), toScreen ( poly [k] ) );
+		}
+	}
+
+	bool	isVisible ( const bbox& box ) const
+	{
+		float		minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, zMin = 1;
+		int			behind = 0;
+		glm::vec4	p [8];
+
+		for ( int i = 0; i < 8; i++ )
+			if ( (p [i] = viewProj * glm::vec4 ( box.getVertex ( i ), 1.0f )).z < 0 )
+				behind++;
+
+		if ( behind > 0 )
+			return behind < 8;
+
+		for ( int i = 0; i < 8; i++ )
+		{
+			glm::vec3	s = toScreen ( p [i] );
+
+			minX = std::min ( minX, s.x );
+			maxX = std::max ( maxX, s.x );
+			minY = std::min ( minY, s.y );
+			maxY = std::max ( maxY, s.y );
+			zMin = std::min ( zMin, s.z );
+		}
+
+		if ( maxX < 0 || maxY < 0 || minX > width || minY > height || zMin > 1 )
+			return false;
+
+		for ( int y = std::max ( 0, int ( minY ) ); y <= std::min ( height - 1, int ( maxY ) ); y++ )
+			for ( int x = std::max ( 0, int ( minX ) ); x <= std::min ( width - 1, int ( maxX ) ); x++ )
+				if ( zMin < depth [y * width + x] )
+					return true;
+
+		return false;
+	}
+};
+
+int main ( int argc, const char * argv [] )
+{
+	std::vector<Vertex>		vertices;
+	std::vector<uint32_t>	indices;
+	std::vector<bbox>		boxes;
+	float					cell    = blockSize + streetSize;
+	float					extent  = gridSize * cell;
+	unsigned				threads = std::max ( 1u, std::thread::hardware_concurrency () );
+
+		// buildings of random height, objects are spread over the streets and inside blocks
+	for ( int i = 0; i < gridSize; i++ )
+		for ( int j = 0; j < gridSize; j++ )
+		{
+			glm::vec3	a ( i * cell + streetSize, 0, j * cell + streetSize );
+
+			addBox ( vertices, indices, a, a + glm::vec3 ( blockSize, rnd ( 10, 60 ), blockSize ) );
+		}
+
+	for ( int i = 0; i < numObjects; i++ )
+	{
+		glm::vec3	c ( rnd ( 0, extent ), rnd ( 0, 3 ), rnd ( 0, extent ) );
+		glm::vec3	h ( rnd ( 0.2f, 1.5f ) );
+
+		boxes.push_back ( bbox ( c - h, c + h ) );
+	}
+
+	printf ( "%d occluder triangles, %d objects, %dx%d buffer, %s, %u threads\n", int ( indices.size () / 3 ), numObjects, width, height, SoftwareOcclusion::simdName (), threads );
+
+	SoftwareOcclusion	culler ( width, height );
+	ReferenceBuffer		reference;
+	VisibilityMask		mask;
+	glm::mat4			proj    = glm::perspective ( glm::radians ( 60.0f ), 2.0f, 0.5f, 1000.0f );
+	double				time1   = 0;		// rasterization on one thread
+	double				timeN   = 0;		// rasterization on all threads
+	double				timeTest = 0;
+	size_t				visible = 0;
+	size_t				refVisible = 0;
+	size_t				errors  = 0;
+	size_t				tris    = 0;
+
+		// camera walks along the street at eye level
+	for ( int frame = 0; frame < numFrames; frame++ )
+	{
+		float		z        = streetSize * 0.5f + cell * (frame % gridSize);
+		glm::vec3	eye      ( extent * frame / numFrames, 1.7f, z );
+		glm::mat4	viewProj = proj * glm::lookAt ( eye, eye + glm::vec3 ( 1, 0, 0.2f ), glm::vec3 ( 0, 1, 0 ) );
+
+		double	t0 = now ();
+
+		culler.begin ( viewProj );
+		culler.addOccluder ( vertices, indices );
+		culler.rasterize ( 1 );
+
+		double	t1 = now ();
+
+		culler.begin ( viewProj );
+		culler.addOccluder ( vertices, indices );
+		culler.rasterize ( threads );
+
+		double	t2 = now ();
+
+		culler.testBoxes ( boxes, mask, threads );
+
+		double	t3 = now ();
+
+		time1    += t1 - t0;
+		timeN    += t2 - t1;
+		timeTest += t3 - t2;
+		visible  += mask.visibleCount ();
+		tris     += culler.triangleCount ();
+
+		reference.clear ( viewProj );
+		reference.mesh  ( vertices, indices );
+
+		for ( size_t i = 0; i < boxes.size (); i++ )
+		{
+			bool	ref = reference.isVisible ( boxes [i] );
+
+			refVisible += ref ? 1 : 0;
+
+			if ( ref && !mask.isVisible ( i ) )
+				errors++;
+		}
+	}
+
+	printf ( "Rasterize: 1 thread %.3f ms, %u threads %.3f ms per frame, %zu triangles after clipping\n", time1 / numFrames, threads, timeN / numFrames, tris / numFrames );
+	printf ( "Test boxes: %.3f ms per frame, %.1f ns per box\n", timeTest / numFrames, timeTest * 1e6 / (double ( numFrames ) * numObjects) );
+	printf ( "Visible: %zu of %d, reference %zu, wrongly culled %zu\n", visible / numFrames, numObjects, refVisible / numFrames, errors );
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+//
+// Benchmark: build time of RenderQueue (radix sort and merging) for scene with repeated
+// content submitted in random order, draws and state changes are compared with drawing
+// every packet in submission order. Sorted order is checked against std::sort
+//
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<chrono>
+#include	<algorithm>
+#include	<glm/glm.hpp>
+#include	<glm/gtc/matrix_transform.hpp>
+#include	"RenderQueue.h"
+#include	"Pipeline.h"
+#include	"Buffer.h"
+
+enum
+{
+	numObjects   = 100 * 1000,
+	numMeshes    = 64,
+	numBuffers   = 4,					// meshes share vertex and index buffers
+	numMaterials = 32,
+	numPipelines = 4,
+	numFrames    = 20
+};
+
+static double	now ()
+{
+	return std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ().time_since_epoch () ).count ();
+}
+
+static void	printStats ( const char * title, const RenderQueueStats& s )
+{
+	printf ( "%-10s draws %7zu, pipeline changes %7zu, material changes %7zu, buffer binds %7zu\n", title, s.draws, s.pipelineChanges, s.materialChanges, s.bufferBinds );
+}
+
+int main ( int argc, const char * argv [] )
+{
+	Buffer				vertexBuffers [numBuffers];		// only addresses are used, nothing is recorded
+	Buffer				indexBuffers  [numBuffers];
+	GraphicsPipeline	pipelines     [numPipelines];
+	RenderQueue			queue;
+
+	for ( int i = 0; i < numMeshes; i++ )
+	{
+		RenderMesh	mesh;
+
+		mesh.vertexBuffer = &vertexBuffers [i % numBuffers];
+		mesh.indexBuffer  = &indexBuffers  [i % numBuffers];
+		mesh.firstIndex   = 3000 * (i / numBuffers);
+		mesh.indexCount   = 3000;
+
+		queue.addMesh ( mesh );
+	}
+
+	for ( int i = 0; i < numMaterials; i++ )
+		queue.addMaterial ( glm::uvec4 ( i, i, i, i ) );
+
+	for ( auto& p : pipelines )
+		queue.addPipeline ( p );
+
+	queue.setCamera ( glm::vec3 ( 0 ), 1000.0f );
+
+	double	buildTime = 0;
+	double	stdTime   = 0;
+	size_t	errors    = 0;
+
+	for ( int frame = 0; frame < numFrames; frame++ )
+	{
+		queue.clear ();
+
+			// every object is a random mesh with one of few materials, every 16th one is transparent and goes to pass 1
+		for ( int i = 0; i < numObjects; i++ )
+		{
+			glm::vec3	pos ( rand () % 1000 - 500, rand () % 1000 - 500, rand () % 100 );
+			uint32_t	mesh = rand () % numMeshes;
+			bool		transparent = i % 16 == 0;
+
+			queue.submit ( mesh, (mesh * 7 + rand () % 4) % numMaterials, mesh % numPipelines, glm::translate ( glm::mat4 ( 1 ), pos ), transparent ? 1 : 0, transparent );
+		}
+
+		double	t0 = now ();
+
+		queue.build ();
+
+		double	t1 = now ();
+
+		std::vector<uint64_t>	keys;
+
+		for ( auto& p : queue.getPackets () )
+			keys.push_back ( p.key );
+
+		double	t2 = now ();
+
+		std::sort ( keys.begin (), keys.end () );
+
+		double	t3 = now ();
+
+		buildTime += t1 - t0;
+		stdTime   += t3 - t2;
+
+			// batches must give the same sequence of states as std::sort, instances must have their materials
+		size_t	k = 0;
+
+		for ( auto& b : queue.getBatches () )
+			for ( uint32_t i = 0; i < b.instanceCount; i++, k++ )
+			{
+				uint64_t	key         = keys [k];
+				bool		transparent = (key >> 60) == 1;
+				uint32_t	pipeline    = uint32_t ( key >> 52 ) & 0xFF;
+				uint32_t	material    = uint32_t ( transparent ? key >> 16 : key >> 36 ) & 0xFFFF;
+				uint32_t	mesh        = uint32_t ( transparent ? key       : key >> 20 ) & 0xFFFF;
+
+				if ( b.pipeline != pipeline || b.material != material || b.mesh != mesh || queue.getInstances () [b.firstInstance + i].albedo != material )
+					errors++;
+			}
+
+		if ( k != keys.size () )
+			errors++;
+	}
+
+	printf ( "%d packets, %d meshes in %d buffers, %d materials, %d pipelines\n", numObjects, numMeshes, numBuffers, numMaterials, numPipelines );
+	printf ( "Build (radix sort + merge): %.3f ms, std::sort of keys only: %.3f ms per frame, errors %zu\n", buildTime / numFrames, stdTime / numFrames, errors );
+	printStats ( "unsorted:", queue.getUnsortedStats () );
+	printStats ( "queue:",    queue.getStats () );
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+//
+// Benchmark: BasicVertex (56 bytes) vs PackedVertex (20 bytes) for the same dense knot
+// drawn many times with instancing. Press P to switch format, vertex buffer size
+// and average GPU time are logged
+//
+
+#include	"VulkanWindow.h"
+#include	"Buffer.h"
+#include	"DescriptorSet.h"
+#include	"Mesh.h"
+#include	"TimestampPool.h"
+#include	"Controller.h"
+
+struct UniformBufferObject
+{
+	glm::mat4 mv;
+	glm::mat4 proj;
+	glm::vec4 grid;						// grid size and spacing
+};
+
+class	ExampleWindow : public VulkanWindow
+{
+	enum
+	{
+		gridSize    = 10,				// gridSize^2 instances
+		statsFrames = 200				// frames to average GPU time
+	};
+
+	std::vector<CommandBuffer>					commandBuffers;
+	std::vector<DescriptorSet> 					descriptorSets;
+	std::vector<Uniform<UniformBufferObject>>	uniformBuffers;
+	GraphicsPipeline							pipelineBasic;
+	GraphicsPipeline							pipelinePacked;
+	Renderpass									renderPass;
+	std::unique_ptr<Mesh>						meshBasic;
+	std::unique_ptr<Mesh>						meshPacked;
+	TimestampPool								timestamps;
+	std::vector<bool>							submitted;		// timestamps of image's command buffer were written
+	bool										usePacked = true;
+	double										gpuTime   = 0;
+	int											gpuFrames = 0;
+	float										spacing   = 3.0f;
+	glm::vec3									eye       = glm::vec3 ( -30, 0, 0 );
+
+public:
+	ExampleWindow ( int w, int h, const std::string& t, DevicePolicy * p ) : VulkanWindow ( w, h, t, true, p )
+	{
+		setController ( new RotateController ( this, eye ) );
+
+		meshBasic  = std::unique_ptr<Mesh> ( createKnot ( device, 1.0f, 0.3f, 1000, 100 ) );
+		meshPacked = std::unique_ptr<Mesh> ( createKnot ( device, 1.0f, 0.3f, 1000, 100, MeshBuildFlags ().setPacked () ) );
+
+		for ( Mesh * m : { meshBasic.get (), meshPacked.get () } )
+			log () << (m->isPacked () ? "packed: " : "basic:  ") << m->getNumVertices () << " vertices, "
+				   << m->getNumVertices () * m->getVertexSize () / 1024 << " KB of vertex data" << Log::endl;
+
+		createPipelines ();
+	}
+
+	void	createUniformBuffers ()
+	{
+		uniformBuffers.resize ( swapChain.imageCount () );
+
+		for ( auto& ub : uniformBuffers )
+			ub.create ( device );
+	}
+
+	void	createDescriptorSets ()
+	{
+		descriptorSets.resize ( swapChain.imageCount () );
+
+		for ( uint32_t i = 0; i < swapChain.imageCount (); i++ )
+		{
+			descriptorSets [i]
+				.setLayout ( device, descAllocator, pipelineBasic.getDescLayout () )
+				.addBuffer ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers [i], 0, sizeof ( UniformBufferObject ) )
+				.create    ();
+		}
+	}
+
+	template <typename Vertex>
+	void	createPipeline ( GraphicsPipeline& pipeline, const std::string& vertexShader )
+	{
+		pipeline.setDevice ( device )
+				.setVertexShader   ( vertexShader )
+				.setFragmentShader ( "shaders/occlusion-scene.frag.spv" )
+				.setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
+				.addVertexBinding  ( sizeof ( Vertex ) )
+				.addVertexAttributes <Vertex> ()
+				.addDescLayout     ( 0, DescSetLayout ()
+					.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT ) )
+				.setCullMode       ( VK_CULL_MODE_NONE )
+				.setDepthTest      ( true )
+				.setDepthWrite     ( true )
+				.create            ( renderPass );
+	}
+
+	virtual	void	createPipelines () override
+	{
+		createUniformBuffers    ();
+		createDefaultRenderPass ( renderPass );
+		createPipeline<BasicVertex>  ( pipelineBasic,  "shaders/vertex-basic.vert.spv"  );
+		createPipeline<PackedVertex> ( pipelinePacked, "shaders/vertex-packed.vert.spv" );
+
+				// create before command buffers
+		swapChain.createFramebuffers ( renderPass, depthTexture.getImageView () );
+
+		timestamps.create    ( device, 2 * swapChain.imageCount () );
+		createDescriptorSets ();
+		createCommandBuffers ();
+	}
+
+	virtual	void	freePipelines () override
+	{
+		commandBuffers.clear  ();
+		pipelineBasic.clean   ();
+		pipelinePacked.clean  ();
+		renderPass.clean      ();
+		uniformBuffers.clear  ();
+		descriptorSets.clear  ();
+		timestamps.destroy    ();
+		descAllocator.clean   ();
+	}
+
+	virtual	void	submit ( uint32_t imageIndex ) override
+	{
+		std::vector<uint64_t>	ts ( 2 );
+
+			// previous submission of this command buffer is completed here
+		if ( submitted [imageIndex] && timestamps.getResults ( ts, 2 * imageIndex, 2 ) && ts [1] > ts [0] )
+		{
+			gpuTime += timestamps.convertToMs ( ts [1] - ts [0] );
+
+			if ( ++gpuFrames == statsFrames )
+			{
+				log () << (usePacked ? "packed" : "basic") << ": GPU time " << gpuTime / gpuFrames << " ms" << Log::endl;
+
+				gpuTime   = 0;
+				gpuFrames = 0;
+			}
+		}
+
+		updateUniformBuffer ( imageIndex );
+
+		defaultSubmit ( commandBuffers [imageIndex] );
+
+		submitted [imageIndex] = true;
+	}
+
+	virtual	void	keyTyped ( int key, int scancode, int action, int mods ) override
+	{
+		if ( key == 'P' && action == GLFW_RELEASE )		// switch vertex format
+		{
+			usePacked = !usePacked;
+			gpuTime   = 0;
+			gpuFrames = 0;
+
+			vkDeviceWaitIdle     ( device.getDevice () );
+			createCommandBuffers ();
+		}
+
+		VulkanWindow::keyTyped ( key, scancode, action, mods );
+	}
+
+	void	createCommandBuffers ()
+	{
+		auto	framebuffers = swapChain.getFramebuffers ();
+
+		commandBuffers = device.allocCommandBuffers ( (uint32_t)framebuffers.size ());
+		submitted.assign ( commandBuffers.size (), false );
+
+		for ( size_t i = 0; i < commandBuffers.size(); i++ )
+		{
+			CommandBuffer&	cb = commandBuffers [i];
+
+			cb.begin ();
+
+			timestamps.reset          ( cb, 2 * (uint32_t) i, 2 );
+			timestamps.writeTimestamp ( cb, 2 * (int) i, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT );
+
+			cb.beginRenderPass ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor ().clearDepthStencil () )
+			  .pipeline          ( usePacked ? pipelinePacked : pipelineBasic )
+			  .addDescriptorSets ( { descriptorSets [i] } )
+			  .setViewport       ( swapChain.getExtent () )
+			  .setScissor        ( swapChain.getExtent () );
+
+			(usePacked ? meshPacked : meshBasic)->render ( cb, gridSize * gridSize );
+
+			timestamps.writeTimestamp ( cb, 2 * (int) i + 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT );
+			cb.end ();
+		}
+	}
+
+	void updateUniformBuffer ( uint32_t currentImage )
+	{
+		UniformBufferObject	ubo  = {};
+
+		ubo.mv   = controller->getModelView ();
+		ubo.proj = projectionMatrix ( 45, getAspect (), 0.1f, 200.0f );
+		ubo.grid = glm::vec4 ( gridSize, spacing, 0, 0 );
+
+		*uniformBuffers [currentImage].getPtr () = ubo;
+	}
+};
+
+int main ( int argc, const char * argv [] )
+{
+	DevicePolicy	policy;
+
+	return ExampleWindow ( 1200, 1200, "Vertex format benchmark", &policy ).run ();
+}
@@ -3,6 +3,7 @@
 #include	"VulkanWindow.h"
 #include	"Buffer.h"
 #include	"DescriptorSet.h"
+#include	"BindlessHeap.h"
 #include	"Mesh.h"
 #include	"Controller.h"
 
@@ -13,6 +14,12 @@ struct Ubo
 	glm::mat4 proj;
 };
 
+struct	TextureIndices			// indices into bindless heap
+{
+	uint32_t	firstTexture;
+	uint32_t	sampler;
+};
+
 class	ExampleWindow : public VulkanWindow
 {
 	std::vector<CommandBuffer>		commandBuffers;
@@ -22,6 +29,8 @@ class	ExampleWindow : public VulkanWindow
 	Renderpass						renderPass;
 	std::vector<Texture>			textures;
 	Sampler							sampler;
+	BindlessHeap					heap;
+	TextureIndices					indices;
 	std::unique_ptr<Mesh>           mesh;
 	Buffer							buffer;
 
@@ -32,9 +41,12 @@ public:
 
 		mesh = std::unique_ptr<Mesh> ( createKnot ( device, 1.0f, 0.8f, 120, 30 ) );
 
-		descAllocator.setFlags ( VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT  );
+		if ( !heap.create ( device, 1024, 16, 1024, VK_SHADER_STAGE_FRAGMENT_BIT, swapChain.framesInFlight () ) )
+			fatal () << "Cannot create bindless heap" << Log::endl;
+
 		createTextures  ();
 		sampler.create  ( device );		// use default options
+		indices.sampler = heap.addSampler ( sampler );
 		createPipelines ();
 	}
 
@@ -48,6 +60,14 @@ public:
 			if ( !textures [i].load ( device, texPath + texs [i] ) )
 				fatal () << "Error loading texture " << texs [i] << std::endl;
 
+			// textures are registered in order, so their indices are consecutive
+		for ( size_t i = 0; i < textures.size (); i++ )
+		{
+			uint32_t	index = heap.addTexture ( textures [i] );
+
+			if ( i == 0 )
+				indices.firstTexture = index;
+		}
 	}
 
 	void	createUniformBuffers ()
@@ -72,15 +92,12 @@ public:
 			descriptorSets  [i]
 				.setLayout        ( device, descAllocator, pipeline.getDescLayout () )
 				.addUniformBuffer ( 0, uniformBuffers [i], 0, sizeof ( Ubo ) )
-				.addSampler       ( 1, sampler )
-				.addImageArray    ( 2, textures )
 				.create           ();
 		}
 	}
 	
 	virtual	void	createPipelines () override 
 	{
-		VkDescriptorBindingFlags descFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;	//VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT | VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
 		DescSetLayout	layout;
 
 		createUniformBuffers    ();
@@ -88,10 +105,7 @@ public:
 
 		layout
 			.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT )
-			.add ( 1, VK_DESCRIPTOR_TYPE_SAMPLER,		 VK_SHADER_STAGE_FRAGMENT_BIT )
-			.add ( 2, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,  VK_SHADER_STAGE_FRAGMENT_BIT, uint32_t ( textures.size () ) )
-			.addFlags ( { 0, 0, descFlags } )
-			.create ( device.getDevice (), VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT );
+			.create ( device.getDevice () );
 
 		pipeline.setDevice ( device )
 				.setVertexShader   ( "shaders/shader-bindless.vert.spv" )
@@ -100,6 +114,8 @@ public:
 				.addVertexBinding  ( sizeof ( BasicVertex ) )
 				.addVertexAttributes <BasicVertex> ()
 				.addDescLayout     ( 0, layout )
+				.addDescLayout     ( 1, DescSetLayout ( heap.getLayout () ) )
+				.addPushConstRange ( VK_SHADER_STAGE_FRAGMENT_BIT, sizeof ( TextureIndices ) )
 			.setCullMode       ( VK_CULL_MODE_NONE)
 			.setDepthTest      ( true )
 			.setDepthWrite     ( true )
@@ -124,6 +140,7 @@ public:
 	
 	virtual	void	submit ( uint32_t imageIndex ) override 
 	{
+		heap.beginFrame     ();
 		updateUniformBuffer ( imageIndex );
 		defaultSubmit       ( commandBuffers [imageIndex] );
 	}
@@ -141,6 +158,8 @@ public:
 				.beginRenderPass   ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor (0,0,0,1).clearDepthStencil () )
 				.pipeline          ( pipeline )
 				.addDescriptorSets ( { descriptorSets[i] } )
+				.bindDescriptorSet ( 1, heap.getHandle () )			// single bind for all textures
+				.pushConstants     ( pipeline.getLayout (), VK_SHADER_STAGE_FRAGMENT_BIT, indices )
 				.setViewport       ( swapChain.getExtent () )
 				.setScissor        ( swapChain.getExtent () )
 				.render            ( mesh.get () )
@@ -161,16 +180,8 @@ int main ( int argc, const char * argv [] )
 	DevicePolicy								policy;
 	VkPhysicalDeviceDescriptorIndexingFeatures	featuresIndexing = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES   };
 
-	featuresIndexing.shaderSampledImageArrayNonUniformIndexing    = VK_TRUE;
-	featuresIndexing.runtimeDescriptorArray                       = VK_TRUE;
-	featuresIndexing.shaderSampledImageArrayNonUniformIndexing    = VK_TRUE;
-	featuresIndexing.runtimeDescriptorArray                       = VK_TRUE;
-	featuresIndexing.descriptorBindingVariableDescriptorCount     = VK_TRUE;
-	featuresIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
-	featuresIndexing.descriptorBindingUpdateUnusedWhilePending    = VK_TRUE;
-	featuresIndexing.descriptorBindingPartiallyBound              = VK_TRUE;
-		             
-	policy.addFeatures ( &featuresIndexing );
+	BindlessHeap::enableFeatures ( featuresIndexing );
+	policy.addFeatures           ( &featuresIndexing );
 
 	return ExampleWindow ( 800, 600, "Vulkan bindless", true,  &policy ).run ();
 }
@@ -170,8 +170,8 @@ public:
 				.setVertexShader   ( "shaders/depthpass.vert.spv" )
 				.setFragmentShader ( "shaders/depthpass.frag.spv" )
 				.setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
-				.addVertexBinding  ( sizeof ( BasicVertex ) )
-				.addVertexAttributes<BasicVertex> ()
+				.addVertexBinding  ( sizeof ( PositionVertex ) )
+				.addVertexAttributes<PositionVertex> ()
 				.addDescLayout     ( 0, DescSetLayout ()
 							.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         VK_SHADER_STAGE_VERTEX_BIT	)
 							.add ( 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT ) 		// decal
@@ -245,9 +245,9 @@ public:
 
 		offscreenCmd.begin ( true ).beginRenderPass ( RenderPassInfo ( fb.getRenderpass() ).clearDepthStencil ().framebuffer ( fb ).extent ( fb.getWidth (), fb.getHeight () ) )
 			.pipeline          ( offscreenPipeline )
-			.addDescriptorSets ( { offscreenDescriptorSet1 } ).render ( box1 )
-			.addDescriptorSets ( { offscreenDescriptorSet2 } ).render ( box2 ).render ( box3 ).render ( box4 ).render ( box5 )
-			.addDescriptorSets ( { offscreenDescriptorSet3 } ).render ( knot )
+			.addDescriptorSets ( { offscreenDescriptorSet1 } ).renderDepth ( box1 )
+			.addDescriptorSets ( { offscreenDescriptorSet2 } ).renderDepth ( box2 ).renderDepth ( box3 ).renderDepth ( box4 ).renderDepth ( box5 )
+			.addDescriptorSets ( { offscreenDescriptorSet3 } ).renderDepth ( knot )
 			.end               ();
 	}
 	
@@ -0,0 +1,293 @@
+//
+// GPU-driven rendering with frustum and two-phase Hi-Z occlusion culling:
+// objects visible against previous frame pyramid are drawn first, then pyramid is built
+// from this depth and the rest is retested and drawn, so disoccluded objects do not pop.
+// Scene is a set of walls with many small cubes between them, culling counters are logged
+//
+
+#include	"VulkanWindow.h"
+#include	"Buffer.h"
+#include	"DescriptorSet.h"
+#include	"Model.h"
+#include	"GpuCulling.h"
+#include	"HiZPyramid.h"
+#include	"Controller.h"
+
+struct UniformBufferObject
+{
+	glm::mat4 model;
+	glm::mat4 proj;
+	glm::vec4 eye;
+	glm::vec4 light;
+};
+
+class	ExampleWindow : public VulkanWindow
+{
+	enum
+	{
+		numWalls    = 5,
+		gridSize    = 20,					// gridSize^2 cubes behind every wall
+		statsFrames = 100					// log counters every statsFrames frames
+	};
+
+	std::vector<CommandBuffer>		commandBuffers;
+	std::vector<DescriptorSet> 		descriptorSets;
+	std::vector<Buffer>				uniformBuffers;
+	GraphicsPipeline				pipeline;
+	Renderpass						renderPass;			// clears attachments, used for first phase
+	Renderpass						renderPassLoad;		// keeps attachments, used for second phase
+	Model							model;
+	HiZPyramid						pyramid;
+	GpuCulling						culling;
+	Sampler							sampler;
+	int								frame = 0;
+	glm::vec3						light = glm::vec3 ( -12, 0, 0 );
+	glm::vec3						eye   = glm::vec3 ( -12, 0, 0 );
+
+public:
+	ExampleWindow ( int w, int h, const std::string& t, DevicePolicy * p ) : VulkanWindow ( w, h, t, true, p )
+	{
+		setController ( new RotateController ( this, eye ) );
+
+		createModel    ();
+		sampler.create ( device );		// use default options
+
+		createPipelines ();
+	}
+
+		// walls are unit cubes scaled to thin panels, all primitives share the same 36 indices
+	void	createModel ()
+	{
+		static const glm::vec3	normals [6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+
+		std::vector<BasicVertex>	vertices;
+		std::vector<GLuint>			indices;
+		std::vector<glm::uvec2>		ranges;
+		std::vector<glm::mat4>		transforms;
+
+		for ( int f = 0; f < 6; f++ )
+		{
+			glm::vec3	n    = normals [f];
+			glm::vec3	t    = glm::vec3 ( n.y != 0 || n.z != 0 ? 1 : 0, n.x != 0 ? 1 : 0, 0 );
+			glm::vec3	b    = glm::cross ( n, t );
+			GLuint		base = (GLuint) vertices.size ();
+
+			for ( int k = 0; k < 4; k++ )
+			{
+				glm::vec2	tex ( k & 1, k >> 1 );
+				BasicVertex	v ( n + (2.0f * tex.x - 1.0f) * t + (2.0f * tex.y - 1.0f) * b, tex );
+
+				v.n = n;
+				v.t = t;
+				v.b = b;
+
+				vertices.push_back ( v );
+			}
+
+			for ( GLuint k : { 0, 1, 3, 0, 3, 2 } )
+				indices.push_back ( base + k );
+		}
+
+		for ( int w = 0; w < numWalls; w++ )
+		{
+			float	x = -4.0f + 2.0f * w;
+
+			ranges.push_back     ( glm::uvec2 ( 0, 36 ) );
+			transforms.push_back ( glm::scale ( glm::translate ( glm::mat4 ( 1 ), glm::vec3 ( x, 0, 0 ) ), glm::vec3 ( 0.05f, 3, 3 ) ) );
+
+			for ( int i = 0; i < gridSize; i++ )
+				for ( int j = 0; j < gridSize; j++ )
+				{
+					glm::vec3	pos ( x + 1, 2.8f * (2.0f * i / (gridSize - 1) - 1), 2.8f * (2.0f * j / (gridSize - 1) - 1) );
+
+					ranges.push_back     ( glm::uvec2 ( 0, 36 ) );
+					transforms.push_back ( glm::scale ( glm::translate ( glm::mat4 ( 1 ), pos ), glm::vec3 ( 0.08f ) ) );
+				}
+		}
+
+		if ( !model.create ( device, vertices, indices, ranges, transforms, "textures/texture.jpg" ) )
+			fatal () << "Cannot create model" << Log::endl;
+
+		log () << "Model with " << model.primitiveCount () << " primitives" << Log::endl;
+	}
+
+	void	createUniformBuffers ()
+	{
+		uniformBuffers.resize ( swapChain.imageCount() );
+
+		for ( size_t i = 0; i < swapChain.imageCount (); i++ )
+			uniformBuffers [i].create ( device, sizeof ( UniformBufferObject ), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+	}
+
+	void	freeUniformBuffers ()
+	{
+		uniformBuffers.clear ();
+	}
+
+		// pyramid depends on depth texture, so it is recreated with swap chain
+	void	createCulling ()
+	{
+		std::vector<GpuObject>	objects;
+
+		model.collectObjects ( objects );
+
+		if ( !pyramid.create ( device, descAllocator, depthTexture ) )
+			fatal () << "Cannot create Hi-Z pyramid" << Log::endl;
+
+		if ( !culling.create ( device, descAllocator, objects, swapChain.imageCount (), &pyramid ) )
+			fatal () << "Cannot create GPU culling" << Log::endl;
+	}
+
+	void	createDescriptorSets ()
+	{
+		descriptorSets.resize ( swapChain.imageCount () );
+
+		for ( uint32_t i = 0; i < swapChain.imageCount (); i++ )
+		{
+			descriptorSets  [i]
+				.setLayout      ( device, descAllocator, pipeline.getDescLayout () )
+				.addBuffer      ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers [i], 0, sizeof ( UniformBufferObject ) )
+				.addSampler     ( 1, sampler )
+				.addImageArray  ( 2, model.getTextures () )
+				.addBuffer      ( 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, culling.getObjectBuffer () )
+				.create    ();
+		}
+	}
+
+	virtual	void	createPipelines () override
+	{
+		createUniformBuffers    ();
+		createDefaultRenderPass ( renderPass );
+
+		renderPassLoad
+			.addAttachment   ( swapChain.getFormat (),       VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_ATTACHMENT_LOAD_OP_LOAD )
+			.addAttachment   ( depthTexture.getFormat (),    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_LOAD_OP_LOAD )
+			.addSubpass      ( 0 )
+			.addDepthSubpass ( 1 )
+			.create          ( device );
+
+		pipeline.setDevice ( device )
+				.setVertexShader   ( "shaders/model-pbr-culled.vert.spv" )
+				.setFragmentShader ( "shaders/model-pbr-culled.frag.spv" )
+				.setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
+				.addVertexBinding  ( sizeof ( BasicVertex ) )
+				.addVertexAttributes <BasicVertex> ()
+				.addDescLayout     ( 0, DescSetLayout ()
+					.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,    VK_SHADER_STAGE_VERTEX_BIT )
+					.add ( 1, VK_DESCRIPTOR_TYPE_SAMPLER,           VK_SHADER_STAGE_FRAGMENT_BIT )
+					.add ( 2, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,     VK_SHADER_STAGE_FRAGMENT_BIT, (uint32_t) model.getTextures ().size () )
+					.add ( 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,    VK_SHADER_STAGE_VERTEX_BIT ) )
+				.setCullMode       ( VK_CULL_MODE_NONE               )
+				.setDepthTest      ( true )
+				.setDepthWrite     ( true )
+				.create            ( renderPass );			// compatible with renderPassLoad
+
+				// create before command buffers
+		swapChain.createFramebuffers ( renderPass, depthTexture.getImageView () );
+
+		createCulling        ();
+		createDescriptorSets ();
+		createCommandBuffers ();
+	}
+
+	virtual	void	freePipelines () override
+	{
+		commandBuffers.clear ();
+		pipeline.clean       ();
+		renderPass.clean     ();
+		renderPassLoad.clean ();
+		freeUniformBuffers   ();
+		descriptorSets.clear ();
+		culling.clean        ();
+		pyramid.clean        ();
+		descAllocator.clean  ();
+	}
+
+	virtual	void	submit ( uint32_t imageIndex ) override
+	{
+			// previous submission of this command buffer is completed here
+		if ( ++frame % statsFrames == 0 )
+		{
+			auto	stats = culling.getStats ( imageIndex );
+
+			log () << "objects " << culling.getObjectCount () << ", frustum culled " << stats.frustumCulled << ", occluded " << stats.occluded
+				   << ", drawn late " << stats.earlyOccluded - stats.occluded << Log::endl;
+		}
+
+		updateUniformBuffer ( imageIndex );
+
+		defaultSubmit ( commandBuffers [imageIndex] );
+	}
+
+	void	createCommandBuffers ()
+	{
+		auto	framebuffers = swapChain.getFramebuffers ();
+		auto&	images       = swapChain.getImages       ();
+
+		commandBuffers = device.allocCommandBuffers ( (uint32_t)framebuffers.size ());
+
+		for ( size_t i = 0; i < commandBuffers.size(); i++ )
+		{
+			CommandBuffer&	cb = commandBuffers [i];
+
+			cb.begin ();
+
+				// first phase: objects not occluded by previous frame pyramid
+			culling.cull ( cb, (uint32_t) i );
+
+			cb.beginRenderPass ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor ().clearDepthStencil () )
+			  .pipeline          ( pipeline )
+			  .addDescriptorSets ( { descriptorSets[i] } )
+			  .setViewport       ( swapChain.getExtent () )
+			  .setScissor        ( swapChain.getExtent () );
+
+			model.bindBuffers ( cb );
+			culling.draw      ( cb, (uint32_t) i );
+			cb.endRenderPass  ();
+
+				// second phase: pyramid from this depth, retest occluded objects
+			pyramid.build    ( cb );
+			culling.cullLate ( cb, (uint32_t) i );
+
+			pipelineBarrier ( cb, { imageBarrier ( images [i], VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+												   VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR ) } );
+
+			cb.beginRenderPass ( RenderPassInfo ( renderPassLoad ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ) )
+			  .pipeline          ( pipeline )
+			  .addDescriptorSets ( { descriptorSets[i] } )
+			  .setViewport       ( swapChain.getExtent () )
+			  .setScissor        ( swapChain.getExtent () );
+
+			model.bindBuffers ( cb );
+			culling.drawLate  ( cb, (uint32_t) i );
+
+			cb.end ();
+		}
+	}
+
+	void updateUniformBuffer ( uint32_t currentImage )
+	{
+		UniformBufferObject ubo  = {};
+
+		ubo.model = controller->getModelView  ();
+		ubo.proj  = projectionMatrix ( 45, getAspect (), 0.1f, 100.0f );
+		ubo.eye   = glm::vec4 ( eye, 1.0f );
+		ubo.light = glm::vec4 ( light, 1.0 );
+
+		uniformBuffers [currentImage].copy ( &ubo, sizeof ( ubo ) );
+		culling.update ( currentImage, ubo.proj * ubo.model );
+	}
+};
+
+int main ( int argc, const char * argv [] )
+{
+	DevicePolicy						policy;
+	VkPhysicalDeviceVulkan12Features	features12 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+
+	policy.features.features.drawIndirectFirstInstance = VK_TRUE;		// object id is passed in firstInstance
+	features12.drawIndirectCount                       = VK_TRUE;		// number of draws is written by cull-hiz.comp
+
+	policy.addFeatures12 ( features12 );
+
+	return ExampleWindow ( 1200, 1200, "Hi-Z occlusion culling", &policy ).run ();
+}
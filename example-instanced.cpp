@@ -4,6 +4,7 @@
 #include	"DescriptorSet.h"
 #include	"Mesh.h"
 #include	"Controller.h"
+#include	"InstanceBuffer.h"
 
 struct Ubo
 {
@@ -15,6 +16,11 @@ struct Ubo
 
 class	InstancedWindow : public VulkanWindow
 {
+	enum
+	{
+		gridSize = 8					// gridSize^3 instances
+	};
+
 	std::vector<CommandBuffer>		commandBuffers;
 	std::vector<DescriptorSet> 		descriptorSets;
 	std::vector<Uniform<Ubo>>		uniformBuffers;
@@ -23,6 +29,8 @@ class	InstancedWindow : public VulkanWindow
 	Texture							texture;
 	Sampler							sampler;
 	std::unique_ptr<Mesh>			mesh;
+	InstanceBuffer<>				instances;
+	uint32_t						frame = 0;
 
 public:
 	InstancedWindow ( int w, int h, const std::string& t ) : VulkanWindow ( w, h, t )
@@ -33,6 +41,11 @@ public:
 		
 		sampler.create  ( device );		// use default options	
 		texture.load    ( device, "../../Textures/block.jpg", false );
+		instances.create ( device, gridSize * gridSize * gridSize, swapChain.imageCount () );
+
+		for ( int i = 0; i < gridSize * gridSize * gridSize; i++ )
+			instances.add ( { glm::translate ( glm::mat4 ( 1 ), gridPos ( i ) ), glm::vec4 ( 1 ) } );
+
 		createPipelines ();
 	}
 
@@ -59,6 +72,7 @@ public:
 				.setLayout        ( device, descAllocator, pipeline.getDescLayout () )
 				.addUniformBuffer ( 0, uniformBuffers [i], 0, sizeof ( Ubo ) )
 				.addImage         ( 1, texture, sampler )
+				.addStorageBuffer ( 2, instances.getBuffer ( i ) )
 				.create           ();
 		}
 	}
@@ -76,7 +90,8 @@ public:
 				.addVertexAttributes <BasicVertex> ()
 				.addDescLayout     ( 0, DescSetLayout ()
 					.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         VK_SHADER_STAGE_VERTEX_BIT )
-					.add ( 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT ) )
+					.add ( 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT )
+					.add ( 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         VK_SHADER_STAGE_VERTEX_BIT ) )
 				.setCullMode       ( VK_CULL_MODE_NONE               )
 			.setDepthTest      ( true )
 			.setDepthWrite     ( true )
@@ -102,6 +117,8 @@ public:
 	virtual	void	submit ( uint32_t imageIndex ) override 
 	{
 		updateUniformBuffer ( imageIndex );
+		updateInstances     ();
+		instances.flush     ( imageIndex );			// only changed blocks of this image's copy
 		defaultSubmit       ( commandBuffers [imageIndex] );
 	}
 
@@ -120,11 +137,28 @@ public:
 				.addDescriptorSets ( { descriptorSets[i] } )
 				.setViewport       ( swapChain.getExtent () )
 				.setScissor        ( swapChain.getExtent () )
-				.renderInstanced   ( mesh.get (), 8*64 )		// draw 64 instances
+				.renderInstanced   ( mesh.get (), instances )		// draw all instances
 				.end               ();
 		}
 	}
 
+	static glm::vec3	gridPos ( int i )
+	{
+		return glm::vec3 ( i % gridSize, (i / gridSize) % gridSize, i / (gridSize * gridSize) ) * 2.0f - glm::vec3 ( gridSize );
+	}
+
+		// spin one layer of gridSize^2 instances per frame, the rest stay untouched
+	void	updateInstances ()
+	{
+		float		time  = (float)getTime ();
+		uint32_t	num   = gridSize * gridSize;
+		uint32_t	first = (frame++ % gridSize) * num;
+		auto	  * data  = instances.modify ( first, num );
+
+		for ( uint32_t i = 0; i < num; i++ )
+			data [i].matrix = glm::rotate ( glm::translate ( glm::mat4 ( 1 ), gridPos ( first + i ) ), time, glm::vec3 ( 0, 1, 0 ) );
+	}
+
 	void updateUniformBuffer ( uint32_t currentImage )
 	{
 		uniformBuffers [currentImage]->model = controller->getModelView  ();
@@ -0,0 +1,251 @@
+//
+// Levels of detail: crowd of knots, every knot gets level by projected screen-space error
+// of its LOD chain built by MeshSimplifier. Levels are drawn with one indirect command each,
+// near switching distance two levels are crossfaded with complementary dither patterns.
+// Press F to toggle crossfade, L to toggle LODs
+//
+
+#include	"VulkanWindow.h"
+#include	"Buffer.h"
+#include	"DescriptorSet.h"
+#include	"Mesh.h"
+#include	"LodSelector.h"
+#include	"Controller.h"
+
+struct UniformBufferObject
+{
+	glm::mat4 mv;
+	glm::mat4 proj;
+};
+
+struct	LodInstance
+{
+	glm::vec4	pos;
+	float		fade;
+	uint32_t	second;
+	float		pad [2];
+};
+
+class	ExampleWindow : public VulkanWindow
+{
+	enum
+	{
+		gridSize = 50,					// gridSize^2 knots
+		numLods  = 6
+	};
+
+	std::vector<CommandBuffer>					commandBuffers;
+	std::vector<DescriptorSet> 					descriptorSets;
+	std::vector<Uniform<UniformBufferObject>>	uniformBuffers;
+	std::vector<PersistentBuffer>				instanceBuffers;	// region of gridSize^2 instances per level
+	std::vector<PersistentBuffer>				indirectBuffers;	// draw command per level
+	GraphicsPipeline							pipeline;
+	Renderpass									renderPass;
+	std::unique_ptr<Mesh>						mesh;
+	std::vector<glm::vec3>						positions;
+	LodSelector									selector;
+	bool										useLods  = true;
+	bool										useFade  = true;
+	float										spacing  = 4.0f;
+	float										fov      = 45.0f;
+	size_t										frame    = 0;
+	glm::vec3									eye      = glm::vec3 ( -10, 0, 0 );
+
+public:
+	ExampleWindow ( int w, int h, const std::string& t ) : VulkanWindow ( w, h, t, true )
+	{
+		setController ( new RotateController ( this, eye ) );
+
+		mesh = std::unique_ptr<Mesh> ( createKnot ( device, 1.0f, 0.3f, 400, 40, MeshBuildFlags ().setLods ( numLods ) ) );
+
+		for ( auto& lod : mesh->getLods () )
+			log () << "lod triangles " << lod.indexCount / 3 << ", error " << lod.error << Log::endl;
+
+			// crowd goes away from the eye
+		for ( int i = 0; i < gridSize; i++ )
+			for ( int j = 0; j < gridSize; j++ )
+				positions.push_back ( glm::vec3 ( i * spacing, 0, (j - gridSize / 2) * spacing ) );
+
+		selector.setThreshold ( 1.0f ).setFadeRange ( 0.5f );
+
+		createPipelines ();
+	}
+
+	void	createBuffers ()
+	{
+		uniformBuffers.resize  ( swapChain.imageCount () );
+		instanceBuffers.resize ( swapChain.imageCount () );
+		indirectBuffers.resize ( swapChain.imageCount () );
+
+		for ( auto& ub : uniformBuffers )
+			ub.create ( device );
+
+		for ( auto& buf : instanceBuffers )
+			if ( !buf.create ( device, numLods * positions.size () * sizeof ( LodInstance ), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, Buffer::hostWrite ) )
+				fatal () << "LOD: cannot create instance buffer" << Log::endl;
+
+		for ( auto& buf : indirectBuffers )
+			if ( !buf.create ( device, numLods * sizeof ( VkDrawIndexedIndirectCommand ), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, Buffer::hostWrite ) )
+				fatal () << "LOD: cannot create indirect buffer" << Log::endl;
+	}
+
+	void	createDescriptorSets ()
+	{
+		descriptorSets.resize ( swapChain.imageCount () );
+
+		for ( uint32_t i = 0; i < swapChain.imageCount (); i++ )
+		{
+			descriptorSets [i]
+				.setLayout ( device, descAllocator, pipeline.getDescLayout () )
+				.addBuffer ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers [i], 0, sizeof ( UniformBufferObject ) )
+				.addBuffer ( 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, instanceBuffers [i] )
+				.create    ();
+		}
+	}
+
+	virtual	void	createPipelines () override
+	{
+		createBuffers           ();
+		createDefaultRenderPass ( renderPass );
+
+		pipeline.setDevice ( device )
+				.setVertexShader   ( "shaders/lod.vert.spv" )
+				.setFragmentShader ( "shaders/lod.frag.spv" )
+				.setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
+				.addVertexBinding  ( sizeof ( BasicVertex ) )
+				.addVertexAttributes <BasicVertex> ()
+				.addDescLayout     ( 0, DescSetLayout ()
+					.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT )
+					.add ( 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT ) )
+				.addPushConstRange ( VK_SHADER_STAGE_VERTEX_BIT, sizeof ( uint32_t ) )
+				.setCullMode       ( VK_CULL_MODE_NONE )
+				.setDepthTest      ( true )
+				.setDepthWrite     ( true )
+				.create            ( renderPass );
+
+				// create before command buffers
+		swapChain.createFramebuffers ( renderPass, depthTexture.getImageView () );
+
+		createDescriptorSets ();
+		createCommandBuffers ();
+	}
+
+	virtual	void	freePipelines () override
+	{
+		commandBuffers.clear  ();
+		pipeline.clean        ();
+		renderPass.clean      ();
+		uniformBuffers.clear  ();
+		instanceBuffers.clear ();
+		indirectBuffers.clear ();
+		descriptorSets.clear  ();
+		descAllocator.clean   ();
+	}
+
+	virtual	void	submit ( uint32_t imageIndex ) override
+	{
+		updateUniformBuffer ( imageIndex );
+		updateInstances     ( imageIndex );
+
+		defaultSubmit ( commandBuffers [imageIndex] );
+	}
+
+	virtual	void	keyTyped ( int key, int scancode, int action, int mods ) override
+	{
+		if ( key == 'F' && action == GLFW_RELEASE )
+		{
+			useFade = !useFade;
+			selector.setFadeRange ( useFade ? 0.5f : 0.0f );
+		}
+		else
+		if ( key == 'L' && action == GLFW_RELEASE )
+			useLods = !useLods;
+
+		VulkanWindow::keyTyped ( key, scancode, action, mods );
+	}
+
+		// commands are static, only instance regions and instance counts change every frame
+	void	createCommandBuffers ()
+	{
+		auto	framebuffers = swapChain.getFramebuffers ();
+
+		commandBuffers = device.allocCommandBuffers ( (uint32_t)framebuffers.size ());
+
+		for ( size_t i = 0; i < commandBuffers.size(); i++ )
+		{
+			CommandBuffer&	cb = commandBuffers [i];
+
+			cb.begin ();
+			cb.beginRenderPass ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor ().clearDepthStencil () )
+			  .pipeline          ( pipeline )
+			  .addDescriptorSets ( { descriptorSets [i] } )
+			  .setViewport       ( swapChain.getExtent () )
+			  .setScissor        ( swapChain.getExtent () )
+			  .bindVertexBuffers ( { { mesh->getVertexBuffer (), 0 } } )
+			  .bindIndexBuffer   ( mesh->getIndexBuffer (), mesh->getIndexType () );
+
+			for ( uint32_t lod = 0; lod < (uint32_t) mesh->getLodCount (); lod++ )
+			{
+				uint32_t	base = lod * (uint32_t) positions.size ();
+
+				cb.pushConstants       ( pipeline.getLayout (), VK_SHADER_STAGE_VERTEX_BIT, base );
+				cb.drawIndexedIndirect ( indirectBuffers [i], 1, lod * sizeof ( VkDrawIndexedIndirectCommand ) );
+			}
+
+			cb.end ();
+		}
+	}
+
+		// select level for every knot using eye position in object space
+	void	updateInstances ( uint32_t imageIndex )
+	{
+		const std::vector<MeshLod>&	lods     = mesh->getLods ();
+		LodInstance				  * instances = (LodInstance *) instanceBuffers [imageIndex].getPtr ();
+		auto					  * commands  = (VkDrawIndexedIndirectCommand *) indirectBuffers [imageIndex].getPtr ();
+		glm::vec3					center    = mesh->getBox ().getCenter ();
+		float						radius    = 0.5f * glm::length ( mesh->getBox ().getSize () );
+		size_t						n         = positions.size ();
+		std::vector<uint32_t>		counts ( lods.size (), 0 );
+
+		selector.setView ( glm::vec3 ( glm::inverse ( controller->getModelView () ) * glm::vec4 ( 0, 0, 0, 1 ) ), fov, (float) swapChain.getExtent ().height );
+
+		for ( auto& pos : positions )
+		{
+			LodChoice	choice;
+
+			if ( useLods )
+				choice = selector.select ( lods, pos + center, radius );
+
+			instances [choice.lod * n + counts [choice.lod]++] = { glm::vec4 ( pos, 1 ), choice.fade, 0, { 0, 0 } };
+
+			if ( choice.next >= 0 )
+				instances [choice.next * n + counts [choice.next]++] = { glm::vec4 ( pos, 1 ), choice.fade, 1, { 0, 0 } };
+		}
+
+		size_t	triangles = 0;
+
+		for ( size_t i = 0; i < lods.size (); i++ )
+		{
+			commands [i] = { lods [i].indexCount, counts [i], lods [i].firstIndex, 0, 0 };
+			triangles   += counts [i] * (lods [i].indexCount / 3);
+		}
+
+		if ( ++frame % 100 == 0 )
+			log () << "triangles " << triangles << " of " << n * (lods [0].indexCount / 3) << " at full resolution" << Log::endl;
+	}
+
+	void updateUniformBuffer ( uint32_t currentImage )
+	{
+		UniformBufferObject	ubo  = {};
+
+		ubo.mv   = controller->getModelView ();
+		ubo.proj = projectionMatrix ( fov, getAspect (), 0.1f, 500.0f );
+
+		*uniformBuffers [currentImage].getPtr () = ubo;
+	}
+};
+
+int main ( int argc, const char * argv [] )
+{
+	return ExampleWindow ( 1200, 1200, "Levels of detail with screen-space error selection" ).run ();
+}
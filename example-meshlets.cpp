@@ -0,0 +1,204 @@
+//
+// Mesh shading: grid of knots split into meshlets, task shader culls meshlets outside
+// of frustum and back-facing ones (by normal cone) before mesh shader emits triangles.
+// Every meshlet gets its own color. Press C to toggle meshlet culling
+//
+
+#include	"VulkanWindow.h"
+#include	"Buffer.h"
+#include	"DescriptorSet.h"
+#include	"Mesh.h"
+#include	"Frustum.h"
+#include	"Controller.h"
+
+struct UniformBufferObject
+{
+	glm::mat4	mv;
+	glm::mat4	proj;
+	glm::vec4	planes [6];
+	glm::vec4	eye;
+	uint32_t	cull;
+	uint32_t	pad [3];
+};
+
+class	ExampleWindow : public VulkanWindow
+{
+	enum
+	{
+		gridSize = 16					// gridSize^2 knots
+	};
+
+	std::vector<CommandBuffer>					commandBuffers;
+	std::vector<DescriptorSet> 					descriptorSets;
+	std::vector<Uniform<UniformBufferObject>>	uniformBuffers;
+	GraphicsPipeline							pipeline;
+	Renderpass									renderPass;
+	std::unique_ptr<Mesh>						mesh;
+	Buffer										instances;
+	bool										cull    = true;
+	float										spacing = 3.0f;
+	glm::vec3									eye     = glm::vec3 ( -30, 0, 0 );
+
+public:
+	ExampleWindow ( int w, int h, const std::string& t, DevicePolicy * p ) : VulkanWindow ( w, h, t, true, p )
+	{
+		std::vector<glm::vec4>	offsets;
+
+		setController ( new RotateController ( this, eye ) );
+
+		mesh = std::unique_ptr<Mesh> ( createKnot ( device, 1.0f, 0.3f, 400, 40, MeshBuildFlags ().setMeshlets () ) );
+
+		for ( int i = 0; i < gridSize; i++ )
+			for ( int j = 0; j < gridSize; j++ )
+				offsets.push_back ( glm::vec4 ( 0, (i - gridSize / 2) * spacing, (j - gridSize / 2) * spacing, 0 ) );
+
+		instances.createDeviceLocal ( device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, offsets );
+
+		log () << "meshlets " << mesh->getMeshletCount () << " per knot, " << mesh->getNumTriangles () << " triangles" << Log::endl;
+
+		createPipelines ();
+	}
+
+	void	createUniformBuffers ()
+	{
+		uniformBuffers.resize ( swapChain.imageCount () );
+
+		for ( auto& ub : uniformBuffers )
+			ub.create ( device );
+	}
+
+	void	createDescriptorSets ()
+	{
+		descriptorSets.resize ( swapChain.imageCount () );
+
+		for ( uint32_t i = 0; i < swapChain.imageCount (); i++ )
+		{
+			descriptorSets [i]
+				.setLayout ( device, descAllocator, pipeline.getDescLayout () )
+				.addBuffer ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers [i], 0, sizeof ( UniformBufferObject ) )
+				.addBuffer ( 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, mesh->getVertexBuffer     () )
+				.addBuffer ( 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, mesh->getMeshletBuffer    () )
+				.addBuffer ( 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, mesh->getMeshletVertices  () )
+				.addBuffer ( 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, mesh->getMeshletTriangles () )
+				.addBuffer ( 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, instances )
+				.create    ();
+		}
+	}
+
+	virtual	void	createPipelines () override
+	{
+		VkShaderStageFlags	stages = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+
+		createUniformBuffers    ();
+		createDefaultRenderPass ( renderPass );
+
+		pipeline.setDevice ( device )
+				.setTaskShader     ( "shaders/meshlet.task.spv" )
+				.setMeshShader     ( "shaders/meshlet.mesh.spv" )
+				.setFragmentShader ( "shaders/occlusion-scene.frag.spv" )
+				.setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
+				.addDescLayout     ( 0, DescSetLayout ()
+					.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, stages )
+					.add ( 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT )
+					.add ( 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages )
+					.add ( 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT )
+					.add ( 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT )
+					.add ( 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages ) )
+				.addPushConstRange ( stages, sizeof ( MeshletRange ) )
+				.setCullMode       ( VK_CULL_MODE_NONE )
+				.setDepthTest      ( true )
+				.setDepthWrite     ( true )
+				.create            ( renderPass );
+
+				// create before command buffers
+		swapChain.createFramebuffers ( renderPass, depthTexture.getImageView () );
+
+		createDescriptorSets ();
+		createCommandBuffers ();
+	}
+
+	virtual	void	freePipelines () override
+	{
+		commandBuffers.clear ();
+		pipeline.clean       ();
+		renderPass.clean     ();
+		uniformBuffers.clear ();
+		descriptorSets.clear ();
+		descAllocator.clean  ();
+	}
+
+	virtual	void	submit ( uint32_t imageIndex ) override
+	{
+		updateUniformBuffer ( imageIndex );
+
+		defaultSubmit ( commandBuffers [imageIndex] );
+	}
+
+	virtual	void	keyTyped ( int key, int scancode, int action, int mods ) override
+	{
+		if ( key == 'C' && action == GLFW_RELEASE )
+		{
+			cull = !cull;
+
+			log () << "meshlet culling " << (cull ? "on" : "off") << Log::endl;
+		}
+
+		VulkanWindow::keyTyped ( key, scancode, action, mods );
+	}
+
+		// task workgroups: x covers meshlets of knot, y is knot instance
+	void	createCommandBuffers ()
+	{
+		auto	framebuffers = swapChain.getFramebuffers ();
+
+		commandBuffers = device.allocCommandBuffers ( (uint32_t)framebuffers.size ());
+
+		for ( size_t i = 0; i < commandBuffers.size(); i++ )
+		{
+			CommandBuffer&	cb = commandBuffers [i];
+
+			cb.begin ();
+			cb.beginRenderPass ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor ().clearDepthStencil () )
+			  .pipeline          ( pipeline )
+			  .addDescriptorSets ( { descriptorSets [i] } )
+			  .setViewport       ( swapChain.getExtent () )
+			  .setScissor        ( swapChain.getExtent () );
+
+			mesh->renderMeshlets ( cb, pipeline.getLayout (), gridSize * gridSize );
+
+			cb.end ();
+		}
+	}
+
+	void updateUniformBuffer ( uint32_t currentImage )
+	{
+		UniformBufferObject	ubo  = {};
+		Frustum				frustum;
+
+		ubo.mv   = controller->getModelView ();
+		ubo.proj = projectionMatrix ( 45, getAspect (), 0.1f, 200.0f );
+		ubo.eye  = glm::inverse ( ubo.mv ) * glm::vec4 ( 0, 0, 0, 1 );
+		ubo.cull = cull ? 1 : 0;
+
+		frustum.update ( ubo.proj * ubo.mv );
+
+		for ( int i = 0; i < 6; i++ )
+			ubo.planes [i] = frustum.planes [i];
+
+		*uniformBuffers [currentImage].getPtr () = ubo;
+	}
+};
+
+int main ( int argc, const char * argv [] )
+{
+	DevicePolicy						policy;
+	VkPhysicalDeviceMeshShaderFeaturesEXT	meshFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT };
+
+	meshFeatures.taskShader = VK_TRUE;
+	meshFeatures.meshShader = VK_TRUE;
+
+	policy.addDeviceExtension ( VK_EXT_MESH_SHADER_EXTENSION_NAME );
+	policy.addFeatures        ( &meshFeatures );
+
+	return ExampleWindow ( 1200, 1200, "Meshlets with task shader culling", &policy ).run ();
+}
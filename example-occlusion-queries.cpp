@@ -0,0 +1,220 @@
+//
+// Occlusion queries with conditional rendering: heavy knots are hidden behind walls,
+// their bounding boxes are tested with occlusion queries after walls are drawn and
+// every knot is drawn inside its own VK_EXT_conditional_rendering block using results
+// of the previous frame. Number of knots considered visible on CPU is logged
+//
+
+#include	"VulkanWindow.h"
+#include	"Buffer.h"
+#include	"DescriptorSet.h"
+#include	"Mesh.h"
+#include	"OcclusionQueries.h"
+#include	"Controller.h"
+
+struct UniformBufferObject
+{
+	glm::mat4 mv;
+	glm::mat4 proj;
+};
+
+	// push constants of occlusion-scene.vert
+struct	ObjectConstants
+{
+	glm::vec4	offs;
+	glm::vec4	color;
+};
+
+class	ExampleWindow : public VulkanWindow
+{
+	enum
+	{
+		gridSize    = 5,					// gridSize^2 knots
+		numWalls    = 4,
+		statsFrames = 100					// log counters every statsFrames frames
+	};
+
+	std::vector<CommandBuffer>					commandBuffers;
+	std::vector<DescriptorSet> 					descriptorSets;
+	std::vector<Uniform<UniformBufferObject>>	uniformBuffers;
+	GraphicsPipeline							pipeline;
+	Renderpass									renderPass;
+	std::unique_ptr<Mesh>						knot;
+	std::vector<std::unique_ptr<Mesh>>			walls;
+	std::vector<glm::vec3>						positions;			// of knots
+	OcclusionQueries							queries;
+	int											frame   = 0;
+	float										spacing = 8.0f;
+	glm::vec3									eye     = glm::vec3 ( -30, 0, 0 );
+
+public:
+	ExampleWindow ( int w, int h, const std::string& t, DevicePolicy * p ) : VulkanWindow ( w, h, t, true, p )
+	{
+		setController ( new RotateController ( this, eye ) );
+
+		knot = std::unique_ptr<Mesh> ( createKnot ( device, 1.0f, 0.3f, 400, 40 ) );		// 32k triangles
+
+		for ( int i = 0; i < gridSize; i++ )
+			for ( int j = 0; j < gridSize; j++ )
+				positions.push_back ( spacing * glm::vec3 ( i - gridSize / 2, j - gridSize / 2, 0 ) );
+
+			// walls between columns of knots
+		for ( int i = 0; i < numWalls; i++ )
+			walls.push_back ( std::unique_ptr<Mesh> ( createBox ( device, glm::vec3 ( spacing * (i - numWalls / 2) + 0.5f * spacing - 0.25f, -0.6f * spacing * gridSize, -4 ),
+																   glm::vec3 ( 0.5f, 1.2f * spacing * gridSize, 8 ) ) ) );
+
+		createPipelines ();
+	}
+
+	void	createUniformBuffers ()
+	{
+		uniformBuffers.resize ( swapChain.imageCount () );
+
+		for ( auto& ub : uniformBuffers )
+			ub.create ( device );
+	}
+
+	void	createQueries ()
+	{
+		std::vector<bbox>	boxes;
+		const bbox&			box = knot->getBox ();
+
+		for ( auto& p : positions )
+			boxes.push_back ( bbox ( box.getMinPoint () + p, box.getMaxPoint () + p ) );
+
+		if ( !queries.create ( device, descAllocator, renderPass, boxes, swapChain.imageCount (), true ) )
+			fatal () << "Cannot create occlusion queries" << Log::endl;
+	}
+
+	void	createDescriptorSets ()
+	{
+		descriptorSets.resize ( swapChain.imageCount () );
+
+		for ( uint32_t i = 0; i < swapChain.imageCount (); i++ )
+		{
+			descriptorSets  [i]
+				.setLayout ( device, descAllocator, pipeline.getDescLayout () )
+				.addBuffer ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers [i], 0, sizeof ( UniformBufferObject ) )
+				.create    ();
+		}
+	}
+
+	virtual	void	createPipelines () override
+	{
+		createUniformBuffers    ();
+		createDefaultRenderPass ( renderPass );
+
+		pipeline.setDevice ( device )
+				.setVertexShader   ( "shaders/occlusion-scene.vert.spv" )
+				.setFragmentShader ( "shaders/occlusion-scene.frag.spv" )
+				.setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
+				.addVertexBinding  ( sizeof ( BasicVertex ) )
+				.addVertexAttributes <BasicVertex> ()
+				.addDescLayout     ( 0, DescSetLayout ()
+					.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT ) )
+				.addPushConstRange ( VK_SHADER_STAGE_VERTEX_BIT, sizeof ( ObjectConstants ) )
+				.setCullMode       ( VK_CULL_MODE_NONE )
+				.setDepthTest      ( true )
+				.setDepthWrite     ( true )
+				.create            ( renderPass );
+
+				// create before command buffers
+		swapChain.createFramebuffers ( renderPass, depthTexture.getImageView () );
+
+		createQueries        ();
+		createDescriptorSets ();
+		createCommandBuffers ();
+	}
+
+	virtual	void	freePipelines () override
+	{
+		commandBuffers.clear ();
+		pipeline.clean       ();
+		renderPass.clean     ();
+		uniformBuffers.clear ();
+		descriptorSets.clear ();
+		queries.clean        ();
+		descAllocator.clean  ();
+	}
+
+	virtual	void	submit ( uint32_t imageIndex ) override
+	{
+		updateUniformBuffer ( imageIndex );
+
+		if ( ++frame % statsFrames == 0 )
+			log () << "knots " << queries.getObjectCount () << ", visible " << queries.visibleCount () << Log::endl;
+
+		defaultSubmit ( commandBuffers [imageIndex] );
+	}
+
+	void	createCommandBuffers ()
+	{
+		auto	framebuffers = swapChain.getFramebuffers ();
+
+		commandBuffers = device.allocCommandBuffers ( (uint32_t)framebuffers.size ());
+
+		for ( size_t i = 0; i < commandBuffers.size(); i++ )
+		{
+			CommandBuffer&	cb    = commandBuffers [i];
+			uint32_t		index = (uint32_t) i;
+
+			cb.begin ();
+			queries.begin ( cb, index );
+
+			cb.beginRenderPass ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor ().clearDepthStencil () )
+			  .pipeline          ( pipeline )
+			  .addDescriptorSets ( { descriptorSets[i] } )
+			  .setViewport       ( swapChain.getExtent () )
+			  .setScissor        ( swapChain.getExtent () );
+
+				// occluders first, then boxes of heavy objects against their depth
+			for ( auto& w : walls )
+				cb.pushConstants ( pipeline.getLayout (), VK_SHADER_STAGE_VERTEX_BIT, ObjectConstants { glm::vec4 ( 0 ), glm::vec4 ( 0.6f, 0.6f, 0.6f, 1 ) } )
+				  .render        ( w.get () );
+
+			queries.drawBoxes ( cb, index );
+
+			cb.pipeline          ( pipeline )
+			  .addDescriptorSets ( { descriptorSets[i] } );
+
+			for ( uint32_t k = 0; k < (uint32_t) positions.size (); k++ )
+			{
+				queries.beginConditional ( cb, k );
+				cb.pushConstants         ( pipeline.getLayout (), VK_SHADER_STAGE_VERTEX_BIT, ObjectConstants { glm::vec4 ( positions [k], 0 ), glm::vec4 ( 1, 0.8f, 0.2f, 1 ) } )
+				  .render                ( knot.get () );
+				queries.endConditional   ( cb );
+			}
+
+			cb.endRenderPass ();
+			queries.end      ( cb, index );
+			cb.end           ();
+		}
+	}
+
+	void updateUniformBuffer ( uint32_t currentImage )
+	{
+		UniformBufferObject	ubo  = {};
+		const float			zNear = 0.1f;
+
+		ubo.mv   = controller->getModelView ();
+		ubo.proj = projectionMatrix ( 45, getAspect (), zNear, 200.0f );
+
+		*uniformBuffers [currentImage].getPtr () = ubo;
+
+			// boxes are in object space, so is the eye
+		queries.update ( currentImage, ubo.proj * ubo.mv, glm::vec3 ( glm::inverse ( ubo.mv ) * glm::vec4 ( 0, 0, 0, 1 ) ), 2 * zNear );
+	}
+};
+
+int main ( int argc, const char * argv [] )
+{
+	DevicePolicy									policy;
+	VkPhysicalDeviceConditionalRenderingFeaturesEXT	conditionalFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_CONDITIONAL_RENDERING_FEATURES_EXT };
+
+	conditionalFeatures.conditionalRendering = VK_TRUE;
+
+	policy.addDeviceExtension ( VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME );
+	policy.addFeatures        ( &conditionalFeatures );
+
+	return ExampleWindow ( 1200, 1200, "Occlusion queries", &policy ).run ();
+}
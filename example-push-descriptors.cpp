@@ -0,0 +1,188 @@
+#include	<memory>
+#include	"VulkanWindow.h"
+#include	"Buffer.h"
+#include	"DescriptorSet.h"
+#include	"PushDescriptors.h"
+#include	"Mesh.h"
+#include	"Controller.h"
+
+struct Ubo 
+{
+	glm::mat4 model;
+	glm::mat4 view;
+	glm::mat4 proj;
+	glm::vec4 offs;
+	glm::vec4 color;
+};
+
+struct	DrawDescriptors			// layout of data for update template
+{
+	VkDescriptorBufferInfo	ubo;
+	VkDescriptorImageInfo	image;
+};
+
+class	ExampleWindow : public VulkanWindow
+{
+	std::vector<CommandBuffer>		commandBuffers;
+	std::vector<Uniform<Ubo>>		uniformBuffers;
+	GraphicsPipeline				pipeline;
+	Renderpass						renderPass;
+	Texture							texture;
+	Sampler							sampler;
+	std::unique_ptr<Mesh>           mesh;
+	DescriptorUpdateTemplate		updateTemplate;
+	bool							useTemplate = true;
+
+public:
+	ExampleWindow ( int w, int h, const std::string& t, DevicePolicy * p ) : VulkanWindow ( w, h, t, true, p )
+	{
+		setController ( new RotateController ( this, glm::vec3(2.0f, 2.0f, 2.0f) ) );
+
+		mesh = std::unique_ptr<Mesh> ( loadMesh ( device, "../../Models/teapot.3ds", 0.04f ) );
+
+		sampler.create  ( device );		// use default options
+		texture.load    ( device, "../../Textures/Fieldstone.dds", false );
+		createPipelines ();
+	}
+
+	void	createUniformBuffers ()
+	{
+		auto	align = device.getProperties ().properties.limits.minUniformBufferOffsetAlignment;
+
+		uniformBuffers.resize ( swapChain.imageCount() );
+		
+		for ( size_t i = 0; i < swapChain.imageCount (); i++ )
+			uniformBuffers [i].create ( device, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 64, int ( align ) );			// each buffer for 64 Ubo structs
+	}
+
+	void	freeUniformBuffers ()
+	{
+		uniformBuffers.clear ();
+	}
+
+	virtual	void	createPipelines () override 
+	{
+		createUniformBuffers    ();
+		createDefaultRenderPass ( renderPass );
+
+		pipeline.setDevice ( device )
+				.setVertexShader   ( "shaders/shader-dynamic-uniform.vert.spv" )
+				.setFragmentShader ( "shaders/shader-dynamic-uniform.frag.spv" )
+				.setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
+				.addVertexBinding  ( sizeof ( BasicVertex ) )
+				.addVertexAttributes <BasicVertex> ()
+				.addDescLayout     ( 0, DescSetLayout ()
+					.setPushDescriptor ()
+					.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         VK_SHADER_STAGE_VERTEX_BIT )
+					.add ( 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT ) )
+			.setCullMode       ( VK_CULL_MODE_NONE               )
+			.setDepthTest      ( true )
+			.setDepthWrite     ( true )
+			.create            ( renderPass );			
+
+		updateTemplate
+			.add    ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         offsetof ( DrawDescriptors, ubo   ) )
+			.add    ( 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, offsetof ( DrawDescriptors, image ) );
+
+		if ( !updateTemplate.create ( device, pipeline.getDescLayout ().getHandle (), pipeline.getLayout (), 0 ) )
+			fatal () << "Cannot create descriptor update template" << Log::endl;
+
+				// create before command buffers
+		swapChain.createFramebuffers ( renderPass, depthTexture.getImageView () );
+
+		createCommandBuffers ( renderPass );
+	}
+
+	virtual	void	freePipelines () override
+	{
+		commandBuffers.clear   ();
+		updateTemplate.clean   ();
+		pipeline.clean         ();
+		renderPass.clean       ();
+		freeUniformBuffers     ();
+	}
+	
+	virtual	void	submit ( uint32_t imageIndex ) override 
+	{
+		updateUniformBuffer ( imageIndex );
+		defaultSubmit       ( commandBuffers [imageIndex] );
+	}
+
+	virtual	void	keyTyped ( int key, int scancode, int action, int mods ) override
+	{
+		if ( key == 'T' && action == GLFW_RELEASE )		// toggle between template and DescriptorSet writes
+		{
+			useTemplate = !useTemplate;
+			vkDeviceWaitIdle     ( device.getDevice () );
+			createCommandBuffers ( renderPass );
+		}
+
+		VulkanWindow::keyTyped ( key, scancode, action, mods );
+	}
+
+	void	createCommandBuffers ( Renderpass& renderPass )
+	{
+		auto	framebuffers = swapChain.getFramebuffers ();
+
+		commandBuffers = device.allocCommandBuffers ( (uint32_t)framebuffers.size ());
+
+		for ( size_t i = 0; i < commandBuffers.size(); i++ )
+		{
+			commandBuffers [i]
+				.begin             ()
+				.beginRenderPass   ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor ().clearDepthStencil () )
+				.pipeline          ( pipeline )
+				.setViewport       ( swapChain.getExtent () )
+				.setScissor        ( swapChain.getExtent () );
+
+				// per-draw bindings go directly into command buffer, nothing is allocated
+			for ( int j = 0; j < 64; j++ )
+			{
+				if ( useTemplate )
+				{
+					DrawDescriptors	data;
+
+					data.ubo   = { uniformBuffers [i].getHandle (), uniformBuffers [i].offsForItem ( j ), sizeof ( Ubo ) };
+					data.image = { sampler.getHandle (), texture.getImageView (), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+					commandBuffers [i].pushDescriptorSet ( 0, updateTemplate, &data );
+				}
+				else
+				{
+					DescriptorSet	ds;
+
+					ds.setLayout        ( device, pipeline.getDescLayout () )
+					  .addUniformBuffer ( 0, uniformBuffers [i], uniformBuffers [i].offsForItem ( j ), sizeof ( Ubo ) )
+					  .addImage         ( 1, texture, sampler );
+
+					commandBuffers [i].pushDescriptorSet ( 0, ds );
+				}
+
+				commandBuffers [i].render ( mesh.get () );
+			}
+
+			commandBuffers [i].end ();
+		}
+	}
+
+	void updateUniformBuffer ( uint32_t currentImage )
+	{
+		for ( int j = 0; j < 64; j++ )
+		{
+			uniformBuffers [currentImage][j].model = controller->getModelView  ();
+			uniformBuffers [currentImage][j].view  = glm::mat4 ( 1 );
+			uniformBuffers [currentImage][j].proj  = controller->getProjection ();
+			uniformBuffers [currentImage][j].offs  = glm::vec4 ( j % 8 - 4, j / 8 - 4, 0, 0 );
+			uniformBuffers [currentImage][j].color = glm::vec4 ( (j / 8) / 8.0f, 1 - (j%8) / 8.0f, 0, 1 );
+		}
+	}
+};
+
+int main ( int argc, const char * argv [] ) 
+{
+	DevicePolicy	policy;
+
+	policy.addDeviceExtension ( VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME );
+
+	return ExampleWindow ( 800, 600, "Push descriptors", &policy ).run ();
+}
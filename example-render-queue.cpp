@@ -0,0 +1,228 @@
+//
+// Render queue with automatic instancing: grid of objects made of few meshes and materials
+// is submitted in random order, sorted by state and drawn as instanced batches.
+// Press Q to switch between sorted queue and one draw per object in submission order
+//
+
+#include	"VulkanWindow.h"
+#include	"Buffer.h"
+#include	"DescriptorSet.h"
+#include	"Mesh.h"
+#include	"RenderQueue.h"
+#include	"Controller.h"
+
+struct UniformBufferObject
+{
+	glm::mat4 mv;
+	glm::mat4 proj;
+};
+
+	// object of the scene in submission order
+struct	SceneObject
+{
+	uint32_t	mesh;
+	uint32_t	material;
+	glm::mat4	matrix;
+};
+
+class	ExampleWindow : public VulkanWindow
+{
+	enum
+	{
+		gridSize     = 40,					// gridSize^2 objects
+		numMaterials = 8
+	};
+
+	std::vector<CommandBuffer>					commandBuffers;
+	std::vector<DescriptorSet> 					queueSets;			// with sorted instances
+	std::vector<DescriptorSet> 					objectSets;			// with instances in submission order
+	std::vector<Uniform<UniformBufferObject>>	uniformBuffers;
+	GraphicsPipeline							pipeline;
+	Renderpass									renderPass;
+	std::vector<std::unique_ptr<Mesh>>			meshes;
+	std::vector<SceneObject>					objects;
+	RenderQueue									queue;
+	Buffer										queueInstances;
+	Buffer										objectInstances;
+	bool										useQueue = true;
+	float										spacing  = 1.5f;
+	glm::vec3									eye      = glm::vec3 ( -70, 0, 0 );
+
+public:
+	ExampleWindow ( int w, int h, const std::string& t ) : VulkanWindow ( w, h, t, true )
+	{
+		setController ( new RotateController ( this, eye ) );
+
+		meshes.push_back ( std::unique_ptr<Mesh> ( createKnot   ( device, 0.4f, 0.12f, 120, 16 ) ) );
+		meshes.push_back ( std::unique_ptr<Mesh> ( createSphere ( device, glm::vec3 ( 0 ), 0.5f, 24, 24 ) ) );
+		meshes.push_back ( std::unique_ptr<Mesh> ( createBox    ( device, glm::vec3 ( -0.4f ), glm::vec3 ( 0.8f ) ) ) );
+		meshes.push_back ( std::unique_ptr<Mesh> ( createTorus  ( device, 0.45f, 0.15f, 32, 16 ) ) );
+
+		createScene     ();
+		createPipelines ();
+	}
+
+		// objects are submitted in random order, queue sorts them once since scene is static
+	void	createScene ()
+	{
+		std::vector<InstanceData>	instances;
+
+		for ( auto& m : meshes )
+			queue.addMesh ( m->getRenderMesh () );
+
+		for ( uint32_t i = 0; i < numMaterials; i++ )
+			queue.addMaterial ( glm::uvec4 ( i, 0, 0, 0 ) );
+
+		queue.addPipeline ( pipeline );
+		queue.setCamera   ( eye, 200.0f );
+
+		for ( int i = 0; i < gridSize; i++ )
+			for ( int j = 0; j < gridSize; j++ )
+			{
+				glm::vec3	pos = spacing * glm::vec3 ( 0, i - gridSize / 2, j - gridSize / 2 );
+
+				objects.push_back ( { uint32_t ( rand () % meshes.size () ), uint32_t ( rand () % numMaterials ), glm::translate ( glm::mat4 ( 1 ), pos ) } );
+			}
+
+		for ( auto& obj : objects )
+		{
+			queue.submit ( obj.mesh, obj.material, 0, obj.matrix );
+			instances.push_back ( { obj.matrix, obj.material, 0, 0, 0 } );
+		}
+
+		queue.build ();
+
+		queueInstances.createDeviceLocal  ( device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queue.getInstances () );
+		objectInstances.createDeviceLocal ( device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instances );
+
+		const RenderQueueStats&	s = queue.getStats ();
+		const RenderQueueStats&	u = queue.getUnsortedStats ();
+
+		log () << "objects " << s.packets << ", draws " << u.draws << " -> " << s.draws << ", material changes " << u.materialChanges << " -> " << s.materialChanges
+			   << ", buffer binds " << u.bufferBinds << " -> " << s.bufferBinds << Log::endl;
+	}
+
+	void	createUniformBuffers ()
+	{
+		uniformBuffers.resize ( swapChain.imageCount () );
+
+		for ( auto& ub : uniformBuffers )
+			ub.create ( device );
+	}
+
+	void	createDescriptorSets ( std::vector<DescriptorSet>& sets, Buffer& instances )
+	{
+		sets.resize ( swapChain.imageCount () );
+
+		for ( uint32_t i = 0; i < swapChain.imageCount (); i++ )
+		{
+			sets [i]
+				.setLayout ( device, descAllocator, pipeline.getDescLayout () )
+				.addBuffer ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers [i], 0, sizeof ( UniformBufferObject ) )
+				.addBuffer ( 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, instances )
+				.create    ();
+		}
+	}
+
+	virtual	void	createPipelines () override
+	{
+		createUniformBuffers    ();
+		createDefaultRenderPass ( renderPass );
+
+		pipeline.setDevice ( device )
+				.setVertexShader   ( "shaders/render-queue.vert.spv" )
+				.setFragmentShader ( "shaders/occlusion-scene.frag.spv" )
+				.setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
+				.addVertexBinding  ( sizeof ( BasicVertex ) )
+				.addVertexAttributes <BasicVertex> ()
+				.addDescLayout     ( 0, DescSetLayout ()
+					.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT )
+					.add ( 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT ) )
+				.setCullMode       ( VK_CULL_MODE_NONE )
+				.setDepthTest      ( true )
+				.setDepthWrite     ( true )
+				.create            ( renderPass );
+
+				// create before command buffers
+		swapChain.createFramebuffers ( renderPass, depthTexture.getImageView () );
+
+		createDescriptorSets ( queueSets,  queueInstances  );
+		createDescriptorSets ( objectSets, objectInstances );
+		createCommandBuffers ();
+	}
+
+	virtual	void	freePipelines () override
+	{
+		commandBuffers.clear ();
+		pipeline.clean       ();
+		renderPass.clean     ();
+		uniformBuffers.clear ();
+		queueSets.clear      ();
+		objectSets.clear     ();
+		descAllocator.clean  ();
+	}
+
+	virtual	void	submit ( uint32_t imageIndex ) override
+	{
+		updateUniformBuffer ( imageIndex );
+
+		defaultSubmit ( commandBuffers [imageIndex] );
+	}
+
+	virtual	void	keyTyped ( int key, int scancode, int action, int mods ) override
+	{
+		if ( key == 'Q' && action == GLFW_RELEASE )		// switch between sorted queue and draw per object
+		{
+			useQueue = !useQueue;
+
+			log () << (useQueue ? "render queue: " : "per object: ") << (useQueue ? queue.getStats ().draws : objects.size ()) << " draws" << Log::endl;
+
+			vkDeviceWaitIdle     ( device.getDevice () );
+			createCommandBuffers ();
+		}
+
+		VulkanWindow::keyTyped ( key, scancode, action, mods );
+	}
+
+	void	createCommandBuffers ()
+	{
+		auto	framebuffers = swapChain.getFramebuffers ();
+
+		commandBuffers = device.allocCommandBuffers ( (uint32_t)framebuffers.size ());
+
+		for ( size_t i = 0; i < commandBuffers.size(); i++ )
+		{
+			CommandBuffer&	cb = commandBuffers [i];
+
+			cb.begin ();
+			cb.beginRenderPass ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor ().clearDepthStencil () )
+			  .pipeline          ( pipeline )
+			  .addDescriptorSets ( { useQueue ? queueSets [i] : objectSets [i] } )
+			  .setViewport       ( swapChain.getExtent () )
+			  .setScissor        ( swapChain.getExtent () );
+
+			if ( useQueue )
+				queue.record ( cb );
+			else
+				for ( uint32_t k = 0; k < (uint32_t) objects.size (); k++ )
+					meshes [objects [k].mesh]->render ( cb, 1, k );
+
+			cb.end ();
+		}
+	}
+
+	void updateUniformBuffer ( uint32_t currentImage )
+	{
+		UniformBufferObject	ubo  = {};
+
+		ubo.mv   = controller->getModelView ();
+		ubo.proj = projectionMatrix ( 45, getAspect (), 0.1f, 200.0f );
+
+		*uniformBuffers [currentImage].getPtr () = ubo;
+	}
+};
+
+int main ( int argc, const char * argv [] )
+{
+	return ExampleWindow ( 1200, 1200, "Render queue with automatic instancing" ).run ();
+}
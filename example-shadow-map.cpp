@@ -140,8 +140,8 @@ public:
 				.setVertexShader   ( "shaders/depthpass.vert.spv" )
 				.setFragmentShader ( "shaders/depthpass.frag.spv" )
 				.setSize           ( shadowMapSize, shadowMapSize )
-				.addVertexBinding  ( sizeof ( BasicVertex ) )
-				.addVertexAttributes<BasicVertex> ()
+				.addVertexBinding  ( sizeof ( PositionVertex ) )
+				.addVertexAttributes<PositionVertex> ()
 				.addDescLayout     ( 0, DescSetLayout ()
 						.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         VK_SHADER_STAGE_VERTEX_BIT	) )
 				.setCullMode       ( VK_CULL_MODE_NONE )
@@ -218,8 +218,8 @@ public:
 			.addDescriptorSets ( { offscreenDescriptorSet } )
 			.setViewport       ( fb.getWidth (), fb.getHeight () )
 			.setScissor        ( fb.getWidth (), fb.getHeight () )
-			.render            ( mesh1.get () )
-			.render            ( mesh2.get () )
+			.renderDepth       ( mesh1.get () )
+			.renderDepth       ( mesh2.get () )
 			.end               ();
 	}
 	
@@ -0,0 +1,295 @@
+//
+// Static batching: field of small boxes with a few materials is drawn either as separate
+// meshes (draw per box) or merged by StaticBatcher into batches drawn with one indirect
+// draw per material, culled batches get zero instances. Press B to switch modes, draw
+// count and GPU time are logged. Right click picks the box under cursor
+//
+
+#include	"VulkanWindow.h"
+#include	"Buffer.h"
+#include	"DescriptorSet.h"
+#include	"Mesh.h"
+#include	"StaticBatch.h"
+#include	"Frustum.h"
+#include	"TimestampPool.h"
+#include	"Controller.h"
+
+struct UniformBufferObject
+{
+	glm::mat4 mv;
+	glm::mat4 proj;
+};
+
+	// push constants of occlusion-scene.vert
+struct	ObjectConstants
+{
+	glm::vec4	offs;
+	glm::vec4	color;
+};
+
+class	ExampleWindow : public VulkanWindow
+{
+	enum
+	{
+		gridSize     = 48,					// gridSize^2 boxes
+		numMaterials = 4,
+		statsFrames  = 100					// frames to average GPU time
+	};
+
+	std::vector<CommandBuffer>					commandBuffers;
+	std::vector<DescriptorSet> 					descriptorSets;
+	std::vector<Uniform<UniformBufferObject>>	uniformBuffers;
+	std::vector<PersistentBuffer>				indirectBuffers;	// command per batch
+	GraphicsPipeline							pipeline;
+	Renderpass									renderPass;
+	std::vector<std::unique_ptr<Mesh>>			boxes;				// separate meshes
+	std::vector<uint32_t>						materialOf;			// of every box
+	StaticBatcher								batcher;
+	glm::vec4									colors [numMaterials];
+	TimestampPool								timestamps;
+	std::vector<bool>							submitted;
+	bool										batched    = true;
+	uint32_t									visible    = 0;
+	double										gpuTime    = 0;
+	int											gpuFrames  = 0;
+	glm::vec3									eye        = glm::vec3 ( -70, -70, 60 );
+
+public:
+	ExampleWindow ( int w, int h, const std::string& t, DevicePolicy * p ) : VulkanWindow ( w, h, t, true, p )
+	{
+		setController ( new RotateController ( this, eye ) );
+
+		colors [0] = glm::vec4 ( 1.0f, 0.4f, 0.3f, 1 );
+		colors [1] = glm::vec4 ( 0.3f, 0.8f, 0.4f, 1 );
+		colors [2] = glm::vec4 ( 0.3f, 0.5f, 1.0f, 1 );
+		colors [3] = glm::vec4 ( 0.9f, 0.8f, 0.3f, 1 );
+
+		std::vector<BasicVertex>	vertices;
+		std::vector<uint32_t>		indices;
+
+		buildBox ( glm::vec3 ( -0.5f, -0.5f, 0 ), glm::vec3 ( 1 ), nullptr, false, vertices, indices );
+
+		for ( int i = 0; i < gridSize; i++ )
+			for ( int j = 0; j < gridSize; j++ )
+			{
+				uint32_t	id       = (uint32_t) boxes.size ();
+				uint32_t	material = (i * 7 + j * 3) % numMaterials;
+				glm::vec3	size     = glm::vec3 ( 0.6f + 0.1f * (j % 5), 0.6f + 0.1f * (i % 4), 0.5f + 0.25f * ((i * j) % 7) );
+				glm::mat4	m        = glm::translate ( glm::mat4 ( 1 ), glm::vec3 ( 2.0f * (i - gridSize / 2), 2.0f * (j - gridSize / 2), 0 ) );
+
+				m = glm::rotate ( m, 0.3f * (i + j), glm::vec3 ( 0, 0, 1 ) );
+				m = glm::scale  ( m, size );
+
+				boxes.push_back ( std::unique_ptr<Mesh> ( createBox ( device, glm::vec3 ( -0.5f, -0.5f, 0 ), glm::vec3 ( 1 ), &m ) ) );
+				materialOf.push_back ( material );
+				batcher.add ( vertices.data (), vertices.size (), indices.data (), indices.size () / 3, m, material, id );
+			}
+
+		batcher.create  ( device );
+		createPipelines ();
+	}
+
+	void	createUniformBuffers ()
+	{
+		uniformBuffers.resize  ( swapChain.imageCount () );
+		indirectBuffers.resize ( swapChain.imageCount () );
+
+		for ( auto& ub : uniformBuffers )
+			ub.create ( device );
+
+		for ( auto& buf : indirectBuffers )
+			buf.create ( device, batcher.getBatches ().size () * sizeof ( VkDrawIndexedIndirectCommand ), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, Buffer::hostWrite );
+	}
+
+	void	createDescriptorSets ()
+	{
+		descriptorSets.resize ( swapChain.imageCount () );
+
+		for ( uint32_t i = 0; i < swapChain.imageCount (); i++ )
+		{
+			descriptorSets [i]
+				.setLayout ( device, descAllocator, pipeline.getDescLayout () )
+				.addBuffer ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers [i], 0, sizeof ( UniformBufferObject ) )
+				.create    ();
+		}
+	}
+
+	virtual	void	createPipelines () override
+	{
+		createUniformBuffers    ();
+		createDefaultRenderPass ( renderPass );
+
+		pipeline.setDevice ( device )
+				.setVertexShader   ( "shaders/occlusion-scene.vert.spv" )
+				.setFragmentShader ( "shaders/occlusion-scene.frag.spv" )
+				.setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
+				.addVertexBinding  ( sizeof ( BasicVertex ) )
+				.addVertexAttributes <BasicVertex> ()
+				.addDescLayout     ( 0, DescSetLayout ()
+					.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT ) )
+				.addPushConstRange ( VK_SHADER_STAGE_VERTEX_BIT, sizeof ( ObjectConstants ) )
+				.setCullMode       ( VK_CULL_MODE_NONE )
+				.setDepthTest      ( true )
+				.setDepthWrite     ( true )
+				.create            ( renderPass );
+
+				// create before command buffers
+		swapChain.createFramebuffers ( renderPass, depthTexture.getImageView () );
+
+		timestamps.create    ( device, 2 * swapChain.imageCount () );
+		createDescriptorSets ();
+		createCommandBuffers ();
+	}
+
+	virtual	void	freePipelines () override
+	{
+		commandBuffers.clear  ();
+		pipeline.clean        ();
+		renderPass.clean      ();
+		uniformBuffers.clear  ();
+		indirectBuffers.clear ();
+		descriptorSets.clear  ();
+		timestamps.destroy    ();
+		descAllocator.clean   ();
+	}
+
+	virtual	void	submit ( uint32_t imageIndex ) override
+	{
+		std::vector<uint64_t>	ts ( 2 );
+
+			// previous submission of this command buffer is completed here
+		if ( submitted [imageIndex] && timestamps.getResults ( ts, 2 * imageIndex, 2 ) && ts [1] > ts [0] )
+		{
+			gpuTime += timestamps.convertToMs ( ts [1] - ts [0] );
+
+			if ( ++gpuFrames == statsFrames )
+			{
+				if ( batched )
+					log () << "batched: " << batcher.getMaterials ().size () << " draws, " << visible << " of " << batcher.getBatches ().size ()
+						   << " batches visible, " << gpuTime / gpuFrames << " ms" << Log::endl;
+				else
+					log () << "separate meshes: " << boxes.size () << " draws, " << gpuTime / gpuFrames << " ms" << Log::endl;
+
+				gpuTime   = 0;
+				gpuFrames = 0;
+			}
+		}
+
+		updateUniformBuffer ( imageIndex );
+
+		defaultSubmit ( commandBuffers [imageIndex] );
+
+		submitted [imageIndex] = true;
+	}
+
+	virtual	void	keyTyped ( int key, int scancode, int action, int mods ) override
+	{
+		if ( key == 'B' && action == GLFW_RELEASE )
+		{
+			batched   = !batched;
+			gpuTime   = 0;
+			gpuFrames = 0;
+
+			vkDeviceWaitIdle     ( device.getDevice () );
+			createCommandBuffers ();
+		}
+
+		VulkanWindow::keyTyped ( key, scancode, action, mods );
+	}
+
+	virtual	void	mouseClick ( int button, int action, int mods ) override
+	{
+		if ( button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS )
+		{
+			double		x, y;
+			float		t;
+
+			glfwGetCursorPos ( getWindow (), &x, &y );
+
+				// ray from eye through far plane point under cursor
+			glm::mat4	mv  = controller->getModelView ();
+			glm::mat4	inv = glm::inverse ( controller->getProjection () * mv );
+			glm::vec4	p   = inv * glm::vec4 ( 2.0f * (float) x / swapChain.getExtent ().width - 1, 2.0f * (float) y / swapChain.getExtent ().height - 1, 1, 1 );
+			glm::vec3	org = glm::vec3 ( glm::inverse ( mv ) * glm::vec4 ( 0, 0, 0, 1 ) );
+			int			id  = batcher.pick ( ray ( org, glm::vec3 ( p ) / p.w - org ), t );
+
+			if ( id >= 0 )
+				log () << "picked box " << id << ", material " << materialOf [id] << ", distance " << t << Log::endl;
+		}
+
+		VulkanWindow::mouseClick ( button, action, mods );
+	}
+
+	void	createCommandBuffers ()
+	{
+		auto	framebuffers = swapChain.getFramebuffers ();
+
+		commandBuffers = device.allocCommandBuffers ( (uint32_t)framebuffers.size ());
+		submitted.assign ( commandBuffers.size (), false );
+
+		for ( size_t i = 0; i < commandBuffers.size(); i++ )
+		{
+			CommandBuffer&	cb = commandBuffers [i];
+
+			cb.begin ();
+
+			timestamps.reset          ( cb, 2 * (uint32_t) i, 2 );
+			timestamps.writeTimestamp ( cb, 2 * (int) i, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT );
+
+			cb.beginRenderPass   ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor ().clearDepthStencil () )
+			  .pipeline          ( pipeline )
+			  .addDescriptorSets ( { descriptorSets [i] } )
+			  .setViewport       ( swapChain.getExtent () )
+			  .setScissor        ( swapChain.getExtent () );
+
+			if ( batched )
+			{
+				batcher.bindBuffers ( cb );
+
+					// batches of every material are consecutive, culled ones have zero instances
+				for ( auto& range : batcher.getMaterials () )
+				{
+					cb.pushConstants       ( pipeline.getLayout (), VK_SHADER_STAGE_VERTEX_BIT, ObjectConstants { glm::vec4 ( 0 ), colors [range.material] } );
+					cb.drawIndexedIndirect ( indirectBuffers [i], range.batchCount, range.firstBatch * sizeof ( VkDrawIndexedIndirectCommand ) );
+				}
+			}
+			else
+			{
+				for ( size_t k = 0; k < boxes.size (); k++ )
+				{
+					cb.pushConstants ( pipeline.getLayout (), VK_SHADER_STAGE_VERTEX_BIT, ObjectConstants { glm::vec4 ( 0 ), colors [materialOf [k]] } );
+					cb.render        ( boxes [k].get () );
+				}
+			}
+
+			cb.endRenderPass ();
+
+			timestamps.writeTimestamp ( cb, 2 * (int) i + 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT );
+			cb.end ();
+		}
+	}
+
+	void updateUniformBuffer ( uint32_t currentImage )
+	{
+		UniformBufferObject	ubo = {};
+		Frustum				frustum;
+
+		ubo.mv   = controller->getModelView  ();
+		ubo.proj = controller->getProjection ();
+
+		frustum.update ( ubo.proj * ubo.mv );
+
+		visible = batcher.writeCommands ( (VkDrawIndexedIndirectCommand *) indirectBuffers [currentImage].getPtr (), frustum );
+
+		*uniformBuffers [currentImage].getPtr () = ubo;
+	}
+};
+
+int main ( int argc, const char * argv [] )
+{
+	DevicePolicy	policy;
+
+	policy.features.features.multiDrawIndirect = VK_TRUE;		// batches of material in one call
+
+	return ExampleWindow ( 1200, 1200, "Static batching", &policy ).run ();
+}
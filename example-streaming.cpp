@@ -0,0 +1,286 @@
+//
+// Geometry streaming: large terrain is split into chunks with LOD chains stored in chunk file
+// (built on the first run), only levels needed near the camera are kept in geometry heap much
+// smaller than the whole terrain. Camera flies over terrain, chunks still loading are drawn
+// with coarser levels. All chunks are drawn with single indirect draw from the heap.
+// Press P to pause flight, residency statistics are logged
+//
+
+#include	"VulkanWindow.h"
+#include	"Buffer.h"
+#include	"DescriptorSet.h"
+#include	"Mesh.h"
+#include	"GeometryStreamer.h"
+#include	"LodSelector.h"
+#include	"Frustum.h"
+#include	"Controller.h"
+
+struct UniformBufferObject
+{
+	glm::mat4 mv;
+	glm::mat4 proj;
+};
+
+	// push constants of occlusion-scene.vert
+struct	ObjectConstants
+{
+	glm::vec4	offs;
+	glm::vec4	color;
+};
+
+class	ExampleWindow : public VulkanWindow
+{
+	enum
+	{
+		terrainSize = 1024,					// quads per side
+		gridSize    = 16,					// chunks per side
+		statsFrames = 100
+	};
+
+	std::vector<CommandBuffer>					commandBuffers;
+	std::vector<DescriptorSet> 					descriptorSets;
+	std::vector<Uniform<UniformBufferObject>>	uniformBuffers;
+	std::vector<PersistentBuffer>				indirectBuffers;	// command per chunk
+	GraphicsPipeline							pipeline;
+	Renderpass									renderPass;
+	GeometryStreamer							streamer;
+	LodSelector									selector;
+	RotateController						  * rotator;
+	std::string									fileName   = "terrain.chunks";
+	VkDeviceSize								heapSize   = 24 * 1024 * 1024;
+	bool										paused     = false;
+	double										flightTime = 0;
+	double										lastTime   = 0;
+	size_t										frame      = 0;
+
+public:
+	ExampleWindow ( int w, int h, const std::string& t, DevicePolicy * p ) : VulkanWindow ( w, h, t, true, p )
+	{
+		rotator = new RotateController ( this, flightPos ( 0 ) );
+
+		rotator->setDepthRange ( 1.0f, 2000.0f );
+		setController ( rotator );
+
+		FILE * fp = fopen ( fileName.c_str (), "rb" );
+
+		if ( fp != nullptr )
+			fclose ( fp );
+		else
+			createTerrain ();
+
+		if ( !streamer.open ( device, fileName, heapSize, 4 * 1024 * 1024, swapChain.imageCount () ) )
+			fatal () << "Streaming: cannot open " << fileName << Log::endl;
+
+		streamer.setPrefetchDistance ( 100.0f );
+		selector.setThreshold ( 1.0f );
+
+		lastTime = getTime ();
+
+		createPipelines ();
+	}
+
+	float	height ( float x, float y ) const
+	{
+		return 40.0f * sinf ( x * 0.007f ) * cosf ( y * 0.005f ) + 12.0f * sinf ( x * 0.031f + 1.3f ) * sinf ( y * 0.027f ) + 3.0f * cosf ( x * 0.11f ) * sinf ( y * 0.13f + 0.7f );
+	}
+
+		// heightfield of terrainSize^2 quads centered at origin
+	void	createTerrain ()
+	{
+		const int					n = terrainSize + 1;
+		const float					h = terrainSize * 0.5f;
+		std::vector<BasicVertex>	vertices ( n * n );
+		std::vector<uint32_t>		indices;
+
+		for ( int i = 0; i < n; i++ )
+			for ( int j = 0; j < n; j++ )
+			{
+				BasicVertex&	v = vertices [i * n + j];
+				float			x = j - h;
+				float			y = i - h;
+
+				v.pos = glm::vec3 ( x, y, height ( x, y ) );
+				v.tex = glm::vec2 ( (float) j / terrainSize, (float) i / terrainSize );
+				v.n   = glm::normalize ( glm::vec3 ( height ( x - 1, y ) - height ( x + 1, y ), height ( x, y - 1 ) - height ( x, y + 1 ), 2 ) );
+				v.t   = glm::normalize ( glm::vec3 ( 2, 0, height ( x + 1, y ) - height ( x - 1, y ) ) );
+				v.b   = glm::cross ( v.n, v.t );
+			}
+
+		indices.reserve ( 6 * terrainSize * terrainSize );
+
+		for ( int i = 0; i < terrainSize; i++ )
+			for ( int j = 0; j < terrainSize; j++ )
+			{
+				uint32_t	k = i * n + j;
+
+				indices.insert ( indices.end (), { k, k + 1, k + n, k + 1, k + n + 1, k + n } );
+			}
+
+		log () << "Streaming: building " << fileName << " for " << indices.size () / 3 << " triangles" << Log::endl;
+
+		if ( !GeometryStreamer::buildChunkFile ( fileName, vertices.data (), vertices.size (), sizeof ( BasicVertex ), indices, glm::ivec3 ( gridSize, gridSize, 1 ), 5 ) )
+			fatal () << "Streaming: cannot write " << fileName << Log::endl;
+	}
+
+		// low flight along a loop over terrain
+	glm::vec3	flightPos ( double t ) const
+	{
+		float	a = (float) t * 0.05f;
+		float	r = terrainSize * 0.35f;
+
+		return glm::vec3 ( r * cosf ( a ), r * sinf ( 2 * a ) * 0.7f, 90.0f );
+	}
+
+	void	createUniformBuffers ()
+	{
+		uniformBuffers.resize  ( swapChain.imageCount () );
+		indirectBuffers.resize ( swapChain.imageCount () );
+
+		for ( auto& ub : uniformBuffers )
+			ub.create ( device );
+
+		for ( auto& buf : indirectBuffers )
+			if ( !buf.create ( device, streamer.getChunkCount () * sizeof ( VkDrawIndexedIndirectCommand ), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, Buffer::hostWrite ) )
+				fatal () << "Streaming: cannot create indirect buffer" << Log::endl;
+	}
+
+	void	createDescriptorSets ()
+	{
+		descriptorSets.resize ( swapChain.imageCount () );
+
+		for ( uint32_t i = 0; i < swapChain.imageCount (); i++ )
+		{
+			descriptorSets [i]
+				.setLayout ( device, descAllocator, pipeline.getDescLayout () )
+				.addBuffer ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers [i], 0, sizeof ( UniformBufferObject ) )
+				.create    ();
+		}
+	}
+
+	virtual	void	createPipelines () override
+	{
+		createUniformBuffers    ();
+		createDefaultRenderPass ( renderPass );
+
+		pipeline.setDevice ( device )
+				.setVertexShader   ( "shaders/occlusion-scene.vert.spv" )
+				.setFragmentShader ( "shaders/occlusion-scene.frag.spv" )
+				.setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
+				.addVertexBinding  ( sizeof ( BasicVertex ) )
+				.addVertexAttributes <BasicVertex> ()
+				.addDescLayout     ( 0, DescSetLayout ()
+					.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT ) )
+				.addPushConstRange ( VK_SHADER_STAGE_VERTEX_BIT, sizeof ( ObjectConstants ) )
+				.setCullMode       ( VK_CULL_MODE_NONE )
+				.setDepthTest      ( true )
+				.setDepthWrite     ( true )
+				.create            ( renderPass );
+
+				// create before command buffers
+		swapChain.createFramebuffers ( renderPass, depthTexture.getImageView () );
+
+		createDescriptorSets ();
+		createCommandBuffers ();
+	}
+
+	virtual	void	freePipelines () override
+	{
+		commandBuffers.clear  ();
+		pipeline.clean        ();
+		renderPass.clean      ();
+		uniformBuffers.clear  ();
+		indirectBuffers.clear ();
+		descriptorSets.clear  ();
+		descAllocator.clean   ();
+	}
+
+	virtual	void	submit ( uint32_t imageIndex ) override
+	{
+		updateUniformBuffer ( imageIndex );
+
+		defaultSubmit ( commandBuffers [imageIndex] );
+	}
+
+	virtual	void	idle () override
+	{
+		double	t = getTime ();
+
+		if ( !paused )
+		{
+			flightTime += t - lastTime;
+			rotator->setEye ( flightPos ( flightTime ) );
+		}
+
+		lastTime = t;
+	}
+
+	virtual	void	keyTyped ( int key, int scancode, int action, int mods ) override
+	{
+		if ( key == 'P' && action == GLFW_RELEASE )
+			paused = !paused;
+
+		VulkanWindow::keyTyped ( key, scancode, action, mods );
+	}
+
+		// commands are static, heap offsets and culling go through indirect buffer
+	void	createCommandBuffers ()
+	{
+		auto	framebuffers = swapChain.getFramebuffers ();
+
+		commandBuffers = device.allocCommandBuffers ( (uint32_t)framebuffers.size ());
+
+		for ( size_t i = 0; i < commandBuffers.size(); i++ )
+		{
+			CommandBuffer&	cb = commandBuffers [i];
+
+			cb.begin ();
+			cb.beginRenderPass   ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor ().clearDepthStencil () )
+			  .pipeline          ( pipeline )
+			  .addDescriptorSets ( { descriptorSets [i] } )
+			  .setViewport       ( swapChain.getExtent () )
+			  .setScissor        ( swapChain.getExtent () )
+			  .pushConstants     ( pipeline.getLayout (), VK_SHADER_STAGE_VERTEX_BIT, ObjectConstants { glm::vec4 ( 0 ), glm::vec4 ( 0.5f, 0.7f, 0.4f, 1 ) } );
+
+			streamer.bindBuffers ( cb );
+
+			cb.drawIndexedIndirect ( indirectBuffers [i], (uint32_t) streamer.getChunkCount () );
+			cb.endRenderPass ();
+			cb.end ();
+		}
+	}
+
+	void updateUniformBuffer ( uint32_t currentImage )
+	{
+		UniformBufferObject	ubo = {};
+		Frustum				frustum;
+
+		ubo.mv   = controller->getModelView  ();
+		ubo.proj = controller->getProjection ();
+
+		frustum.update  ( ubo.proj * ubo.mv );
+		selector.setView ( glm::vec3 ( glm::inverse ( ubo.mv ) * glm::vec4 ( 0, 0, 0, 1 ) ), controller->getFov (), (float) swapChain.getExtent ().height );
+		streamer.update ( frustum, selector );
+
+		uint32_t	drawn = streamer.writeCommands ( (VkDrawIndexedIndirectCommand *) indirectBuffers [currentImage].getPtr () );
+
+		*uniformBuffers [currentImage].getPtr () = ubo;
+
+		if ( ++frame % statsFrames == 0 )
+		{
+			const StreamingStats&	stats = streamer.getStats ();
+
+			log () << "chunks drawn " << drawn << " of " << streamer.getChunkCount () << ", " << stats.fallbacks << " with coarser levels, resident "
+				   << stats.residentBytes / (1024 * 1024) << " of " << stats.heapSize / (1024 * 1024) << " MB, "
+				   << stats.loadsPending << " loads pending, " << stats.evictions << " evictions" << Log::endl;
+		}
+	}
+};
+
+int main ( int argc, const char * argv [] )
+{
+	DevicePolicy	policy;
+
+	policy.features.features.multiDrawIndirect = VK_TRUE;		// all chunks in one call
+
+	return ExampleWindow ( 1200, 1200, "Geometry streaming", &policy ).run ();
+}
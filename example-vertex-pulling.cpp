@@ -0,0 +1,154 @@
+//
+// Vertex pulling example: meshes with BasicVertex and PackedVertex, 16 and 32-bit indices
+// are drawn by single pipeline without vertex input, no vertex or index buffers are bound.
+// Every mesh gets its own range of instances on the grid
+//
+
+#include	"VulkanWindow.h"
+#include	"Buffer.h"
+#include	"DescriptorSet.h"
+#include	"Mesh.h"
+#include	"Controller.h"
+
+struct UniformBufferObject
+{
+	glm::mat4 mv;
+	glm::mat4 proj;
+	glm::vec4 grid;						// grid size and spacing
+};
+
+class	ExampleWindow : public VulkanWindow
+{
+	enum
+	{
+		gridSize       = 6,				// gridSize^2 instances
+		meshInstances  = 12				// instances of every mesh
+	};
+
+	std::vector<CommandBuffer>					commandBuffers;
+	std::vector<DescriptorSet> 					descriptorSets;
+	std::vector<Uniform<UniformBufferObject>>	uniformBuffers;
+	GraphicsPipeline							pipeline;
+	Renderpass									renderPass;
+	std::vector<std::unique_ptr<Mesh>>			meshes;
+	float										spacing = 3.0f;
+	glm::vec3									eye     = glm::vec3 ( -20, 0, 0 );
+
+public:
+	ExampleWindow ( int w, int h, const std::string& t, DevicePolicy * p ) : VulkanWindow ( w, h, t, true, p )
+	{
+		setController ( new RotateController ( this, eye ) );
+
+		meshes.push_back ( std::unique_ptr<Mesh> ( createKnot   ( device, 1.0f, 0.3f, 1000, 100 ) ) );					// 32-bit indices
+		meshes.push_back ( std::unique_ptr<Mesh> ( createKnot   ( device, 1.0f, 0.3f, 1000, 100, MeshBuildFlags ().setPacked () ) ) );	// packed vertices
+		meshes.push_back ( std::unique_ptr<Mesh> ( createSphere ( device, glm::vec3 ( 0 ), 1.0f, 64, 64 ) ) );			// 16-bit indices
+
+		for ( auto& m : meshes )
+			log () << (m->isPacked () ? "packed, " : "basic, ") << (m->getIndexType () == VK_INDEX_TYPE_UINT16 ? "16" : "32")
+				   << "-bit indices, " << m->getNumTriangles () << " triangles" << Log::endl;
+
+		createPipelines ();
+	}
+
+	void	createUniformBuffers ()
+	{
+		uniformBuffers.resize ( swapChain.imageCount () );
+
+		for ( auto& ub : uniformBuffers )
+			ub.create ( device );
+	}
+
+	void	createDescriptorSets ()
+	{
+		descriptorSets.resize ( swapChain.imageCount () );
+
+		for ( uint32_t i = 0; i < swapChain.imageCount (); i++ )
+		{
+			descriptorSets [i]
+				.setLayout ( device, descAllocator, pipeline.getDescLayout () )
+				.addBuffer ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers [i], 0, sizeof ( UniformBufferObject ) )
+				.create    ();
+		}
+	}
+
+	virtual	void	createPipelines () override
+	{
+		createUniformBuffers    ();
+		createDefaultRenderPass ( renderPass );
+		setupPullingPipeline    ( pipeline );
+
+		pipeline.setDevice ( device )
+				.setVertexShader   ( "shaders/vertex-pulling.vert.spv" )
+				.setFragmentShader ( "shaders/occlusion-scene.frag.spv" )
+				.setSize           ( swapChain.getExtent ().width, swapChain.getExtent ().height )
+				.addDescLayout     ( 0, DescSetLayout ()
+					.add ( 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT ) )
+				.setCullMode       ( VK_CULL_MODE_NONE )
+				.setDepthTest      ( true )
+				.setDepthWrite     ( true )
+				.create            ( renderPass );
+
+				// create before command buffers
+		swapChain.createFramebuffers ( renderPass, depthTexture.getImageView () );
+
+		createDescriptorSets ();
+		createCommandBuffers ();
+	}
+
+	virtual	void	freePipelines () override
+	{
+		commandBuffers.clear  ();
+		pipeline.clean        ();
+		renderPass.clean      ();
+		uniformBuffers.clear  ();
+		descriptorSets.clear  ();
+		descAllocator.clean   ();
+	}
+
+	virtual	void	submit ( uint32_t imageIndex ) override
+	{
+		updateUniformBuffer ( imageIndex );
+		defaultSubmit       ( commandBuffers [imageIndex] );
+	}
+
+	void	createCommandBuffers ()
+	{
+		auto	framebuffers = swapChain.getFramebuffers ();
+
+		commandBuffers = device.allocCommandBuffers ( (uint32_t)framebuffers.size ());
+
+		for ( size_t i = 0; i < commandBuffers.size(); i++ )
+		{
+			CommandBuffer&	cb = commandBuffers [i];
+
+			cb.begin ().beginRenderPass ( RenderPassInfo ( renderPass ).framebuffer ( framebuffers [i] ).extent ( swapChain.getExtent ().width, swapChain.getExtent ().height ).clearColor ().clearDepthStencil () )
+			  .pipeline          ( pipeline )
+			  .addDescriptorSets ( { descriptorSets [i] } )
+			  .setViewport       ( swapChain.getExtent () )
+			  .setScissor        ( swapChain.getExtent () );
+
+			for ( size_t k = 0; k < meshes.size (); k++ )
+				meshes [k]->renderPulling ( cb, pipeline.getLayout (), meshInstances, (uint32_t) k * meshInstances );
+
+			cb.end ();
+		}
+	}
+
+	void updateUniformBuffer ( uint32_t currentImage )
+	{
+		UniformBufferObject	ubo  = {};
+
+		ubo.mv   = controller->getModelView ();
+		ubo.proj = projectionMatrix ( 45, getAspect (), 0.1f, 200.0f );
+		ubo.grid = glm::vec4 ( gridSize, spacing, 0, 0 );
+
+		*uniformBuffers [currentImage].getPtr () = ubo;
+	}
+};
+
+int main ( int argc, const char * argv [] )
+{
+	DevicePolicy	policy;
+
+	return ExampleWindow ( 1200, 1200, "Vertex pulling", &policy ).run ();
+}
@@ -10,10 +10,11 @@ layout(std140, binding = 0) uniform UniformBufferObject
 	mat4 shadowMat;
 } ubo;
 
-layout ( location = 0 ) in vec3 pos;
-layout ( location = 1 ) in vec2 texCoord;
+layout ( location = 0 ) in vec3 pos;			// PositionVertex stream, Mesh::renderDepth
 //layout ( location = 2 ) in vec3 normal;
 
+invariant gl_Position;							// depth prepass relies on exactly equal depth in main pass
+
 //layout(location = 0) out vec2 tex;
 //layout(location = 1) out vec3 n;
 //layout(location = 2) out vec3 l;
@@ -0,0 +1,30 @@
+//
+// Dithered crossfade between LOD levels: both levels are drawn with complementary
+// 4x4 Bayer patterns, so every pixel is covered by exactly one of them
+//
+
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout ( location = 0 ) in vec3 n;
+layout ( location = 1 ) flat in float fade;
+layout ( location = 2 ) flat in uint  second;
+
+layout ( location = 0 ) out vec4 color;
+
+const float	bayer [16] = float [16] ( 0.0,  8.0,  2.0, 10.0,
+									  12.0, 4.0, 14.0,  6.0,
+									  3.0, 11.0,  1.0,  9.0,
+									  15.0, 7.0, 13.0,  5.0 );
+
+void main ()
+{
+	ivec2	p = ivec2 ( gl_FragCoord.xy ) & 3;
+	float	d = (bayer [p.y * 4 + p.x] + 0.5) / 16.0;
+
+	if ( (d < fade) != (second != 0) )
+		discard;
+
+		// light at the eye
+	color = vec4 ( 0.9, 0.7, 0.3, 1.0 ) * (0.3 + 0.7 * abs ( normalize ( n ).z ));
+}
@@ -0,0 +1,48 @@
+//
+// Vertex shader for LOD crowd: instances of every level are stored in their own region
+// of instance buffer, base of region comes in push constants
+//
+
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout ( std140, binding = 0 ) uniform UniformBufferObject
+{
+	mat4	mv;
+	mat4	proj;
+};
+
+struct LodInstance
+{
+	vec4	pos;
+	float	fade;			// weight of coarser level
+	uint	second;			// 1 if this is coarser level of crossfade
+	float	pad0, pad1;
+};
+
+layout ( std430, binding = 1 ) readonly buffer Instances
+{
+	LodInstance	instances [];
+};
+
+layout ( push_constant ) uniform PushConstants
+{
+	uint	base;
+};
+
+layout ( location = 0 ) in vec3 pos;
+layout ( location = 2 ) in vec3 normal;
+
+layout ( location = 0 ) out vec3 n;
+layout ( location = 1 ) flat out float fade;
+layout ( location = 2 ) flat out uint  second;
+
+void main ()
+{
+	LodInstance	obj = instances [base + gl_InstanceIndex];
+
+	gl_Position = proj * mv * vec4 ( pos + obj.pos.xyz, 1.0 );
+	n           = mat3 ( mv ) * normal;
+	fade        = obj.fade;
+	second      = obj.second;
+}
@@ -0,0 +1,62 @@
+//
+// Vertex shader for multi-draw-indirect model: matrix and material come from
+// per-draw data buffer indexed by gl_DrawID
+//
+
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shader_draw_parameters : enable
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec2 tex;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec3 tangent;
+layout(location = 4) in vec3 binormal;
+
+layout(std140, binding = 0) uniform UniformBufferObject 
+{
+	mat4 mv;
+	mat4 proj;
+	vec4 eye;		// eye position
+	vec4 lightDir;
+} ubo;
+
+struct DrawData
+{
+	mat4	matrix;
+	uint	albedo, metallic, normal, roughness;
+};
+
+layout ( std430, binding = 3 ) readonly buffer Draws
+{
+	DrawData	draws [];
+};
+
+layout(location = 0) out vec2 tx;
+layout(location = 1) out vec3 v;
+layout(location = 2) out vec3 l;
+layout(location = 3) out vec3 h;
+layout(location = 4) flat out uvec4 material;		// albedo, metallic, normal, roughness
+
+void main(void)
+{
+	DrawData	obj = draws [gl_DrawIDARB];
+	mat4	mv = ubo.mv * obj.matrix;
+	mat3	nm = inverse ( transpose ( mat3 ( mv ) ) );
+	vec4	p  = mv * vec4 ( pos, 1.0 );
+
+	vec3	n  = nm * normal;
+	vec3	t  = nm * tangent;
+	vec3	b  = nm * binormal;
+	vec3	l1 = normalize ( ubo.lightDir.xyz );
+	vec3	v1 = normalize ( ubo.eye.xyz - p.xyz );
+	vec3	h1 = normalize ( l1 + v1             );
+	
+				// convert to TBN
+	v  = vec3 ( dot ( v1, t ), dot ( v1, b ), dot ( v1, n ) );
+	l  = vec3 ( dot ( l1, t ), dot ( l1, b ), dot ( l1, n ) );
+	h  = vec3 ( dot ( h1, t ), dot ( h1, b ), dot ( h1, n ) );
+	tx = tex;
+	material    = uvec4 ( obj.albedo, obj.metallic, obj.normal, obj.roughness );
+	gl_Position = ubo.proj * p;
+}
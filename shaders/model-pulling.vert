@@ -0,0 +1,88 @@
+//
+// Vertex shader for Model::renderIndirectPulling: BasicVertex and index are read through
+// buffer device addresses, matrix and material come from per-draw data buffer indexed by
+// gl_DrawID. Output is the same as of model-pbr-mdi.vert
+//
+
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shader_draw_parameters : enable
+#extension GL_EXT_buffer_reference : require
+
+layout(std140, binding = 0) uniform UniformBufferObject 
+{
+	mat4 mv;
+	mat4 proj;
+	vec4 eye;		// eye position
+	vec4 lightDir;
+} ubo;
+
+struct DrawData
+{
+	mat4	matrix;
+	uint	albedo, metallic, normal, roughness;
+};
+
+layout ( std430, binding = 3 ) readonly buffer Draws
+{
+	DrawData	draws [];
+};
+
+layout ( buffer_reference, std430, buffer_reference_align = 4 ) readonly buffer Words
+{
+	uint	data [];
+};
+
+layout ( push_constant ) uniform PullingData
+{
+	Words	vertices;
+	Words	indices;
+	uint	flags;				// 2 - 16-bit indices
+} push;
+
+layout(location = 0) out vec2 tx;
+layout(location = 1) out vec3 v;
+layout(location = 2) out vec3 l;
+layout(location = 3) out vec3 h;
+layout(location = 4) flat out uvec4 material;		// albedo, metallic, normal, roughness
+
+uint	fetchIndex ( uint i )
+{
+	if ( ( push.flags & 2u ) == 0u )
+		return push.indices.data [i];
+
+	uint	w = push.indices.data [i >> 1];
+
+	return ( i & 1u ) != 0u ? w >> 16 : w & 0xFFFFu;
+}
+
+vec3	fetchVec3 ( uint offs )
+{
+	return uintBitsToFloat ( uvec3 ( push.vertices.data [offs], push.vertices.data [offs + 1], push.vertices.data [offs + 2] ) );
+}
+
+void main(void)
+{
+	uint		base = 14u * fetchIndex ( gl_VertexIndex );		// BasicVertex is 14 floats
+	vec3		pos  = fetchVec3 ( base );
+	vec2		tex  = uintBitsToFloat ( uvec2 ( push.vertices.data [base + 3], push.vertices.data [base + 4] ) );
+	DrawData	obj  = draws [gl_DrawIDARB];
+	mat4	mv = ubo.mv * obj.matrix;
+	mat3	nm = inverse ( transpose ( mat3 ( mv ) ) );
+	vec4	p  = mv * vec4 ( pos, 1.0 );
+
+	vec3	n  = nm * fetchVec3 ( base + 5 );
+	vec3	t  = nm * fetchVec3 ( base + 8 );
+	vec3	b  = nm * fetchVec3 ( base + 11 );
+	vec3	l1 = normalize ( ubo.lightDir.xyz );
+	vec3	v1 = normalize ( ubo.eye.xyz - p.xyz );
+	vec3	h1 = normalize ( l1 + v1             );
+	
+				// convert to TBN
+	v  = vec3 ( dot ( v1, t ), dot ( v1, b ), dot ( v1, n ) );
+	l  = vec3 ( dot ( l1, t ), dot ( l1, b ), dot ( l1, n ) );
+	h  = vec3 ( dot ( h1, t ), dot ( h1, b ), dot ( h1, n ) );
+	tx = tex;
+	material    = uvec4 ( obj.albedo, obj.metallic, obj.normal, obj.roughness );
+	gl_Position = ubo.proj * p;
+}
@@ -0,0 +1,10 @@
+//
+// Occlusion query boxes write nothing, only samples passed depth test are counted
+//
+
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+void main ()
+{
+}
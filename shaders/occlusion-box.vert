@@ -0,0 +1,44 @@
+//
+// Bounding box of tested object for occlusion query, box index is gl_InstanceIndex.
+// When camera is inside box grown by margin, box is turned into full screen quads at near plane
+//
+
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+struct Box
+{
+	vec4	minPoint;
+	vec4	maxPoint;
+};
+
+layout ( std140, binding = 0 ) uniform Params
+{
+	mat4	viewProj;
+	vec4	eye;			// w - margin
+};
+
+layout ( std430, binding = 1 ) readonly buffer Boxes
+{
+	Box	boxes [];
+};
+
+		// corners are encoded as bits: 1 - x, 2 - y, 4 - z
+const int	corners [36] = int [36] ( 0, 2, 3,  0, 3, 1,		// z = min
+								  4, 5, 7,  4, 7, 6,		// z = max
+								  0, 1, 5,  0, 5, 4,		// y = min
+								  2, 6, 7,  2, 7, 3,		// y = max
+								  0, 4, 6,  0, 6, 2,		// x = min
+								  1, 3, 7,  1, 7, 5 );		// x = max
+
+void main ()
+{
+	Box		box    = boxes [gl_InstanceIndex];
+	int		corner = corners [gl_VertexIndex];
+	vec3	t      = vec3 ( corner & 1, (corner >> 1) & 1, (corner >> 2) & 1 );
+
+	if ( all ( greaterThanEqual ( eye.xyz, box.minPoint.xyz - vec3 ( eye.w ) ) ) && all ( lessThanEqual ( eye.xyz, box.maxPoint.xyz + vec3 ( eye.w ) ) ) )
+		gl_Position = vec4 ( 2.0 * t.xy - 1.0, 0.0, 1.0 );
+	else
+		gl_Position = viewProj * vec4 ( mix ( box.minPoint.xyz, box.maxPoint.xyz, t ), 1.0 );
+}
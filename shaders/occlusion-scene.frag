@@ -0,0 +1,13 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout ( location = 0 ) in vec3 n;
+layout ( location = 1 ) in vec4 clr;
+
+layout ( location = 0 ) out vec4 color;
+
+void main ()
+{
+		// light at the eye
+	color = clr * (0.3 + 0.7 * abs ( normalize ( n ).z ));
+}
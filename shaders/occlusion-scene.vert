@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout ( std140, binding = 0 ) uniform UniformBufferObject
+{
+	mat4	mv;
+	mat4	proj;
+};
+
+layout ( push_constant ) uniform Object
+{
+	vec4	offs;
+	vec4	color;
+};
+
+layout ( location = 0 ) in vec3 pos;
+layout ( location = 2 ) in vec3 normal;
+
+layout ( location = 0 ) out vec3 n;
+layout ( location = 1 ) out vec4 clr;
+
+void main ()
+{
+	gl_Position = proj * mv * vec4 ( pos + offs.xyz, 1.0 );
+	n           = mat3 ( mv ) * normal;
+	clr         = color;
+}
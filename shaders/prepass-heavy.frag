@@ -0,0 +1,35 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+	// synthetic expensive shading, cost is set by ubo.light.w
+layout(std140, binding = 0) uniform UniformBufferObject 
+{
+	mat4 mv;
+	mat4 proj;
+	mat4 nm;
+	vec4 light;
+	mat4 shadowMat;
+} ubo;
+
+layout(location = 0) in vec2 tex;
+layout(location = 1) in vec3 n;
+layout(location = 2) in vec3 l;
+
+layout(location = 0) out vec4 color;
+
+void main(void)
+{
+	int		count = int ( ubo.light.w );
+	vec3	n2    = normalize ( n );
+	vec3	c     = vec3 ( 0.0 );
+
+	for ( int i = 0; i < count; i++ )
+	{
+		vec2	t = tex * float ( i + 1 );
+		vec3	d = normalize ( vec3 ( sin ( t.x * 7.1 + float ( i ) ), cos ( t.y * 5.3 - float ( i ) ), 1.0 ) );
+
+		c += pow ( max ( dot ( n2, d ), 0.0 ), 8.0 ) * vec3 ( 0.5 + 0.5 * sin ( float ( i ) ), 0.5, 0.5 + 0.5 * cos ( float ( i ) ) );
+	}
+
+	color = vec4 ( max ( dot ( n2, normalize ( l ) ), 0.2 ) * vec3 ( 0.5 ) + c / max ( float ( count ), 1.0 ), 1.0 );
+}
@@ -0,0 +1,32 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+	// main pass of benchmark-depth-prepass, block is the same as in depthpass.vert
+layout(std140, binding = 0) uniform UniformBufferObject 
+{
+	mat4 mv;
+	mat4 proj;
+	mat4 nm;
+	vec4 light;			// w is number of shading iterations
+	mat4 shadowMat;
+} ubo;
+
+layout ( location = 0 ) in vec3 pos;
+layout ( location = 1 ) in vec2 texCoord;
+layout ( location = 2 ) in vec3 normal;
+
+layout(location = 0) out vec2 tex;
+layout(location = 1) out vec3 n;
+layout(location = 2) out vec3 l;
+
+invariant gl_Position;						// must match depth of depthpass.vert exactly
+
+void main(void)
+{
+	vec4 	p  = ubo.mv * vec4 ( pos, 1.0 );
+
+	n           = normalize ( mat3 ( ubo.nm ) * normal );
+	l           = normalize ( ubo.light.xyz - p.xyz );
+	tex         = texCoord;
+	gl_Position = ubo.proj * p;
+}
@@ -0,0 +1,43 @@
+//
+// Vertex shader for instanced batches of RenderQueue: object matrix and material
+// come from per-instance buffer, albedo index selects color from palette
+//
+
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout ( std140, binding = 0 ) uniform UniformBufferObject
+{
+	mat4	mv;
+	mat4	proj;
+};
+
+struct InstanceData
+{
+	mat4	matrix;
+	uint	albedo, metallic, normal, roughness;
+};
+
+layout ( std430, binding = 1 ) readonly buffer Instances
+{
+	InstanceData	instances [];
+};
+
+layout ( location = 0 ) in vec3 pos;
+layout ( location = 2 ) in vec3 normal;
+
+layout ( location = 0 ) out vec3 n;
+layout ( location = 1 ) out vec4 clr;
+
+const vec3	palette [8] = vec3 [8] ( vec3 ( 1.0, 0.8, 0.2 ), vec3 ( 0.9, 0.3, 0.2 ), vec3 ( 0.3, 0.8, 0.3 ), vec3 ( 0.2, 0.5, 0.9 ),
+									 vec3 ( 0.8, 0.4, 0.9 ), vec3 ( 0.3, 0.9, 0.9 ), vec3 ( 0.9, 0.9, 0.9 ), vec3 ( 0.6, 0.5, 0.4 ) );
+
+void main ()
+{
+	InstanceData	obj = instances [gl_InstanceIndex];
+	mat4			m   = mv * obj.matrix;
+
+	gl_Position = proj * m * vec4 ( pos, 1.0 );
+	n           = mat3 ( m ) * normal;
+	clr         = vec4 ( palette [obj.albedo % 8], 1.0 );
+}
@@ -2,8 +2,14 @@
 
 #extension GL_EXT_nonuniform_qualifier : require
 
-layout ( set = 0, binding = 1 ) uniform sampler samp;
-layout ( set = 0, binding = 2 ) uniform texture2D textures [];
+layout ( set = 1, binding = 0 ) uniform texture2D textures [];		// bindless heap
+layout ( set = 1, binding = 1 ) uniform sampler   samplers [];
+
+layout ( push_constant ) uniform TextureIndices
+{
+	uint	firstTexture;
+	uint	samplerIndex;
+};
 
 layout(location = 0) in vec2 tex;
 layout(location = 0) out vec4 color;
@@ -12,7 +18,7 @@ void main()
 {
 	vec2  t  = tex * vec2 ( 4.0, 4.0 );
 	ivec2 i  = ivec2 ( t );
-	int   no = (i.x + 4 * i.y) % 8;
+	uint  no = firstTexture + uint ( (i.x + 4 * i.y) % 8 );
 	
-	color = texture ( sampler2D ( textures [nonuniformEXT ( no )], samp ), tex );
-}
\ No newline at end of file
+	color = texture ( sampler2D ( textures [nonuniformEXT ( no )], samplers [samplerIndex] ), tex );
+}
@@ -0,0 +1,33 @@
+//
+// Vertex shader for vertex format comparison: BasicVertex input, instances are placed
+// on a grid, color is made from texture coordinates and tangent frame
+//
+
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout ( std140, binding = 0 ) uniform UniformBufferObject
+{
+	mat4	mv;
+	mat4	proj;
+	vec4	grid;				// grid size and spacing
+};
+
+layout ( location = 0 ) in vec3 pos;
+layout ( location = 1 ) in vec2 tex;
+layout ( location = 2 ) in vec3 normal;
+layout ( location = 3 ) in vec3 tangent;
+layout ( location = 4 ) in vec3 binormal;
+
+layout ( location = 0 ) out vec3 n;
+layout ( location = 1 ) out vec4 clr;
+
+void main ()
+{
+	int		size = int ( grid.x );
+	vec3	offs = grid.y * vec3 ( 0, gl_InstanceIndex / size - size / 2, gl_InstanceIndex % size - size / 2 );
+
+	gl_Position = proj * mv * vec4 ( pos + offs, 1.0 );
+	n           = mat3 ( mv ) * normal;
+	clr         = vec4 ( 0.6 + 0.2 * fract ( 4.0 * tex ), 0.6 + 0.2 * abs ( dot ( tangent, binormal ) ), 1.0 );
+}
@@ -0,0 +1,44 @@
+//
+// Vertex shader for PackedVertex: half position with bitangent sign in w, half texture
+// coordinates, octahedral normal and tangent. Output is the same as of vertex-basic.vert
+//
+
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout ( std140, binding = 0 ) uniform UniformBufferObject
+{
+	mat4	mv;
+	mat4	proj;
+	vec4	grid;				// grid size and spacing
+};
+
+layout ( location = 0 ) in vec4 pos;
+layout ( location = 1 ) in vec2 tex;
+layout ( location = 2 ) in vec4 frame;
+
+layout ( location = 0 ) out vec3 n;
+layout ( location = 1 ) out vec4 clr;
+
+vec3	octDecode ( vec2 e )
+{
+	vec3	v = vec3 ( e, 1.0 - abs ( e.x ) - abs ( e.y ) );
+	float	t = max ( -v.z, 0.0 );
+
+	v.xy += mix ( vec2 ( t ), vec2 ( -t ), greaterThanEqual ( v.xy, vec2 ( 0.0 ) ) );
+
+	return normalize ( v );
+}
+
+void main ()
+{
+	int		size     = int ( grid.x );
+	vec3	offs     = grid.y * vec3 ( 0, gl_InstanceIndex / size - size / 2, gl_InstanceIndex % size - size / 2 );
+	vec3	normal   = octDecode ( frame.xy );
+	vec3	tangent  = octDecode ( frame.zw );
+	vec3	binormal = pos.w * cross ( normal, tangent );
+
+	gl_Position = proj * mv * vec4 ( pos.xyz + offs, 1.0 );
+	n           = mat3 ( mv ) * normal;
+	clr         = vec4 ( 0.6 + 0.2 * fract ( 4.0 * tex ), 0.6 + 0.2 * abs ( dot ( tangent, binormal ) ), 1.0 );
+}
@@ -0,0 +1,93 @@
+//
+// Vertex pulling for Mesh::renderPulling: indices and vertices are read through buffer
+// device addresses, BasicVertex and PackedVertex meshes with 16 or 32-bit indices share
+// this shader. Uniforms and output are the same as of vertex-basic.vert
+//
+
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_buffer_reference : require
+
+layout ( std140, binding = 0 ) uniform UniformBufferObject
+{
+	mat4	mv;
+	mat4	proj;
+	vec4	grid;				// grid size and spacing
+};
+
+layout ( buffer_reference, std430, buffer_reference_align = 4 ) readonly buffer Words
+{
+	uint	data [];
+};
+
+layout ( push_constant ) uniform PullingData
+{
+	Words	vertices;
+	Words	indices;
+	uint	flags;				// 1 - PackedVertex, 2 - 16-bit indices
+} push;
+
+layout ( location = 0 ) out vec3 n;
+layout ( location = 1 ) out vec4 clr;
+
+uint	fetchIndex ( uint i )
+{
+	if ( ( push.flags & 2u ) == 0u )
+		return push.indices.data [i];
+
+	uint	w = push.indices.data [i >> 1];
+
+	return ( i & 1u ) != 0u ? w >> 16 : w & 0xFFFFu;
+}
+
+vec3	octDecode ( vec2 e )
+{
+	vec3	v = vec3 ( e, 1.0 - abs ( e.x ) - abs ( e.y ) );
+	float	t = max ( -v.z, 0.0 );
+
+	v.xy += mix ( vec2 ( t ), vec2 ( -t ), greaterThanEqual ( v.xy, vec2 ( 0.0 ) ) );
+
+	return normalize ( v );
+}
+
+vec3	fetchVec3 ( uint offs )
+{
+	return uintBitsToFloat ( uvec3 ( push.vertices.data [offs], push.vertices.data [offs + 1], push.vertices.data [offs + 2] ) );
+}
+
+void main ()
+{
+	uint	index = fetchIndex ( gl_VertexIndex );
+	vec3	pos, normal, tangent, binormal;
+	vec2	tex;
+
+	if ( ( push.flags & 1u ) != 0u )			// PackedVertex, 5 words
+	{
+		uint	base = 5u * index;
+		vec2	xy   = unpackHalf2x16   ( push.vertices.data [base] );
+		vec2	zw   = unpackHalf2x16   ( push.vertices.data [base + 1] );
+
+		pos      = vec3 ( xy, zw.x );
+		tex      = unpackHalf2x16 ( push.vertices.data [base + 2] );
+		normal   = octDecode ( unpackSnorm2x16 ( push.vertices.data [base + 3] ) );
+		tangent  = octDecode ( unpackSnorm2x16 ( push.vertices.data [base + 4] ) );
+		binormal = zw.y * cross ( normal, tangent );
+	}
+	else										// BasicVertex, 14 floats
+	{
+		uint	base = 14u * index;
+
+		pos      = fetchVec3 ( base );
+		tex      = uintBitsToFloat ( uvec2 ( push.vertices.data [base + 3], push.vertices.data [base + 4] ) );
+		normal   = fetchVec3 ( base + 5 );
+		tangent  = fetchVec3 ( base + 8 );
+		binormal = fetchVec3 ( base + 11 );
+	}
+
+	int		size = int ( grid.x );
+	vec3	offs = grid.y * vec3 ( 0, gl_InstanceIndex / size - size / 2, gl_InstanceIndex % size - size / 2 );
+
+	gl_Position = proj * mv * vec4 ( pos + offs, 1.0 );
+	n           = mat3 ( mv ) * normal;
+	clr         = vec4 ( 0.6 + 0.2 * fract ( 4.0 * tex ), 0.6 + 0.2 * abs ( dot ( tangent, binormal ) ), 1.0 );
+}